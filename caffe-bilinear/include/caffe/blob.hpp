@@ -24,7 +24,8 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), diff_free_(false),
+         diff_forbidden_(false) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -216,6 +217,21 @@ class Blob {
     return diff_;
   }
 
+  /**
+   * @brief Set whether the blob has a diff. A diff-free blob frees its diff
+   *        and allocates none when reshaped; the first access to its diff
+   *        allocates it zeroed and ends the diff-free state. Net makes
+   *        diff-free the blobs that never receive gradients.
+   */
+  void set_diff_free(bool diff_free);
+  inline bool diff_free() const { return diff_free_; }
+  /**
+   * @brief Make the blob diff-free for good: any access to its diff is an
+   *        error, and so is sharing it. Used by nets that only run forward.
+   */
+  void ForbidDiff();
+  inline bool diff_forbidden() const { return diff_forbidden_; }
+
   const Dtype* cpu_data() const;
   void set_cpu_data(Dtype* data);
   const int* gpu_shape() const;
@@ -260,19 +276,27 @@ class Blob {
    *        in their Forward pass.
    *
    * This deallocates the SyncedMemory holding this Blob's diff_, as
-   * shared_ptr calls its destructor when reset with the "=" operator.
+   * shared_ptr calls its destructor when reset with the "=" operator. A Blob
+   * with a diff gives other its diff back if other is diff-free; a diff-free
+   * Blob stays diff-free when sharing with another one. A Blob whose diff is
+   * forbidden keeps no diff, and sharing a forbidden diff forbids this one.
    */
   void ShareDiff(const Blob& other);
 
   bool ShapeEquals(const BlobProto& other);
 
  protected:
+  /// @brief Allocates the diff of a diff-free blob before it is accessed.
+  void AllocateDiff() const;
+
   shared_ptr<SyncedMemory> data_;
   shared_ptr<SyncedMemory> diff_;
   shared_ptr<SyncedMemory> shape_data_;
   vector<int> shape_;
   int count_;
   int capacity_;
+  bool diff_free_;
+  bool diff_forbidden_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
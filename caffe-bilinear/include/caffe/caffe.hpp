@@ -16,6 +16,7 @@
 #include "caffe/solver_factory.hpp"
 #include "caffe/util/benchmark.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/memory_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 #endif  // CAFFE_CAFFE_HPP_
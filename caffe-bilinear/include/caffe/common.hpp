@@ -93,6 +93,8 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
+class MemoryPool;
+
 // A global initialization function that you should call in your main function.
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
@@ -168,6 +170,9 @@ class Caffe {
   inline static bool multiprocess() { return Get().multiprocess_; }
   inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
+  // The cache of host and device buffers behind SyncedMemory, shared by all
+  // threads.
+  static MemoryPool& memory_pool();
 
  protected:
 
@@ -50,6 +50,21 @@ class DataTransformer {
   void Transform(const vector<Datum> & datum_vector,
                 Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the transformation defined in the data layer's
+   * transform_param block to raw uint8 pixels, such as a record of a
+   * memory-mapped ReIDDataset. If stripes is set, the image is first cut into
+   * overlapping horizontal stripes stacked along the channels, read in place.
+   *
+   * @param pixels
+   *    channels x height x width bytes in CHW order.
+   * @param transformed_blob
+   *    This is destination blob. It can be part of top blob's data if
+   *    set_cpu_data() is used. See reid_data_layer.cpp for an example.
+   */
+  void Transform(const uint8_t* pixels, int channels, int height, int width,
+                Blob<Dtype>* transformed_blob);
+
 #ifdef USE_OPENCV
   /**
    * @brief Applies the transformation defined in the data layer's
@@ -98,6 +113,11 @@ class DataTransformer {
    *    Datum containing the data to be transformed.
    */
   vector<int> InferBlobShape(const Datum& datum);
+  /**
+   * @brief Infers the shape of transformed_blob will have when
+   *    the transformation is applied to raw pixels of the given shape.
+   */
+  vector<int> InferBlobShape(int channels, int height, int width);
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -139,6 +159,15 @@ class DataTransformer {
   virtual int Rand(int n);
 
   void Transform(const Datum& datum, Dtype* transformed_data);
+  void Transform(const uint8_t* pixels, int channels, int height, int width,
+                Dtype* transformed_data);
+  // The shape of an image of channels x height x width once cut into the
+  // regions of the stripes / stripe_overlap parameters (the same shape if
+  // unset), and the address of row h of channel c of those regions.
+  void RegionShape(int channels, int height, int* region_channels,
+                   int* region_height) const;
+  const uint8_t* RegionRow(const uint8_t* pixels, int channels, int height,
+                           int width, int region_height, int c, int h) const;
   // Tranformation parameters
   TransformationParameter param_;
 
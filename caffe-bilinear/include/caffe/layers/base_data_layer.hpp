@@ -9,6 +9,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -43,12 +44,15 @@ class BaseDataLayer : public Layer<Dtype> {
   TransformationParameter transform_param_;
   shared_ptr<DataTransformer<Dtype> > data_transformer_;
   bool output_labels_;
+  // Whether a third top receives the camera ids of the items, for layers
+  // such as CosineSimilarityBatch that compare items across cameras.
+  bool output_cameras_;
 };
 
 template <typename Dtype>
 class Batch {
  public:
-  Blob<Dtype> data_, label_;
+  Blob<Dtype> data_, label_, camera_;
 };
 
 template <typename Dtype>
@@ -77,6 +81,13 @@ class BasePrefetchingDataLayer :
   Batch<Dtype>* prefetch_current_;
 
   Blob<Dtype> transformed_data_;
+
+  // Set when data_param().decode_threads() > 1: the threads load_batch may
+  // spread the decoding and transformation of a batch over, each with its
+  // own transformer (and random generator) so that results do not depend on
+  // thread scheduling. decode_transformers_[0] is data_transformer_.
+  shared_ptr<ThreadPool> decode_pool_;
+  vector<shared_ptr<DataTransformer<Dtype> > > decode_transformers_;
 };
 
 }  // namespace caffe
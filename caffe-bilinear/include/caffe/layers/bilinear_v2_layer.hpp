@@ -0,0 +1,77 @@
+#ifndef CAFFE_BILINEAR_V2_LAYER_HPP_
+#define CAFFE_BILINEAR_V2_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Computes the bilinear (outer product) pooling of two feature maps
+ *        over non-overlapping patch_h x patch_w patches:
+ *        @f$ y_{n, a C_b + b, i, j} = \sum_{(u, v) \in patch(i, j)}
+ *            x^A_{n, a, u, v} x^B_{n, b, u, v} @f$.
+ *
+ * This is the Bilinear layer with kernel = stride = patch and no padding,
+ * computed directly on the NCHW inputs. Bilinear stages each input through
+ * im2col and a transpose, and the products through one more buffer, which
+ * costs 2 N (C_a + C_b) patch_h patch_w H' W' + 2 N C_a C_b H' W' values
+ * (data and diff) on top of the inputs and output. BilinearV2 needs no
+ * buffer on the GPU, where each thread block computes a tile of products
+ * from tiles of the two patches held in shared memory, and only
+ * (C_a + C_b) patch_h patch_w + C_a C_b values on the CPU, where each patch
+ * is packed for one GEMM. Rows and columns past the last whole patch are
+ * ignored.
+ *
+ * @param bottom input Blob vector (length 2)
+ *   -# @f$ (N \times C_a \times H \times W) @f$ the first features
+ *   -# @f$ (N \times C_b \times H \times W) @f$ the second features
+ * @param top output Blob vector (length 1)
+ *   -# @f$ (N \times C_a C_b \times H / patch_h \times W / patch_w) @f$
+ */
+template <typename Dtype>
+class BilinearV2Layer : public Layer<Dtype> {
+ public:
+  explicit BilinearV2Layer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "BilinearV2"; }
+  virtual inline int ExactNumBottomBlobs() const { return 2; }
+  virtual inline int ExactNumTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Copies the channels x patch_h x patch_w values of the patch (ph, pw) of
+  // image n between an NCHW blob and a channels x (patch_h patch_w) matrix.
+  void PackPatch(const Dtype* blob, int channels, int n, int ph, int pw,
+      Dtype* patch) const;
+  void UnpackPatch(const Dtype* patch, int channels, int n, int ph, int pw,
+      Dtype* blob) const;
+
+  int patch_h_, patch_w_;
+  int num_, channels_a_, channels_b_, height_, width_;
+  int top_height_, top_width_;
+  // CPU scratch for one patch: the packed inputs, and their products.
+  Blob<Dtype> patch_a_;
+  Blob<Dtype> patch_b_;
+  Blob<Dtype> product_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_BILINEAR_V2_LAYER_HPP_
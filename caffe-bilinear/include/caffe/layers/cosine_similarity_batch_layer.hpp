@@ -18,7 +18,7 @@ template <typename Dtype>
 class CosineSimilarityBatchLayer : public Layer<Dtype>{
  public:
   explicit CosineSimilarityBatchLayer(const LayerParameter& param)
-      : Layer<Dtype>(param), xy_(NULL) {}
+      : Layer<Dtype>(param), xy_(NULL), num_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -43,9 +43,21 @@ class CosineSimilarityBatchLayer : public Layer<Dtype>{
       const vector<Blob<Dtype>*>& top);
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
-  
+
+  // Index in the tops of the pair of items i < j.
+  inline int PairIndex(int i, int j) const {
+    return num_ * i - i * (i + 1) / 2 + j - i - 1;
+  }
+  // Eliminates, in top[2], the pairs that no item selects as one of its
+  // hardest (see hard_negatives, hard_positives and semi_hard).
+  void MinePairs(const vector<Blob<Dtype>*>& top);
+
   Dtype **xy_; 
   int num_;
+  // The pairs i < j not eliminated by the last Forward, the only ones
+  // Backward visits.
+  vector<int> active_i_;
+  vector<int> active_j_;
 };
 
 }  // namespace caffe
@@ -1,6 +1,7 @@
 #ifndef CAFFE_DATA_LAYER_HPP_
 #define CAFFE_DATA_LAYER_HPP_
 
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -13,6 +14,11 @@
 
 namespace caffe {
 
+/**
+ * @brief Provides data to the Net from a database of Datums: the data,
+ *        transformed, and optionally the labels and the camera ids
+ *        (Datum::camera, see tools/convert_reid_dataset.cpp).
+ */
 template <typename Dtype>
 class DataLayer : public BasePrefetchingDataLayer<Dtype> {
  public:
@@ -25,16 +31,25 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
   virtual inline const char* type() const { return "Data"; }
   virtual inline int ExactNumBottomBlobs() const { return 0; }
   virtual inline int MinTopBlobs() const { return 1; }
-  virtual inline int MaxTopBlobs() const { return 2; }
+  virtual inline int MaxTopBlobs() const { return 3; }
 
  protected:
   void Next();
   bool Skip();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Decodes and transforms the worker-th range of values_ into the batch
+  // held by top_data, top_label and top_camera (NULL when not output).
+  void DecodeRange(Dtype* top_data, Dtype* top_label, Dtype* top_camera,
+      int worker);
 
   shared_ptr<db::DB> db_;
   shared_ptr<db::Cursor> cursor_;
   uint64_t offset_;
+  // Raw values of the batch being loaded, and per worker timings, when
+  // decoding in parallel.
+  vector<string> values_;
+  vector<double> read_time_;
+  vector<double> trans_time_;
 };
 
 }  // namespace caffe
@@ -96,6 +96,10 @@ class HingeLossLayer : public LossLayer<Dtype> {
    */
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// Holds the margins when the predictions are diff-free; otherwise their
+  /// diff does, for Backward.
+  Blob<Dtype> margins_;
 };
 
 
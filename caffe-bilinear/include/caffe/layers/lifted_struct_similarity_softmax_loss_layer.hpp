@@ -0,0 +1,84 @@
+#ifndef CAFFE_LIFTED_STRUCT_SIMILARITY_SOFTMAX_LOSS_LAYER_HPP_
+#define CAFFE_LIFTED_STRUCT_SIMILARITY_SOFTMAX_LOSS_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/loss_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Computes the lifted structured embedding loss of Song et al.,
+ *        "Deep Metric Learning via Lifted Structured Feature Embedding",
+ *        over all the pairs of a batch: @f$
+ *          E = \frac{1}{2|P|} \sum\limits_{(i,j) \in P}
+ *              \max \left(J_{ij}, 0\right)^2 @f$ with @f$
+ *          J_{ij} = \log \left( \sum\limits_{k \in N_i} e^{m - d_{ik}} +
+ *              \sum\limits_{l \in N_j} e^{m - d_{jl}} \right) + d_{ij}
+ *          @f$, where P are the pairs of items with the same label,
+ *          N_i the items with a label other than that of item i, m the
+ *          margin and @f$ d_{ij} = \left| \left| x_i - x_j \right| \right|_2
+ *          @f$.
+ *
+ * The distances come from one N x N Gram matrix product and the gradient
+ * goes back to the features through a second one, @f$
+ * \frac{\partial E}{\partial x_i} = \sum_j g_{ij} (x_i - x_j) / d_{ij} @f$,
+ * so the cost is dominated by two GEMMs instead of a loop over triplets.
+ * The log-sum-exp over the negatives of each item is computed once per item
+ * and shared by all its positive pairs.
+ *
+ * @param bottom input Blob vector (length 2)
+ *   -# @f$ (N \times C \times 1 \times 1) @f$
+ *      the features @f$ x \in [-\infty, +\infty]@f$
+ *   -# @f$ (N \times 1 \times 1 \times 1) @f$
+ *      the labels
+ * @param top output Blob vector (length 1)
+ *   -# @f$ (1 \times 1 \times 1 \times 1) @f$
+ *      the computed loss @f$ E @f$
+ */
+template <typename Dtype>
+class LiftedStructSimilaritySoftmaxLossLayer : public LossLayer<Dtype> {
+ public:
+  explicit LiftedStructSimilaritySoftmaxLossLayer(const LayerParameter& param)
+      : LossLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const {
+    return "LiftedStructSimilaritySoftmaxLoss";
+  }
+  virtual inline bool AllowForceBackward(const int bottom_index) const {
+    return bottom_index == 0;
+  }
+
+ protected:
+  /// @copydoc LiftedStructSimilaritySoftmaxLossLayer
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Number of pairs of items with the same label.
+  int CountPositivePairs(const Blob<Dtype>* label) const;
+
+  Blob<Dtype> dot_;         // x_i . x_j, then the gradient weights g_ij / d_ij
+  Blob<Dtype> dist_;        // d_ij
+  Blob<Dtype> log_sum_exp_;  // log of the sum over k in N_i of e^{m - d_ik}
+  Blob<Dtype> row_loss_;    // sum over the pairs of i of max(J_ij, 0)^2
+  Blob<Dtype> row_weight_;  // derivative of the loss wrt log_sum_exp_
+  Blob<Dtype> row_sum_;     // sum over j of g_ij / d_ij
+  Blob<Dtype> ones_;
+  int num_positive_pairs_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_LIFTED_STRUCT_SIMILARITY_SOFTMAX_LOSS_LAYER_HPP_
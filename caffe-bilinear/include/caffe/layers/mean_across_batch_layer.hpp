@@ -6,14 +6,19 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 /**
- * @brief Compute elementwise operations, such as product and sum,
- *        along multiple input Blobs.
+ * @brief Averages the items of a batch over consecutive chunks of
+ *        chunk_size items; the last chunk may be shorter.
  *
- * TODO(dox): thorough documentation for Forward, Backward, and proto params.
+ * The mean of a chunk is repeated for each of its items, or, with reduce,
+ * output once, as a batch of ceil(num / chunk_size) items. Each chunk is
+ * reduced and broadcast in one pass over its items, without a temporary;
+ * on the CPU, ranges of chunks go to num_threads threads. Without reduce,
+ * the layer may work in place.
  */
 template <typename Dtype>
 class MeanAcrossBatchLayer : public Layer<Dtype> {
@@ -39,9 +44,21 @@ class MeanAcrossBatchLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // Averages the chunks of range part of num_parts into out: the mean
+  // repeated for each item of a chunk, or once per chunk with reduce.
+  void AverageChunks(const Dtype* in, Dtype* out, bool reduce, int part,
+      int num_parts);
+  // Writes row c of in, divided by the size of chunk c, to each item of
+  // the chunk: the gradient of reduce.
+  void SpreadChunks(const Dtype* in, Dtype* out, int part, int num_parts);
 
-  Blob<Dtype> mean_in_chunk_;
-
+  int chunk_size_;
+  int num_;
+  int num_chunks_;
+  // Values per item.
+  int count_;
+  bool reduce_;
+  shared_ptr<ThreadPool> pool_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,57 @@
+#ifndef CAFFE_REID_DATA_LAYER_HPP_
+#define CAFFE_REID_DATA_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/reid_dataset.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides data to the Net from a memory-mapped ReIDDataset: the
+ *        records, transformed, and optionally their person labels and
+ *        camera ids.
+ *
+ * Records are read in place, without parsing. With identities_per_batch set,
+ * batches are identity-balanced: P distinct persons with K records each,
+ * as needed by CosineSimilarityBatch and the metric learning losses.
+ */
+template <typename Dtype>
+class ReIDDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit ReIDDataLayer(const LayerParameter& param)
+      : BasePrefetchingDataLayer<Dtype>(param) {}
+  virtual ~ReIDDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "ReIDData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 3; }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch);
+  // Fills records_ with the records of the next batch.
+  void SampleRecords();
+  void SampleIdentities();
+  int Rand(int n);
+
+  ReIDDataset dataset_;
+  shared_ptr<Caffe::RNG> prefetch_rng_;
+  vector<int> records_;
+  // Reading order of the records, or of the identities when sampling by
+  // identity, and the position in it.
+  vector<int> order_;
+  int order_id_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_REID_DATA_LAYER_HPP_
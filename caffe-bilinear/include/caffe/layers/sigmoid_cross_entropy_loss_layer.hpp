@@ -108,6 +108,8 @@ class SigmoidCrossEntropyLossLayer : public LossLayer<Dtype> {
   shared_ptr<SigmoidLayer<Dtype> > sigmoid_layer_;
   /// sigmoid_output stores the output of the SigmoidLayer.
   shared_ptr<Blob<Dtype> > sigmoid_output_;
+  /// Holds the GPU losses when the predictions are diff-free.
+  Blob<Dtype> loss_buffer_;
   /// bottom vector holder to call the underlying SigmoidLayer::Forward
   vector<Blob<Dtype>*> sigmoid_bottom_vec_;
   /// top vector holder to call the underlying SigmoidLayer::Forward
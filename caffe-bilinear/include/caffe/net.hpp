@@ -81,6 +81,14 @@ class Net {
    * a forward pass, e.g. to compute output feature size.
    */
   void Reshape();
+  /**
+   * @brief Sizes the blobs of all layers for inputs of up to max_batch items,
+   *        leaving the input shapes as they are.
+   *
+   * Reshaping the inputs to any batch no larger than max_batch afterwards
+   * allocates nothing, which suits serving batches of varying size.
+   */
+  void Reserve(int max_batch);
 
   Dtype ForwardBackward() {
     Dtype loss;
@@ -104,6 +112,18 @@ class Net {
    *        additional memory) the pre-trained layers from another Net.
    */
   void ShareTrainedLayersWith(const Net* other);
+  /**
+   * @brief Creates a lightweight execution context of this net: a Net built
+   *        from the same definition whose parameter blobs share this net's
+   *        data, so that it only owns its own activation blobs.
+   *
+   * Contexts are meant for concurrent inference: each thread runs Forward on
+   * its own context while the weights stay resident once. The shared
+   * parameters must be treated as read-only while contexts are in use, and
+   * every thread has to set its own Caffe::mode() since Caffe's state is
+   * thread-local.
+   */
+  shared_ptr<Net<Dtype> > CreateContext() const;
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
   // trained layers from another net parameter instance.
   /**
@@ -215,6 +235,8 @@ class Net {
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
   void set_debug_info(const bool value) { debug_info_ = value; }
+  /// @brief returns whether the net runs forward only
+  inline bool inference() const { return inference_; }
 
   // Helpers for Init.
   /**
@@ -272,9 +294,23 @@ class Net {
   void BackwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Update.
   void UpdateDebugInfo(const int param_id);
+  /// @brief Finds the layers whose tops are recomputed for Backward.
+  void SetUpRecompute();
+  /// @brief Whether running a layer forward twice leaves the same tops and
+  ///        state as running it once: false for sampling or statistics
+  ///        gathering layers.
+  bool IsDeterministic(const int layer_id) const;
+  /// @brief Frees the data of the tops of a recomputed segment.
+  void ReleaseSegment(const int segment_id);
+  /// @brief Runs a released segment forward again, along with the released
+  ///        segments it reads from.
+  void RecomputeSegment(const int segment_id);
 
   /// @brief The network name
   string name_;
+  /// @brief The definition (without weights) the net was initialized from,
+  ///        kept to build execution contexts
+  NetParameter net_param_;
   /// @brief The phase: TRAIN or TEST
   Phase phase_;
   /// @brief Individual layers in the net
@@ -328,8 +364,20 @@ class Net {
   vector<bool> has_params_decay_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// Segments of layers whose tops are released after their last use in
+  /// Forward and recomputed in Backward: a layer with recompute set and the
+  /// layers that follow it in place, as [first, last] layer ids, the blobs
+  /// sharing the data of its tops, and the last layer reading them.
+  vector<pair<int, int> > recompute_layers_;
+  vector<vector<int> > recompute_blob_ids_;
+  vector<int> recompute_last_use_;
+  vector<bool> recompute_released_;
+  /// The segment sharing the data of each blob, or -1.
+  vector<int> recompute_segment_of_blob_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether the net runs forward only, with no diffs.
+  bool inference_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
@@ -68,6 +68,17 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  // Frees the memory held, if owned; it is allocated again, uninitialized,
+  // on the next access.
+  void release();
+
+  // Host and device memory held by all the instances, and the most held at
+  // once since the last ResetPeakMemory().
+  static size_t host_memory();
+  static size_t device_memory();
+  static size_t peak_host_memory();
+  static size_t peak_device_memory();
+  static void ResetPeakMemory();
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -0,0 +1,52 @@
+#ifndef CAFFE_TEST_EMBEDDING_UTIL_H_
+#define CAFFE_TEST_EMBEDDING_UTIL_H_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Synthetic re-ID embeddings scattered around people: each person is a
+// Gaussian direction of unit deviation, and each embedding of a person is
+// that direction plus Gaussian noise. Everything is drawn from Caffe's RNG,
+// seeded on construction, in the order of the calls.
+class ClusteredEmbeddings {
+ public:
+  ClusteredEmbeddings(int num_people, int dim,
+      const unsigned int seed = 1701)
+      : num_people_(num_people), dim_(dim), people_(num_people * dim) {
+    Caffe::set_random_seed(seed);
+    caffe_rng_gaussian<float>(people_.size(), 0, 1, &people_[0]);
+  }
+
+  // Fills num embeddings, of person i % num_people for embedding i.
+  void Fill(int num, float noise, float* embeddings) const {
+    caffe_rng_gaussian<float>(num * dim_, 0, noise, embeddings);
+    for (int i = 0; i < num; ++i) {
+      caffe_axpy<float>(dim_, 1, person(i % num_people_),
+          embeddings + i * dim_);
+    }
+  }
+  // One embedding of person p; a zero noise gives the person itself.
+  vector<float> Sample(int p, float noise) const {
+    vector<float> embedding(dim_);
+    if (noise > 0) {
+      caffe_rng_gaussian<float>(dim_, 0, noise, &embedding[0]);
+    }
+    caffe_axpy<float>(dim_, 1, person(p), &embedding[0]);
+    return embedding;
+  }
+
+  inline const float* person(int p) const { return &people_[p * dim_]; }
+
+ protected:
+  int num_people_;
+  int dim_;
+  vector<float> people_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_TEST_EMBEDDING_UTIL_H_
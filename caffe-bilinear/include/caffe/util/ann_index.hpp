@@ -0,0 +1,140 @@
+#ifndef CAFFE_UTIL_ANN_INDEX_HPP_
+#define CAFFE_UTIL_ANN_INDEX_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/reid_search.hpp"
+
+namespace caffe {
+
+class ThreadPool;
+
+/**
+ * @brief An approximate nearest neighbor index over embeddings, for galleries
+ *        too large to search exhaustively with ReIDSearch.
+ *
+ * Embeddings are numbered in the order they are added, from 0. Distances are
+ * those of ReIDSearch: 1 - cos with cosine, the squared euclidean distance
+ * otherwise. The effort knob trades recall for latency; what it counts
+ * depends on the index. Indices are built, then saved and loaded whole, and
+ * searched concurrently by any number of threads.
+ */
+class ANNIndex {
+ public:
+  ANNIndex(int dim, bool cosine);
+  virtual ~ANNIndex() {}
+
+  virtual const char* type() const = 0;
+
+  /**
+   * @brief Learns what the index needs from a sample of the embeddings, if
+   *        anything; indices that need it cannot be added to before.
+   */
+  virtual void Train(const float* embeddings, int num) {}
+  // The fewest embeddings Train() accepts.
+  virtual int min_train_size() const { return 1; }
+  // Adds num embeddings of dim() floats, numbered from size() on.
+  void Add(const float* embeddings, int num);
+  // Train() then Add() on the same embeddings.
+  void Build(const float* embeddings, int num);
+
+  // Fills matches with the (approximate) k nearest embeddings, nearest first.
+  void Search(const float* query, int k, vector<ReIDMatch>* matches) const;
+  // Searches num queries, spread over the threads of pool if not NULL.
+  void Search(const float* queries, int num, int k,
+      vector<vector<ReIDMatch> >* results, ThreadPool* pool) const;
+
+  virtual int effort() const = 0;
+  virtual void set_effort(int effort) = 0;
+
+  /**
+   * @brief Lends the exact embeddings, size() x dim() floats in the order
+   *        added, to indices that keep them compressed, which then re-rank
+   *        their nearest candidates with them; they must outlive searches.
+   */
+  virtual void set_exact_embeddings(const float* embeddings) {}
+
+  inline int dim() const { return dim_; }
+  inline bool cosine() const { return cosine_; }
+  inline int size() const { return size_; }
+
+  void Save(const string& path) const;
+
+  static const uint32_t kMagic = 0x4e4e4143;  // "CANN"
+  static const uint32_t kVersion = 1;
+
+ protected:
+  // Adds embeddings, already normalized for cosine.
+  virtual void AddEmbeddings(const float* embeddings, int num) = 0;
+  // Searches with a query normalized for cosine; matches hold squared
+  // euclidean distances.
+  virtual void SearchEmbedding(const float* query, int k,
+      vector<ReIDMatch>* matches) const = 0;
+  virtual void Write(FILE* file) const = 0;
+  virtual void Read(FILE* file) = 0;
+
+  void SearchPart(const float* queries, int num, int k,
+      vector<vector<ReIDMatch> >* results, int part, int num_parts) const;
+
+  // Scales each of num embeddings of dim floats to norm 1, leaving zeros.
+  static void Normalize(float* embeddings, int num, int dim);
+  static float SquaredDistance(const float* a, const float* b, int dim);
+  static void WriteOrDie(FILE* file, const void* data, size_t size);
+  static void ReadOrDie(FILE* file, void* data, size_t size);
+  template <typename T>
+  static void WriteVector(FILE* file, const vector<T>& values);
+  template <typename T>
+  static void ReadVector(FILE* file, vector<T>* values);
+
+  int dim_;
+  bool cosine_;
+  int size_;
+
+  friend ANNIndex* LoadANNIndex(const string& path);
+
+  DISABLE_COPY_AND_ASSIGN(ANNIndex);
+};
+
+/**
+ * @brief Clusters num embeddings of dim floats around k centroids with
+ *        Lloyd's algorithm, started from k of them drawn at random, using
+ *        at most max_samples of them. Fills k x dim centroids.
+ */
+void KMeans(const float* embeddings, int num, int dim, int k, int iterations,
+    int max_samples, vector<float>* centroids);
+
+// The nearest of num_centroids centroids to each of num embeddings.
+void NearestCentroids(const float* centroids, int num_centroids,
+    const float* embeddings, int num, int dim, vector<int>* nearest);
+
+// Creates an empty index of type "hnsw", "ivf" or "pq" with its default
+// settings.
+ANNIndex* GetANNIndex(const string& type, int dim, bool cosine);
+// Loads an index saved by ANNIndex::Save.
+ANNIndex* LoadANNIndex(const string& path);
+
+template <typename T>
+void ANNIndex::WriteVector(FILE* file, const vector<T>& values) {
+  const uint64_t count = values.size();
+  WriteOrDie(file, &count, sizeof(count));
+  if (count) {
+    WriteOrDie(file, &values[0], count * sizeof(T));
+  }
+}
+
+template <typename T>
+void ANNIndex::ReadVector(FILE* file, vector<T>* values) {
+  uint64_t count;
+  ReadOrDie(file, &count, sizeof(count));
+  values->resize(count);
+  if (count) {
+    ReadOrDie(file, &(*values)[0], count * sizeof(T));
+  }
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ANN_INDEX_HPP_
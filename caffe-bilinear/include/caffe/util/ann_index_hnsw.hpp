@@ -0,0 +1,76 @@
+#ifndef CAFFE_UTIL_ANN_INDEX_HNSW_HPP_
+#define CAFFE_UTIL_ANN_INDEX_HNSW_HPP_
+
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A hierarchical navigable small world graph (Malkov and Yashunin,
+ *        2016): every embedding is a node linked to up to M near nodes on
+ *        each of a random number of layers, 2 M on the bottom one, and a
+ *        query descends greedily through the sparse upper layers before a
+ *        best-first search of the bottom one.
+ *
+ * The effort is the size of the candidate list of that last search, at least
+ * k; embeddings may be added at any time and need no training.
+ */
+class HNSWIndex : public ANNIndex {
+ public:
+  HNSWIndex(int dim, bool cosine, int M = 16, int ef_construction = 200);
+
+  virtual const char* type() const { return "hnsw"; }
+
+  virtual int effort() const { return ef_search_; }
+  virtual void set_effort(int effort);
+
+ protected:
+  typedef std::pair<float, int> Candidate;
+
+  virtual void AddEmbeddings(const float* embeddings, int num);
+  virtual void SearchEmbedding(const float* query, int k,
+      vector<ReIDMatch>* matches) const;
+  virtual void Write(FILE* file) const;
+  virtual void Read(FILE* file);
+
+  void Insert(int node);
+  // Walks level to the node nearest to query from *node, at *distance.
+  void Descend(const float* query, int level, int* node,
+      float* distance) const;
+  // Best-first search of level from entry: the ef nearest nodes found,
+  // nearest first.
+  void SearchLevel(const float* query, const Candidate& entry, int ef,
+      int level, vector<Candidate>* nearest) const;
+  // Keeps up to max_links of the candidates, nearest first, skipping those
+  // nearer to a kept one than to the query.
+  void SelectNeighbors(const vector<Candidate>& candidates, int max_links,
+      vector<int>* neighbors) const;
+  void Link(int node, int level, const vector<int>& neighbors);
+
+  inline const float* embedding(int node) const {
+    return &data_[static_cast<size_t>(node) * dim_];
+  }
+  inline int max_links(int level) const { return level ? M_ : 2 * M_; }
+
+  int M_;
+  int ef_construction_;
+  int ef_search_;
+  double level_scale_;
+  rng_t rng_;
+  vector<float> data_;
+  vector<int> levels_;
+  // links_[node][level] are the neighbors of node on level.
+  vector<vector<vector<int> > > links_;
+  int entry_point_;
+  int max_level_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ANN_INDEX_HNSW_HPP_
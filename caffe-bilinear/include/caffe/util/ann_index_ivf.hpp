@@ -0,0 +1,55 @@
+#ifndef CAFFE_UTIL_ANN_INDEX_IVF_HPP_
+#define CAFFE_UTIL_ANN_INDEX_IVF_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/ann_index.hpp"
+
+namespace caffe {
+
+/**
+ * @brief An inverted file: Train() clusters the embeddings around num_lists
+ *        centroids with k-means, every embedding is added to the list of its
+ *        nearest centroid, and a query scans only the lists of its effort
+ *        nearest centroids.
+ *
+ * Effort num_lists() makes the search exact.
+ */
+class IVFIndex : public ANNIndex {
+ public:
+  IVFIndex(int dim, bool cosine, int num_lists = 1024);
+
+  virtual const char* type() const { return "ivf"; }
+
+  // Uses at most 256 embeddings per list, and fewer lists than embeddings.
+  virtual void Train(const float* embeddings, int num);
+
+  virtual int effort() const { return num_probes_; }
+  virtual void set_effort(int effort);
+
+  inline int num_lists() const { return centroids_.size() / dim_; }
+  inline void set_train_iterations(int iterations) {
+    train_iterations_ = iterations;
+  }
+
+ protected:
+  virtual void AddEmbeddings(const float* embeddings, int num);
+  virtual void SearchEmbedding(const float* query, int k,
+      vector<ReIDMatch>* matches) const;
+  virtual void Write(FILE* file) const;
+  virtual void Read(FILE* file);
+
+  int max_lists_;
+  int num_probes_;
+  int train_iterations_;
+  vector<float> centroids_;
+  // The ids and embeddings of each list.
+  vector<vector<int> > ids_;
+  vector<vector<float> > data_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ANN_INDEX_IVF_HPP_
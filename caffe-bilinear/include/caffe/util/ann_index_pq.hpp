@@ -0,0 +1,79 @@
+#ifndef CAFFE_UTIL_ANN_INDEX_PQ_HPP_
+#define CAFFE_UTIL_ANN_INDEX_PQ_HPP_
+
+#include <cstdio>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/product_quantizer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Product-quantized embeddings, scanned exhaustively: a query is
+ *        compared with every code through its ProductQuantizer table, and
+ *        the effort nearest by that estimate are re-ranked exactly when
+ *        set_exact_embeddings() lends the embeddings, e.g. from the mapped
+ *        EmbeddingStore of the gallery.
+ *
+ * The index keeps only the codebooks and num_subspaces bytes per embedding.
+ */
+class PQIndex : public ANNIndex {
+ public:
+  // Uses at most dim subspaces.
+  PQIndex(int dim, bool cosine, int num_subspaces = 32);
+
+  virtual const char* type() const { return "pq"; }
+
+  // Needs at least 256 embeddings.
+  virtual void Train(const float* embeddings, int num);
+  virtual int min_train_size() const {
+    return ProductQuantizer::kNumCentroids;
+  }
+
+  virtual int effort() const { return rerank_; }
+  virtual void set_effort(int effort);
+  virtual void set_exact_embeddings(const float* embeddings) {
+    exact_ = embeddings;
+  }
+
+  /**
+   * @brief Fills distances with the distance from query to every embedding,
+   *        for evaluating whole rankings: estimated from the codes, but exact
+   *        for the effort nearest estimates if exact embeddings are lent,
+   *        in which case those rank first and the estimates of the rest are
+   *        shifted behind them.
+   */
+  void Distances(const float* query, float* distances) const;
+
+  inline const ProductQuantizer& quantizer() const { return quantizer_; }
+  inline void set_train_iterations(int iterations) {
+    train_iterations_ = iterations;
+  }
+
+ protected:
+  virtual void AddEmbeddings(const float* embeddings, int num);
+  virtual void SearchEmbedding(const float* query, int k,
+      vector<ReIDMatch>* matches) const;
+  virtual void Write(FILE* file) const;
+  virtual void Read(FILE* file);
+
+  // The squared distances from a normalized query to every code, with the
+  // nearest num_exact of them replaced by exact ones if possible; fills
+  // nearest with those num_exact, or the num_exact nearest estimates.
+  void SquaredDistances(const float* query, int num_exact,
+      vector<float>* distances, vector<int>* nearest) const;
+  // The squared distance from a normalized query to exact embedding i.
+  float ExactDistance(const float* query, int i) const;
+
+  ProductQuantizer quantizer_;
+  int rerank_;
+  int train_iterations_;
+  vector<uint8_t> codes_;
+  const float* exact_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ANN_INDEX_PQ_HPP_
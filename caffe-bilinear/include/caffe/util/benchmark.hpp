@@ -3,6 +3,9 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <string>
+#include <vector>
+
 #include "caffe/util/device_alternate.hpp"
 
 namespace caffe {
@@ -47,6 +50,45 @@ class CPUTimer : public Timer {
   virtual float MicroSeconds();
 };
 
+/**
+ * @brief Histogram of latencies in microseconds with geometrically growing
+ *        buckets, for reporting percentiles of serving and benchmark timings.
+ *
+ * Each octave is split into kBucketsPerOctave buckets, so percentiles are
+ * reported with bounded relative error over any range of values. It is not
+ * thread-safe: guard it externally or Merge per-thread instances.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+  void Add(double microseconds);
+  void Merge(const LatencyHistogram& other);
+  void Clear();
+
+  inline size_t count() const { return count_; }
+  inline double max() const { return max_; }
+  inline double mean() const { return count_ ? sum_ / count_ : 0; }
+  /**
+   * @brief Returns the upper bound of the bucket holding the p-th percentile
+   *        (0 <= p <= 100), clamped to the largest value seen.
+   */
+  double Percentile(double p) const;
+  /// @brief Returns a one-line count/mean/p50/p90/p99/max summary in ms.
+  std::string Summary() const;
+
+  static const int kBucketsPerOctave = 4;
+  static const int kNumBuckets = 40 * kBucketsPerOctave;
+
+ protected:
+  static int Bucket(double microseconds);
+  static double BucketUpperBound(int bucket);
+
+  std::vector<size_t> buckets_;
+  size_t count_;
+  double sum_;
+  double max_;
+};
+
 }  // namespace caffe
 
 #endif   // CAFFE_UTIL_BENCHMARK_H_
@@ -0,0 +1,100 @@
+#ifndef CAFFE_UTIL_EMBEDDING_CACHE_HPP_
+#define CAFFE_UTIL_EMBEDDING_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "boost/unordered_map.hpp"
+
+#include "caffe/common.hpp"
+
+// Forward declare boost::mutex so that only embedding_cache.cpp needs
+// boost/thread.hpp.
+namespace boost { class mutex; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed-size cache of embeddings keyed by a hash of the input they
+ *        were computed from, so that repeated inputs skip the forward pass.
+ *
+ * Entries are evicted with CLOCK: a hand sweeps the slots, clearing the
+ * referenced bit of entries looked up since its last pass and evicting the
+ * first entry without it. New entries start unreferenced, so inputs seen
+ * once go before those seen again. Keys are 64-bit hashes and are trusted:
+ * a collision returns the embedding of the other input.
+ *
+ * Lookups and insertions are thread-safe. The cache can be saved to and
+ * loaded from an EmbeddingStore, with the key of each embedding as its name.
+ * The store leads with an entry naming model, a digest of the net the
+ * embeddings came from, and is ignored by a cache of another model.
+ */
+class EmbeddingCache {
+ public:
+  EmbeddingCache(int dim, int capacity, uint64_t model = 0);
+
+  // Copies the embedding of key into embedding and returns true, or returns
+  // false if it is not cached.
+  bool Lookup(uint64_t key, float* embedding);
+  // Caches the embedding of key, evicting an entry if full.
+  void Insert(uint64_t key, const float* embedding);
+  void Clear();
+
+  // Writes the entries to an embedding store at path, through a temporary
+  // file renamed over it once complete.
+  void Save(const string& path) const;
+  // Inserts the entries of an embedding store saved by Save() for the same
+  // model; returns the number inserted, 0 if the store is of another model.
+  int Load(const string& path);
+
+  /**
+   * @brief A fast 64-bit hash of size bytes of data, over 8-byte words,
+   *        chained from seed.
+   */
+  static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    int size;
+
+    Stats() : hits(0), misses(0), insertions(0), evictions(0), size(0) {}
+    double hit_rate() const;
+    string Summary() const;
+  };
+  Stats stats() const;
+
+  inline int dim() const { return dim_; }
+  inline int capacity() const { return capacity_; }
+  inline uint64_t model() const { return model_; }
+
+ protected:
+  struct Slot {
+    uint64_t key;
+    bool referenced;
+  };
+
+  // Returns the slot to fill with a new entry; needs the lock.
+  int Evict();
+
+  int dim_;
+  int capacity_;
+  uint64_t model_;
+  vector<Slot> slots_;
+  // capacity x dim embeddings, one row per slot.
+  vector<float> embeddings_;
+  boost::unordered_map<uint64_t, int> index_;
+  int hand_;
+  Stats stats_;
+  shared_ptr<boost::mutex> mutex_;
+
+  DISABLE_COPY_AND_ASSIGN(EmbeddingCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_EMBEDDING_CACHE_HPP_
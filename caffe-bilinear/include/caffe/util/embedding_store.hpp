@@ -0,0 +1,140 @@
+#ifndef CAFFE_UTIL_EMBEDDING_STORE_HPP_
+#define CAFFE_UTIL_EMBEDDING_STORE_HPP_
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "boost/crc.hpp"
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A read-only, memory-mapped matrix of embeddings with the person,
+ *        camera and file name of each, as a re-ID gallery is searched.
+ *
+ * Float embeddings form one contiguous row-major matrix that is used in
+ * place, so opening a store costs no more than the page faults of reading
+ * it. Embeddings may also be kept as fp16 or as int8 with a scale per row,
+ * and are then decoded on demand. Files are written by EmbeddingStoreWriter.
+ * The layout is native-endian, each section 64-byte aligned:
+ *
+ *   header    EmbeddingStoreHeader
+ *   rows      num_embeddings x dim values of the store type
+ *   scales    num_embeddings floats, int8 stores only: row i is
+ *             scales[i] * rows[i]
+ *   labels    num_embeddings x {int32 person, int32 camera}
+ *   names     num_embeddings + 1 uint64 offsets into the characters that
+ *             follow them; name i is characters [offsets[i], offsets[i + 1])
+ *
+ * The header holds a CRC-32 of the rows and scales, checked by Verify(), and
+ * one of the labels and names, checked by Open().
+ */
+class EmbeddingStore {
+ public:
+  enum Type { FLOAT = 0, FLOAT16 = 1, INT8 = 2 };
+
+  EmbeddingStore();
+  ~EmbeddingStore();
+
+  void Open(const string& path);
+  void Close();
+  // Whether the rows and scales still match their checksum.
+  bool Verify() const;
+
+  inline int num_embeddings() const { return header_->num_embeddings; }
+  inline int dim() const { return header_->dim; }
+  inline Type type() const { return static_cast<Type>(header_->type); }
+
+  // The num_embeddings() x dim() embeddings, in place; FLOAT stores only.
+  const float* data() const;
+  // Decodes embeddings [begin, end) into (end - begin) x dim() floats.
+  void Decode(int begin, int end, float* embeddings) const;
+
+  inline int person(int i) const { return labels_[2 * i]; }
+  inline int camera(int i) const { return labels_[2 * i + 1]; }
+  inline string name(int i) const {
+    return string(names_ + name_offsets_[i],
+        name_offsets_[i + 1] - name_offsets_[i]);
+  }
+
+  static size_t ValueSize(Type type);
+
+  struct EmbeddingStoreHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;
+    uint32_t dim;
+    uint32_t num_embeddings;
+    uint32_t data_checksum;
+    uint32_t metadata_checksum;
+    uint32_t reserved;
+    uint64_t rows_offset;
+    uint64_t scales_offset;
+    uint64_t labels_offset;
+    uint64_t names_offset;
+    uint64_t size;
+  };
+  static const uint32_t kMagic = 0x424d4543;  // "CEMB"
+  static const uint32_t kVersion = 1;
+
+ protected:
+  void* mapping_;
+  size_t mapping_size_;
+  const EmbeddingStoreHeader* header_;
+  const uint8_t* rows_;
+  const float* scales_;
+  const int32_t* labels_;
+  const uint64_t* name_offsets_;
+  const char* names_;
+
+  DISABLE_COPY_AND_ASSIGN(EmbeddingStore);
+};
+
+/**
+ * @brief Writes an EmbeddingStore file. Embeddings are only ever appended,
+ *        and streamed to disk as they are added; the scales, labels and
+ *        names follow on Close().
+ */
+class EmbeddingStoreWriter {
+ public:
+  EmbeddingStoreWriter(const string& path, int dim, EmbeddingStore::Type type);
+  ~EmbeddingStoreWriter();
+
+  // embedding holds dim floats.
+  void Add(const float* embedding, int person, int camera,
+      const string& name);
+  void Close();
+
+  inline int num_embeddings() const { return persons_.size(); }
+
+ protected:
+  void Write(const void* data, size_t size);
+
+  string path_;
+  FILE* file_;
+  EmbeddingStore::EmbeddingStoreHeader header_;
+  // CRC-32 of the rows written so far.
+  boost::crc_32_type data_crc_;
+  vector<uint8_t> row_;
+  vector<float> scales_;
+  vector<int> persons_;
+  vector<int> cameras_;
+  vector<string> names_;
+
+  DISABLE_COPY_AND_ASSIGN(EmbeddingStoreWriter);
+};
+
+/**
+ * @brief Rounds a float to the nearest fp16 value, ties to even, and back.
+ */
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_EMBEDDING_STORE_HPP_
@@ -148,6 +148,17 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]));
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// y[i] = (x[i] - mean) * scale for n uint8 pixels, writing y in reverse
+// order if mirror. Vectorized for float (SSE2/AVX2 or NEON), and exact: the
+// result is the same as the scalar loop's.
+template <typename Dtype>
+void caffe_cpu_uint8_scale(const int n, const uint8_t* x, const Dtype mean,
+    const Dtype scale, const bool mirror, Dtype* y);
+
+// Whether the CPU runs AVX2, checked once. The kernels built for AVX2 with
+// target attributes ask it before running; it is false off x86.
+bool caffe_cpu_has_avx2();
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
@@ -0,0 +1,111 @@
+#ifndef CAFFE_UTIL_MEMORY_POOL_HPP_
+#define CAFFE_UTIL_MEMORY_POOL_HPP_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+// Forward declare boost::mutex to keep boost/thread.hpp out of caffe.hpp,
+// which includes this header.
+namespace boost { class mutex; }
+
+namespace caffe {
+
+/**
+ * @brief Caches the host and device buffers of SyncedMemory for reuse.
+ *
+ * Sizes are rounded up to buckets, eight per power of two and no smaller
+ * than kMinBucket bytes, and a freed buffer is kept for the next request of
+ * its bucket instead of going back to the system. This takes the allocator
+ * off the path of nets that reshape every iteration or serve variable batch
+ * sizes. Pinned and pageable host buffers are cached apart, and device
+ * buffers per device. The pool is shared by all threads; Caffe::memory_pool()
+ * returns the one SyncedMemory uses.
+ *
+ * At most cache_limit() free bytes are kept, for host and device each;
+ * buffers freed beyond that go back to the system. The limit starts at
+ * kDefaultCacheLimit; a limit of 0 turns the pool off: sizes are no longer
+ * rounded and nothing is cached. The owner of the process decides when to
+ * call EmptyCache(); nothing in the library does.
+ */
+class MemoryPool {
+ public:
+  struct Stats {
+    Stats() : requests(0), hits(0), cached(0), reserved(0), peak_reserved(0) {}
+    // Allocations served, and how many of them came from the cache.
+    size_t requests;
+    size_t hits;
+    // Bytes held in the cache, free.
+    size_t cached;
+    // Bytes taken from the system, in use or cached, and the most taken at
+    // once.
+    size_t reserved;
+    size_t peak_reserved;
+
+    // One line for logs.
+    string Summary() const;
+  };
+
+  MemoryPool();
+  ~MemoryPool();
+
+  // Like CaffeMallocHost: pinned in GPU mode, reported through use_cuda.
+  void* MallocHost(size_t size, bool* use_cuda);
+  void FreeHost(void* ptr, size_t size, bool use_cuda);
+  // On the current device. If the device is out of memory, the cache is
+  // emptied and the allocation tried again.
+  void* MallocDevice(size_t size);
+  void FreeDevice(void* ptr, size_t size);
+
+  // Returns every cached buffer to the system.
+  void EmptyCache();
+  // Sets the most free bytes cached, emptying the cache if it holds more.
+  void set_cache_limit(size_t limit);
+  size_t cache_limit() const;
+
+  Stats host_stats() const;
+  Stats device_stats() const;
+
+  static const size_t kMinBucket = 512;
+  // The cache limit of a new pool: 256 MB.
+  static const size_t kDefaultCacheLimit = 256 << 20;
+  // The size allocated for a request of the given size while caching.
+  static size_t BucketSize(size_t size);
+
+ private:
+  // Free buffers by bucket size.
+  typedef std::map<size_t, std::vector<void*> > Cache;
+  struct DeviceBuffer {
+    size_t size;
+    int device;
+  };
+
+  // Pops a cached buffer of the given bucket, or returns NULL.
+  static void* TakeCached(Cache* cache, size_t bucket);
+  static void CountRequest(Stats* stats, size_t bucket, bool hit);
+  // Needs the lock.
+  void EmptyHostCache();
+  void EmptyDeviceCache();
+
+  shared_ptr<boost::mutex> mutex_;
+  size_t cache_limit_;
+  Cache pageable_cache_;
+  Cache pinned_cache_;
+  // By device.
+  std::map<int, Cache> device_caches_;
+  // The allocated size of each buffer in use, and the device of those on
+  // devices.
+  std::map<void*, size_t> host_buffers_;
+  std::map<void*, DeviceBuffer> device_buffers_;
+  Stats host_stats_;
+  Stats device_stats_;
+
+  DISABLE_COPY_AND_ASSIGN(MemoryPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MEMORY_POOL_HPP_
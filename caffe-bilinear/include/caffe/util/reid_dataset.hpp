@@ -0,0 +1,142 @@
+#ifndef CAFFE_UTIL_REID_DATASET_HPP_
+#define CAFFE_UTIL_REID_DATASET_HPP_
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Parses the person and camera ids out of a Market-1501 file name
+ *        such as "0002_c1s1_000451_03.jpg" (person 2, camera 1). Leading
+ *        directories are ignored. Junk images have person -1.
+ *
+ * @return false if the name does not follow the convention.
+ */
+bool ParseMarket1501Name(const string& path, int* person, int* camera);
+
+/**
+ * @brief A read-only, memory-mapped re-identification dataset: fixed-size
+ *        uint8 records (channels x height x width, CHW), their person and
+ *        camera labels, and an index from each person to its records.
+ *
+ * Records are used in place, without parsing or copying, and the records of
+ * any identity are found in constant time, which is what identity-balanced
+ * sampling needs. Files are written by ReIDDatasetWriter. The layout is
+ * native-endian:
+ *
+ *   header       ReIDDatasetHeader
+ *   records      num_records x record_size() bytes, from records_offset
+ *   labels       num_records x {int32 person, int32 camera}
+ *   identities   num_persons x {int32 person, uint32 first, uint32 count},
+ *                sorted by person
+ *   members      num_records x uint32 record ids, grouped by identity; the
+ *                records of identity k are members[first, first + count)
+ */
+class ReIDDataset {
+ public:
+  ReIDDataset();
+  ~ReIDDataset();
+
+  void Open(const string& path);
+  void Close();
+
+  inline int num_records() const { return header_->num_records; }
+  inline int channels() const { return header_->channels; }
+  inline int height() const { return header_->height; }
+  inline int width() const { return header_->width; }
+  inline size_t record_size() const {
+    return static_cast<size_t>(header_->channels) * header_->height *
+        header_->width;
+  }
+  inline const uint8_t* record(int i) const {
+    return records_ + i * record_size();
+  }
+  inline int person(int i) const { return labels_[2 * i]; }
+  inline int camera(int i) const { return labels_[2 * i + 1]; }
+
+  // Identities are numbered 0 .. num_persons() - 1 in increasing person id.
+  inline int num_persons() const { return header_->num_persons; }
+  inline int person_id(int identity) const {
+    return identities_[3 * identity];
+  }
+  inline int num_records_of(int identity) const {
+    return identities_[3 * identity + 2];
+  }
+  inline const uint32_t* records_of(int identity) const {
+    return members_ + identities_[3 * identity + 1];
+  }
+  // Returns the identity of person, or -1 if it has no records.
+  int FindPerson(int person) const;
+
+  struct ReIDDatasetHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channels;
+    uint32_t height;
+    uint32_t width;
+    uint32_t num_records;
+    uint32_t num_persons;
+    uint32_t reserved;
+    uint64_t records_offset;
+    uint64_t labels_offset;
+    uint64_t identities_offset;
+    uint64_t members_offset;
+  };
+  static const uint32_t kMagic = 0x44495243;  // "CRID"
+  static const uint32_t kVersion = 1;
+
+ protected:
+  void* mapping_;
+  size_t mapping_size_;
+  const ReIDDatasetHeader* header_;
+  const uint8_t* records_;
+  const int32_t* labels_;
+  const uint32_t* identities_;
+  const uint32_t* members_;
+
+  DISABLE_COPY_AND_ASSIGN(ReIDDataset);
+};
+
+/**
+ * @brief Writes a ReIDDataset file. Records are streamed to disk as they are
+ *        added; the labels and the identity index follow on Close().
+ */
+class ReIDDatasetWriter {
+ public:
+  ReIDDatasetWriter(const string& path, int channels, int height, int width);
+  ~ReIDDatasetWriter();
+
+  // pixels holds channels x height x width bytes in CHW order.
+  void Add(const uint8_t* pixels, int person, int camera);
+  void Close();
+
+  inline int num_records() const { return persons_.size(); }
+  inline int channels() const { return header_.channels; }
+  inline int height() const { return header_.height; }
+  inline int width() const { return header_.width; }
+  inline size_t record_size() const {
+    return static_cast<size_t>(header_.channels) * header_.height *
+        header_.width;
+  }
+
+ protected:
+  void Write(const void* data, size_t size);
+
+  string path_;
+  FILE* file_;
+  ReIDDataset::ReIDDatasetHeader header_;
+  vector<int> persons_;
+  vector<int> cameras_;
+
+  DISABLE_COPY_AND_ASSIGN(ReIDDatasetWriter);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_REID_DATASET_HPP_
@@ -0,0 +1,133 @@
+#ifndef CAFFE_UTIL_REID_EVALUATION_HPP_
+#define CAFFE_UTIL_REID_EVALUATION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/embedding_store.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Reads the float Datums of an lmdb/leveldb database, such as
+ *        extract_features writes, in key order into rows of *dim floats.
+ */
+void ReadReIDFeatures(const string& backend, const string& source,
+    vector<float>* features, int* dim);
+
+/**
+ * @brief Reads a list of Market-1501 image names, one per line, and the
+ *        persons and cameras they name. Only the first word of a line is
+ *        read, so the lists of convert_imageset work too.
+ */
+void ReadReIDList(const string& source, vector<string>* names,
+    vector<int>* persons, vector<int>* cameras);
+
+/**
+ * @brief The embeddings of a query or gallery set, with the name, person and
+ *        camera of each when they are known.
+ *
+ * Load reads an EmbeddingStore when backend is "store": float embeddings are
+ * then used in place, and the labels come with them. Any other backend
+ * names a feature database, labelled by a list if one is given. A list
+ * always overrides the labels of a store.
+ */
+class ReIDFeatures {
+ public:
+  ReIDFeatures() : data_(NULL), num_(0), dim_(0) {}
+
+  void Load(const string& backend, const string& source, const string& list);
+
+  inline const float* data() const { return data_; }
+  inline int num() const { return num_; }
+  inline int dim() const { return dim_; }
+  inline bool has_labels() const { return persons_.size() > 0; }
+  // Empty names, as stores may hold, are replaced by the index.
+  inline const vector<string>& names() const { return names_; }
+  inline const vector<int>& persons() const { return persons_; }
+  inline const vector<int>& cameras() const { return cameras_; }
+
+ protected:
+  EmbeddingStore store_;
+  // Holds the embeddings unless they are used in place.
+  vector<float> features_;
+  const float* data_;
+  int num_;
+  int dim_;
+  vector<string> names_;
+  vector<int> persons_;
+  vector<int> cameras_;
+
+  DISABLE_COPY_AND_ASSIGN(ReIDFeatures);
+};
+
+/**
+ * @brief Distances from each of num_queries embeddings to each of
+ *        num_gallery embeddings, all of dim floats, as a row-major
+ *        num_queries x num_gallery matrix, computed with one GEMM.
+ *
+ * With cosine, the distance is 1 - cos(q, g); otherwise it is the squared
+ * euclidean distance. Both rank like the distances the Market-1501
+ * evaluation uses.
+ */
+void ReIDDistances(const float* queries, int num_queries,
+    const float* gallery, int num_gallery, int dim, bool cosine,
+    float* distances);
+
+/**
+ * @brief Fills top with the indices of the k smallest of distances[0, n),
+ *        nearest first, ties going to the lower index.
+ */
+void ReIDTopK(const float* distances, int n, int k, vector<int>* top);
+
+/**
+ * @brief Scores re-identification queries against a labelled gallery,
+ *        following the Market-1501 protocol:
+ *
+ *   - gallery items of person -1 are junk for every query;
+ *   - items of the query person seen by the query camera are junk for it;
+ *   - items of the query person seen by other cameras are its true matches;
+ *   - everything else, including the distractors of person 0, is a false
+ *     match.
+ *
+ * Junk is left out of the ranking. A query is scored from its distances to
+ * the whole gallery in one pass over them, without sorting: the rank of a
+ * true match is the number of non-junk items nearer to the query.
+ */
+class ReIDEvaluator {
+ public:
+  ReIDEvaluator(const vector<int>& persons, const vector<int>& cameras);
+
+  struct Score {
+    // The rank of the first true match, from 0, or -1 if the gallery holds
+    // none.
+    int first_match;
+    // The mean, over the true matches, of the precision at their rank.
+    double average_precision;
+  };
+  // Safe to call from several threads at once.
+  Score Evaluate(const float* distances, int person, int camera) const;
+
+  inline int num_gallery() const { return persons_.size(); }
+
+ protected:
+  vector<int> persons_;
+  vector<int> cameras_;
+  // Junk for every query.
+  vector<bool> junk_;
+  // The gallery items of each person, by person.
+  map<int, vector<int> > items_of_;
+};
+
+/**
+ * @brief Sums up query scores: cmc[r] is the fraction of queries matched at
+ *        rank r or better, for r < max_rank, and the return value is the
+ *        mean average precision. Queries with no true match are left out.
+ */
+double ReIDSummary(const vector<ReIDEvaluator::Score>& scores, int max_rank,
+    vector<double>* cmc);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_REID_EVALUATION_HPP_
@@ -0,0 +1,128 @@
+#ifndef CAFFE_UTIL_REID_GALLERY_HPP_
+#define CAFFE_UTIL_REID_GALLERY_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/reid_search.hpp"
+
+namespace caffe {
+
+class ThreadPool;
+
+/**
+ * @brief A gallery of embeddings that changes while it is searched: items
+ *        are added and removed online, and compacted in the background.
+ *
+ * Added items go to an active segment of up to segment_size items, which is
+ * then sealed; removed items are only marked deleted. Compaction merges
+ * segments into one without the deleted items, searched exhaustively with
+ * ReIDSearch or, unless the type is "exact", through an ANNIndex of that
+ * type built over it. Background compactions merge the sealed segments with
+ * the latest compacted ones no larger than them, so that compacted segments
+ * grow geometrically and each item is merged a logarithmic number of times;
+ * they only merge everything once a quarter of the items are deleted.
+ * Segments too recent to be compacted are searched exhaustively, so items
+ * can be found as soon as Add returns.
+ *
+ * Searches run concurrently with each other and see the gallery either
+ * before or after any update. Compaction builds the merged segment without
+ * holding the gallery, and only swaps it in under the lock; items removed
+ * meanwhile stay removed.
+ *
+ * Items are identified by the ids Add returns, counted from 0 and never
+ * reused; matches carry ids, and distances as ReIDSearch computes them.
+ */
+class ReIDGallery {
+ public:
+  ReIDGallery(int dim, bool cosine, const string& type = "exact");
+  ~ReIDGallery();
+
+  // Adds an item taken by camera, or -1 if unknown, and returns its id.
+  int Add(const float* embedding, int camera = -1);
+  // Adds num items, with cameras or NULL, and returns the id of the first;
+  // the others follow.
+  int Add(const float* embeddings, int num, const int* cameras);
+  // Removes an item; returns false if there is no such item.
+  bool Remove(int id);
+
+  /**
+   * @brief Fills (*results)[i] with the k nearest items of query i, nearest
+   *        first, leaving out those of its camera if query_cameras is not
+   *        NULL. Segments are searched over the threads of pool, if not NULL.
+   */
+  void Search(const float* queries, int num_queries, const int* query_cameras,
+      int k, vector<vector<ReIDMatch> >* results, ThreadPool* pool) const;
+
+  // Merges all the segments into one now, sealing the active one, and
+  // waiting for any running compaction.
+  void Compact();
+  // Starts compacting in the background, unless a compaction is running.
+  void StartCompaction();
+  void WaitForCompaction();
+  // Whether deleted items or segments not yet compacted are numerous
+  // enough to be worth compacting.
+  bool NeedsCompaction() const;
+
+  // Live items.
+  int size() const;
+  int num_deleted() const;
+  int num_segments() const;
+  inline int dim() const { return dim_; }
+  inline bool cosine() const { return cosine_; }
+  inline const string& type() const { return type_; }
+
+  void set_segment_size(int segment_size);
+  // The effort of the ANN indices, now and after compaction.
+  void set_effort(int effort);
+  // Starts a compaction after the updates that make one needed; on by
+  // default.
+  inline void set_auto_compaction(bool auto_compaction) {
+    auto_compaction_ = auto_compaction;
+  }
+
+ protected:
+  struct Segment;
+  // The locks of the gallery, held by searches, updates and compaction,
+  // and the background compaction thread.
+  class sync;
+
+  // Appends to the active segment, sealing it when full; needs the lock.
+  void Append(const float* embedding, int camera);
+  // Seals the active segment; needs the lock.
+  void Seal();
+  // Searches the rows of one segment with its index or with search.
+  void SearchRows(const Segment& segment, const ReIDSearch* search,
+      const float* queries, int num_queries, const int* query_cameras, int k,
+      vector<vector<ReIDMatch> >* matches, ThreadPool* pool) const;
+  // Searches one segment for the k nearest live items of each query.
+  void SearchSegment(const Segment& segment, const float* queries,
+      int num_queries, const int* query_cameras, int k,
+      vector<vector<ReIDMatch> >* results, ThreadPool* pool) const;
+  // Merges all the segments, or the sealed ones with the compacted ones
+  // no larger than them; see the class comment.
+  void Merge(bool all);
+  void CompactionEntry();
+  void MaybeStartCompaction();
+
+  int dim_;
+  bool cosine_;
+  string type_;
+  int segment_size_;
+  // The fewest items an index of type can be built over.
+  int min_index_size_;
+  int effort_;
+  bool auto_compaction_;
+  int next_id_;
+  int num_deleted_;
+  // Sealed segments, oldest first, then the active one.
+  vector<shared_ptr<Segment> > segments_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(ReIDGallery);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_REID_GALLERY_HPP_
@@ -0,0 +1,100 @@
+#ifndef CAFFE_UTIL_REID_RERANKING_HPP_
+#define CAFFE_UTIL_REID_RERANKING_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+class ThreadPool;
+
+/**
+ * @brief k-reciprocal re-ranking (Zhong et al., "Re-ranking Person
+ *        Re-identification with k-reciprocal Encoding", CVPR 2017).
+ *
+ * Queries and gallery items are pooled. Each item is encoded by its
+ * k-reciprocal neighbors, expanded with the half-size reciprocal sets of
+ * those neighbors that mostly agree, and weighted by exp(-distance), with
+ * distances divided by the item's largest to its k1 + 1 nearest neighbors
+ * so that the weights do not depend on the metric's scale. The encodings
+ * are then averaged over the k2 nearest neighbors. A re-ranked
+ * distance is lambda times the original plus (1 - lambda) times the
+ * Jaccard distance between the encodings.
+ *
+ * Memory stays linear in the number of items. The k1 + 1 nearest neighbors
+ * come from ReIDSearch, tile by tile. Encodings are sparse. The gallery
+ * encodings are inverted once, so the Jaccard distances of a query to the
+ * whole gallery cost one pass over the gallery items it shares neighbors
+ * with. Embeddings are used in place and must outlive the re-ranker.
+ */
+class ReIDReranker {
+ public:
+  ReIDReranker(const float* queries, int num_queries, const float* gallery,
+      int num_gallery, int dim, bool cosine, int k1 = 20, int k2 = 6,
+      float lambda = 0.3);
+
+  // Finds the k1 + 1 nearest neighbors of every item.
+  void FindNeighbors(ThreadPool* pool);
+  // Computes the encodings from the neighbors, and inverts those of the
+  // gallery.
+  void Encode(ThreadPool* pool);
+
+  /**
+   * @brief Replaces distances, the original distances from query to every
+   *        gallery item, with the re-ranked ones. Safe to call from several
+   *        threads at once.
+   */
+  void Rerank(int query, float* distances) const;
+
+  inline int num_queries() const { return num_queries_; }
+  inline int num_gallery() const { return num_gallery_; }
+
+ protected:
+  struct Entry {
+    int index;
+    float weight;
+  };
+
+  // Items are the queries, then the gallery items.
+  inline const float* embedding(int item) const {
+    return item < num_queries_ ?
+        queries_ + static_cast<size_t>(item) * dim_ :
+        gallery_ + static_cast<size_t>(item - num_queries_) * dim_;
+  }
+  inline int num_items() const { return num_queries_ + num_gallery_; }
+  // The original distance between two items.
+  float Distance(int a, int b) const;
+  // Whether b is among the first k + 1 neighbors of a.
+  bool IsNeighbor(int a, int b, int k) const;
+  // The items both among the first k + 1 neighbors of item and having item
+  // among their first k + 1.
+  void ReciprocalNeighbors(int item, int k, vector<int>* neighbors) const;
+  void EncodePart(int part, int num_parts);
+  void ExpandQueryPart(const vector<vector<Entry> >* encodings, int part,
+      int num_parts);
+
+  const float* queries_;
+  int num_queries_;
+  const float* gallery_;
+  int num_gallery_;
+  int dim_;
+  bool cosine_;
+  int k1_;
+  int k2_;
+  float lambda_;
+  // Norms of the items for cosine, squared norms otherwise.
+  vector<float> norms_;
+  // The k1 + 1 nearest items of each item, nearest first.
+  vector<vector<int> > neighbors_;
+  vector<vector<Entry> > encodings_;
+  // For each item, the gallery items whose encodings hold it.
+  vector<size_t> inverted_begin_;
+  vector<Entry> inverted_;
+
+  DISABLE_COPY_AND_ASSIGN(ReIDReranker);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_REID_RERANKING_HPP_
@@ -0,0 +1,78 @@
+#ifndef CAFFE_UTIL_REID_SEARCH_HPP_
+#define CAFFE_UTIL_REID_SEARCH_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+class ThreadPool;
+
+struct ReIDMatch {
+  int index;
+  float distance;
+};
+
+/**
+ * @brief Finds the k gallery embeddings nearest to each query without ever
+ *        holding the whole queries x gallery distance matrix.
+ *
+ * Queries are taken block_size at a time and the gallery tile_size items at
+ * a time; the distances of a block to a tile come from one GEMM into a
+ * buffer of block_size x tile_size floats, and are folded at once into a
+ * bounded max-heap per query. Distances are as ReIDDistances computes them,
+ * and ties go to the lower gallery index.
+ *
+ * The gallery is used in place, so it must outlive the search.
+ */
+class ReIDSearch {
+ public:
+  ReIDSearch(const float* gallery, int num_gallery, int dim, bool cosine);
+
+  /**
+   * @brief Gives the camera of every gallery item. A query given a camera
+   *        then never matches items of that camera; camera -1 matches all.
+   */
+  void set_cameras(const vector<int>& cameras);
+  void set_block_size(int block_size);
+  void set_tile_size(int tile_size);
+
+  /**
+   * @brief Fills (*results)[i] with the k matches of query i, nearest first.
+   *
+   * @param query_cameras the camera of each query, or NULL to match every
+   *        gallery item
+   * @param pool spreads the query blocks over its threads; NULL searches on
+   *        the calling thread
+   */
+  void Search(const float* queries, int num_queries, const int* query_cameras,
+      int k, vector<vector<ReIDMatch> >* results, ThreadPool* pool) const;
+
+  inline int num_gallery() const { return num_gallery_; }
+  inline int dim() const { return dim_; }
+
+ protected:
+  void SearchPart(const float* queries, int num_queries,
+      const int* query_cameras, int k, vector<vector<ReIDMatch> >* results,
+      int part, int num_parts) const;
+  void SearchBlock(const float* queries, int num_queries,
+      const int* query_cameras, int k, float* tile,
+      vector<ReIDMatch>* heaps) const;
+
+  const float* gallery_;
+  int num_gallery_;
+  int dim_;
+  bool cosine_;
+  // Norms of the gallery embeddings for cosine, squared norms otherwise.
+  vector<float> gallery_norms_;
+  vector<int> cameras_;
+  int block_size_;
+  int tile_size_;
+
+  DISABLE_COPY_AND_ASSIGN(ReIDSearch);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_REID_SEARCH_HPP_
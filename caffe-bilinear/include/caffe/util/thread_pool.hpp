@@ -0,0 +1,60 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of threads running one task in parallel, fork-join
+ *        style: Run(task) calls task(thread_id) once for every thread_id in
+ *        [0, num_threads()) and returns when all calls have returned.
+ *
+ * The calling thread runs task(0) itself, so a pool of N threads only keeps
+ * N - 1 threads of its own. The pool threads do not initialize Caffe's
+ * thread local state; tasks should stay away from Caffe::Get() and friends.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  void Run(const boost::function<void(int)>& task);
+
+  inline int num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Splits [0, count) into num_parts contiguous ranges whose sizes
+   *        differ by at most one, and returns the part-th as [*begin, *end).
+   */
+  static void Partition(int count, int num_parts, int part,
+      int* begin, int* end);
+
+ protected:
+  void Entry(int thread_id);
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp,
+   as in BlockingQueue.
+   */
+  class sync;
+
+  int num_threads_;
+  vector<shared_ptr<boost::thread> > threads_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
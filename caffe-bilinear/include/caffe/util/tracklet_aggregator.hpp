@@ -0,0 +1,94 @@
+#ifndef CAFFE_UTIL_TRACKLET_AGGREGATOR_HPP_
+#define CAFFE_UTIL_TRACKLET_AGGREGATOR_HPP_
+
+#include <map>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Pools the embeddings of the frames of tracklets, as they stream in,
+ *        into one descriptor per tracklet, as MeanAcrossBatchLayer does for
+ *        the chunks of a batch.
+ *
+ * A descriptor is the mean of the embedded frames of its tracklet, weighted
+ * by their qualities, e.g. detection scores or embedding norms. Frames are
+ * L2-normalized before pooling if normalize is set.
+ *
+ * Offer() tells whether a frame is worth embedding at all. Each embedded
+ * frame that turns the descriptor by less than tolerance (1 - cos) doubles
+ * the stride between embedded frames, up to max_stride; a frame that turns
+ * it more brings the stride back to 1. After patience such frames in a row,
+ * and at least min_frames, the tracklet is stable and no more of its frames
+ * are embedded. By default every frame is embedded.
+ *
+ * Tracklets are identified by any int, and held from their first frame until
+ * Finish(). Not thread-safe.
+ */
+class TrackletAggregator {
+ public:
+  explicit TrackletAggregator(int dim, bool normalize = true);
+
+  // Counts a new frame of tracklet, and returns whether to embed it and
+  // Add() it.
+  bool Offer(int tracklet);
+  // Pools the embedding of a frame of tracklet; quality must be positive.
+  void Add(int tracklet, const float* embedding, float quality = 1);
+  // Writes the dim floats of the descriptor of tracklet, L2-normalized if
+  // normalize is set.
+  void Descriptor(int tracklet, float* descriptor) const;
+  // Writes the descriptor and forgets tracklet.
+  void Finish(int tracklet, float* descriptor);
+
+  bool Contains(int tracklet) const;
+  // Whether no more frames of tracklet are wanted.
+  bool stable(int tracklet) const;
+  // Frames of tracklet offered, and embedded.
+  int num_offered(int tracklet) const;
+  int num_embedded(int tracklet) const;
+  inline int num_tracklets() const { return tracklets_.size(); }
+  inline int dim() const { return dim_; }
+
+  void set_tolerance(float tolerance);
+  void set_max_stride(int max_stride);
+  void set_patience(int patience);
+  void set_min_frames(int min_frames);
+
+ protected:
+  struct Tracklet {
+    Tracklet() : sum_squares(0), weight(0), offered(0), embedded(0),
+        stride(1), skip(0), calm(0) {}
+    // The quality-weighted sum of the embeddings, and its squared norm.
+    vector<float> sum;
+    float sum_squares;
+    // The sum of the qualities.
+    float weight;
+    int offered;
+    int embedded;
+    int stride;
+    // Frames to skip before the next one embedded.
+    int skip;
+    // Embedded frames in a row that barely turned the descriptor.
+    int calm;
+  };
+
+  const Tracklet& Find(int tracklet) const;
+  bool IsStable(const Tracklet& state) const;
+
+  int dim_;
+  bool normalize_;
+  float tolerance_;
+  int max_stride_;
+  int patience_;
+  int min_frames_;
+  std::map<int, Tracklet> tracklets_;
+  vector<float> frame_;
+
+  DISABLE_COPY_AND_ASSIGN(TrackletAggregator);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TRACKLET_AGGREGATOR_HPP_
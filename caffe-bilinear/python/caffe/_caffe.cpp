@@ -237,6 +237,15 @@ struct NdarrayCallPolicies : public bp::default_call_policies {
   }
 };
 
+// Raises instead of aborting on the diffs of inference nets.
+Dtype* Blob_MutableCpuDiff(Blob<Dtype>* blob) {
+  if (blob->diff_forbidden()) {
+    throw std::runtime_error("Blob.diff is not available in a net that only "
+        "runs forward");
+  }
+  return blob->mutable_cpu_diff();
+}
+
 bp::object Blob_Reshape(bp::tuple args, bp::dict kwargs) {
   if (bp::len(kwargs) > 0) {
     throw std::runtime_error("Blob.reshape takes no kwargs");
@@ -427,7 +436,7 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("reshape",           bp::raw_function(&Blob_Reshape))
     .add_property("data",     bp::make_function(&Blob<Dtype>::mutable_cpu_data,
           NdarrayCallPolicies()))
-    .add_property("diff",     bp::make_function(&Blob<Dtype>::mutable_cpu_diff,
+    .add_property("diff",     bp::make_function(&Blob_MutableCpuDiff,
           NdarrayCallPolicies()));
   BP_REGISTER_SHARED_PTR_TO_PYTHON(Blob<Dtype>);
 
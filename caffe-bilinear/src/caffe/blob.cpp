@@ -40,7 +40,9 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
   if (count_ > capacity_) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
-    diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    if (!diff_free_) {
+      diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    }
   }
 }
 
@@ -63,14 +65,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), diff_free_(false), diff_forbidden_(false) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), diff_free_(false), diff_forbidden_(false) {
   Reshape(shape);
 }
 
@@ -93,7 +95,9 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
   size_t size = count_ * sizeof(Dtype);
   if (data_->size() != size) {
     data_.reset(new SyncedMemory(size));
-    diff_.reset(new SyncedMemory(size));
+    if (!diff_free_) {
+      diff_.reset(new SyncedMemory(size));
+    }
   }
   data_->set_cpu_data(data);
 }
@@ -111,20 +115,22 @@ void Blob<Dtype>::set_gpu_data(Dtype* data) {
   size_t size = count_ * sizeof(Dtype);
   if (data_->size() != size) {
     data_.reset(new SyncedMemory(size));
-    diff_.reset(new SyncedMemory(size));
+    if (!diff_free_) {
+      diff_.reset(new SyncedMemory(size));
+    }
   }
   data_->set_gpu_data(data);
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_diff() const {
-  CHECK(diff_);
+  AllocateDiff();
   return (const Dtype*)diff_->cpu_data();
 }
 
 template <typename Dtype>
 const Dtype* Blob<Dtype>::gpu_diff() const {
-  CHECK(diff_);
+  AllocateDiff();
   return (const Dtype*)diff_->gpu_data();
 }
 
@@ -142,13 +148,13 @@ Dtype* Blob<Dtype>::mutable_gpu_data() {
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_cpu_diff() {
-  CHECK(diff_);
+  AllocateDiff();
   return static_cast<Dtype*>(diff_->mutable_cpu_data());
 }
 
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_diff() {
-  CHECK(diff_);
+  AllocateDiff();
   return static_cast<Dtype*>(diff_->mutable_gpu_data());
 }
 
@@ -161,7 +167,46 @@ void Blob<Dtype>::ShareData(const Blob& other) {
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
-  diff_ = other.diff();
+  if (diff_forbidden_) {
+    return;
+  }
+  if (!diff_free_ && other.diff_free_ && !other.diff_forbidden_) {
+    // The diff this blob needs lives in other from now on.
+    const_cast<Blob&>(other).set_diff_free(false);
+  }
+  diff_ = other.diff_;
+  diff_free_ = other.diff_free_;
+  diff_forbidden_ = other.diff_forbidden_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::set_diff_free(bool diff_free) {
+  CHECK(!diff_forbidden_) << "The diff of this blob is forbidden.";
+  diff_free_ = diff_free;
+  if (diff_free) {
+    diff_.reset();
+  } else if (!diff_ && data_) {
+    diff_.reset(new SyncedMemory(data_->size()));
+  }
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ForbidDiff() {
+  diff_free_ = true;
+  diff_forbidden_ = true;
+  diff_.reset();
+}
+
+template <typename Dtype>
+void Blob<Dtype>::AllocateDiff() const {
+  if (diff_forbidden_) {
+    LOG(FATAL) << "Accessing the diff of a blob of a net that only runs "
+               << "forward.";
+  }
+  if (diff_free_) {
+    const_cast<Blob*>(this)->set_diff_free(false);
+  }
+  CHECK(diff_);
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -441,8 +486,7 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   switch (Caffe::mode()) {
   case Caffe::GPU:
     if (copy_diff) {
-      caffe_copy(count_, source.gpu_diff(),
-          static_cast<Dtype*>(diff_->mutable_gpu_data()));
+      caffe_copy(count_, source.gpu_diff(), mutable_gpu_diff());
     } else {
       caffe_copy(count_, source.gpu_data(),
           static_cast<Dtype*>(data_->mutable_gpu_data()));
@@ -450,8 +494,7 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
     break;
   case Caffe::CPU:
     if (copy_diff) {
-      caffe_copy(count_, source.cpu_diff(),
-          static_cast<Dtype*>(diff_->mutable_cpu_data()));
+      caffe_copy(count_, source.cpu_diff(), mutable_cpu_diff());
     } else {
       caffe_copy(count_, source.cpu_data(),
           static_cast<Dtype*>(data_->mutable_cpu_data()));
@@ -5,6 +5,7 @@
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/memory_pool.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
@@ -27,6 +28,12 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+MemoryPool& Caffe::memory_pool() {
+  // Never destroyed, as blobs may still be freed during static destruction.
+  static MemoryPool* pool = new MemoryPool();
+  return *pool;
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   int64_t s, seed, pid;
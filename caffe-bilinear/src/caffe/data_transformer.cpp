@@ -42,6 +42,12 @@ template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Dtype* transformed_data) {
   const string& data = datum.data();
+  if (data.size() > 0) {
+    Transform(reinterpret_cast<const uint8_t*>(data.data()), datum.channels(),
+        datum.height(), datum.width(), transformed_data);
+    return;
+  }
+  CHECK_EQ(param_.stripes(), 0) << "stripes requires uint8 data";
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
   const int datum_width = datum.width();
@@ -50,7 +56,6 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
@@ -104,12 +109,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
         } else {
           top_index = (c * height + h) * width + w;
         }
-        if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
+        datum_element = datum.float_data(data_index);
         if (has_mean_file) {
           transformed_data[top_index] =
             (datum_element - mean[data_index]) * scale;
@@ -126,6 +126,130 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   }
 }
 
+template<typename Dtype>
+void DataTransformer<Dtype>::RegionShape(const int channels, const int height,
+    int* region_channels, int* region_height) const {
+  const int stripes = param_.stripes();
+  if (stripes == 0) {
+    *region_channels = channels;
+    *region_height = height;
+    return;
+  }
+  const int overlap = param_.stripe_overlap();
+  *region_channels = stripes * channels;
+  *region_height = (height + (stripes - 1) * overlap) / stripes;
+  CHECK_GT(*region_height, overlap) << "stripe_overlap too large for "
+      << stripes << " stripes of " << height << " rows";
+  // The last stripe must fit in the image.
+  CHECK_LE((stripes - 1) * (*region_height - overlap) + *region_height,
+      height);
+}
+
+template<typename Dtype>
+const uint8_t* DataTransformer<Dtype>::RegionRow(const uint8_t* pixels,
+    const int channels, const int height, const int width,
+    const int region_height, const int c, const int h) const {
+  if (param_.stripes() == 0) {
+    return pixels + (c * height + h) * width;
+  }
+  // Channel c of the regions is channel c % channels of stripe c / channels.
+  const int stripe = c / channels;
+  const int start = stripe * (region_height - param_.stripe_overlap());
+  return pixels + ((c % channels) * height + start + h) * width;
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const uint8_t* pixels,
+                                       const int channels,
+                                       const int height,
+                                       const int width,
+                                       Dtype* transformed_data) {
+  // The image as cut into regions, which the rest of the transformation
+  // (crop, mirror, mean) applies to.
+  int datum_channels, datum_height;
+  RegionShape(channels, height, &datum_channels, &datum_height);
+  const int datum_width = width;
+
+  const int crop_size = param_.crop_size();
+  const Dtype scale = param_.scale();
+  const bool do_mirror = param_.mirror() && Rand(2);
+  const bool has_mean_file = param_.has_mean_file();
+  const bool has_mean_values = mean_values_.size() > 0;
+
+  CHECK_GT(datum_channels, 0);
+  CHECK_GE(datum_height, crop_size);
+  CHECK_GE(datum_width, crop_size);
+
+  Dtype* mean = NULL;
+  if (has_mean_file) {
+    CHECK_EQ(datum_channels, data_mean_.channels());
+    CHECK_EQ(datum_height, data_mean_.height());
+    CHECK_EQ(datum_width, data_mean_.width());
+    mean = data_mean_.mutable_cpu_data();
+  }
+  if (has_mean_values) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == datum_channels) <<
+     "Specify either 1 mean_value or as many as channels: " << datum_channels;
+    if (datum_channels > 1 && mean_values_.size() == 1) {
+      // Replicate the mean_value for simplicity
+      for (int c = 1; c < datum_channels; ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+  }
+
+  int crop_height = datum_height;
+  int crop_width = datum_width;
+
+  int h_off = 0;
+  int w_off = 0;
+  if (crop_size) {
+    crop_height = crop_size;
+    crop_width = crop_size;
+    // We only do random crop when we do training.
+    if (phase_ == TRAIN) {
+      h_off = Rand(datum_height - crop_size + 1);
+      w_off = Rand(datum_width - crop_size + 1);
+    } else {
+      h_off = (datum_height - crop_size) / 2;
+      w_off = (datum_width - crop_size) / 2;
+    }
+  }
+
+  for (int c = 0; c < datum_channels; ++c) {
+    const Dtype mean_value = has_mean_values ? mean_values_[c] : Dtype(0);
+    for (int h = 0; h < crop_height; ++h) {
+      const uint8_t* row = RegionRow(pixels, channels, height, width,
+          datum_height, c, h_off + h) + w_off;
+      Dtype* top_row = transformed_data + (c * crop_height + h) * crop_width;
+      if (has_mean_file) {
+        const Dtype* mean_row =
+            mean + (c * datum_height + h_off + h) * datum_width + w_off;
+        for (int w = 0; w < crop_width; ++w) {
+          const int top_index = do_mirror ? crop_width - 1 - w : w;
+          top_row[top_index] =
+              (static_cast<Dtype>(row[w]) - mean_row[w]) * scale;
+        }
+      } else {
+        // Convert whole rows at once with the vectorized kernel.
+        caffe_cpu_uint8_scale(crop_width, row, mean_value, scale, do_mirror,
+            top_row);
+      }
+    }
+  }
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const uint8_t* pixels,
+                                       const int channels, const int height,
+                                       const int width,
+                                       Blob<Dtype>* transformed_blob) {
+  const vector<int> shape = InferBlobShape(channels, height, width);
+  CHECK_EQ(transformed_blob->count(1), shape[1] * shape[2] * shape[3]);
+  CHECK_EQ(transformed_blob->num(), 1);
+  Transform(pixels, channels, height, width,
+      transformed_blob->mutable_cpu_data());
+}
 
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
@@ -154,8 +278,9 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   }
 
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
+  int datum_channels, datum_height;
+  RegionShape(datum.channels(), datum.height(), &datum_channels,
+      &datum_height);
   const int datum_width = datum.width();
 
   // Check dimensions.
@@ -230,6 +355,28 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   const int img_height = cv_img.rows;
   const int img_width = cv_img.cols;
 
+  if (param_.stripes()) {
+    // Cut into regions from the planar layout of the image.
+    CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
+    vector<uint8_t> pixels(img_channels * img_height * img_width);
+    for (int h = 0; h < img_height; ++h) {
+      const uchar* ptr = cv_img.ptr<uchar>(h);
+      for (int w = 0; w < img_width; ++w) {
+        for (int c = 0; c < img_channels; ++c) {
+          pixels[(c * img_height + h) * img_width + w] = *ptr++;
+        }
+      }
+    }
+    const vector<int> shape =
+        InferBlobShape(img_channels, img_height, img_width);
+    CHECK_EQ(transformed_blob->channels(), shape[1]);
+    CHECK_EQ(transformed_blob->height(), shape[2]);
+    CHECK_EQ(transformed_blob->width(), shape[3]);
+    Transform(&pixels[0], img_channels, img_height, img_width,
+        transformed_blob->mutable_cpu_data());
+    return;
+  }
+
   // Check dimensions.
   const int channels = transformed_blob->channels();
   const int height = transformed_blob->height();
@@ -457,10 +604,16 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
   }
+  return InferBlobShape(datum.channels(), datum.height(), datum.width());
+}
+
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const int channels,
+    const int height, const int width) {
+  int datum_channels, datum_height;
+  RegionShape(channels, height, &datum_channels, &datum_height);
+  const int datum_width = width;
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
   // Check dimensions.
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
@@ -493,6 +646,9 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const cv::Mat& cv_img) {
   const int img_channels = cv_img.channels();
   const int img_height = cv_img.rows;
   const int img_width = cv_img.cols;
+  if (param_.stripes()) {
+    return InferBlobShape(img_channels, img_height, img_width);
+  }
   // Check dimensions.
   CHECK_GT(img_channels, 0);
   CHECK_GE(img_height, crop_size);
@@ -25,6 +25,7 @@ void BaseDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   } else {
     output_labels_ = true;
   }
+  output_cameras_ = top.size() > 2;
   data_transformer_.reset(
       new DataTransformer<Dtype>(transform_param_, this->phase_));
   data_transformer_->InitRand();
@@ -58,6 +59,9 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     if (this->output_labels_) {
       prefetch_[i]->label_.mutable_cpu_data();
     }
+    if (this->output_cameras_) {
+      prefetch_[i]->camera_.mutable_cpu_data();
+    }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
@@ -66,11 +70,28 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
       if (this->output_labels_) {
         prefetch_[i]->label_.mutable_gpu_data();
       }
+      if (this->output_cameras_) {
+        prefetch_[i]->camera_.mutable_gpu_data();
+      }
     }
   }
 #endif
   DLOG(INFO) << "Initializing prefetch";
   this->data_transformer_->InitRand();
+  const int decode_threads = this->layer_param_.data_param().decode_threads();
+  if (decode_threads > 1) {
+    decode_transformers_.clear();
+    decode_transformers_.push_back(this->data_transformer_);
+    for (int i = 1; i < decode_threads; ++i) {
+      // Seeded here, from this thread's random generator, so that the
+      // sequence of each worker is reproducible under set_random_seed.
+      shared_ptr<DataTransformer<Dtype> > transformer(
+          new DataTransformer<Dtype>(this->transform_param_, this->phase_));
+      transformer->InitRand();
+      decode_transformers_.push_back(transformer);
+    }
+    decode_pool_.reset(new ThreadPool(decode_threads));
+  }
   StartInternalThread();
   DLOG(INFO) << "Prefetch initialized.";
 }
@@ -94,6 +115,9 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
         if (this->output_labels_) {
           batch->label_.data().get()->async_gpu_push(stream);
         }
+        if (this->output_cameras_) {
+          batch->camera_.data().get()->async_gpu_push(stream);
+        }
         CUDA_CHECK(cudaStreamSynchronize(stream));
       }
 #endif
@@ -124,6 +148,10 @@ void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     top[1]->ReshapeLike(prefetch_current_->label_);
     top[1]->set_cpu_data(prefetch_current_->label_.mutable_cpu_data());
   }
+  if (this->output_cameras_) {
+    top[2]->ReshapeLike(prefetch_current_->camera_);
+    top[2]->set_cpu_data(prefetch_current_->camera_.mutable_cpu_data());
+  }
 }
 
 #ifdef CPU_ONLY
@@ -19,6 +19,10 @@ void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
     top[1]->ReshapeLike(prefetch_current_->label_);
     top[1]->set_gpu_data(prefetch_current_->label_.mutable_gpu_data());
   }
+  if (this->output_cameras_) {
+    top[2]->ReshapeLike(prefetch_current_->camera_);
+    top[2]->set_gpu_data(prefetch_current_->camera_.mutable_gpu_data());
+  }
 }
 
 INSTANTIATE_LAYER_GPU_FORWARD(BasePrefetchingDataLayer);
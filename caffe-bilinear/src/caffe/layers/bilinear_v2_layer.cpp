@@ -0,0 +1,149 @@
+#include <vector>
+
+#include "caffe/layers/bilinear_v2_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const BilinearV2Parameter& param = this->layer_param_.bilinear_v2_param();
+  patch_h_ = param.patch_h();
+  patch_w_ = param.patch_w();
+  CHECK_GT(patch_h_, 0) << "patch_h must be positive.";
+  CHECK_GT(patch_w_, 0) << "patch_w must be positive.";
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(4, bottom[0]->num_axes()) << "Inputs must have 4 axes.";
+  CHECK_EQ(4, bottom[1]->num_axes()) << "Inputs must have 4 axes.";
+  CHECK_EQ(bottom[0]->num(), bottom[1]->num());
+  CHECK_EQ(bottom[0]->height(), bottom[1]->height());
+  CHECK_EQ(bottom[0]->width(), bottom[1]->width());
+  num_ = bottom[0]->num();
+  channels_a_ = bottom[0]->channels();
+  channels_b_ = bottom[1]->channels();
+  height_ = bottom[0]->height();
+  width_ = bottom[0]->width();
+  top_height_ = height_ / patch_h_;
+  top_width_ = width_ / patch_w_;
+  CHECK_GT(top_height_, 0) << "Inputs are smaller than a patch.";
+  CHECK_GT(top_width_, 0) << "Inputs are smaller than a patch.";
+  top[0]->Reshape(num_, channels_a_ * channels_b_, top_height_, top_width_);
+  patch_a_.Reshape(1, channels_a_, patch_h_, patch_w_);
+  patch_b_.Reshape(1, channels_b_, patch_h_, patch_w_);
+  product_.Reshape(1, channels_a_, channels_b_, 1);
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::PackPatch(const Dtype* blob, int channels,
+    int n, int ph, int pw, Dtype* patch) const {
+  for (int c = 0; c < channels; ++c) {
+    const Dtype* src = blob + ((n * channels + c) * height_ + ph * patch_h_)
+        * width_ + pw * patch_w_;
+    for (int y = 0; y < patch_h_; ++y, src += width_, patch += patch_w_) {
+      caffe_copy(patch_w_, src, patch);
+    }
+  }
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::UnpackPatch(const Dtype* patch, int channels,
+    int n, int ph, int pw, Dtype* blob) const {
+  for (int c = 0; c < channels; ++c) {
+    Dtype* dst = blob + ((n * channels + c) * height_ + ph * patch_h_)
+        * width_ + pw * patch_w_;
+    for (int y = 0; y < patch_h_; ++y, dst += width_, patch += patch_w_) {
+      caffe_copy(patch_w_, patch, dst);
+    }
+  }
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int patch_size = patch_h_ * patch_w_;
+  const int top_size = top_height_ * top_width_;
+  Dtype* patch_a = patch_a_.mutable_cpu_data();
+  Dtype* patch_b = patch_b_.mutable_cpu_data();
+  Dtype* product = product_.mutable_cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  for (int n = 0; n < num_; ++n) {
+    for (int ph = 0; ph < top_height_; ++ph) {
+      for (int pw = 0; pw < top_width_; ++pw) {
+        PackPatch(bottom[0]->cpu_data(), channels_a_, n, ph, pw, patch_a);
+        PackPatch(bottom[1]->cpu_data(), channels_b_, n, ph, pw, patch_b);
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, channels_a_,
+            channels_b_, patch_size, Dtype(1), patch_a, patch_b, Dtype(0),
+            product);
+        Dtype* top_patch = top_data + n * channels_a_ * channels_b_ * top_size
+            + ph * top_width_ + pw;
+        for (int ab = 0; ab < channels_a_ * channels_b_; ++ab) {
+          top_patch[ab * top_size] = product[ab];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0] && !propagate_down[1]) {
+    return;
+  }
+  const int patch_size = patch_h_ * patch_w_;
+  const int top_size = top_height_ * top_width_;
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* patch_a = patch_a_.mutable_cpu_data();
+  Dtype* patch_b = patch_b_.mutable_cpu_data();
+  Dtype* patch_a_diff = patch_a_.mutable_cpu_diff();
+  Dtype* patch_b_diff = patch_b_.mutable_cpu_diff();
+  Dtype* product_diff = product_.mutable_cpu_diff();
+  // Values past the last whole patch get no gradient.
+  for (int i = 0; i < 2; ++i) {
+    if (propagate_down[i]) {
+      caffe_set(bottom[i]->count(), Dtype(0), bottom[i]->mutable_cpu_diff());
+    }
+  }
+  for (int n = 0; n < num_; ++n) {
+    for (int ph = 0; ph < top_height_; ++ph) {
+      for (int pw = 0; pw < top_width_; ++pw) {
+        const Dtype* top_patch = top_diff +
+            n * channels_a_ * channels_b_ * top_size + ph * top_width_ + pw;
+        for (int ab = 0; ab < channels_a_ * channels_b_; ++ab) {
+          product_diff[ab] = top_patch[ab * top_size];
+        }
+        PackPatch(bottom[0]->cpu_data(), channels_a_, n, ph, pw, patch_a);
+        PackPatch(bottom[1]->cpu_data(), channels_b_, n, ph, pw, patch_b);
+        if (propagate_down[0]) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels_a_,
+              patch_size, channels_b_, Dtype(1), product_diff, patch_b,
+              Dtype(0), patch_a_diff);
+          UnpackPatch(patch_a_diff, channels_a_, n, ph, pw,
+              bottom[0]->mutable_cpu_diff());
+        }
+        if (propagate_down[1]) {
+          caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, channels_b_,
+              patch_size, channels_a_, Dtype(1), product_diff, patch_a,
+              Dtype(0), patch_b_diff);
+          UnpackPatch(patch_b_diff, channels_b_, n, ph, pw,
+              bottom[1]->mutable_cpu_diff());
+        }
+      }
+    }
+  }
+}
+
+#ifdef CPU_ONLY
+STUB_GPU(BilinearV2Layer);
+#endif
+
+INSTANTIATE_CLASS(BilinearV2Layer);
+REGISTER_LAYER_CLASS(BilinearV2);
+
+}  // namespace caffe
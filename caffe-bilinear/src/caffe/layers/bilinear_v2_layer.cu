@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/bilinear_v2_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+// Side of the square tiles of products each thread block computes.
+#define BILINEAR_TILE 16
+
+namespace caffe {
+
+// Offset in an NCHW blob of the value of channel c at pixel p of the patch
+// (ph, pw) of image n.
+__device__ inline int PatchOffset(int n, int c, int p, int ph, int pw,
+    int channels, int height, int width, int patch_h, int patch_w) {
+  const int y = ph * patch_h + p / patch_w;
+  const int x = pw * patch_w + p % patch_w;
+  return ((n * channels + c) * height + y) * width + x;
+}
+
+// Block (bx, by, patch) computes the products of channels
+// a in [by * TILE, (by + 1) * TILE) and b in [bx * TILE, (bx + 1) * TILE),
+// loading TILE pixels of the patch from each input at a time.
+template <typename Dtype>
+__global__ void BilinearV2Forward(const int num_patches, const Dtype* a_data,
+    const Dtype* b_data, const int channels_a, const int channels_b,
+    const int height, const int width, const int patch_h, const int patch_w,
+    const int top_height, const int top_width, Dtype* top_data) {
+  __shared__ Dtype a_tile[BILINEAR_TILE][BILINEAR_TILE + 1];
+  __shared__ Dtype b_tile[BILINEAR_TILE][BILINEAR_TILE + 1];
+  const int tx = threadIdx.x;
+  const int ty = threadIdx.y;
+  const int a = blockIdx.y * BILINEAR_TILE + ty;
+  const int b = blockIdx.x * BILINEAR_TILE + tx;
+  const int patch_size = patch_h * patch_w;
+  for (int patch = blockIdx.z; patch < num_patches; patch += gridDim.z) {
+    const int pw = patch % top_width;
+    const int ph = (patch / top_width) % top_height;
+    const int n = patch / top_width / top_height;
+    Dtype sum = 0;
+    for (int p0 = 0; p0 < patch_size; p0 += BILINEAR_TILE) {
+      const int p = p0 + tx;
+      const int load_b = blockIdx.x * BILINEAR_TILE + ty;
+      a_tile[ty][tx] = (a < channels_a && p < patch_size) ?
+          a_data[PatchOffset(n, a, p, ph, pw, channels_a, height, width,
+                             patch_h, patch_w)] : Dtype(0);
+      b_tile[ty][tx] = (load_b < channels_b && p < patch_size) ?
+          b_data[PatchOffset(n, load_b, p, ph, pw, channels_b, height, width,
+                             patch_h, patch_w)] : Dtype(0);
+      __syncthreads();
+      for (int t = 0; t < BILINEAR_TILE; ++t) {
+        sum += a_tile[ty][t] * b_tile[tx][t];
+      }
+      __syncthreads();
+    }
+    if (a < channels_a && b < channels_b) {
+      top_data[((n * channels_a * channels_b + a * channels_b + b)
+          * top_height + ph) * top_width + pw] = sum;
+    }
+  }
+}
+
+// Gradient wrt the first input: dA[a][p] = sum_b dY[a][b] B[b][p]. Block
+// (bx, by, patch) computes a in [by * TILE, ...) and p in [bx * TILE, ...).
+// The gradient wrt the second input, dB[b][p] = sum_a dY[a][b] A[a][p], is
+// the same with the roles of the inputs swapped and dY transposed.
+template <typename Dtype>
+__global__ void BilinearV2Backward(const int num_patches, const Dtype* top_diff,
+    const Dtype* other_data, const int channels, const int other_channels,
+    const bool transpose, const int height, const int width,
+    const int patch_h, const int patch_w, const int top_height,
+    const int top_width, Dtype* bottom_diff) {
+  __shared__ Dtype g_tile[BILINEAR_TILE][BILINEAR_TILE + 1];
+  __shared__ Dtype x_tile[BILINEAR_TILE][BILINEAR_TILE + 1];
+  const int tx = threadIdx.x;
+  const int ty = threadIdx.y;
+  const int c = blockIdx.y * BILINEAR_TILE + ty;
+  const int p = blockIdx.x * BILINEAR_TILE + tx;
+  const int patch_size = patch_h * patch_w;
+  const int top_size = top_height * top_width;
+  for (int patch = blockIdx.z; patch < num_patches; patch += gridDim.z) {
+    const int pw = patch % top_width;
+    const int ph = (patch / top_width) % top_height;
+    const int n = patch / top_width / top_height;
+    const Dtype* top_patch = top_diff +
+        n * channels * other_channels * top_size + ph * top_width + pw;
+    Dtype sum = 0;
+    for (int o0 = 0; o0 < other_channels; o0 += BILINEAR_TILE) {
+      const int o = o0 + tx;
+      const int load_o = o0 + ty;
+      if (c < channels && o < other_channels) {
+        const int ab = transpose ? o * channels + c : c * other_channels + o;
+        g_tile[ty][tx] = top_patch[ab * top_size];
+      } else {
+        g_tile[ty][tx] = 0;
+      }
+      x_tile[ty][tx] = (load_o < other_channels && p < patch_size) ?
+          other_data[PatchOffset(n, load_o, p, ph, pw, other_channels, height,
+                                 width, patch_h, patch_w)] : Dtype(0);
+      __syncthreads();
+      for (int t = 0; t < BILINEAR_TILE; ++t) {
+        sum += g_tile[ty][t] * x_tile[t][tx];
+      }
+      __syncthreads();
+    }
+    if (c < channels && p < patch_size) {
+      bottom_diff[PatchOffset(n, c, p, ph, pw, channels, height, width,
+                              patch_h, patch_w)] = sum;
+    }
+  }
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int num_patches = num_ * top_height_ * top_width_;
+  const dim3 threads(BILINEAR_TILE, BILINEAR_TILE);
+  const dim3 blocks((channels_b_ + BILINEAR_TILE - 1) / BILINEAR_TILE,
+      (channels_a_ + BILINEAR_TILE - 1) / BILINEAR_TILE,
+      std::min(num_patches, 65535));
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  BilinearV2Forward<Dtype><<<blocks, threads>>>(num_patches,
+      bottom[0]->gpu_data(), bottom[1]->gpu_data(), channels_a_, channels_b_,
+      height_, width_, patch_h_, patch_w_, top_height_, top_width_,
+      top[0]->mutable_gpu_data());
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template <typename Dtype>
+void BilinearV2Layer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  const int num_patches = num_ * top_height_ * top_width_;
+  const int patch_size = patch_h_ * patch_w_;
+  const dim3 threads(BILINEAR_TILE, BILINEAR_TILE);
+  for (int i = 0; i < 2; ++i) {
+    if (!propagate_down[i]) {
+      continue;
+    }
+    const int channels = i == 0 ? channels_a_ : channels_b_;
+    const int other_channels = i == 0 ? channels_b_ : channels_a_;
+    Dtype* bottom_diff = bottom[i]->mutable_gpu_diff();
+    if (top_height_ * patch_h_ != height_ || top_width_ * patch_w_ != width_) {
+      // Values past the last whole patch get no gradient.
+      caffe_gpu_set(bottom[i]->count(), Dtype(0), bottom_diff);
+    }
+    const dim3 blocks((patch_size + BILINEAR_TILE - 1) / BILINEAR_TILE,
+        (channels + BILINEAR_TILE - 1) / BILINEAR_TILE,
+        std::min(num_patches, 65535));
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    BilinearV2Backward<Dtype><<<blocks, threads>>>(num_patches,
+        top[0]->gpu_diff(), bottom[1 - i]->gpu_data(), channels,
+        other_channels, i == 1, height_, width_, patch_h_, patch_w_,
+        top_height_, top_width_, bottom_diff);
+    CUDA_POST_KERNEL_CHECK;
+  }
+}
+
+INSTANTIATE_LAYER_GPU_FUNCS(BilinearV2Layer);
+
+}  // namespace caffe
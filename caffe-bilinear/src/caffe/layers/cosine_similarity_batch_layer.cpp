@@ -1,8 +1,12 @@
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
 #include <vector>
 
 #include "caffe/layer.hpp"
 #include "caffe/layers/cosine_similarity_batch_layer.hpp"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include <math.h> 
@@ -18,11 +22,6 @@ void CosineSimilarityBatchLayer<Dtype>::LayerSetUp(
   CHECK_EQ(bottom[1]->height(), 1);
   CHECK_EQ(bottom[1]->width(), 1);
   CHECK_EQ(bottom[1]->channels(), 1);
-  
-  xy_ = new Dtype*[bottom[0]->num()];
-  for (int i = 0; i < bottom[0]->num(); i++){
-    xy_[i] = new Dtype[bottom[0]->num()];
-  } 
 }
          
 template <typename Dtype>
@@ -32,7 +31,18 @@ void CosineSimilarityBatchLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bott
   top[0]->Reshape(bottom[0]->num()*(bottom[0]->num() - 1)/2, 1, 1, 1);
   top[1]->Reshape(bottom[1]->num()*(bottom[1]->num() - 1)/2, 1, 1, 1);
   top[2]->Reshape(bottom[1]->num()*(bottom[1]->num() - 1)/2, 1, 1, 1);
-  num_ = bottom[0]->num();
+  // xy_ holds num x num dot products; reallocate it when the batch changes.
+  if (bottom[0]->num() != num_) {
+    for (int i = 0; i < num_; i++){
+      delete [] xy_[i];
+    }
+    delete [] xy_;
+    num_ = bottom[0]->num();
+    xy_ = new Dtype*[num_];
+    for (int i = 0; i < num_; i++){
+      xy_[i] = new Dtype[num_];
+    }
+  }
 }
 
 template <typename Dtype>
@@ -89,32 +99,127 @@ void CosineSimilarityBatchLayer<Dtype>::Forward_cpu(
       k++;
     }
   } 
- 
+
+  const CosineSimilarityBatchParameter& param =
+      this->layer_param_.cosine_similarity_batch_param();
+  if (param.hard_negatives() || param.hard_positives() ||
+      param.semi_hard()) {
+    CPUTimer timer;
+    timer.Start();
+    MinePairs(top);
+    DLOG(INFO) << "Pair mining: " << timer.MilliSeconds() << " ms.";
+  }
+  active_i_.clear();
+  active_j_.clear();
+  for (int i = 0, h = 0; i < num_; ++i) {
+    for (int j = i + 1; j < num_; ++j, ++h) {
+      if (top[2]->cpu_data()[h]) {
+        active_i_.push_back(i);
+        active_j_.push_back(j);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void CosineSimilarityBatchLayer<Dtype>::MinePairs(
+    const vector<Blob<Dtype>*>& top) {
+  const CosineSimilarityBatchParameter& param =
+      this->layer_param_.cosine_similarity_batch_param();
+  const Dtype* similarity = top[0]->cpu_data();
+  const Dtype* label = top[1]->cpu_data();
+  Dtype* keep = top[2]->mutable_cpu_data();
+  const Dtype pos_label = param.pos_label();
+  const int num_pairs = top[2]->count();
+  vector<char> selected(num_pairs, 0);
+  // (similarity, pair index) of the candidate pairs of one item.
+  vector<std::pair<Dtype, int> > negatives, positives;
+  for (int i = 0; i < num_; ++i) {
+    negatives.clear();
+    positives.clear();
+    for (int j = 0; j < num_; ++j) {
+      if (j == i) {
+        continue;
+      }
+      const int h = i < j ? PairIndex(i, j) : PairIndex(j, i);
+      if (!keep[h]) {
+        continue;
+      }
+      if (label[h] == pos_label) {
+        positives.push_back(std::make_pair(similarity[h], h));
+      } else {
+        negatives.push_back(std::make_pair(similarity[h], h));
+      }
+    }
+    if (param.semi_hard() && !positives.empty()) {
+      Dtype hardest_positive = std::numeric_limits<Dtype>::max();
+      for (int p = 0; p < positives.size(); ++p) {
+        hardest_positive = std::min(hardest_positive, positives[p].first);
+      }
+      int kept = 0;
+      for (int n = 0; n < negatives.size(); ++n) {
+        if (negatives[n].first < hardest_positive) {
+          negatives[kept++] = negatives[n];
+        }
+      }
+      negatives.resize(kept);
+    }
+    // The hardest negatives are the most similar, the hardest positives the
+    // least similar: select them in linear time, unordered.
+    if (param.hard_negatives() && param.hard_negatives() < negatives.size()) {
+      std::nth_element(negatives.begin(),
+          negatives.begin() + param.hard_negatives(), negatives.end(),
+          std::greater<std::pair<Dtype, int> >());
+      negatives.resize(param.hard_negatives());
+    }
+    if (param.hard_positives() && param.hard_positives() < positives.size()) {
+      std::nth_element(positives.begin(),
+          positives.begin() + param.hard_positives(), positives.end());
+      positives.resize(param.hard_positives());
+    }
+    for (int n = 0; n < negatives.size(); ++n) {
+      selected[negatives[n].second] = 1;
+    }
+    for (int p = 0; p < positives.size(); ++p) {
+      selected[positives[p].second] = 1;
+    }
+  }
+  for (int h = 0; h < num_pairs; ++h) {
+    if (!selected[h]) {
+      keep[h] = 0;
+    }
+  }
 }
 
 template <typename Dtype>
 void CosineSimilarityBatchLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-    
-  int channels = bottom[0]->channels();
-  int num = bottom[0]->num();
-  for (int i = 0; i < num; ++i) {
-    for (int k = 0; k < channels; ++k) {
-      Dtype dsdx = 0;
-      for (int j = 0; j < num; ++j) {
-	//i j --> h    
-        int h;
-        if (i < j)
-          h =  num * i - i * (i+1)/2 + j-i-1;
-	else if (i > j)
-          h =  num * j - j * (j+1)/2 + i-j-1;               
-        else continue;
-        Dtype add_dsdx = top[0]->cpu_diff()[h] * top[2]->cpu_data()[h] * (bottom[0]->cpu_data()[j*channels + k]/sqrt(xy_[i][i] * xy_[j][j]) - xy_[i][j]/xy_[i][i] * bottom[0]->cpu_data()[i*channels + k]/sqrt(xy_[i][i] * xy_[j][j]));
-        dsdx += add_dsdx;
-    }		
-    bottom[0]->mutable_cpu_diff()[i*channels + k] = dsdx; 
+  if (!propagate_down[0]) {
+    return;
+  }
+  const int channels = bottom[0]->channels();
+  const Dtype* x = bottom[0]->cpu_data();
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* keep = top[2]->cpu_data();
+  Dtype* x_diff = bottom[0]->mutable_cpu_diff();
+  caffe_set(bottom[0]->count(), Dtype(0), x_diff);
+  // Only the pairs kept by Forward have a gradient:
+  // ds_ij/dx_i = (x_j - x_ij / x_ii * x_i) / sqrt(x_ii * x_jj).
+  for (int p = 0; p < active_i_.size(); ++p) {
+    const int i = active_i_[p];
+    const int j = active_j_[p];
+    const int h = PairIndex(i, j);
+    const Dtype g = top_diff[h] * keep[h] / sqrt(xy_[i][i] * xy_[j][j]);
+    if (g == 0) {
+      continue;
+    }
+    caffe_axpy(channels, g, x + j * channels, x_diff + i * channels);
+    caffe_axpy(channels, -g * xy_[i][j] / xy_[i][i], x + i * channels,
+        x_diff + i * channels);
+    caffe_axpy(channels, g, x + i * channels, x_diff + j * channels);
+    caffe_axpy(channels, -g * xy_[i][j] / xy_[j][j], x + j * channels,
+        x_diff + j * channels);
   }
-} 
 }
 
 #ifdef CPU_ONLY
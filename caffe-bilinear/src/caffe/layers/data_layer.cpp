@@ -3,6 +3,8 @@
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <boost/bind.hpp>
+#include <string>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
@@ -54,6 +56,14 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       this->prefetch_[i]->label_.Reshape(label_shape);
     }
   }
+  // camera
+  if (this->output_cameras_) {
+    vector<int> camera_shape(1, batch_size);
+    top[2]->Reshape(camera_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->camera_.Reshape(camera_shape);
+    }
+  }
 }
 
 template <typename Dtype>
@@ -89,6 +99,48 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CHECK(this->transformed_data_.count());
   const int batch_size = this->layer_param_.data_param().batch_size();
 
+  if (this->decode_pool_) {
+    // Read the raw values in order on this thread, then let the workers
+    // parse and transform disjoint ranges of them.
+    values_.resize(batch_size);
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      timer.Start();
+      while (Skip()) {
+        Next();
+      }
+      values_[item_id] = cursor_->value();
+      read_time += timer.MicroSeconds();
+      Next();
+    }
+    // Reshape according to the first datum of each batch.
+    Datum datum;
+    datum.ParseFromString(values_[0]);
+    vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+    this->transformed_data_.Reshape(top_shape);
+    top_shape[0] = batch_size;
+    batch->data_.Reshape(top_shape);
+    Dtype* top_data = batch->data_.mutable_cpu_data();
+    Dtype* top_label = this->output_labels_ ?
+        batch->label_.mutable_cpu_data() : NULL;
+    Dtype* top_camera = this->output_cameras_ ?
+        batch->camera_.mutable_cpu_data() : NULL;
+    const int num_workers = this->decode_pool_->num_threads();
+    read_time_.assign(num_workers, 0);
+    trans_time_.assign(num_workers, 0);
+    this->decode_pool_->Run(
+        boost::bind(&DataLayer<Dtype>::DecodeRange, this, top_data, top_label,
+                    top_camera, _1));
+    batch_timer.Stop();
+    DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+    DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
+    for (int i = 0; i < num_workers; ++i) {
+      DLOG(INFO) << "  Worker " << i << " parse time: "
+          << read_time_[i] / 1000 << " ms, transform time: "
+          << trans_time_[i] / 1000 << " ms.";
+    }
+    return;
+  }
+
   Datum datum;
   for (int item_id = 0; item_id < batch_size; ++item_id) {
     timer.Start();
@@ -120,6 +172,10 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       Dtype* top_label = batch->label_.mutable_cpu_data();
       top_label[item_id] = datum.label();
     }
+    if (this->output_cameras_) {
+      Dtype* top_camera = batch->camera_.mutable_cpu_data();
+      top_camera[item_id] = datum.camera();
+    }
     trans_time += timer.MicroSeconds();
     Next();
   }
@@ -130,6 +186,40 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
 }
 
+// This function is called on the decode threads
+template<typename Dtype>
+void DataLayer<Dtype>::DecodeRange(Dtype* top_data, Dtype* top_label,
+    Dtype* top_camera, int worker) {
+  // Timed without CPUTimer, which would set up Caffe on this thread.
+  using boost::posix_time::microsec_clock;
+  using boost::posix_time::ptime;
+  int begin, end;
+  ThreadPool::Partition(values_.size(), this->decode_pool_->num_threads(),
+      worker, &begin, &end);
+  DataTransformer<Dtype>* transformer =
+      this->decode_transformers_[worker].get();
+  // A view of one item of the batch, like transformed_data_.
+  Blob<Dtype> transformed_data(this->transformed_data_.shape());
+  const int item_size = transformed_data.count();
+  Datum datum;
+  for (int item_id = begin; item_id < end; ++item_id) {
+    const ptime start = microsec_clock::local_time();
+    datum.ParseFromString(values_[item_id]);
+    const ptime parsed = microsec_clock::local_time();
+    read_time_[worker] += (parsed - start).total_microseconds();
+    transformed_data.set_cpu_data(top_data + item_id * item_size);
+    transformer->Transform(datum, &transformed_data);
+    if (top_label) {
+      top_label[item_id] = datum.label();
+    }
+    if (top_camera) {
+      top_camera[item_id] = datum.camera();
+    }
+    trans_time_[worker] +=
+        (microsec_clock::local_time() - parsed).total_microseconds();
+  }
+}
+
 INSTANTIATE_CLASS(DataLayer);
 REGISTER_LAYER_CLASS(Data);
 
@@ -10,7 +10,11 @@ template <typename Dtype>
 void HingeLossLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  if (bottom[0]->diff_free()) {
+    margins_.ReshapeLike(*bottom[0]);
+  }
+  Dtype* bottom_diff = bottom[0]->diff_free() ?
+      margins_.mutable_cpu_data() : bottom[0]->mutable_cpu_diff();
   const Dtype* label = bottom[1]->cpu_data();
   int num = bottom[0]->num();
   int count = bottom[0]->count();
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/lifted_struct_similarity_softmax_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void LiftedStructSimilaritySoftmaxLossLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LossLayer<Dtype>::Reshape(bottom, top);
+  CHECK_EQ(bottom[1]->count(), bottom[1]->num())
+      << "Labels must have one value per item.";
+  const int num = bottom[0]->num();
+  dot_.Reshape(num, num, 1, 1);
+  dist_.Reshape(num, num, 1, 1);
+  log_sum_exp_.Reshape(num, 1, 1, 1);
+  row_loss_.Reshape(num, 1, 1, 1);
+  row_weight_.Reshape(num, 1, 1, 1);
+  row_sum_.Reshape(num, 1, 1, 1);
+  if (ones_.count() != num) {
+    ones_.Reshape(num, 1, 1, 1);
+    caffe_set(num, Dtype(1), ones_.mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+int LiftedStructSimilaritySoftmaxLossLayer<Dtype>::CountPositivePairs(
+    const Blob<Dtype>* label) const {
+  vector<Dtype> sorted(label->cpu_data(), label->cpu_data() + label->count());
+  std::sort(sorted.begin(), sorted.end());
+  int num_pairs = 0;
+  for (int i = 0, run = 0; i < sorted.size(); ++i) {
+    run = (i > 0 && sorted[i] == sorted[i - 1]) ? run + 1 : 0;
+    num_pairs += run;
+  }
+  return num_pairs;
+}
+
+// log(e^a + e^b), finite for the -FLT_MAX of items without negatives.
+template <typename Dtype>
+inline Dtype LogAddExp(Dtype a, Dtype b) {
+  const Dtype m = std::max(a, b);
+  return m + log(exp(a - m) + exp(b - m));
+}
+
+template <typename Dtype>
+void LiftedStructSimilaritySoftmaxLossLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int num = bottom[0]->num();
+  const int dim = bottom[0]->count() / num;
+  const Dtype margin =
+      this->layer_param_.lifted_struct_sim_softmax_loss_param().margin();
+  const Dtype* label = bottom[1]->cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, num, dim, Dtype(1),
+      bottom[0]->cpu_data(), bottom[0]->cpu_data(), Dtype(0),
+      dot_.mutable_cpu_data());
+  const Dtype* dot = dot_.cpu_data();
+  Dtype* dist = dist_.mutable_cpu_data();
+  for (int i = 0; i < num; ++i) {
+    for (int j = 0; j < num; ++j) {
+      const Dtype dist_sq =
+          dot[i * num + i] + dot[j * num + j] - 2 * dot[i * num + j];
+      dist[i * num + j] = sqrt(std::max(dist_sq, Dtype(0)));
+    }
+  }
+  // Log-sum-exp over the negatives of each item, shared by its pairs.
+  Dtype* log_sum_exp = log_sum_exp_.mutable_cpu_data();
+  for (int i = 0; i < num; ++i) {
+    Dtype max_value = -FLT_MAX;
+    for (int k = 0; k < num; ++k) {
+      if (label[k] != label[i]) {
+        max_value = std::max(max_value, margin - dist[i * num + k]);
+      }
+    }
+    Dtype sum = 0;
+    for (int k = 0; k < num; ++k) {
+      if (label[k] != label[i]) {
+        sum += exp(margin - dist[i * num + k] - max_value);
+      }
+    }
+    log_sum_exp[i] = sum > 0 ? max_value + log(sum) : -FLT_MAX;
+  }
+  Dtype* row_loss = row_loss_.mutable_cpu_data();
+  Dtype* row_weight = row_weight_.mutable_cpu_data();
+  for (int i = 0; i < num; ++i) {
+    row_loss[i] = 0;
+    row_weight[i] = 0;
+    for (int j = 0; j < num; ++j) {
+      if (j == i || label[j] != label[i]) {
+        continue;
+      }
+      const Dtype lse = LogAddExp(log_sum_exp[i], log_sum_exp[j]);
+      const Dtype J = lse + dist[i * num + j];
+      if (J > 0) {
+        row_loss[i] += J * J;
+        row_weight[i] += J * exp(log_sum_exp[i] - lse);
+      }
+    }
+  }
+  num_positive_pairs_ = CountPositivePairs(bottom[1]);
+  // Every pair is counted by both of its items.
+  top[0]->mutable_cpu_data()[0] = num_positive_pairs_ ?
+      caffe_cpu_asum(num, row_loss) / (4 * num_positive_pairs_) : Dtype(0);
+}
+
+template <typename Dtype>
+void LiftedStructSimilaritySoftmaxLossLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (propagate_down[1]) {
+    LOG(FATAL) << this->type()
+               << " Layer cannot backpropagate to label inputs.";
+  }
+  if (!propagate_down[0]) {
+    return;
+  }
+  const int num = bottom[0]->num();
+  const int dim = bottom[0]->count() / num;
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  if (!num_positive_pairs_) {
+    caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+    return;
+  }
+  const Dtype margin =
+      this->layer_param_.lifted_struct_sim_softmax_loss_param().margin();
+  const Dtype* label = bottom[1]->cpu_data();
+  const Dtype* dist = dist_.cpu_data();
+  const Dtype* log_sum_exp = log_sum_exp_.cpu_data();
+  const Dtype* row_weight = row_weight_.cpu_data();
+  // Gradient wrt d_ij, up to 1 / |P|, over d_ij: reuses the Gram matrix.
+  Dtype* weight = dot_.mutable_cpu_data();
+  for (int i = 0; i < num; ++i) {
+    for (int j = 0; j < num; ++j) {
+      const Dtype d = dist[i * num + j];
+      Dtype g = 0;
+      if (label[j] == label[i]) {
+        if (j != i) {
+          g = std::max(LogAddExp(log_sum_exp[i], log_sum_exp[j]) + d,
+              Dtype(0));
+        }
+      } else {
+        g = -row_weight[i] * exp(margin - d - log_sum_exp[i])
+            - row_weight[j] * exp(margin - d - log_sum_exp[j]);
+      }
+      weight[i * num + j] = g / std::max(d, Dtype(1e-4));
+    }
+  }
+  // dE/dx_i = scale * (sum_j w_ij x_i - sum_j w_ij x_j).
+  const Dtype scale = top[0]->cpu_diff()[0] / num_positive_pairs_;
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, num, -scale,
+      weight, bottom_data, Dtype(0), bottom_diff);
+  caffe_cpu_gemv<Dtype>(CblasNoTrans, num, num, Dtype(1), weight,
+      ones_.cpu_data(), Dtype(0), row_sum_.mutable_cpu_data());
+  const Dtype* row_sum = row_sum_.cpu_data();
+  for (int i = 0; i < num; ++i) {
+    caffe_axpy(dim, scale * row_sum[i], bottom_data + i * dim,
+        bottom_diff + i * dim);
+  }
+}
+
+#ifdef CPU_ONLY
+STUB_GPU(LiftedStructSimilaritySoftmaxLossLayer);
+#endif
+
+INSTANTIATE_CLASS(LiftedStructSimilaritySoftmaxLossLayer);
+REGISTER_LAYER_CLASS(LiftedStructSimilaritySoftmaxLoss);
+
+}  // namespace caffe
@@ -0,0 +1,171 @@
+#include <cfloat>
+#include <vector>
+
+#include "caffe/layers/lifted_struct_similarity_softmax_loss_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+__device__ Dtype LogAddExpGPU(Dtype a, Dtype b) {
+  const Dtype m = max(a, b);
+  return m + log(exp(a - m) + exp(b - m));
+}
+
+template <typename Dtype>
+__global__ void LSDistance(const int num, const Dtype* dot, Dtype* dist) {
+  CUDA_KERNEL_LOOP(index, num * num) {
+    const int i = index / num;
+    const int j = index % num;
+    const Dtype dist_sq = dot[i * num + i] + dot[j * num + j] - 2 * dot[index];
+    dist[index] = sqrt(max(dist_sq, Dtype(0)));
+  }
+}
+
+template <typename Dtype>
+__global__ void LSLogSumExp(const int num, const Dtype margin,
+    const Dtype* label, const Dtype* dist, Dtype* log_sum_exp) {
+  CUDA_KERNEL_LOOP(i, num) {
+    Dtype max_value = -FLT_MAX;
+    for (int k = 0; k < num; ++k) {
+      if (label[k] != label[i]) {
+        max_value = max(max_value, margin - dist[i * num + k]);
+      }
+    }
+    Dtype sum = 0;
+    for (int k = 0; k < num; ++k) {
+      if (label[k] != label[i]) {
+        sum += exp(margin - dist[i * num + k] - max_value);
+      }
+    }
+    log_sum_exp[i] = sum > 0 ? max_value + log(sum) : -FLT_MAX;
+  }
+}
+
+template <typename Dtype>
+__global__ void LSRowLoss(const int num, const Dtype* label, const Dtype* dist,
+    const Dtype* log_sum_exp, Dtype* row_loss, Dtype* row_weight) {
+  CUDA_KERNEL_LOOP(i, num) {
+    Dtype loss = 0;
+    Dtype weight = 0;
+    for (int j = 0; j < num; ++j) {
+      if (j == i || label[j] != label[i]) {
+        continue;
+      }
+      const Dtype lse = LogAddExpGPU(log_sum_exp[i], log_sum_exp[j]);
+      const Dtype J = lse + dist[i * num + j];
+      if (J > 0) {
+        loss += J * J;
+        weight += J * exp(log_sum_exp[i] - lse);
+      }
+    }
+    row_loss[i] = loss;
+    row_weight[i] = weight;
+  }
+}
+
+template <typename Dtype>
+__global__ void LSPairWeight(const int num, const Dtype margin,
+    const Dtype* label, const Dtype* dist, const Dtype* log_sum_exp,
+    const Dtype* row_weight, Dtype* weight) {
+  CUDA_KERNEL_LOOP(index, num * num) {
+    const int i = index / num;
+    const int j = index % num;
+    const Dtype d = dist[index];
+    Dtype g = 0;
+    if (label[j] == label[i]) {
+      if (j != i) {
+        g = max(LogAddExpGPU(log_sum_exp[i], log_sum_exp[j]) + d, Dtype(0));
+      }
+    } else {
+      g = -row_weight[i] * exp(margin - d - log_sum_exp[i])
+          - row_weight[j] * exp(margin - d - log_sum_exp[j]);
+    }
+    weight[index] = g / max(d, Dtype(1e-4));
+  }
+}
+
+template <typename Dtype>
+__global__ void LSAddRowSum(const int count, const int dim, const Dtype scale,
+    const Dtype* row_sum, const Dtype* bottom_data, Dtype* bottom_diff) {
+  CUDA_KERNEL_LOOP(index, count) {
+    bottom_diff[index] += scale * row_sum[index / dim] * bottom_data[index];
+  }
+}
+
+template <typename Dtype>
+void LiftedStructSimilaritySoftmaxLossLayer<Dtype>::Forward_gpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int num = bottom[0]->num();
+  const int dim = bottom[0]->count() / num;
+  const Dtype margin =
+      this->layer_param_.lifted_struct_sim_softmax_loss_param().margin();
+  const Dtype* label = bottom[1]->gpu_data();
+  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, num, dim, Dtype(1),
+      bottom[0]->gpu_data(), bottom[0]->gpu_data(), Dtype(0),
+      dot_.mutable_gpu_data());
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  LSDistance<Dtype><<<CAFFE_GET_BLOCKS(num * num), CAFFE_CUDA_NUM_THREADS>>>(
+      num, dot_.gpu_data(), dist_.mutable_gpu_data());
+  CUDA_POST_KERNEL_CHECK;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  LSLogSumExp<Dtype><<<CAFFE_GET_BLOCKS(num), CAFFE_CUDA_NUM_THREADS>>>(
+      num, margin, label, dist_.gpu_data(), log_sum_exp_.mutable_gpu_data());
+  CUDA_POST_KERNEL_CHECK;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  LSRowLoss<Dtype><<<CAFFE_GET_BLOCKS(num), CAFFE_CUDA_NUM_THREADS>>>(
+      num, label, dist_.gpu_data(), log_sum_exp_.gpu_data(),
+      row_loss_.mutable_gpu_data(), row_weight_.mutable_gpu_data());
+  CUDA_POST_KERNEL_CHECK;
+  num_positive_pairs_ = CountPositivePairs(bottom[1]);
+  Dtype loss = 0;
+  if (num_positive_pairs_) {
+    caffe_gpu_asum(num, row_loss_.gpu_data(), &loss);
+    // Every pair is counted by both of its items.
+    loss /= 4 * num_positive_pairs_;
+  }
+  top[0]->mutable_cpu_data()[0] = loss;
+}
+
+template <typename Dtype>
+void LiftedStructSimilaritySoftmaxLossLayer<Dtype>::Backward_gpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (propagate_down[1]) {
+    LOG(FATAL) << this->type()
+               << " Layer cannot backpropagate to label inputs.";
+  }
+  if (!propagate_down[0]) {
+    return;
+  }
+  const int num = bottom[0]->num();
+  const int dim = bottom[0]->count() / num;
+  Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+  if (!num_positive_pairs_) {
+    caffe_gpu_set(bottom[0]->count(), Dtype(0), bottom_diff);
+    return;
+  }
+  const Dtype margin =
+      this->layer_param_.lifted_struct_sim_softmax_loss_param().margin();
+  Dtype* weight = dot_.mutable_gpu_data();
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  LSPairWeight<Dtype><<<CAFFE_GET_BLOCKS(num * num), CAFFE_CUDA_NUM_THREADS>>>(
+      num, margin, bottom[1]->gpu_data(), dist_.gpu_data(),
+      log_sum_exp_.gpu_data(), row_weight_.gpu_data(), weight);
+  CUDA_POST_KERNEL_CHECK;
+  const Dtype scale = top[0]->cpu_diff()[0] / num_positive_pairs_;
+  const Dtype* bottom_data = bottom[0]->gpu_data();
+  caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num, dim, num, -scale,
+      weight, bottom_data, Dtype(0), bottom_diff);
+  caffe_gpu_gemv<Dtype>(CblasNoTrans, num, num, Dtype(1), weight,
+      ones_.gpu_data(), Dtype(0), row_sum_.mutable_gpu_data());
+  const int count = bottom[0]->count();
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  LSAddRowSum<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
+      count, dim, scale, row_sum_.gpu_data(), bottom_data, bottom_diff);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+INSTANTIATE_LAYER_GPU_FUNCS(LiftedStructSimilaritySoftmaxLossLayer);
+
+}  // namespace caffe
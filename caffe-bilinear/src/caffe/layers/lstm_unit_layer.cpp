@@ -84,8 +84,9 @@ void LSTMUnitLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* H = top[1]->cpu_data();
   const Dtype* C_diff = top[0]->cpu_diff();
   const Dtype* H_diff = top[1]->cpu_diff();
-  Dtype* C_prev_diff = bottom[0]->mutable_cpu_diff();
-  Dtype* X_diff = bottom[1]->mutable_cpu_diff();
+  // Bottoms that get no gradient may have no diff.
+  Dtype* C_prev_diff = propagate_down[0] ? bottom[0]->mutable_cpu_diff() : NULL;
+  Dtype* X_diff = propagate_down[1] ? bottom[1]->mutable_cpu_diff() : NULL;
   for (int n = 0; n < num; ++n) {
     for (int d = 0; d < hidden_dim_; ++d) {
       const Dtype i = sigmoid(X[d]);
@@ -96,18 +97,21 @@ void LSTMUnitLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const Dtype c_prev = C_prev[d];
       const Dtype c = C[d];
       const Dtype tanh_c = tanh(c);
-      Dtype* c_prev_diff = C_prev_diff + d;
-      Dtype* i_diff = X_diff + d;
-      Dtype* f_diff = X_diff + 1 * hidden_dim_ + d;
-      Dtype* o_diff = X_diff + 2 * hidden_dim_ + d;
-      Dtype* g_diff = X_diff + 3 * hidden_dim_ + d;
       const Dtype c_term_diff =
           C_diff[d] + H_diff[d] * o * (1 - tanh_c * tanh_c);
-      *c_prev_diff = c_term_diff * f;
-      *i_diff = c_term_diff * g * i * (1 - i);
-      *f_diff = c_term_diff * c_prev * f * (1 - f);
-      *o_diff = H_diff[d] * tanh_c * o * (1 - o);
-      *g_diff = c_term_diff * i * (1 - g * g);
+      if (C_prev_diff) {
+        C_prev_diff[n * hidden_dim_ + d] = c_term_diff * f;
+      }
+      if (X_diff) {
+        Dtype* i_diff = X_diff + n * x_dim + d;
+        Dtype* f_diff = X_diff + n * x_dim + 1 * hidden_dim_ + d;
+        Dtype* o_diff = X_diff + n * x_dim + 2 * hidden_dim_ + d;
+        Dtype* g_diff = X_diff + n * x_dim + 3 * hidden_dim_ + d;
+        *i_diff = c_term_diff * g * i * (1 - i);
+        *f_diff = c_term_diff * c_prev * f * (1 - f);
+        *o_diff = H_diff[d] * tanh_c * o * (1 - o);
+        *g_diff = c_term_diff * i * (1 - g * g);
+      }
     }
     C_prev += hidden_dim_;
     X += x_dim;
@@ -115,8 +119,6 @@ void LSTMUnitLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     H += hidden_dim_;
     C_diff += hidden_dim_;
     H_diff += hidden_dim_;
-    X_diff += x_dim;
-    C_prev_diff += hidden_dim_;
     ++cont;
   }
 }
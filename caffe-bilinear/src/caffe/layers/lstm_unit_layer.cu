@@ -88,7 +88,6 @@ __global__ void LSTMUnitBackward(const int nthreads, const int dim,
     const Dtype c_prev = C_prev[index];
     const Dtype c = C[index];
     const Dtype tanh_c = tanh(c);
-    Dtype* c_prev_diff = C_prev_diff + index;
     Dtype* X_diff_offset = X_diff + 4 * dim * n;
     Dtype* i_diff = X_diff_offset + d;
     Dtype* f_diff = X_diff_offset + 1 * dim + d;
@@ -97,7 +96,9 @@ __global__ void LSTMUnitBackward(const int nthreads, const int dim,
     const Dtype c_term_diff =
         C_diff[index] + H_diff[index] * o * (1 - tanh_c * tanh_c);
     const Dtype cont_n = cont[n];
-    *c_prev_diff = cont_n * c_term_diff * f;
+    if (C_prev_diff) {
+      C_prev_diff[index] = cont_n * c_term_diff * f;
+    }
     *i_diff = c_term_diff * g;
     *f_diff = cont_n * c_term_diff * c_prev;
     *o_diff = H_diff[index] * tanh_c;
@@ -135,12 +136,14 @@ void LSTMUnitLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   const Dtype* H = top[1]->gpu_data();
   const Dtype* C_diff = top[0]->gpu_diff();
   const Dtype* H_diff = top[1]->gpu_diff();
-  Dtype* C_prev_diff = bottom[0]->mutable_gpu_diff();
+  // Bottoms that get no gradient may have no diff.
+  Dtype* C_prev_diff = propagate_down[0] ? bottom[0]->mutable_gpu_diff() : NULL;
   Dtype* X_acts_diff = X_acts_.mutable_gpu_diff();
   LSTMUnitBackward<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
       <<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(count, hidden_dim_,
       C_prev, X_acts, C, H, cont, C_diff, H_diff, C_prev_diff, X_acts_diff);
   CUDA_POST_KERNEL_CHECK;
+  if (!propagate_down[1]) { return; }
   const int X_count = bottom[1]->count();
   Dtype* X_diff = bottom[1]->mutable_gpu_diff();
   LSTMActsBackward<Dtype>  // NOLINT_NEXT_LINE(whitespace/operators)
@@ -1,4 +1,6 @@
-#include <cfloat>
+#include <boost/bind.hpp>
+
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/mean_across_batch_layer.hpp"
@@ -9,69 +11,111 @@ namespace caffe {
 template <typename Dtype>
 void MeanAcrossBatchLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  
-  CHECK(bottom.size() == 1);
-  CHECK(this->layer_param().mean_across_batch_param().chunk_size() > 0) << "Chunk size for mean calculation should be greater than zero!";
-
-  mean_in_chunk_.Reshape(1, bottom[0]->channels(), bottom[0]->height(), bottom[0]->width());
+  const MeanAcrossBatchParameter& param =
+      this->layer_param_.mean_across_batch_param();
+  chunk_size_ = param.chunk_size();
+  CHECK_GT(chunk_size_, 0)
+      << "Chunk size for mean calculation should be greater than zero!";
+  reduce_ = param.reduce();
+  if (param.num_threads() > 1) {
+    pool_.reset(new ThreadPool(param.num_threads()));
+  }
 }
 
 template <typename Dtype>
 void MeanAcrossBatchLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
- // top[0]->ReshapeLike(*bottom[0]);
-    top[0]->Reshape(bottom[0]->num(), bottom[0]->channels(),  bottom[0]->height(),  bottom[0]->width());
+  CHECK_GE(bottom[0]->num_axes(), 1);
+  num_ = bottom[0]->shape(0);
+  num_chunks_ = (num_ + chunk_size_ - 1) / chunk_size_;
+  count_ = bottom[0]->count(1);
+  if (reduce_) {
+    CHECK_NE(top[0], bottom[0])
+        << "MeanAcrossBatch cannot reduce in place.";
+  }
+  vector<int> top_shape = bottom[0]->shape();
+  top_shape[0] = reduce_ ? num_chunks_ : num_;
+  top[0]->Reshape(top_shape);
 }
 
 template <typename Dtype>
-void MeanAcrossBatchLayer<Dtype>::Forward_cpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-
-  int chunk_size = this->layer_param().mean_across_batch_param().chunk_size();
-  int count = bottom[0]->channels() * bottom[0]->height() * bottom[0]->width();
-  
-  for (int i = 0; i < (bottom[0]->num() + chunk_size)/chunk_size; i++){
-      int s = i * chunk_size;
-      int e = std::min((i + 1) * chunk_size, bottom[0]->num());
-      
-      if (s >= e)
-	  break;
-
-      caffe_set(count, Dtype(0.), mean_in_chunk_.mutable_cpu_data());
-      for (int j = s; j < e; j++){
-          caffe_axpy(count, Dtype(1./(e-s)), bottom[0]->cpu_data() + count * j, mean_in_chunk_.mutable_cpu_data());
-
+void MeanAcrossBatchLayer<Dtype>::AverageChunks(const Dtype* in, Dtype* out,
+    bool reduce, int part, int num_parts) {
+  int begin, end;
+  ThreadPool::Partition(num_chunks_, num_parts, part, &begin, &end);
+  for (int c = begin; c < end; ++c) {
+    const int s = c * chunk_size_;
+    const int e = std::min(s + chunk_size_, num_);
+    const Dtype scale = Dtype(1.) / (e - s);
+    // Accumulate into the first output row of the chunk, then broadcast it.
+    // Rows after s are only read before they are written, so in == out
+    // works too.
+    Dtype* mean = out + static_cast<size_t>(reduce ? c : s) * count_;
+    caffe_cpu_scale(count_, scale, in + static_cast<size_t>(s) * count_,
+        mean);
+    for (int j = s + 1; j < e; ++j) {
+      caffe_axpy(count_, scale, in + static_cast<size_t>(j) * count_, mean);
+    }
+    if (!reduce) {
+      // Not caffe_copy: pool threads must stay away from Caffe::mode().
+      for (int j = s + 1; j < e; ++j) {
+        std::copy(mean, mean + count_, out + static_cast<size_t>(j) * count_);
       }
-      for (int j = s; j < e; j++){
-          caffe_copy(count, mean_in_chunk_.cpu_data(), top[0]->mutable_cpu_data() + count * j);
-      }
-
+    }
   }
+}
 
+template <typename Dtype>
+void MeanAcrossBatchLayer<Dtype>::SpreadChunks(const Dtype* in, Dtype* out,
+    int part, int num_parts) {
+  int begin, end;
+  ThreadPool::Partition(num_chunks_, num_parts, part, &begin, &end);
+  for (int c = begin; c < end; ++c) {
+    const int s = c * chunk_size_;
+    const int e = std::min(s + chunk_size_, num_);
+    for (int j = s; j < e; ++j) {
+      caffe_cpu_scale(count_, Dtype(1.) / (e - s),
+          in + static_cast<size_t>(c) * count_,
+          out + static_cast<size_t>(j) * count_);
+    }
+  }
+}
 
+template <typename Dtype>
+void MeanAcrossBatchLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  if (pool_) {
+    pool_->Run(boost::bind(&MeanAcrossBatchLayer<Dtype>::AverageChunks, this,
+        bottom_data, top_data, reduce_, _1, pool_->num_threads()));
+  } else {
+    AverageChunks(bottom_data, top_data, reduce_, 0, 1);
+  }
 }
 
 template <typename Dtype>
 void MeanAcrossBatchLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-
-  int chunk_size = this->layer_param().mean_across_batch_param().chunk_size();
-  int count = bottom[0]->channels() * bottom[0]->height() * bottom[0]->width(); 
-  
-  for (int i = 0; i < (top[0]->num() + chunk_size)/chunk_size; i++){
-      int s = i * chunk_size;
-      int e = std::min((i + 1) * chunk_size, bottom[0]->num());
-      
-      if (s >= e)
-	  break;
-
-      caffe_set(count, Dtype(0.), mean_in_chunk_.mutable_cpu_diff());
-      for (int j = s; j < e; j++){
-          caffe_axpy(count, Dtype(1./(e-s)), top[0]->cpu_diff() + count * j, mean_in_chunk_.mutable_cpu_diff());
-      }
-      for (int j = s; j < e; j++){
-          caffe_copy(count, mean_in_chunk_.cpu_diff(), bottom[0]->mutable_cpu_diff() + count * j);
-      }
+  if (!propagate_down[0]) {
+    return;
+  }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  // Each item of a chunk of n gets 1 / n of the gradient of every output of
+  // the chunk: the mean of the repeated outputs', or the reduced one's / n.
+  if (pool_) {
+    if (reduce_) {
+      pool_->Run(boost::bind(&MeanAcrossBatchLayer<Dtype>::SpreadChunks, this,
+          top_diff, bottom_diff, _1, pool_->num_threads()));
+    } else {
+      pool_->Run(boost::bind(&MeanAcrossBatchLayer<Dtype>::AverageChunks,
+          this, top_diff, bottom_diff, false, _1, pool_->num_threads()));
+    }
+  } else if (reduce_) {
+    SpreadChunks(top_diff, bottom_diff, 0, 1);
+  } else {
+    AverageChunks(top_diff, bottom_diff, false, 0, 1);
   }
 }
 
@@ -1,4 +1,3 @@
-#include <cfloat>
 #include <vector>
 
 #include "caffe/layers/mean_across_batch_layer.hpp"
@@ -6,61 +5,82 @@
 
 namespace caffe {
 
-
-
+// One thread per value of each chunk: it sums the value over the items of
+// the chunk and writes the mean back to each of them, or once with reduce.
+// A thread reads and writes its own values only, so in == out works too.
 template <typename Dtype>
-void MeanAcrossBatchLayer<Dtype>::Forward_gpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-
-  int chunk_size = this->layer_param().mean_across_batch_param().chunk_size();
-  int count = bottom[0]->channels() * bottom[0]->height() * bottom[0]->width();
-  
-  for (int i = 0; i < (bottom[0]->num() + chunk_size)/chunk_size; i++){
-      int s = i * chunk_size;
-      int e = std::min((i + 1) * chunk_size, bottom[0]->num());
-      
-      if (s >= e)
-	  break;
-
-      caffe_gpu_set(count, Dtype(0.), mean_in_chunk_.mutable_gpu_data());
-      for (int j = s; j < e; j++){
-          caffe_gpu_axpy(count, Dtype(1./(e-s)), bottom[0]->gpu_data() + count * j, mean_in_chunk_.mutable_gpu_data());
-
-      }
-      for (int j = s; j < e; j++){
-          caffe_copy(count, mean_in_chunk_.gpu_data(), top[0]->mutable_gpu_data() + count * j);
+__global__ void MeanAcrossBatchForward(const int nthreads, const int count,
+    const int num, const int chunk_size, const bool reduce,
+    const Dtype* in, Dtype* out) {
+  CUDA_KERNEL_LOOP(index, nthreads) {
+    const int c = index / count;
+    const int k = index % count;
+    const int s = c * chunk_size;
+    const int e = min(s + chunk_size, num);
+    Dtype sum = 0;
+    for (int j = s; j < e; ++j) {
+      sum += in[j * count + k];
+    }
+    const Dtype mean = sum / (e - s);
+    if (reduce) {
+      out[index] = mean;
+    } else {
+      for (int j = s; j < e; ++j) {
+        out[j * count + k] = mean;
       }
-
+    }
   }
+}
 
+// One thread per value of each item: the value of the row of its chunk,
+// divided by the size of the chunk.
+template <typename Dtype>
+__global__ void MeanAcrossBatchSpread(const int nthreads, const int count,
+    const int num, const int chunk_size, const Dtype* in, Dtype* out) {
+  CUDA_KERNEL_LOOP(index, nthreads) {
+    const int c = index / count / chunk_size;
+    const int k = index % count;
+    const int s = c * chunk_size;
+    const int e = min(s + chunk_size, num);
+    out[index] = in[c * count + k] / (e - s);
+  }
+}
 
+template <typename Dtype>
+void MeanAcrossBatchLayer<Dtype>::Forward_gpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int nthreads = num_chunks_ * count_;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  MeanAcrossBatchForward<Dtype><<<CAFFE_GET_BLOCKS(nthreads),
+      CAFFE_CUDA_NUM_THREADS>>>(nthreads, count_, num_, chunk_size_, reduce_,
+      bottom[0]->gpu_data(), top[0]->mutable_gpu_data());
+  CUDA_POST_KERNEL_CHECK;
 }
 
 template <typename Dtype>
 void MeanAcrossBatchLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-
-  int chunk_size = this->layer_param().mean_across_batch_param().chunk_size();
-  int count = bottom[0]->channels() * bottom[0]->height() * bottom[0]->width(); 
-  
-  for (int i = 0; i < (top[0]->num() + chunk_size)/chunk_size; i++){
-      int s = i * chunk_size;
-      int e = std::min((i + 1) * chunk_size, bottom[0]->num());
-      
-      if (s >= e)
-	  break;
-
-      caffe_gpu_set(count, Dtype(0.), mean_in_chunk_.mutable_gpu_diff());
-      for (int j = s; j < e; j++){
-          caffe_gpu_axpy(count, Dtype(1./(e-s)), top[0]->gpu_diff() + count * j, mean_in_chunk_.mutable_gpu_diff());
-      }
-      for (int j = s; j < e; j++){
-          caffe_copy(count, mean_in_chunk_.gpu_diff(), bottom[0]->mutable_gpu_diff() + count * j);
-      }
+  if (!propagate_down[0]) {
+    return;
   }
+  const Dtype* top_diff = top[0]->gpu_diff();
+  Dtype* bottom_diff = bottom[0]->mutable_gpu_diff();
+  if (reduce_) {
+    const int nthreads = num_ * count_;
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    MeanAcrossBatchSpread<Dtype><<<CAFFE_GET_BLOCKS(nthreads),
+        CAFFE_CUDA_NUM_THREADS>>>(nthreads, count_, num_, chunk_size_,
+        top_diff, bottom_diff);
+  } else {
+    const int nthreads = num_chunks_ * count_;
+    // NOLINT_NEXT_LINE(whitespace/operators)
+    MeanAcrossBatchForward<Dtype><<<CAFFE_GET_BLOCKS(nthreads),
+        CAFFE_CUDA_NUM_THREADS>>>(nthreads, count_, num_, chunk_size_, false,
+        top_diff, bottom_diff);
+  }
+  CUDA_POST_KERNEL_CHECK;
 }
 
 INSTANTIATE_LAYER_GPU_FUNCS(MeanAcrossBatchLayer);
 
-
 }  // namespace caffe
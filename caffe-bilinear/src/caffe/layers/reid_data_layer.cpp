@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/reid_data_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+ReIDDataLayer<Dtype>::~ReIDDataLayer() {
+  this->StopInternalThread();
+}
+
+template <typename Dtype>
+void ReIDDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const ReIDDataParameter& param = this->layer_param_.reid_data_param();
+  const int batch_size = param.batch_size();
+  CHECK_GT(batch_size, 0) << "Positive batch size required";
+  LOG(INFO) << "Opening re-ID dataset " << param.source();
+  dataset_.Open(param.source());
+  CHECK_GT(dataset_.num_records(), 0) << "Dataset is empty";
+  LOG(INFO) << "A total of " << dataset_.num_records() << " records of "
+      << dataset_.num_persons() << " persons.";
+
+  const unsigned int prefetch_rng_seed = caffe_rng_rand();
+  prefetch_rng_.reset(new Caffe::RNG(prefetch_rng_seed));
+  const int identities_per_batch = param.identities_per_batch();
+  if (identities_per_batch) {
+    CHECK_EQ(batch_size % identities_per_batch, 0)
+        << "batch_size must be a multiple of identities_per_batch";
+    CHECK_LE(identities_per_batch, dataset_.num_persons())
+        << "Not enough persons for identities_per_batch";
+    order_.resize(dataset_.num_persons());
+  } else {
+    order_.resize(dataset_.num_records());
+  }
+  for (int i = 0; i < order_.size(); ++i) {
+    order_[i] = i;
+  }
+  if (param.shuffle()) {
+    caffe::rng_t* prefetch_rng =
+        static_cast<caffe::rng_t*>(prefetch_rng_->generator());
+    shuffle(order_.begin(), order_.end(), prefetch_rng);
+  }
+  order_id_ = 0;
+
+  vector<int> top_shape = this->data_transformer_->InferBlobShape(
+      dataset_.channels(), dataset_.height(), dataset_.width());
+  this->transformed_data_.Reshape(top_shape);
+  top_shape[0] = batch_size;
+  top[0]->Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
+  }
+  LOG(INFO) << "output data size: " << top[0]->num() << ","
+      << top[0]->channels() << "," << top[0]->height() << ","
+      << top[0]->width();
+  if (this->output_labels_) {
+    vector<int> label_shape(1, batch_size);
+    top[1]->Reshape(label_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(label_shape);
+    }
+  }
+  if (this->output_cameras_) {
+    vector<int> camera_shape(1, batch_size);
+    top[2]->Reshape(camera_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->camera_.Reshape(camera_shape);
+    }
+  }
+}
+
+template <typename Dtype>
+int ReIDDataLayer<Dtype>::Rand(int n) {
+  caffe::rng_t* prefetch_rng =
+      static_cast<caffe::rng_t*>(prefetch_rng_->generator());
+  return (*prefetch_rng)() % n;
+}
+
+template <typename Dtype>
+void ReIDDataLayer<Dtype>::SampleRecords() {
+  const ReIDDataParameter& param = this->layer_param_.reid_data_param();
+  for (int i = 0; i < records_.size(); ++i) {
+    records_[i] = order_[order_id_++];
+    if (order_id_ == order_.size()) {
+      DLOG(INFO) << "Restarting data prefetching from start.";
+      order_id_ = 0;
+      if (param.shuffle()) {
+        caffe::rng_t* prefetch_rng =
+            static_cast<caffe::rng_t*>(prefetch_rng_->generator());
+        shuffle(order_.begin(), order_.end(), prefetch_rng);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void ReIDDataLayer<Dtype>::SampleIdentities() {
+  const ReIDDataParameter& param = this->layer_param_.reid_data_param();
+  const int identities_per_batch = param.identities_per_batch();
+  const int records_per_identity = records_.size() / identities_per_batch;
+  if (order_id_ + identities_per_batch > order_.size()) {
+    // Start the next epoch early rather than split the batch across two
+    // orders, which could repeat a person within the batch.
+    DLOG(INFO) << "Restarting data prefetching from start.";
+    order_id_ = 0;
+    if (param.shuffle()) {
+      caffe::rng_t* prefetch_rng =
+          static_cast<caffe::rng_t*>(prefetch_rng_->generator());
+      shuffle(order_.begin(), order_.end(), prefetch_rng);
+    }
+  }
+  vector<uint32_t> candidates;
+  for (int p = 0; p < identities_per_batch; ++p) {
+    const int identity = order_[order_id_++];
+    const int count = dataset_.num_records_of(identity);
+    const uint32_t* members = dataset_.records_of(identity);
+    int* records = &records_[p * records_per_identity];
+    if (count >= records_per_identity) {
+      // Draw without replacement: a partial Fisher-Yates shuffle.
+      candidates.assign(members, members + count);
+      for (int k = 0; k < records_per_identity; ++k) {
+        std::swap(candidates[k], candidates[k + Rand(count - k)]);
+        records[k] = candidates[k];
+      }
+    } else {
+      for (int k = 0; k < records_per_identity; ++k) {
+        records[k] = members[Rand(count)];
+      }
+    }
+  }
+}
+
+// This function is called on prefetch thread
+template <typename Dtype>
+void ReIDDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  CPUTimer batch_timer;
+  batch_timer.Start();
+  CHECK(batch->data_.count());
+  CHECK(this->transformed_data_.count());
+  const ReIDDataParameter& param = this->layer_param_.reid_data_param();
+  records_.resize(param.batch_size());
+  if (param.identities_per_batch()) {
+    SampleIdentities();
+  } else {
+    SampleRecords();
+  }
+
+  Dtype* top_data = batch->data_.mutable_cpu_data();
+  Dtype* top_label = this->output_labels_ ?
+      batch->label_.mutable_cpu_data() : NULL;
+  Dtype* top_camera = this->output_cameras_ ?
+      batch->camera_.mutable_cpu_data() : NULL;
+  for (int item_id = 0; item_id < records_.size(); ++item_id) {
+    const int record = records_[item_id];
+    this->transformed_data_.set_cpu_data(top_data +
+        batch->data_.offset(item_id));
+    this->data_transformer_->Transform(dataset_.record(record),
+        dataset_.channels(), dataset_.height(), dataset_.width(),
+        &(this->transformed_data_));
+    if (top_label) {
+      top_label[item_id] = dataset_.person(record);
+    }
+    if (top_camera) {
+      top_camera[item_id] = dataset_.camera(record);
+    }
+  }
+  batch_timer.Stop();
+  DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+}
+
+INSTANTIATE_CLASS(ReIDDataLayer);
+REGISTER_LAYER_CLASS(ReIDData);
+
+}  // namespace caffe
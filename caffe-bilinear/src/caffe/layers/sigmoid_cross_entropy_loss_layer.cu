@@ -50,9 +50,15 @@ void SigmoidCrossEntropyLossLayer<Dtype>::Forward_gpu(
   const Dtype* target = bottom[1]->gpu_data();
   // Since this memory is not used for anything until it is overwritten
   // on the backward pass, we use it here to avoid having to allocate new GPU
-  // memory to accumulate intermediate results in the kernel.
-  Dtype* loss_data = bottom[0]->mutable_gpu_diff();
-  Dtype* count_data = bottom[1]->mutable_gpu_diff();
+  // memory to accumulate intermediate results in the kernel. Diff-free
+  // predictions have no such memory. The targets never get gradients, and
+  // the diff of the sigmoid outputs is otherwise unused.
+  if (bottom[0]->diff_free()) {
+    loss_buffer_.ReshapeLike(*bottom[0]);
+  }
+  Dtype* loss_data = bottom[0]->diff_free() ?
+      loss_buffer_.mutable_gpu_data() : bottom[0]->mutable_gpu_diff();
+  Dtype* count_data = sigmoid_output_->mutable_gpu_diff();
   Dtype valid_count;
   // NOLINT_NEXT_LINE(whitespace/operators)
   SigmoidCrossEntropyLossForwardGPU<Dtype><<<CAFFE_GET_BLOCKS(count),
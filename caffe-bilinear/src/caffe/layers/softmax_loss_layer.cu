@@ -38,8 +38,13 @@ void SoftmaxWithLossLayer<Dtype>::Forward_gpu(
   const int nthreads = outer_num_ * inner_num_;
   // Since this memory is not used for anything until it is overwritten
   // on the backward pass, we use it here to avoid having to allocate new GPU
-  // memory to accumulate intermediate results in the kernel.
-  Dtype* loss_data = bottom[0]->mutable_gpu_diff();
+  // memory to accumulate intermediate results in the kernel. Diff-free
+  // predictions have no such memory.
+  if (bottom[0]->diff_free()) {
+    loss_buffer_.Reshape(vector<int>(1, nthreads));
+  }
+  Dtype* loss_data = bottom[0]->diff_free() ?
+      loss_buffer_.mutable_gpu_data() : bottom[0]->mutable_gpu_diff();
   // Similarly, this memory is never used elsewhere, and thus we can use it
   // to avoid having to allocate additional GPU memory.
   Dtype* counts = prob_.mutable_gpu_diff();
@@ -44,6 +44,12 @@ template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   // Set phase from the state.
   phase_ = in_param.state().phase();
+  // Keep the definition around for CreateContext, minus any weights it
+  // carries: contexts take those from this net instead.
+  net_param_.CopyFrom(in_param);
+  for (int i = 0; i < net_param_.layer_size(); ++i) {
+    net_param_.mutable_layer(i)->clear_blobs();
+  }
   // Filter layers based on their include/exclude rules and
   // the current NetState.
   NetParameter filtered_param;
@@ -251,6 +257,49 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  SetUpRecompute();
+  // Free the diffs that will never be written, and allocate no more for them.
+  // Losses keep theirs, where loss layers store their weights, and so do the
+  // inputs of a net that runs backward, whose diffs pycaffe returns. A net
+  // that only runs forward forbids every other diff, its params' included.
+  inference_ = param.inference();
+  vector<bool> blob_gets_diff(blob_need_backward_);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      if (bottom_need_backward_[layer_id][bottom_id]) {
+        blob_gets_diff[bottom_id_vecs_[layer_id][bottom_id]] = true;
+      }
+    }
+  }
+  if (!inference_) {
+    for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+      blob_gets_diff[net_input_blob_indices_[i]] = true;
+    }
+  }
+  size_t diff_free_memory = 0;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const bool has_loss = blob_id < blob_loss_weights_.size() &&
+        blob_loss_weights_[blob_id] != 0;
+    if (has_loss) {
+      continue;
+    }
+    if (inference_) {
+      blobs_[blob_id]->ForbidDiff();
+    } else if (!blob_gets_diff[blob_id]) {
+      blobs_[blob_id]->set_diff_free(true);
+    } else {
+      continue;
+    }
+    diff_free_memory += blobs_[blob_id]->count() * sizeof(Dtype);
+  }
+  if (inference_) {
+    for (int i = 0; i < params_.size(); ++i) {
+      params_[i]->ForbidDiff();
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory saved on diffs: " << diff_free_memory;
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
@@ -512,6 +561,154 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   }
 }
 
+template <typename Dtype>
+bool Net<Dtype>::IsDeterministic(const int layer_id) const {
+  const LayerParameter& param = layers_[layer_id]->layer_param();
+  if (phase_ != TRAIN) { return true; }
+  if (param.type() == "Dropout") { return false; }
+  if (param.type() == "BatchNorm") {
+    return param.batch_norm_param().use_global_stats();
+  }
+  return true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::SetUpRecompute() {
+  recompute_layers_.clear();
+  recompute_blob_ids_.clear();
+  recompute_last_use_.clear();
+  recompute_released_.clear();
+  recompute_segment_of_blob_.assign(blobs_.size(), -1);
+  const set<int> output_ids(net_output_blob_indices_.begin(),
+      net_output_blob_indices_.end());
+  for (int first = 0; first < layers_.size(); ++first) {
+    if (!layers_[first]->layer_param().recompute()) { continue; }
+    const string& name = layer_names_[first];
+    CHECK_GT(bottom_vecs_[first].size(), 0) << "Layer " << name
+        << " has no bottoms to be recomputed from.";
+    CHECK(IsDeterministic(first)) << "Layer " << name << " of type "
+        << layers_[first]->type() << " samples or updates state in Forward"
+        << " and cannot be recomputed.";
+    // The blobs sharing data with the tops: the tops, and the tops of the
+    // split, flatten, reshape... layers reading them. Splits share their
+    // bottom in Forward, the others already have in Reshape.
+    set<int> blob_ids;
+    for (int i = 0; i < top_id_vecs_[first].size(); ++i) {
+      const int top_id = top_id_vecs_[first][i];
+      CHECK(std::find(bottom_id_vecs_[first].begin(),
+          bottom_id_vecs_[first].end(), top_id) == bottom_id_vecs_[first].end())
+          << "Layer " << name << " computes in place and cannot be recomputed.";
+      blob_ids.insert(top_id);
+    }
+    for (int layer_id = first + 1; layer_id < layers_.size(); ++layer_id) {
+      for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+        const int bottom_id = bottom_id_vecs_[layer_id][i];
+        if (!blob_ids.count(bottom_id)) { continue; }
+        const bool split = layers_[layer_id]->layer_param().type() == "Split";
+        for (int j = 0; j < top_id_vecs_[layer_id].size(); ++j) {
+          const int top_id = top_id_vecs_[layer_id][j];
+          if (split || (blobs_[top_id]->count() > 0 &&
+              blobs_[bottom_id]->count() > 0 &&
+              blobs_[top_id]->data() == blobs_[bottom_id]->data())) {
+            blob_ids.insert(top_id);
+          }
+        }
+      }
+    }
+    // Extend the segment with the layers that follow in place.
+    int last = first;
+    while (last + 1 < layers_.size() && top_id_vecs_[last + 1].size() > 0) {
+      bool in_place = true;
+      for (int i = 0; i < top_id_vecs_[last + 1].size(); ++i) {
+        const int top_id = top_id_vecs_[last + 1][i];
+        in_place &= blob_ids.count(top_id) && std::find(
+            bottom_id_vecs_[last + 1].begin(), bottom_id_vecs_[last + 1].end(),
+            top_id) != bottom_id_vecs_[last + 1].end();
+      }
+      if (!in_place) { break; }
+      ++last;
+      // Masks would be drawn, or statistics gathered, a second time.
+      CHECK(IsDeterministic(last)) << "Layer " << layer_names_[last]
+          << " of type " << layers_[last]->type() << " follows " << name
+          << " in place but samples or updates state in Forward, so " << name
+          << " cannot be recomputed.";
+    }
+    int last_use = -1;
+    for (int layer_id = last + 1; layer_id < layers_.size(); ++layer_id) {
+      for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+        const int bottom_id = bottom_id_vecs_[layer_id][i];
+        if (!blob_ids.count(bottom_id)) { continue; }
+        last_use = layer_id;
+        CHECK(std::find(top_id_vecs_[layer_id].begin(),
+            top_id_vecs_[layer_id].end(), bottom_id) ==
+            top_id_vecs_[layer_id].end()) << "Layer " << layer_names_[layer_id]
+            << " modifies the tops of " << name << " in place, which cannot"
+            << " be recomputed.";
+      }
+    }
+    bool is_output = false;
+    for (set<int>::const_iterator it = blob_ids.begin(); it != blob_ids.end();
+        ++it) {
+      is_output |= output_ids.count(*it) > 0;
+    }
+    if (last_use < 0 || is_output) {
+      LOG_IF(INFO, Caffe::root_solver()) << "Layer " << name
+          << " produces outputs of the net, which are not recomputed.";
+      continue;
+    }
+    const int segment_id = recompute_layers_.size();
+    size_t bytes = 0;
+    for (set<int>::const_iterator it = blob_ids.begin(); it != blob_ids.end();
+        ++it) {
+      CHECK_EQ(recompute_segment_of_blob_[*it], -1) << "Blob "
+          << blob_names_[*it] << " is shared by two recomputed layers.";
+      recompute_segment_of_blob_[*it] = segment_id;
+      if (std::find(top_id_vecs_[first].begin(), top_id_vecs_[first].end(),
+          *it) != top_id_vecs_[first].end()) {
+        bytes += blobs_[*it]->count() * sizeof(Dtype);
+      }
+    }
+    recompute_layers_.push_back(std::make_pair(first, last));
+    recompute_blob_ids_.push_back(vector<int>(blob_ids.begin(),
+        blob_ids.end()));
+    recompute_last_use_.push_back(last_use);
+    recompute_released_.push_back(false);
+    LOG_IF(INFO, Caffe::root_solver()) << "Layers " << name << " to "
+        << layer_names_[last] << " will be recomputed for backward, releasing "
+        << bytes << " bytes of data after " << layer_names_[last_use];
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::ReleaseSegment(const int segment_id) {
+  const vector<int>& blob_ids = recompute_blob_ids_[segment_id];
+  for (int i = 0; i < blob_ids.size(); ++i) {
+    blobs_[blob_ids[i]]->data()->release();
+  }
+  recompute_released_[segment_id] = true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RecomputeSegment(const int segment_id) {
+  const int first = recompute_layers_[segment_id].first;
+  const int last = recompute_layers_[segment_id].second;
+  // The inputs may have been released too.
+  for (int layer_id = first; layer_id <= last; ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int source =
+          recompute_segment_of_blob_[bottom_id_vecs_[layer_id][i]];
+      if (source >= 0 && source != segment_id &&
+          recompute_released_[source]) {
+        RecomputeSegment(source);
+      }
+    }
+  }
+  for (int layer_id = first; layer_id <= last; ++layer_id) {
+    layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+  }
+  recompute_released_[segment_id] = false;
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
@@ -521,12 +718,26 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
+    // Forward may restart past a segment released by an earlier pass.
+    for (int s = 0; s < recompute_layers_.size(); ++s) {
+      if (recompute_released_[s] && recompute_layers_[s].second < i &&
+          i <= recompute_last_use_[s]) {
+        RecomputeSegment(s);
+      }
+    }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
     for (int c = 0; c < after_forward_.size(); ++c) {
       after_forward_[c]->run(i);
     }
+    for (int s = 0; s < recompute_layers_.size(); ++s) {
+      if (recompute_layers_[s].first == i) {
+        recompute_released_[s] = false;
+      } else if (recompute_last_use_[s] == i) {
+        ReleaseSegment(s);
+      }
+    }
   }
   return loss;
 }
@@ -565,6 +776,7 @@ const vector<Blob<Dtype>*>& Net<Dtype>::Forward(
 
 template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
+  CHECK(!inference_) << "Net " << name_ << " is set to run forward only.";
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
@@ -572,6 +784,12 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
       before_backward_[c]->run(i);
     }
     if (layer_need_backward_[i]) {
+      for (int s = 0; s < recompute_layers_.size(); ++s) {
+        if (recompute_released_[s] && recompute_layers_[s].first <= i &&
+            i <= recompute_last_use_[s]) {
+          RecomputeSegment(s);
+        }
+      }
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
       if (debug_info_) { BackwardDebugInfo(i); }
@@ -579,6 +797,12 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
     for (int c = 0; c < after_backward_.size(); ++c) {
       after_backward_[c]->run(i);
     }
+    // Nothing below a recomputed layer reads its tops.
+    for (int s = 0; s < recompute_layers_.size(); ++s) {
+      if (recompute_layers_[s].first == i && !recompute_released_[s]) {
+        ReleaseSegment(s);
+      }
+    }
   }
 }
 
@@ -693,6 +917,28 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   }
 }
 
+template <typename Dtype>
+shared_ptr<Net<Dtype> > Net<Dtype>::CreateContext() const {
+  shared_ptr<Net<Dtype> > context(new Net<Dtype>(net_param_));
+  // The context's own freshly filled parameters are released here: sharing
+  // resets their data to this net's SyncedMemory. Parameters shared inside
+  // the net were already tied to their owners by the context's ShareWeights.
+  context->ShareTrainedLayersWith(this);
+  context->set_debug_info(debug_info_);
+  // Bring the shared weights to a synced state now. Reading a SyncedMemory
+  // for the first time moves its head, which must not happen concurrently
+  // from the threads running the contexts.
+  for (int i = 0; i < params_.size(); ++i) {
+    params_[i]->cpu_data();
+#ifndef CPU_ONLY
+    if (Caffe::mode() == Caffe::GPU) {
+      params_[i]->gpu_data();
+    }
+#endif
+  }
+  return context;
+}
+
 template <typename Dtype>
 void Net<Dtype>::BackwardFrom(int start) {
   BackwardFromTo(start, 0);
@@ -729,6 +975,28 @@ void Net<Dtype>::Reshape() {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::Reserve(int max_batch) {
+  CHECK_GT(max_batch, 0);
+  CHECK_GT(net_input_blobs_.size(), 0)
+      << "Only nets with Input layers can reserve a batch size.";
+  // Blobs keep their capacity when they shrink, so reshaping once to the
+  // largest batch sizes them all.
+  vector<vector<int> > shapes(net_input_blobs_.size());
+  for (int i = 0; i < net_input_blobs_.size(); ++i) {
+    shapes[i] = net_input_blobs_[i]->shape();
+    vector<int> shape = shapes[i];
+    CHECK_GT(shape.size(), 0) << "Input " << i << " has no batch axis.";
+    shape[0] = max_batch;
+    net_input_blobs_[i]->Reshape(shape);
+  }
+  Reshape();
+  for (int i = 0; i < net_input_blobs_.size(); ++i) {
+    net_input_blobs_[i]->Reshape(shapes[i]);
+  }
+  Reshape();
+}
+
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
   int num_source_layers = param.layer_size();
@@ -1,8 +1,62 @@
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/memory_pool.hpp"
 
 namespace caffe {
+
+namespace {
+
+// Memory accounting, shared by all threads.
+boost::mutex memory_mutex;
+size_t host_memory = 0;
+size_t device_memory = 0;
+size_t peak_host_memory = 0;
+size_t peak_device_memory = 0;
+
+void CountAllocation(size_t size, size_t* memory, size_t* peak_memory) {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  *memory += size;
+  *peak_memory = std::max(*peak_memory, *memory);
+}
+
+void CountFree(size_t size, size_t* memory) {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  *memory -= size;
+}
+
+}  // namespace
+
+size_t SyncedMemory::host_memory() {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  return caffe::host_memory;
+}
+
+size_t SyncedMemory::device_memory() {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  return caffe::device_memory;
+}
+
+size_t SyncedMemory::peak_host_memory() {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  return caffe::peak_host_memory;
+}
+
+size_t SyncedMemory::peak_device_memory() {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  return caffe::peak_device_memory;
+}
+
+void SyncedMemory::ResetPeakMemory() {
+  boost::mutex::scoped_lock lock(memory_mutex);
+  caffe::peak_host_memory = caffe::host_memory;
+  caffe::peak_device_memory = caffe::device_memory;
+}
+
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
     own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
@@ -24,23 +78,34 @@ SyncedMemory::SyncedMemory(size_t size)
 }
 
 SyncedMemory::~SyncedMemory() {
+  release();
+}
+
+void SyncedMemory::release() {
   check_device();
   if (cpu_ptr_ && own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    Caffe::memory_pool().FreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_);
+    CountFree(size_, &caffe::host_memory);
   }
-
+  cpu_ptr_ = NULL;
+  own_cpu_data_ = false;
 #ifndef CPU_ONLY
   if (gpu_ptr_ && own_gpu_data_) {
-    CUDA_CHECK(cudaFree(gpu_ptr_));
+    Caffe::memory_pool().FreeDevice(gpu_ptr_, size_);
+    CountFree(size_, &caffe::device_memory);
   }
 #endif  // CPU_ONLY
+  gpu_ptr_ = NULL;
+  own_gpu_data_ = false;
+  head_ = UNINITIALIZED;
 }
 
 inline void SyncedMemory::to_cpu() {
   check_device();
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    cpu_ptr_ = Caffe::memory_pool().MallocHost(size_, &cpu_malloc_use_cuda_);
+    CountAllocation(size_, &caffe::host_memory, &caffe::peak_host_memory);
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -48,7 +113,8 @@ inline void SyncedMemory::to_cpu() {
   case HEAD_AT_GPU:
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      cpu_ptr_ = Caffe::memory_pool().MallocHost(size_, &cpu_malloc_use_cuda_);
+      CountAllocation(size_, &caffe::host_memory, &caffe::peak_host_memory);
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -68,14 +134,18 @@ inline void SyncedMemory::to_gpu() {
 #ifndef CPU_ONLY
   switch (head_) {
   case UNINITIALIZED:
-    CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    gpu_ptr_ = Caffe::memory_pool().MallocDevice(size_);
+    CountAllocation(size_, &caffe::device_memory,
+        &caffe::peak_device_memory);
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
     break;
   case HEAD_AT_CPU:
     if (gpu_ptr_ == NULL) {
-      CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+      gpu_ptr_ = Caffe::memory_pool().MallocDevice(size_);
+      CountAllocation(size_, &caffe::device_memory,
+          &caffe::peak_device_memory);
       own_gpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
@@ -100,7 +170,8 @@ void SyncedMemory::set_cpu_data(void* data) {
   check_device();
   CHECK(data);
   if (own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    Caffe::memory_pool().FreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_);
+    CountFree(size_, &caffe::host_memory);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
@@ -123,7 +194,8 @@ void SyncedMemory::set_gpu_data(void* data) {
 #ifndef CPU_ONLY
   CHECK(data);
   if (own_gpu_data_) {
-    CUDA_CHECK(cudaFree(gpu_ptr_));
+    Caffe::memory_pool().FreeDevice(gpu_ptr_, size_);
+    CountFree(size_, &caffe::device_memory);
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
@@ -157,7 +229,8 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   check_device();
   CHECK(head_ == HEAD_AT_CPU);
   if (gpu_ptr_ == NULL) {
-    CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    gpu_ptr_ = Caffe::memory_pool().MallocDevice(size_);
+    CountAllocation(size_, &caffe::device_memory, &caffe::peak_device_memory);
     own_gpu_data_ = true;
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
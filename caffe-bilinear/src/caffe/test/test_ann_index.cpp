@@ -0,0 +1,189 @@
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/ann_index_hnsw.hpp"
+#include "caffe/util/ann_index_ivf.hpp"
+#include "caffe/util/ann_index_pq.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/reid_search.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_embedding_util.hpp"
+
+namespace caffe {
+
+class ANNIndexTest : public ::testing::Test {
+ protected:
+  ANNIndexTest()
+      : num_gallery_(1500), num_queries_(40), dim_(16), k_(10),
+        gallery_(num_gallery_ * dim_), queries_(num_queries_ * dim_) {
+    // Embeddings scattered around 30 people.
+    const ClusteredEmbeddings people(30, dim_);
+    people.Fill(num_gallery_, 0.4, &gallery_[0]);
+    people.Fill(num_queries_, 0.4, &queries_[0]);
+  }
+
+  // The fraction of the exact k nearest that results found, checking the
+  // distances of those found.
+  float Recall(const vector<vector<ReIDMatch> >& results, bool cosine) {
+    ReIDSearch search(&gallery_[0], num_gallery_, dim_, cosine);
+    vector<vector<ReIDMatch> > exact;
+    search.Search(&queries_[0], num_queries_, NULL, k_, &exact, NULL);
+    int found = 0;
+    for (int i = 0; i < num_queries_; ++i) {
+      EXPECT_EQ(k_, results[i].size());
+      for (int r = 0; r < results[i].size(); ++r) {
+        if (r > 0) {
+          EXPECT_LE(results[i][r - 1].distance, results[i][r].distance);
+        }
+        for (int e = 0; e < exact[i].size(); ++e) {
+          if (exact[i][e].index == results[i][r].index) {
+            EXPECT_NEAR(exact[i][e].distance, results[i][r].distance, 1e-4);
+            ++found;
+          }
+        }
+      }
+    }
+    return static_cast<float>(found) / (num_queries_ * k_);
+  }
+
+  int num_gallery_;
+  int num_queries_;
+  int dim_;
+  int k_;
+  vector<float> gallery_;
+  vector<float> queries_;
+};
+
+TEST_F(ANNIndexTest, TestHNSWRecall) {
+  HNSWIndex index(dim_, true, 8, 100);
+  index.Build(&gallery_[0], num_gallery_);
+  EXPECT_EQ(num_gallery_, index.size());
+  vector<vector<ReIDMatch> > results;
+  index.set_effort(10);
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  const float low_recall = Recall(results, true);
+  index.set_effort(200);
+  ThreadPool pool(3);
+  index.Search(&queries_[0], num_queries_, k_, &results, &pool);
+  const float high_recall = Recall(results, true);
+  EXPECT_GE(high_recall, low_recall);
+  EXPECT_GE(high_recall, 0.95);
+}
+
+TEST_F(ANNIndexTest, TestHNSWIncremental) {
+  HNSWIndex index(dim_, false);
+  index.Add(&gallery_[0], 500);
+  index.Add(&gallery_[500 * dim_], num_gallery_ - 500);
+  EXPECT_EQ(num_gallery_, index.size());
+  index.set_effort(200);
+  vector<vector<ReIDMatch> > results;
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  EXPECT_GE(Recall(results, false), 0.95);
+}
+
+TEST_F(ANNIndexTest, TestIVFRecall) {
+  IVFIndex index(dim_, true, 20);
+  index.Build(&gallery_[0], num_gallery_);
+  EXPECT_EQ(20, index.num_lists());
+  vector<vector<ReIDMatch> > results;
+  index.set_effort(1);
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  const float low_recall = Recall(results, true);
+  // Probing every list is exhaustive.
+  index.set_effort(20);
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  EXPECT_EQ(1, Recall(results, true));
+  EXPECT_GT(1, low_recall);
+}
+
+TEST_F(ANNIndexTest, TestIVFTrainOnSample) {
+  IVFIndex index(dim_, false, 4);
+  index.Train(&gallery_[0], 100);
+  index.Add(&gallery_[0], num_gallery_);
+  index.set_effort(4);
+  vector<vector<ReIDMatch> > results;
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  EXPECT_EQ(1, Recall(results, false));
+}
+
+TEST_F(ANNIndexTest, TestPQRerank) {
+  PQIndex index(dim_, true, 4);
+  index.Build(&gallery_[0], num_gallery_);
+  EXPECT_EQ(num_gallery_, index.size());
+  index.set_exact_embeddings(&gallery_[0]);
+  index.set_effort(200);
+  vector<vector<ReIDMatch> > results;
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  EXPECT_GE(Recall(results, true), 0.95);
+  // The whole ranking agrees with the search on the re-ranked.
+  vector<float> distances(num_gallery_);
+  for (int i = 0; i < num_queries_; ++i) {
+    index.Distances(&queries_[i * dim_], &distances[0]);
+    for (int r = 0; r < results[i].size(); ++r) {
+      EXPECT_NEAR(results[i][r].distance, distances[results[i][r].index],
+          1e-5);
+    }
+  }
+}
+
+TEST_F(ANNIndexTest, TestPQCodesOnly) {
+  PQIndex index(dim_, false, 8);
+  index.Build(&gallery_[0], num_gallery_);
+  EXPECT_EQ(8, index.quantizer().code_size());
+  vector<vector<ReIDMatch> > results;
+  index.Search(&queries_[0], num_queries_, k_, &results, NULL);
+  vector<float> distances(num_gallery_);
+  int found = 0;
+  ReIDSearch search(&gallery_[0], num_gallery_, dim_, false);
+  vector<vector<ReIDMatch> > exact;
+  search.Search(&queries_[0], num_queries_, NULL, k_, &exact, NULL);
+  for (int i = 0; i < num_queries_; ++i) {
+    ASSERT_EQ(k_, results[i].size());
+    // Estimated distances, ranked.
+    index.Distances(&queries_[i * dim_], &distances[0]);
+    for (int r = 0; r < k_; ++r) {
+      EXPECT_EQ(distances[results[i][r].index], results[i][r].distance);
+      for (int e = 0; e < k_; ++e) {
+        found += exact[i][e].index == results[i][r].index;
+      }
+    }
+  }
+  EXPECT_GE(static_cast<float>(found) / (num_queries_ * k_), 0.5);
+}
+
+TEST_F(ANNIndexTest, TestSaveLoad) {
+  const char* types[] = {"hnsw", "ivf", "pq"};
+  for (int t = 0; t < 3; ++t) {
+    boost::scoped_ptr<ANNIndex> index(GetANNIndex(types[t], dim_, true));
+    index->Build(&gallery_[0], num_gallery_);
+    index->set_effort(12);
+    string filename;
+    MakeTempFilename(&filename);
+    index->Save(filename);
+    boost::scoped_ptr<ANNIndex> loaded(LoadANNIndex(filename));
+    EXPECT_EQ(string(types[t]), loaded->type());
+    EXPECT_EQ(dim_, loaded->dim());
+    EXPECT_TRUE(loaded->cosine());
+    EXPECT_EQ(num_gallery_, loaded->size());
+    EXPECT_EQ(12, loaded->effort());
+    vector<vector<ReIDMatch> > expected, results;
+    index->Search(&queries_[0], num_queries_, k_, &expected, NULL);
+    loaded->Search(&queries_[0], num_queries_, k_, &results, NULL);
+    for (int i = 0; i < num_queries_; ++i) {
+      ASSERT_EQ(expected[i].size(), results[i].size());
+      for (int r = 0; r < results[i].size(); ++r) {
+        EXPECT_EQ(expected[i][r].index, results[i][r].index);
+        EXPECT_EQ(expected[i][r].distance, results[i][r].distance);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
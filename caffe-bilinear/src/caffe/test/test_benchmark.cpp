@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <cmath>
 
 #include "gtest/gtest.h"
 
@@ -87,4 +88,37 @@ TYPED_TEST(BenchmarkTest, TestTimerSeconds) {
   EXPECT_TRUE(timer.has_run_at_least_once());
 }
 
+TEST(LatencyHistogramTest, TestPercentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Percentile(50), 0);
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.Add(i);
+  }
+  EXPECT_EQ(histogram.count(), 1000);
+  EXPECT_DOUBLE_EQ(histogram.mean(), 500.5);
+  EXPECT_DOUBLE_EQ(histogram.max(), 1000);
+  // Percentiles are bucket upper bounds: never below the true value and at
+  // most one bucket above it.
+  const double kBucketRatio =
+      std::pow(2., 1. / LatencyHistogram::kBucketsPerOctave);
+  EXPECT_GE(histogram.Percentile(50), 500);
+  EXPECT_LE(histogram.Percentile(50), 500 * kBucketRatio);
+  EXPECT_GE(histogram.Percentile(99), 990);
+  EXPECT_DOUBLE_EQ(histogram.Percentile(100), 1000);
+}
+
+TEST(LatencyHistogramTest, TestMerge) {
+  LatencyHistogram a, b;
+  a.Add(10);
+  b.Add(100000);
+  b.Add(0.5);
+  a.Merge(b);
+  EXPECT_EQ(a.count(), 3);
+  EXPECT_DOUBLE_EQ(a.max(), 100000);
+  EXPECT_LE(a.Percentile(0), 1);
+  a.Clear();
+  EXPECT_EQ(a.count(), 0);
+  EXPECT_EQ(a.Percentile(50), 0);
+}
+
 }  // namespace caffe
@@ -0,0 +1,107 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/bilinear_v2_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BilinearV2LayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  BilinearV2LayerTest()
+      : blob_bottom_a_(new Blob<Dtype>(2, 3, 7, 5)),
+        blob_bottom_b_(new Blob<Dtype>(2, 2, 7, 5)),
+        blob_top_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_a_);
+    filler.Fill(this->blob_bottom_b_);
+    blob_bottom_vec_.push_back(blob_bottom_a_);
+    blob_bottom_vec_.push_back(blob_bottom_b_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~BilinearV2LayerTest() {
+    delete blob_bottom_a_;
+    delete blob_bottom_b_;
+    delete blob_top_;
+  }
+
+  void TestForward(int patch_h, int patch_w) {
+    LayerParameter layer_param;
+    BilinearV2Parameter* bilinear_param =
+        layer_param.mutable_bilinear_v2_param();
+    bilinear_param->set_patch_h(patch_h);
+    bilinear_param->set_patch_w(patch_w);
+    BilinearV2Layer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    const int top_height = 7 / patch_h;
+    const int top_width = 5 / patch_w;
+    EXPECT_EQ(2, blob_top_->num());
+    EXPECT_EQ(6, blob_top_->channels());
+    EXPECT_EQ(top_height, blob_top_->height());
+    EXPECT_EQ(top_width, blob_top_->width());
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int n = 0; n < 2; ++n) {
+      for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < 2; ++b) {
+          for (int ph = 0; ph < top_height; ++ph) {
+            for (int pw = 0; pw < top_width; ++pw) {
+              Dtype expected = 0;
+              for (int y = ph * patch_h; y < (ph + 1) * patch_h; ++y) {
+                for (int x = pw * patch_w; x < (pw + 1) * patch_w; ++x) {
+                  expected += blob_bottom_a_->data_at(n, a, y, x) *
+                      blob_bottom_b_->data_at(n, b, y, x);
+                }
+              }
+              EXPECT_NEAR(expected, blob_top_->data_at(n, a * 2 + b, ph, pw),
+                  1e-4);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_a_;
+  Blob<Dtype>* const blob_bottom_b_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(BilinearV2LayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(BilinearV2LayerTest, TestForward) {
+  this->TestForward(2, 2);
+}
+
+TYPED_TEST(BilinearV2LayerTest, TestForwardRectangular) {
+  this->TestForward(3, 5);
+}
+
+TYPED_TEST(BilinearV2LayerTest, TestForwardPixels) {
+  this->TestForward(1, 1);
+}
+
+TYPED_TEST(BilinearV2LayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  BilinearV2Parameter* bilinear_param = layer_param.mutable_bilinear_v2_param();
+  bilinear_param->set_patch_h(2);
+  bilinear_param->set_patch_w(3);
+  BilinearV2Layer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
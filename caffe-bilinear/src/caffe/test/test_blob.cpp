@@ -59,6 +59,42 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestDiffFree) {
+  EXPECT_FALSE(this->blob_preshaped_->diff_free());
+  this->blob_preshaped_->mutable_cpu_diff();
+  const size_t held = SyncedMemory::host_memory();
+  this->blob_preshaped_->set_diff_free(true);
+  EXPECT_TRUE(this->blob_preshaped_->diff_free());
+  EXPECT_EQ(held - 120 * sizeof(TypeParam), SyncedMemory::host_memory());
+  // Growing allocates data only.
+  this->blob_preshaped_->Reshape(2, 3, 4, 6);
+  this->blob_preshaped_->mutable_cpu_data();
+  EXPECT_EQ(held + 24 * sizeof(TypeParam), SyncedMemory::host_memory());
+  // Diff-free blobs stay so when sharing.
+  this->blob_->Reshape(2, 3, 4, 6);
+  this->blob_->set_diff_free(true);
+  this->blob_->ShareDiff(*this->blob_preshaped_);
+  EXPECT_TRUE(this->blob_->diff_free());
+  EXPECT_TRUE(this->blob_preshaped_->diff_free());
+  // A blob with a diff gives it to the one it shares with.
+  this->blob_->set_diff_free(false);
+  this->blob_->ShareDiff(*this->blob_preshaped_);
+  EXPECT_FALSE(this->blob_preshaped_->diff_free());
+  EXPECT_EQ(this->blob_->diff(), this->blob_preshaped_->diff());
+  // Reading the diff of a diff-free blob allocates it, zeroed.
+  this->blob_->set_diff_free(true);
+  EXPECT_EQ(0, this->blob_->cpu_diff()[0]);
+  EXPECT_FALSE(this->blob_->diff_free());
+  // A forbidden diff is never shared nor allocated.
+  this->blob_->ForbidDiff();
+  this->blob_->ShareDiff(*this->blob_preshaped_);
+  EXPECT_TRUE(this->blob_->diff_free());
+  EXPECT_TRUE(this->blob_->diff_forbidden());
+  this->blob_preshaped_->ShareDiff(*this->blob_);
+  EXPECT_TRUE(this->blob_preshaped_->diff_forbidden());
+  EXPECT_EQ(0, this->blob_preshaped_->asum_diff());
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
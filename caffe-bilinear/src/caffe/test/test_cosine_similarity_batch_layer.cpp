@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/cosine_similarity_batch_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class CosineSimilarityBatchLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  CosineSimilarityBatchLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(8, 5, 1, 1)),
+        blob_bottom_label_(new Blob<Dtype>(8, 1, 1, 1)),
+        blob_top_similarity_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()),
+        blob_top_keep_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    // Four persons with two items each.
+    for (int i = 0; i < blob_bottom_label_->count(); ++i) {
+      blob_bottom_label_->mutable_cpu_data()[i] = i / 2;
+    }
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    blob_top_vec_.push_back(blob_top_similarity_);
+    blob_top_vec_.push_back(blob_top_label_);
+    blob_top_vec_.push_back(blob_top_keep_);
+  }
+  virtual ~CosineSimilarityBatchLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_label_;
+    delete blob_top_similarity_;
+    delete blob_top_label_;
+    delete blob_top_keep_;
+  }
+
+  // Similarity of items i and j, from the top of the layer.
+  Dtype Similarity(int i, int j) {
+    if (i > j) {
+      std::swap(i, j);
+    }
+    const int num = blob_bottom_data_->num();
+    return blob_top_similarity_->cpu_data()[num * i - i * (i + 1) / 2 + j - i
+        - 1];
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_label_;
+  Blob<Dtype>* const blob_top_similarity_;
+  Blob<Dtype>* const blob_top_label_;
+  Blob<Dtype>* const blob_top_keep_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(CosineSimilarityBatchLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int num = this->blob_bottom_data_->num();
+  const int channels = this->blob_bottom_data_->channels();
+  ASSERT_EQ(num * (num - 1) / 2, this->blob_top_similarity_->count());
+  const Dtype* x = this->blob_bottom_data_->cpu_data();
+  for (int i = 0, h = 0; i < num; ++i) {
+    for (int j = i + 1; j < num; ++j, ++h) {
+      Dtype xy = 0, xx = 0, yy = 0;
+      for (int c = 0; c < channels; ++c) {
+        xy += x[i * channels + c] * x[j * channels + c];
+        xx += x[i * channels + c] * x[i * channels + c];
+        yy += x[j * channels + c] * x[j * channels + c];
+      }
+      EXPECT_NEAR(xy / sqrt(xx * yy), this->blob_top_similarity_->cpu_data()[h],
+          1e-4);
+      EXPECT_EQ(i / 2 == j / 2 ? 1 : -1, this->blob_top_label_->cpu_data()[h]);
+      EXPECT_EQ(1, this->blob_top_keep_->cpu_data()[h]);
+    }
+  }
+}
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestForwardLargerBatch) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // A later, larger batch must not overrun the pairwise products.
+  const int num = 12;
+  const int channels = this->blob_bottom_data_->channels();
+  this->blob_bottom_data_->Reshape(num, channels, 1, 1);
+  this->blob_bottom_label_->Reshape(num, 1, 1, 1);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_data_);
+  for (int i = 0; i < num; ++i) {
+    this->blob_bottom_label_->mutable_cpu_data()[i] = i / 2;
+  }
+  layer.Reshape(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(num * (num - 1) / 2, this->blob_top_similarity_->count());
+  const Dtype* x = this->blob_bottom_data_->cpu_data();
+  const int i = num - 2, j = num - 1;
+  Dtype xy = 0, xx = 0, yy = 0;
+  for (int c = 0; c < channels; ++c) {
+    xy += x[i * channels + c] * x[j * channels + c];
+    xx += x[i * channels + c] * x[i * channels + c];
+    yy += x[j * channels + c] * x[j * channels + c];
+  }
+  EXPECT_NEAR(xy / sqrt(xx * yy), this->Similarity(i, j), 1e-4);
+}
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestHardMining) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_cosine_similarity_batch_param()->set_hard_negatives(1);
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Every item keeps its positive and its most similar negative.
+  const int num = this->blob_bottom_data_->num();
+  vector<int> hardest(num, -1);
+  for (int i = 0; i < num; ++i) {
+    for (int j = 0; j < num; ++j) {
+      if (i / 2 != j / 2 && (hardest[i] < 0 ||
+          this->Similarity(i, j) > this->Similarity(i, hardest[i]))) {
+        hardest[i] = j;
+      }
+    }
+  }
+  for (int i = 0, h = 0; i < num; ++i) {
+    for (int j = i + 1; j < num; ++j, ++h) {
+      const bool expected =
+          i / 2 == j / 2 || hardest[i] == j || hardest[j] == i;
+      EXPECT_EQ(expected, this->blob_top_keep_->cpu_data()[h] != 0)
+          << "debug: i " << i << " j " << j;
+    }
+  }
+}
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestSemiHardMining) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CosineSimilarityBatchParameter* param =
+      layer_param.mutable_cosine_similarity_batch_param();
+  param->set_hard_negatives(2);
+  param->set_semi_hard(true);
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // A negative is kept only by an item whose positive is more similar.
+  const int num = this->blob_bottom_data_->num();
+  for (int i = 0, h = 0; i < num; ++i) {
+    for (int j = i + 1; j < num; ++j, ++h) {
+      if (i / 2 == j / 2 || !this->blob_top_keep_->cpu_data()[h]) {
+        continue;
+      }
+      const Dtype s = this->Similarity(i, j);
+      EXPECT_TRUE(s < this->Similarity(i, i ^ 1) ||
+          s < this->Similarity(j, j ^ 1)) << "debug: i " << i << " j " << j;
+    }
+  }
+}
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestSemiHardOnly) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_cosine_similarity_batch_param()->set_semi_hard(true);
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Every positive is kept, and exactly the negatives semi-hard for either
+  // of their items.
+  const int num = this->blob_bottom_data_->num();
+  for (int i = 0, h = 0; i < num; ++i) {
+    for (int j = i + 1; j < num; ++j, ++h) {
+      const Dtype s = this->Similarity(i, j);
+      const bool expected = i / 2 == j / 2 ||
+          s < this->Similarity(i, i ^ 1) || s < this->Similarity(j, j ^ 1);
+      EXPECT_EQ(expected, this->blob_top_keep_->cpu_data()[h] != 0)
+          << "debug: i " << i << " j " << j;
+    }
+  }
+}
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-3, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(CosineSimilarityBatchLayerTest, TestBackwardHardMining) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  CosineSimilarityBatchParameter* param =
+      layer_param.mutable_cosine_similarity_batch_param();
+  param->set_hard_negatives(2);
+  param->set_hard_positives(1);
+  CosineSimilarityBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_top_similarity_);
+  Blob<Dtype> top_diff;
+  top_diff.ReshapeLike(*this->blob_top_similarity_);
+  caffe_copy(top_diff.count(), this->blob_top_similarity_->cpu_data(),
+      top_diff.mutable_cpu_data());
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_similarity_->mutable_cpu_diff());
+  Blob<Dtype> keep;
+  keep.ReshapeLike(*this->blob_top_keep_);
+  caffe_copy(keep.count(), this->blob_top_keep_->cpu_data(),
+      keep.mutable_cpu_data());
+  vector<bool> propagate_down(2, false);
+  propagate_down[0] = true;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Blob<Dtype> mined_diff;
+  mined_diff.ReshapeLike(*this->blob_bottom_data_);
+  caffe_copy(mined_diff.count(), this->blob_bottom_data_->cpu_diff(),
+      mined_diff.mutable_cpu_diff());
+
+  // Mining is the same as zeroing the gradient of the eliminated pairs.
+  LayerParameter all_pairs_param;
+  CosineSimilarityBatchLayer<Dtype> all_pairs_layer(all_pairs_param);
+  all_pairs_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  all_pairs_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  caffe_mul(top_diff.count(), top_diff.cpu_data(), keep.cpu_data(),
+      this->blob_top_similarity_->mutable_cpu_diff());
+  all_pairs_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  for (int i = 0; i < mined_diff.count(); ++i) {
+    EXPECT_NEAR(this->blob_bottom_data_->cpu_diff()[i],
+        mined_diff.cpu_diff()[i], 1e-4);
+  }
+}
+
+}  // namespace caffe
@@ -49,6 +49,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     for (int i = 0; i < 5; ++i) {
       Datum datum;
       datum.set_label(i);
+      datum.set_camera(i % 2);
       datum.set_channels(2);
       datum.set_height(3);
       datum.set_width(4);
@@ -67,7 +68,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     db->Close();
   }
 
-  void TestRead() {
+  void TestRead(int decode_threads = 1) {
     const Dtype scale = 3;
     LayerParameter param;
     param.set_phase(TRAIN);
@@ -75,6 +76,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_decode_threads(decode_threads);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -105,6 +107,33 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  void TestReadCameras(int decode_threads) {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_decode_threads(decode_threads);
+
+    Blob<Dtype> blob_top_camera;
+    blob_top_vec_.push_back(&blob_top_camera);
+    {
+      DataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      EXPECT_EQ(blob_top_camera.num(), 5);
+      EXPECT_EQ(blob_top_camera.count(), 5);
+      for (int iter = 0; iter < 10; ++iter) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        for (int i = 0; i < 5; ++i) {
+          EXPECT_EQ(i, blob_top_label_->cpu_data()[i]);
+          EXPECT_EQ(i % 2, blob_top_camera.cpu_data()[i]);
+        }
+      }
+    }
+    blob_top_vec_.pop_back();
+  }
+
   void TestSkip() {
     LayerParameter param;
     param.set_phase(TRAIN);
@@ -382,6 +411,19 @@ TYPED_TEST(DataLayerTest, TestReadLevelDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadParallelLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestRead(3);
+}
+
+TYPED_TEST(DataLayerTest, TestReadCamerasLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadCameras(1);
+  this->TestReadCameras(3);
+}
+
 TYPED_TEST(DataLayerTest, TestSkipLevelDB) {
   this->Fill(false, DataParameter_DB_LEVELDB);
   this->TestSkip();
@@ -427,6 +469,19 @@ TYPED_TEST(DataLayerTest, TestReadLMDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadParallelLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestRead(3);
+}
+
+TYPED_TEST(DataLayerTest, TestReadCamerasLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadCameras(1);
+  this->TestReadCameras(3);
+}
+
 TYPED_TEST(DataLayerTest, TestSkipLMDB) {
   this->Fill(false, DataParameter_DB_LMDB);
   this->TestSkip();
@@ -340,5 +340,86 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestStripes) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = true;  // pixels are consecutive ints [0,size]
+  const int label = 0;
+  const int channels = 2;
+  const int height = 16;
+  const int width = 3;
+  // 3 stripes of 6 rows starting at rows 0, 5 and 10.
+  transform_param.set_stripes(3);
+  transform_param.set_stripe_overlap(1);
+
+  Datum datum;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  vector<int> shape = transformer.InferBlobShape(datum);
+  EXPECT_EQ(3 * channels, shape[1]);
+  EXPECT_EQ(6, shape[2]);
+  EXPECT_EQ(width, shape[3]);
+  Blob<TypeParam> blob(shape);
+  transformer.Transform(datum, &blob);
+  for (int s = 0; s < 3; ++s) {
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < 6; ++h) {
+        for (int w = 0; w < width; ++w) {
+          EXPECT_EQ((c * height + s * 5 + h) * width + w,
+              blob.data_at(0, s * channels + c, h, w));
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(DataTransformTest, TestStripesCropMirror) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = true;  // pixels are consecutive ints [0,size]
+  const int label = 0;
+  const int channels = 3;
+  const int height = 32;
+  const int width = 8;
+  transform_param.set_stripes(3);
+  transform_param.set_stripe_overlap(2);
+  transform_param.set_crop_size(6);
+  transform_param.set_mirror(true);
+
+  // The same as cutting the stripes beforehand and storing those.
+  Datum datum, striped;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  const int part_height = (height + 2 * 2) / 3;
+  striped.set_channels(3 * channels);
+  striped.set_height(part_height);
+  striped.set_width(width);
+  for (int s = 0; s < 3; ++s) {
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < part_height; ++h) {
+        striped.mutable_data()->append(datum.data(),
+            (c * height + s * (part_height - 2) + h) * width, width);
+      }
+    }
+  }
+  TransformationParameter striped_param = transform_param;
+  striped_param.clear_stripes();
+  striped_param.clear_stripe_overlap();
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  DataTransformer<TypeParam> striped_transformer(striped_param, TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  transformer.InitRand();
+  Caffe::set_random_seed(this->seed_);
+  striped_transformer.InitRand();
+  Blob<TypeParam> blob(transformer.InferBlobShape(datum));
+  Blob<TypeParam> striped_blob(striped_transformer.InferBlobShape(striped));
+  ASSERT_EQ(striped_blob.shape(), blob.shape());
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    transformer.Transform(datum, &blob);
+    striped_transformer.Transform(striped, &striped_blob);
+    for (int j = 0; j < blob.count(); ++j) {
+      EXPECT_EQ(striped_blob.cpu_data()[j], blob.cpu_data()[j]);
+    }
+  }
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -0,0 +1,140 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/embedding_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class EmbeddingCacheTest : public ::testing::Test {
+ protected:
+  EmbeddingCacheTest() : dim_(4) {}
+
+  vector<float> Embedding(int i) const {
+    vector<float> embedding(dim_);
+    for (int d = 0; d < dim_; ++d) {
+      embedding[d] = std::sin(1.7f * i + d);
+    }
+    return embedding;
+  }
+
+  void ExpectCached(EmbeddingCache* cache, int i) {
+    vector<float> embedding(dim_);
+    ASSERT_TRUE(cache->Lookup(i, &embedding[0])) << "Evicted " << i;
+    const vector<float> expected = Embedding(i);
+    for (int d = 0; d < dim_; ++d) {
+      EXPECT_EQ(expected[d], embedding[d]);
+    }
+  }
+
+  const int dim_;
+};
+
+TEST_F(EmbeddingCacheTest, TestLookup) {
+  EmbeddingCache cache(dim_, 8);
+  vector<float> embedding(dim_);
+  EXPECT_FALSE(cache.Lookup(3, &embedding[0]));
+  cache.Insert(3, &Embedding(3)[0]);
+  ExpectCached(&cache, 3);
+  // Inserting a key again replaces its embedding.
+  cache.Insert(5, &Embedding(4)[0]);
+  cache.Insert(5, &Embedding(5)[0]);
+  ExpectCached(&cache, 5);
+  const EmbeddingCache::Stats stats = cache.stats();
+  EXPECT_EQ(2, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(2, stats.insertions);
+  EXPECT_EQ(0, stats.evictions);
+  EXPECT_EQ(2, stats.size);
+  cache.Clear();
+  EXPECT_FALSE(cache.Lookup(3, &embedding[0]));
+  EXPECT_EQ(0, cache.stats().size);
+}
+
+TEST_F(EmbeddingCacheTest, TestClockEviction) {
+  EmbeddingCache cache(dim_, 4);
+  for (int i = 0; i < 4; ++i) {
+    cache.Insert(i, &Embedding(i)[0]);
+  }
+  // Entries looked up get a second chance; the others go first.
+  ExpectCached(&cache, 0);
+  ExpectCached(&cache, 2);
+  cache.Insert(4, &Embedding(4)[0]);
+  cache.Insert(5, &Embedding(5)[0]);
+  vector<float> embedding(dim_);
+  EXPECT_FALSE(cache.Lookup(1, &embedding[0]));
+  EXPECT_FALSE(cache.Lookup(3, &embedding[0]));
+  ExpectCached(&cache, 0);
+  ExpectCached(&cache, 2);
+  ExpectCached(&cache, 4);
+  ExpectCached(&cache, 5);
+  EXPECT_EQ(2, cache.stats().evictions);
+  EXPECT_EQ(4, cache.stats().size);
+}
+
+TEST_F(EmbeddingCacheTest, TestSaveLoad) {
+  string filename;
+  MakeTempFilename(&filename);
+  EmbeddingCache cache(dim_, 16);
+  const uint64_t large = 0xfedcba9876543210ULL;
+  cache.Insert(large, &Embedding(7)[0]);
+  for (int i = 0; i < 10; ++i) {
+    cache.Insert(i, &Embedding(i)[0]);
+  }
+  cache.Save(filename);
+  EmbeddingCache loaded(dim_, 16);
+  EXPECT_EQ(11, loaded.Load(filename));
+  for (int i = 0; i < 10; ++i) {
+    ExpectCached(&loaded, i);
+  }
+  vector<float> embedding(dim_);
+  ASSERT_TRUE(loaded.Lookup(large, &embedding[0]));
+  EXPECT_EQ(Embedding(7)[0], embedding[0]);
+  remove(filename.c_str());
+}
+
+TEST_F(EmbeddingCacheTest, TestLoadOtherModel) {
+  string filename;
+  MakeTempFilename(&filename);
+  EmbeddingCache cache(dim_, 16, 0x1234);
+  for (int i = 0; i < 10; ++i) {
+    cache.Insert(i, &Embedding(i)[0]);
+  }
+  cache.Save(filename);
+  // The embeddings of another model are stale.
+  EmbeddingCache other(dim_, 16, 0x1235);
+  EXPECT_EQ(0, other.Load(filename));
+  EXPECT_EQ(0, other.stats().size);
+  EmbeddingCache same(dim_, 16, 0x1234);
+  EXPECT_EQ(10, same.Load(filename));
+  ExpectCached(&same, 9);
+  remove(filename.c_str());
+}
+
+TEST_F(EmbeddingCacheTest, TestHash) {
+  vector<float> input(37);
+  for (int i = 0; i < input.size(); ++i) {
+    input[i] = std::sin(0.3f * i);
+  }
+  const size_t size = input.size() * sizeof(float);
+  const uint64_t hash = EmbeddingCache::Hash(&input[0], size);
+  EXPECT_EQ(hash, EmbeddingCache::Hash(&input[0], size));
+  EXPECT_NE(hash, EmbeddingCache::Hash(&input[0], size, 1));
+  EXPECT_NE(hash, EmbeddingCache::Hash(&input[0], size - sizeof(float)));
+  // Any change, in a whole word or in the tail, changes the hash.
+  vector<float> changed(input);
+  changed[0] += 1e-3f;
+  EXPECT_NE(hash, EmbeddingCache::Hash(&changed[0], size));
+  changed = input;
+  changed.back() = -changed.back();
+  EXPECT_NE(hash, EmbeddingCache::Hash(&changed[0], size));
+}
+
+}  // namespace caffe
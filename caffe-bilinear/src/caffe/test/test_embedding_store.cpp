@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/embedding_store.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class EmbeddingStoreTest : public ::testing::Test {
+ protected:
+  EmbeddingStoreTest() : num_(5), dim_(6), embeddings_(num_ * dim_) {
+    MakeTempFilename(&filename_);
+    for (int i = 0; i < embeddings_.size(); ++i) {
+      embeddings_[i] = std::sin(1.7f * i) * (i % 4 + 1);
+    }
+  }
+
+  void Write(EmbeddingStore::Type type) {
+    EmbeddingStoreWriter writer(filename_, dim_, type);
+    for (int i = 0; i < num_; ++i) {
+      writer.Add(&embeddings_[i * dim_], i + 1, 10 + i,
+          i == 2 ? "" : "image_" + format_int(i));
+    }
+    EXPECT_EQ(num_, writer.num_embeddings());
+    writer.Close();
+  }
+
+  void CheckLabels(const EmbeddingStore& store) {
+    ASSERT_EQ(num_, store.num_embeddings());
+    EXPECT_EQ(dim_, store.dim());
+    for (int i = 0; i < num_; ++i) {
+      EXPECT_EQ(i + 1, store.person(i));
+      EXPECT_EQ(10 + i, store.camera(i));
+      EXPECT_EQ(i == 2 ? "" : "image_" + format_int(i), store.name(i));
+    }
+  }
+
+  // Checks the decoded embeddings, to within tolerance times their norm.
+  void CheckDecoded(const EmbeddingStore& store, float tolerance) {
+    vector<float> decoded(num_ * dim_);
+    store.Decode(0, num_, &decoded[0]);
+    for (int i = 0; i < num_; ++i) {
+      float max_abs = 0;
+      for (int d = 0; d < dim_; ++d) {
+        max_abs = std::max(max_abs, std::fabs(embeddings_[i * dim_ + d]));
+      }
+      for (int d = 0; d < dim_; ++d) {
+        EXPECT_NEAR(embeddings_[i * dim_ + d], decoded[i * dim_ + d],
+            tolerance * max_abs);
+      }
+    }
+    // Any range decodes the same.
+    vector<float> range(2 * dim_);
+    store.Decode(2, 4, &range[0]);
+    for (int j = 0; j < range.size(); ++j) {
+      EXPECT_EQ(decoded[2 * dim_ + j], range[j]);
+    }
+  }
+
+  string filename_;
+  int num_;
+  int dim_;
+  vector<float> embeddings_;
+};
+
+TEST_F(EmbeddingStoreTest, TestFloat) {
+  Write(EmbeddingStore::FLOAT);
+  EmbeddingStore store;
+  store.Open(filename_);
+  EXPECT_EQ(EmbeddingStore::FLOAT, store.type());
+  CheckLabels(store);
+  // Float embeddings are used in place, exactly.
+  const float* data = store.data();
+  for (int i = 0; i < embeddings_.size(); ++i) {
+    EXPECT_EQ(embeddings_[i], data[i]);
+  }
+  CheckDecoded(store, 0);
+  EXPECT_TRUE(store.Verify());
+}
+
+TEST_F(EmbeddingStoreTest, TestFloat16) {
+  Write(EmbeddingStore::FLOAT16);
+  EmbeddingStore store;
+  store.Open(filename_);
+  EXPECT_EQ(EmbeddingStore::FLOAT16, store.type());
+  CheckLabels(store);
+  CheckDecoded(store, 1e-3);
+  EXPECT_TRUE(store.Verify());
+}
+
+TEST_F(EmbeddingStoreTest, TestInt8) {
+  Write(EmbeddingStore::INT8);
+  EmbeddingStore store;
+  store.Open(filename_);
+  EXPECT_EQ(EmbeddingStore::INT8, store.type());
+  CheckLabels(store);
+  CheckDecoded(store, 0.5 / 127);
+  EXPECT_TRUE(store.Verify());
+}
+
+TEST_F(EmbeddingStoreTest, TestVerifyFindsCorruption) {
+  Write(EmbeddingStore::INT8);
+  {
+    EmbeddingStore store;
+    store.Open(filename_);
+    EXPECT_TRUE(store.Verify());
+  }
+  // Flip a bit of the first embedding.
+  FILE* file = fopen(filename_.c_str(), "r+b");
+  ASSERT_TRUE(file);
+  EmbeddingStore::EmbeddingStoreHeader header;
+  ASSERT_EQ(1, fread(&header, sizeof(header), 1, file));
+  ASSERT_EQ(0, fseek(file, header.rows_offset, SEEK_SET));
+  const int byte = fgetc(file);
+  ASSERT_EQ(0, fseek(file, -1, SEEK_CUR));
+  fputc(byte ^ 1, file);
+  fclose(file);
+  EmbeddingStore store;
+  store.Open(filename_);
+  EXPECT_FALSE(store.Verify());
+}
+
+TEST_F(EmbeddingStoreTest, TestEmpty) {
+  {
+    EmbeddingStoreWriter writer(filename_, dim_, EmbeddingStore::FLOAT);
+  }
+  EmbeddingStore store;
+  store.Open(filename_);
+  EXPECT_EQ(0, store.num_embeddings());
+  EXPECT_TRUE(store.Verify());
+}
+
+TEST_F(EmbeddingStoreTest, TestHalf) {
+  const float exact[] = {0, 1, -2, 0.5, 65504, 6.103515625e-05f,
+      5.9604644775390625e-08f};
+  for (int i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i) {
+    EXPECT_EQ(exact[i], HalfToFloat(FloatToHalf(exact[i])));
+  }
+  EXPECT_EQ(0x3c00, FloatToHalf(1));
+  EXPECT_EQ(0xc000, FloatToHalf(-2));
+  EXPECT_EQ(0x7bff, FloatToHalf(65504));
+  // Too large for fp16.
+  EXPECT_EQ(0x7c00, FloatToHalf(1e6));
+  EXPECT_TRUE(std::isinf(HalfToFloat(FloatToHalf(-1e6))));
+  // 1 + 2^-11 lies halfway between 1 and the next fp16: ties go to even.
+  EXPECT_EQ(0x3c00, FloatToHalf(1 + std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c02, FloatToHalf(1 + 3 * std::ldexp(1.f, -11)));
+  // Within half a unit in the last place; subnormals have a fixed one.
+  for (float value = -3; value < 3; value += 0.01f) {
+    EXPECT_NEAR(value, HalfToFloat(FloatToHalf(value)),
+        std::max(std::fabs(value) / 2048, std::ldexp(1.f, -25)));
+  }
+}
+
+}  // namespace caffe
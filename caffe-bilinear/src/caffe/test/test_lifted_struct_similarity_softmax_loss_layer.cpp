@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/lifted_struct_similarity_softmax_loss_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class LiftedStructSimilaritySoftmaxLossLayerTest
+    : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  LiftedStructSimilaritySoftmaxLossLayerTest()
+      : blob_bottom_data_(new Blob<Dtype>(10, 4, 1, 1)),
+        blob_bottom_label_(new Blob<Dtype>(10, 1, 1, 1)),
+        blob_top_loss_(new Blob<Dtype>()) {
+    FillerParameter filler_param;
+    filler_param.set_std(0.5);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_data_);
+    blob_bottom_vec_.push_back(blob_bottom_data_);
+    for (int i = 0; i < blob_bottom_label_->count(); ++i) {
+      blob_bottom_label_->mutable_cpu_data()[i] = i % 3;
+    }
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    blob_top_vec_.push_back(blob_top_loss_);
+  }
+  virtual ~LiftedStructSimilaritySoftmaxLossLayerTest() {
+    delete blob_bottom_data_;
+    delete blob_bottom_label_;
+    delete blob_top_loss_;
+  }
+
+  Dtype Distance(int i, int j) {
+    const int dim = blob_bottom_data_->channels();
+    const Dtype* x = blob_bottom_data_->cpu_data();
+    Dtype dist_sq = 0;
+    for (int c = 0; c < dim; ++c) {
+      const Dtype diff = x[i * dim + c] - x[j * dim + c];
+      dist_sq += diff * diff;
+    }
+    return sqrt(dist_sq);
+  }
+
+  // The loss as defined, one positive pair at a time.
+  Dtype ReferenceLoss(Dtype margin) {
+    const int num = blob_bottom_data_->num();
+    const Dtype* label = blob_bottom_label_->cpu_data();
+    Dtype loss = 0;
+    int num_pairs = 0;
+    for (int i = 0; i < num; ++i) {
+      for (int j = i + 1; j < num; ++j) {
+        if (label[i] != label[j]) {
+          continue;
+        }
+        Dtype sum = 0;
+        for (int k = 0; k < num; ++k) {
+          if (label[k] != label[i]) {
+            sum += exp(margin - Distance(i, k));
+          }
+          if (label[k] != label[j]) {
+            sum += exp(margin - Distance(j, k));
+          }
+        }
+        const Dtype J = log(sum) + Distance(i, j);
+        loss += std::max(J, Dtype(0)) * std::max(J, Dtype(0));
+        ++num_pairs;
+      }
+    }
+    return loss / (2 * num_pairs);
+  }
+
+  Blob<Dtype>* const blob_bottom_data_;
+  Blob<Dtype>* const blob_bottom_label_;
+  Blob<Dtype>* const blob_top_loss_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(LiftedStructSimilaritySoftmaxLossLayerTest,
+    TestDtypesAndDevices);
+
+TYPED_TEST(LiftedStructSimilaritySoftmaxLossLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  LiftedStructSimilaritySoftmaxLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype expected = this->ReferenceLoss(1);
+  EXPECT_GT(expected, 0);
+  EXPECT_NEAR(expected, this->blob_top_loss_->cpu_data()[0], 1e-4 * expected);
+}
+
+TYPED_TEST(LiftedStructSimilaritySoftmaxLossLayerTest, TestForwardMargin) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_lifted_struct_sim_softmax_loss_param()->set_margin(3);
+  LiftedStructSimilaritySoftmaxLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype expected = this->ReferenceLoss(3);
+  EXPECT_NEAR(expected, this->blob_top_loss_->cpu_data()[0], 1e-4 * expected);
+}
+
+TYPED_TEST(LiftedStructSimilaritySoftmaxLossLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  LiftedStructSimilaritySoftmaxLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  GradientChecker<Dtype> checker(1e-2, 1e-2, 1701);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(LiftedStructSimilaritySoftmaxLossLayerTest, TestNoPositives) {
+  typedef typename TypeParam::Dtype Dtype;
+  for (int i = 0; i < this->blob_bottom_label_->count(); ++i) {
+    this->blob_bottom_label_->mutable_cpu_data()[i] = i;
+  }
+  LayerParameter layer_param;
+  LiftedStructSimilaritySoftmaxLossLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(0, this->blob_top_loss_->cpu_data()[0]);
+  vector<bool> propagate_down(2, false);
+  propagate_down[0] = true;
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < this->blob_bottom_data_->count(); ++i) {
+    EXPECT_EQ(0, this->blob_bottom_data_->cpu_diff()[i]);
+  }
+}
+
+}  // namespace caffe
@@ -1,6 +1,7 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
 #include <cmath>  // for std::fabs
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -119,6 +120,29 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestUint8Scale) {
+  // Odd lengths exercise both the vectorized body and the scalar tail.
+  const int lengths[] = {1, 7, 16, 37, 60};
+  const TypeParam mean = 104;
+  const TypeParam scale = 0.00390625;
+  for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) {
+    const int n = lengths[l];
+    vector<uint8_t> x(n);
+    for (int i = 0; i < n; ++i) {
+      x[i] = caffe_rng_rand() % 256;
+    }
+    vector<TypeParam> y(n);
+    caffe_cpu_uint8_scale<TypeParam>(n, &x[0], mean, scale, false, &y[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ((static_cast<TypeParam>(x[i]) - mean) * scale, y[i]);
+    }
+    caffe_cpu_uint8_scale<TypeParam>(n, &x[0], mean, scale, true, &y[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ((static_cast<TypeParam>(x[i]) - mean) * scale, y[n - 1 - i]);
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
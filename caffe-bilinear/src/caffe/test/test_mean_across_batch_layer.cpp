@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/mean_across_batch_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class MeanAcrossBatchLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+ protected:
+  MeanAcrossBatchLayerTest()
+      : blob_bottom_(new Blob<Dtype>(7, 3, 2, 2)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    // fill the values
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~MeanAcrossBatchLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Checks the top against the means of chunks of 3 items, the last one
+  // of a single item.
+  void CheckMeans(bool reduce) {
+    const int count = this->blob_bottom_->count(1);
+    const Dtype* bottom = this->blob_bottom_->cpu_data();
+    const Dtype* top = this->blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_bottom_->num(); ++i) {
+      const int s = i / 3 * 3;
+      const int e = std::min(s + 3, this->blob_bottom_->num());
+      const int row = reduce ? i / 3 : i;
+      for (int k = 0; k < count; ++k) {
+        Dtype mean = 0;
+        for (int j = s; j < e; ++j) {
+          mean += bottom[j * count + k];
+        }
+        mean /= e - s;
+        EXPECT_NEAR(mean, top[row * count + k], 1e-5);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(MeanAcrossBatchLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestSetup) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_bottom_->shape(), this->blob_top_->shape());
+  layer_param.mutable_mean_across_batch_param()->set_reduce(true);
+  MeanAcrossBatchLayer<Dtype> reduce_layer(layer_param);
+  reduce_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(3, this->blob_top_->num());
+  EXPECT_EQ(this->blob_bottom_->count(1), this->blob_top_->count(1));
+}
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckMeans(false);
+}
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestForwardReduce) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  layer_param.mutable_mean_across_batch_param()->set_reduce(true);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckMeans(true);
+}
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestForwardThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  layer_param.mutable_mean_across_batch_param()->set_num_threads(2);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->CheckMeans(false);
+}
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestForwardInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  Blob<Dtype> blob(this->blob_bottom_->shape());
+  blob.CopyFrom(*this->blob_bottom_);
+  vector<Blob<Dtype>*> blob_vec(1, &blob);
+  layer.SetUp(blob_vec, blob_vec);
+  layer.Forward(blob_vec, blob_vec);
+  this->blob_top_->CopyFrom(blob, false, true);
+  this->CheckMeans(false);
+}
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+TYPED_TEST(MeanAcrossBatchLayerTest, TestGradientReduce) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_mean_across_batch_param()->set_chunk_size(3);
+  layer_param.mutable_mean_across_batch_param()->set_reduce(true);
+  layer_param.mutable_mean_across_batch_param()->set_num_threads(2);
+  MeanAcrossBatchLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
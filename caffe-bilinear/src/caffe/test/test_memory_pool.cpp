@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/memory_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MemoryPoolTest : public ::testing::Test {};
+
+TEST_F(MemoryPoolTest, TestBucketSize) {
+  EXPECT_EQ(MemoryPool::kMinBucket, MemoryPool::BucketSize(0));
+  EXPECT_EQ(MemoryPool::kMinBucket, MemoryPool::BucketSize(1));
+  EXPECT_EQ(512, MemoryPool::BucketSize(512));
+  EXPECT_EQ(576, MemoryPool::BucketSize(513));
+  EXPECT_EQ(1024, MemoryPool::BucketSize(1000));
+  EXPECT_EQ(4096, MemoryPool::BucketSize(4096));
+  EXPECT_EQ(4608, MemoryPool::BucketSize(4097));
+  // No bucket wastes more than an eighth of the request.
+  for (size_t size = 513; size < 100000; size += 97) {
+    const size_t bucket = MemoryPool::BucketSize(size);
+    EXPECT_GE(bucket, size);
+    EXPECT_LE(bucket - size, size / 8);
+  }
+}
+
+TEST_F(MemoryPoolTest, TestHostReuse) {
+  MemoryPool pool;
+  bool use_cuda;
+  void* ptr = pool.MallocHost(1000, &use_cuda);
+  EXPECT_TRUE(ptr);
+  MemoryPool::Stats stats = pool.host_stats();
+  EXPECT_EQ(1, stats.requests);
+  EXPECT_EQ(0, stats.hits);
+  EXPECT_EQ(1024, stats.reserved);
+  pool.FreeHost(ptr, 1000, use_cuda);
+  EXPECT_EQ(1024, pool.host_stats().cached);
+  // Any size of the same bucket gets the buffer back.
+  void* again = pool.MallocHost(1010, &use_cuda);
+  EXPECT_EQ(ptr, again);
+  stats = pool.host_stats();
+  EXPECT_EQ(2, stats.requests);
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(0, stats.cached);
+  EXPECT_EQ(1024, stats.reserved);
+  // Another bucket does not.
+  void* other = pool.MallocHost(2000, &use_cuda);
+  EXPECT_NE(ptr, other);
+  stats = pool.host_stats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(1024 + 2048, stats.reserved);
+  EXPECT_EQ(1024 + 2048, stats.peak_reserved);
+  pool.FreeHost(again, 1010, use_cuda);
+  pool.FreeHost(other, 2000, use_cuda);
+}
+
+TEST_F(MemoryPoolTest, TestEmptyCache) {
+  MemoryPool pool;
+  bool use_cuda;
+  void* ptr = pool.MallocHost(5000, &use_cuda);
+  void* kept = pool.MallocHost(100, &use_cuda);
+  pool.FreeHost(ptr, 5000, use_cuda);
+  const size_t bucket = MemoryPool::BucketSize(5000);
+  EXPECT_EQ(bucket, pool.host_stats().cached);
+  pool.EmptyCache();
+  MemoryPool::Stats stats = pool.host_stats();
+  EXPECT_EQ(0, stats.cached);
+  EXPECT_EQ(MemoryPool::kMinBucket, stats.reserved);
+  EXPECT_EQ(bucket + MemoryPool::kMinBucket, stats.peak_reserved);
+  ptr = pool.MallocHost(5000, &use_cuda);
+  EXPECT_EQ(0, pool.host_stats().hits);
+  pool.FreeHost(ptr, 5000, use_cuda);
+  pool.FreeHost(kept, 100, use_cuda);
+}
+
+TEST_F(MemoryPoolTest, TestCacheLimit) {
+  MemoryPool pool;
+  EXPECT_EQ(MemoryPool::kDefaultCacheLimit, pool.cache_limit());
+  pool.set_cache_limit(3000);
+  bool use_cuda;
+  void* first = pool.MallocHost(2000, &use_cuda);
+  void* second = pool.MallocHost(2000, &use_cuda);
+  pool.FreeHost(first, 2000, use_cuda);
+  // Caching the second buffer would pass the limit: it is freed.
+  pool.FreeHost(second, 2000, use_cuda);
+  MemoryPool::Stats stats = pool.host_stats();
+  EXPECT_EQ(2048, stats.cached);
+  EXPECT_EQ(2048, stats.reserved);
+  // Lowering the limit below what is cached empties the cache.
+  pool.set_cache_limit(1000);
+  EXPECT_EQ(0, pool.host_stats().cached);
+  // With no cache, sizes are not rounded and nothing is kept.
+  pool.set_cache_limit(0);
+  void* ptr = pool.MallocHost(1000, &use_cuda);
+  EXPECT_EQ(1000, pool.host_stats().reserved);
+  pool.FreeHost(ptr, 1000, use_cuda);
+  stats = pool.host_stats();
+  EXPECT_EQ(0, stats.cached);
+  EXPECT_EQ(0, stats.reserved);
+}
+
+TEST_F(MemoryPoolTest, TestSyncedMemoryReuse) {
+  // Earlier tests may have left a buffer of this size.
+  Caffe::memory_pool().EmptyCache();
+  const MemoryPool::Stats before = Caffe::memory_pool().host_stats();
+  SyncedMemory mem(10000);
+  void* ptr = mem.mutable_cpu_data();
+  mem.release();
+  EXPECT_EQ(ptr, mem.mutable_cpu_data());
+  const MemoryPool::Stats after = Caffe::memory_pool().host_stats();
+  EXPECT_EQ(before.requests + 2, after.requests);
+  EXPECT_EQ(before.hits + 1, after.hits);
+}
+
+#ifndef CPU_ONLY  // GPU test
+
+TEST_F(MemoryPoolTest, TestDeviceReuse) {
+  MemoryPool pool;
+  void* ptr = pool.MallocDevice(1000);
+  EXPECT_TRUE(ptr);
+  pool.FreeDevice(ptr, 1000);
+  EXPECT_EQ(1024, pool.device_stats().cached);
+  EXPECT_EQ(ptr, pool.MallocDevice(1024));
+  MemoryPool::Stats stats = pool.device_stats();
+  EXPECT_EQ(2, stats.requests);
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(1024, stats.reserved);
+  pool.FreeDevice(ptr, 1024);
+  pool.EmptyCache();
+  EXPECT_EQ(0, pool.device_stats().reserved);
+}
+
+#endif
+
+}  // namespace caffe
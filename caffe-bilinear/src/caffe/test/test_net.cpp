@@ -783,6 +783,155 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitFrozenNet(const bool inference = false) {
+    string proto =
+        "name: 'FrozenTestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 5 dim: 2 dim: 3 dim: 4 } "
+        "    data_filler { type: 'gaussian' std: 1 } "
+        "    shape { dim: 5 } "
+        "    data_filler { type: 'constant' value: 0 } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'label' "
+        "} "
+        "layer { "
+        "  name: 'frozen' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 10 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  param { lr_mult: 0 } "
+        "  param { lr_mult: 0 } "
+        "  bottom: 'data' "
+        "  top: 'frozen' "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'frozen' "
+        "  top: 'frozen' "
+        "} "
+        "layer { "
+        "  name: 'innerproduct' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'frozen' "
+        "  top: 'innerproduct' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'innerproduct' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    if (inference) {
+      proto += "inference: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitRecomputeNet(const bool recompute) {
+    const string recompute_str = recompute ? "true" : "false";
+    string proto =
+        "name: 'RecomputeTestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 2 dim: 3 dim: 6 dim: 6 } "
+        "    data_filler { type: 'gaussian' std: 1 } "
+        "    shape { dim: 2 } "
+        "    data_filler { type: 'constant' value: 1 } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'label' "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'constant' value: 0.1 } "
+        "  } "
+        "  recompute: " + recompute_str + " "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'constant' value: 0.1 } "
+        "  } "
+        "  recompute: " + recompute_str + " "
+        "  bottom: 'conv1' "
+        "  top: 'conv2' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv2' "
+        "  top: 'conv2' "
+        "} "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'conv2' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'conv2' "
+        "  top: 'ip2' "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'ip1' "
+        "  bottom: 'ip2' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'sum' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
   virtual void InitAllInOneNet(Phase phase = caffe::TRAIN,
       const int level = 0, const vector<string>* stages = NULL) {
     string proto =
@@ -1457,6 +1606,208 @@ TYPED_TEST(NetTest, TestFromTo) {
   }
 }
 
+TYPED_TEST(NetTest, TestDiffFree) {
+  this->InitFrozenNet();
+  this->net_->Forward();
+  this->net_->Backward();
+  // Only the blobs on the path of the gradients to trained parameters, and
+  // the losses, have diffs.
+  const char* diff_free[] = { "data", "label", "frozen" };
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(this->net_->blob_by_name(diff_free[i])->diff_free());
+  }
+  const char* has_diff[] = { "innerproduct", "loss" };
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_FALSE(this->net_->blob_by_name(has_diff[i])->diff_free());
+  }
+  for (int i = 0; i < this->net_->params().size(); ++i) {
+    EXPECT_FALSE(this->net_->params()[i]->diff_free());
+  }
+}
+
+TYPED_TEST(NetTest, TestDiffFreeSharedDiff) {
+  // The data needs no gradient, but the LSTM shares its diff with its
+  // unrolled net, which always propagates down to it.
+  const string proto =
+      "name: 'LSTMTestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 3 dim: 2 dim: 4 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "    shape { dim: 3 dim: 2 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'cont' "
+      "} "
+      "layer { "
+      "  name: 'lstm' "
+      "  type: 'LSTM' "
+      "  recurrent_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  bottom: 'cont' "
+      "  top: 'lstm' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'Reduction' "
+      "  reduction_param { operation: SUMSQ } "
+      "  bottom: 'lstm' "
+      "  top: 'loss' "
+      "  loss_weight: 1 "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  this->net_->Forward();
+  this->net_->Backward();
+  EXPECT_FALSE(this->net_->blob_by_name("data")->diff_free());
+  EXPECT_TRUE(this->net_->blob_by_name("cont")->diff_free());
+  for (int i = 0; i < this->net_->params().size(); ++i) {
+    EXPECT_GT(this->net_->params()[i]->asum_diff(), 0);
+  }
+}
+
+TYPED_TEST(NetTest, TestInference) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitFrozenNet();
+  Dtype loss;
+  this->net_->Forward(&loss);
+  Caffe::set_random_seed(this->seed_);
+  this->InitFrozenNet(true);
+  EXPECT_TRUE(this->net_->inference());
+  const size_t held = SyncedMemory::host_memory() +
+      SyncedMemory::device_memory();
+  Dtype inference_loss;
+  this->net_->Forward(&inference_loss);
+  EXPECT_EQ(loss, inference_loss);
+  // Forward allocated the data of the blobs, and some scratch, only.
+  size_t data_memory = 0;
+  for (int i = 0; i < this->net_->blobs().size(); ++i) {
+    EXPECT_EQ(this->net_->blob_names()[i] != "loss",
+        this->net_->blobs()[i]->diff_free());
+    data_memory += this->net_->blobs()[i]->count() * sizeof(Dtype);
+  }
+  for (int i = 0; i < this->net_->params().size(); ++i) {
+    EXPECT_TRUE(this->net_->params()[i]->diff_free());
+  }
+  EXPECT_LT(SyncedMemory::host_memory() + SyncedMemory::device_memory() - held,
+      2 * data_memory);
+}
+
+TYPED_TEST(NetTest, TestInferenceForbidsDiffs) {
+  // The LSTM and the Reshape share their diffs, with the unrolled net and
+  // between bottom and top.
+  const string proto =
+      "name: 'InferenceTestNetwork' "
+      "inference: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 3 dim: 2 dim: 4 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "    shape { dim: 3 dim: 2 } "
+      "    data_filler { type: 'constant' value: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'cont' "
+      "} "
+      "layer { "
+      "  name: 'lstm' "
+      "  type: 'LSTM' "
+      "  recurrent_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  bottom: 'cont' "
+      "  top: 'lstm' "
+      "} "
+      "layer { "
+      "  name: 'reshape' "
+      "  type: 'Reshape' "
+      "  reshape_param { shape { dim: 0 dim: -1 } } "
+      "  bottom: 'lstm' "
+      "  top: 'reshape' "
+      "} "
+      "layer { "
+      "  name: 'innerproduct' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 3 "
+      "    weight_filler { type: 'gaussian' std: 0.1 } "
+      "  } "
+      "  bottom: 'reshape' "
+      "  top: 'innerproduct' "
+      "} "
+      "layer { "
+      "  name: 'prob' "
+      "  type: 'Softmax' "
+      "  bottom: 'innerproduct' "
+      "  top: 'prob' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  this->net_->Forward();
+  this->net_->Forward();
+  for (int i = 0; i < this->net_->blobs().size(); ++i) {
+    EXPECT_TRUE(this->net_->blobs()[i]->diff_free())
+        << this->net_->blob_names()[i];
+    EXPECT_TRUE(this->net_->blobs()[i]->diff_forbidden())
+        << this->net_->blob_names()[i];
+  }
+  for (int i = 0; i < this->net_->params().size(); ++i) {
+    EXPECT_TRUE(this->net_->params()[i]->diff_free());
+    EXPECT_TRUE(this->net_->params()[i]->diff_forbidden());
+  }
+}
+
+TYPED_TEST(NetTest, TestRecompute) {
+  typedef typename TypeParam::Dtype Dtype;
+  Dtype loss[2];
+  size_t peak_memory[2];
+  vector<shared_ptr<Blob<Dtype> > > param_diffs[2];
+  for (int recompute = 0; recompute < 2; ++recompute) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitRecomputeNet(recompute);
+    const size_t held =
+        SyncedMemory::host_memory() + SyncedMemory::device_memory();
+    SyncedMemory::ResetPeakMemory();
+    this->net_->Forward(&loss[recompute]);
+    // conv2 is read through a split by ip1 and ip2.
+    const shared_ptr<Blob<Dtype> > conv2 = this->net_->blob_by_name("conv2");
+    if (recompute) {
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED, conv2->data()->head());
+    } else {
+      EXPECT_NE(SyncedMemory::UNINITIALIZED, conv2->data()->head());
+    }
+    this->net_->Backward();
+    if (recompute) {
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED, conv2->data()->head());
+      EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+          this->net_->blob_by_name("conv1")->data()->head());
+    }
+    peak_memory[recompute] = SyncedMemory::peak_host_memory() +
+        SyncedMemory::peak_device_memory() - held;
+    this->CopyNetParams(true, &param_diffs[recompute]);
+  }
+  EXPECT_EQ(loss[0], loss[1]);
+  EXPECT_LT(peak_memory[1], peak_memory[0]);
+  ASSERT_EQ(param_diffs[0].size(), param_diffs[1].size());
+  for (int i = 0; i < param_diffs[0].size(); ++i) {
+    const Blob<Dtype>& expected = *param_diffs[0][i];
+    const Blob<Dtype>& actual = *param_diffs[1][i];
+    ASSERT_EQ(expected.count(), actual.count());
+    for (int j = 0; j < expected.count(); ++j) {
+      EXPECT_NEAR(expected.cpu_diff()[j], actual.cpu_diff()[j], 1e-6);
+    }
+  }
+}
+
 class FilterNetTest : public ::testing::Test {
  protected:
   void RunFilterNetTest(
@@ -2446,6 +2797,72 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestReserve) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitReshapableNet();
+  shared_ptr<Blob<Dtype> > input_blob = this->net_->blob_by_name("data");
+  this->net_->Reserve(4);
+  EXPECT_EQ(1, input_blob->num());
+  EXPECT_EQ(1, this->net_->output_blobs()[0]->num());
+  this->net_->Forward();
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = this->net_->blobs();
+  vector<const Dtype*> data(blobs.size());
+  for (int i = 0; i < blobs.size(); ++i) {
+    data[i] = blobs[i]->cpu_data();
+  }
+  const size_t host_memory = SyncedMemory::host_memory();
+  // Any batch up to the reserved one reuses the same memory.
+  const int batches[] = {4, 2, 3};
+  for (int b = 0; b < 3; ++b) {
+    input_blob->Reshape(batches[b], 3, 100, 100);
+    this->net_->Forward();
+    EXPECT_EQ(batches[b], this->net_->output_blobs()[0]->num());
+    for (int i = 0; i < blobs.size(); ++i) {
+      EXPECT_EQ(data[i], blobs[i]->cpu_data()) << this->net_->blob_names()[i];
+    }
+    EXPECT_EQ(host_memory, SyncedMemory::host_memory());
+  }
+}
+
+TYPED_TEST(NetTest, TestCreateContext) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 3, 12, 10);
+  filler.Fill(&input);
+
+  this->InitReshapableNet();
+  shared_ptr<Net<Dtype> > context = this->net_->CreateContext();
+  // Parameters are shared, activations are not.
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  ASSERT_EQ(params.size(), context->params().size());
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_EQ(params[i]->cpu_data(), context->params()[i]->cpu_data());
+  }
+  ASSERT_EQ(this->net_->blobs().size(), context->blobs().size());
+  for (int i = 0; i < this->net_->blobs().size(); ++i) {
+    EXPECT_NE(this->net_->blobs()[i].get(), context->blobs()[i].get());
+  }
+  // Both compute the same outputs from the same inputs.
+  Net<Dtype>* nets[2] = { this->net_.get(), context.get() };
+  for (int n = 0; n < 2; ++n) {
+    Blob<Dtype>* input_blob = nets[n]->input_blobs()[0];
+    input_blob->ReshapeLike(input);
+    caffe_copy(input.count(), input.cpu_data(),
+        input_blob->mutable_cpu_data());
+    nets[n]->Forward();
+  }
+  const Blob<Dtype>* output = this->net_->output_blobs()[0];
+  const Blob<Dtype>* context_output = context->output_blobs()[0];
+  ASSERT_EQ(output->shape(), context_output->shape());
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_EQ(output->cpu_data()[i], context_output->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
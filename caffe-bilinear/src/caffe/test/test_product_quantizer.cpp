@@ -0,0 +1,98 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/product_quantizer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_embedding_util.hpp"
+
+namespace caffe {
+
+class ProductQuantizerTest : public ::testing::Test {
+ protected:
+  ProductQuantizerTest()
+      : num_(1000), dim_(10), embeddings_(num_ * dim_) {
+    // Embeddings scattered around 40 people.
+    const ClusteredEmbeddings people(40, dim_);
+    people.Fill(num_, 0.1, &embeddings_[0]);
+  }
+
+  int num_;
+  int dim_;
+  vector<float> embeddings_;
+};
+
+TEST_F(ProductQuantizerTest, TestSubspaces) {
+  // 10 dimensions in 4 subspaces: 3, 3, 2, 2.
+  ProductQuantizer quantizer(dim_, 4);
+  EXPECT_EQ(0, quantizer.subspace_begin(0));
+  EXPECT_EQ(3, quantizer.subspace_begin(1));
+  EXPECT_EQ(6, quantizer.subspace_begin(2));
+  EXPECT_EQ(8, quantizer.subspace_begin(3));
+  EXPECT_EQ(10, quantizer.subspace_begin(4));
+  EXPECT_EQ(4, quantizer.code_size());
+  EXPECT_EQ(4 * 256, quantizer.table_size());
+}
+
+TEST_F(ProductQuantizerTest, TestEncodeDecode) {
+  ProductQuantizer quantizer(dim_, 4);
+  EXPECT_FALSE(quantizer.trained());
+  quantizer.Train(&embeddings_[0], num_);
+  EXPECT_TRUE(quantizer.trained());
+  EXPECT_EQ(256 * dim_, quantizer.centroids().size());
+  vector<uint8_t> codes(num_ * quantizer.code_size());
+  quantizer.Encode(&embeddings_[0], num_, &codes[0]);
+  vector<float> decoded(num_ * dim_);
+  quantizer.Decode(&codes[0], num_, &decoded[0]);
+  double error = 0;
+  double energy = 0;
+  for (int i = 0; i < num_ * dim_; ++i) {
+    error += (decoded[i] - embeddings_[i]) * (decoded[i] - embeddings_[i]);
+    energy += embeddings_[i] * embeddings_[i];
+  }
+  EXPECT_LT(error, 0.01 * energy);
+  // A decoded embedding codes to itself.
+  vector<uint8_t> recoded(codes.size());
+  quantizer.Encode(&decoded[0], num_, &recoded[0]);
+  EXPECT_TRUE(codes == recoded);
+}
+
+TEST_F(ProductQuantizerTest, TestTableDistances) {
+  ProductQuantizer quantizer(dim_, 4);
+  quantizer.Train(&embeddings_[0], num_, 3);
+  vector<uint8_t> codes(num_ * quantizer.code_size());
+  quantizer.Encode(&embeddings_[0], num_, &codes[0]);
+  vector<float> decoded(num_ * dim_);
+  quantizer.Decode(&codes[0], num_, &decoded[0]);
+  vector<float> query(dim_);
+  caffe_rng_gaussian<float>(dim_, 0, 1, &query[0]);
+  vector<float> table(quantizer.table_size());
+  quantizer.ComputeTable(&query[0], &table[0]);
+  vector<float> distances(num_);
+  quantizer.Distances(&table[0], &codes[0], num_, &distances[0]);
+  // Asymmetric distances are those to the decoded embeddings.
+  for (int i = 0; i < num_; ++i) {
+    float expected = 0;
+    for (int d = 0; d < dim_; ++d) {
+      expected += (query[d] - decoded[i * dim_ + d]) *
+          (query[d] - decoded[i * dim_ + d]);
+    }
+    EXPECT_NEAR(expected, distances[i], 1e-4);
+  }
+}
+
+TEST_F(ProductQuantizerTest, TestSetCentroids) {
+  ProductQuantizer quantizer(dim_, 5);
+  quantizer.Train(&embeddings_[0], num_, 2);
+  ProductQuantizer copy(dim_, 5);
+  copy.set_centroids(quantizer.centroids());
+  vector<uint8_t> codes(num_ * 5), copy_codes(num_ * 5);
+  quantizer.Encode(&embeddings_[0], num_, &codes[0]);
+  copy.Encode(&embeddings_[0], num_, &copy_codes[0]);
+  EXPECT_TRUE(codes == copy_codes);
+}
+
+}  // namespace caffe
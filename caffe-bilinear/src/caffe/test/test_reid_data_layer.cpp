@@ -0,0 +1,194 @@
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/reid_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/reid_dataset.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(ReIDDatasetTest, TestParseMarket1501Name) {
+  int person, camera;
+  EXPECT_TRUE(ParseMarket1501Name("0002_c1s1_000451_03.jpg", &person,
+      &camera));
+  EXPECT_EQ(2, person);
+  EXPECT_EQ(1, camera);
+  EXPECT_TRUE(ParseMarket1501Name("bounding_box_test/1501_c6s4_001902_01.jpg",
+      &person, &camera));
+  EXPECT_EQ(1501, person);
+  EXPECT_EQ(6, camera);
+  EXPECT_TRUE(ParseMarket1501Name("-1_c3s2_000012_02.jpg", &person,
+      &camera));
+  EXPECT_EQ(-1, person);
+  EXPECT_EQ(3, camera);
+  EXPECT_FALSE(ParseMarket1501Name("Thumbs.db", &person, &camera));
+  EXPECT_FALSE(ParseMarket1501Name("cat_dog.jpg", &person, &camera));
+}
+
+template <typename TypeParam>
+class ReIDDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ReIDDataLayerTest()
+      : blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    MakeTempFilename(&filename_);
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+  }
+  virtual ~ReIDDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // Writes 12 records of 2 x 3 x 4 pixels: record i belongs to person
+  // 10 + i % 4 and camera i % 3, and all its pixels are i.
+  void Fill() {
+    ReIDDatasetWriter writer(filename_, 2, 3, 4);
+    vector<uint8_t> pixels(24);
+    for (int i = 0; i < 12; ++i) {
+      pixels.assign(24, i);
+      writer.Add(&pixels[0], 10 + i % 4, i % 3);
+    }
+    writer.Close();
+  }
+
+  string filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ReIDDataLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ReIDDataLayerTest, TestDataset) {
+  this->Fill();
+  ReIDDataset dataset;
+  dataset.Open(this->filename_);
+  EXPECT_EQ(12, dataset.num_records());
+  EXPECT_EQ(2, dataset.channels());
+  EXPECT_EQ(3, dataset.height());
+  EXPECT_EQ(4, dataset.width());
+  EXPECT_EQ(4, dataset.num_persons());
+  for (int i = 0; i < 12; ++i) {
+    EXPECT_EQ(10 + i % 4, dataset.person(i));
+    EXPECT_EQ(i % 3, dataset.camera(i));
+    for (int j = 0; j < 24; ++j) {
+      EXPECT_EQ(i, dataset.record(i)[j]);
+    }
+  }
+  for (int k = 0; k < 4; ++k) {
+    EXPECT_EQ(10 + k, dataset.person_id(k));
+    EXPECT_EQ(k, dataset.FindPerson(10 + k));
+    ASSERT_EQ(3, dataset.num_records_of(k));
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(k + 4 * j, dataset.records_of(k)[j]);
+    }
+  }
+  EXPECT_EQ(-1, dataset.FindPerson(9));
+  EXPECT_EQ(-1, dataset.FindPerson(14));
+}
+
+TYPED_TEST(ReIDDataLayerTest, TestRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Fill();
+  const Dtype scale = 3;
+  LayerParameter param;
+  param.set_phase(TRAIN);
+  ReIDDataParameter* reid_data_param = param.mutable_reid_data_param();
+  reid_data_param->set_batch_size(5);
+  reid_data_param->set_source(this->filename_);
+  param.mutable_transform_param()->set_scale(scale);
+
+  ReIDDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(5, this->blob_top_data_->num());
+  EXPECT_EQ(2, this->blob_top_data_->channels());
+  EXPECT_EQ(3, this->blob_top_data_->height());
+  EXPECT_EQ(4, this->blob_top_data_->width());
+  EXPECT_EQ(5, this->blob_top_label_->num());
+
+  int record = 0;
+  for (int iter = 0; iter < 5; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 5; ++i, record = (record + 1) % 12) {
+      EXPECT_EQ(10 + record % 4, this->blob_top_label_->cpu_data()[i]);
+      for (int j = 0; j < 24; ++j) {
+        EXPECT_EQ(scale * record, this->blob_top_data_->cpu_data()[i * 24 + j])
+            << "debug: iter " << iter << " i " << i << " j " << j;
+      }
+    }
+  }
+}
+
+TYPED_TEST(ReIDDataLayerTest, TestReadCameras) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Fill();
+  LayerParameter param;
+  param.set_phase(TRAIN);
+  ReIDDataParameter* reid_data_param = param.mutable_reid_data_param();
+  reid_data_param->set_batch_size(6);
+  reid_data_param->set_identities_per_batch(3);
+  reid_data_param->set_shuffle(true);
+  reid_data_param->set_source(this->filename_);
+
+  Blob<Dtype> blob_top_camera;
+  this->blob_top_vec_.push_back(&blob_top_camera);
+  ReIDDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(6, blob_top_camera.num());
+  for (int iter = 0; iter < 5; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 6; ++i) {
+      const int record = this->blob_top_data_->cpu_data()[i * 24];
+      EXPECT_EQ(10 + record % 4, this->blob_top_label_->cpu_data()[i]);
+      EXPECT_EQ(record % 3, blob_top_camera.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(ReIDDataLayerTest, TestSampleIdentities) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Fill();
+  LayerParameter param;
+  param.set_phase(TRAIN);
+  ReIDDataParameter* reid_data_param = param.mutable_reid_data_param();
+  reid_data_param->set_batch_size(6);
+  reid_data_param->set_identities_per_batch(3);
+  reid_data_param->set_shuffle(true);
+  reid_data_param->set_source(this->filename_);
+
+  ReIDDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Dtype* data = this->blob_top_data_->cpu_data();
+    const Dtype* label = this->blob_top_label_->cpu_data();
+    std::set<int> persons;
+    for (int p = 0; p < 3; ++p) {
+      // Two distinct records of the same person.
+      const int person = label[2 * p];
+      EXPECT_EQ(person, label[2 * p + 1]);
+      EXPECT_NE(data[2 * p * 24], data[(2 * p + 1) * 24]);
+      for (int k = 0; k < 2; ++k) {
+        const int record = data[(2 * p + k) * 24];
+        EXPECT_EQ(person, 10 + record % 4);
+      }
+      persons.insert(person);
+    }
+    EXPECT_EQ(3, persons.size());
+  }
+}
+
+}  // namespace caffe
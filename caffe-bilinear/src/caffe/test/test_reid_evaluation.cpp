@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ReIDEvaluationTest : public ::testing::Test {
+ protected:
+  // The gallery of the hand-worked cases.
+  void FillGallery() {
+    const int persons[] = {1, 2, 1, -1, 1, 0};
+    const int cameras[] = {2, 1, 1, 3, 3, 2};
+    persons_.assign(persons, persons + 6);
+    cameras_.assign(cameras, cameras + 6);
+  }
+
+  // Scores a query by sorting the whole gallery, as the notebook did.
+  ReIDEvaluator::Score SortedScore(const vector<float>& distances,
+      int person, int camera) {
+    vector<std::pair<float, int> > ranked;
+    for (int i = 0; i < distances.size(); ++i) {
+      const bool junk = persons_[i] < 0 ||
+          (persons_[i] == person && cameras_[i] == camera);
+      if (!junk) {
+        ranked.push_back(std::make_pair(distances[i], i));
+      }
+    }
+    std::sort(ranked.begin(), ranked.end());
+    ReIDEvaluator::Score score;
+    score.first_match = -1;
+    score.average_precision = 0;
+    int matches = 0;
+    for (int r = 0; r < ranked.size(); ++r) {
+      if (persons_[ranked[r].second] == person) {
+        if (matches == 0) {
+          score.first_match = r;
+        }
+        ++matches;
+        score.average_precision += static_cast<double>(matches) / (r + 1);
+      }
+    }
+    if (matches > 0) {
+      score.average_precision /= matches;
+    }
+    return score;
+  }
+
+  vector<int> persons_;
+  vector<int> cameras_;
+};
+
+TEST_F(ReIDEvaluationTest, TestDistances) {
+  const int num_queries = 3;
+  const int num_gallery = 4;
+  const int dim = 5;
+  vector<float> queries(num_queries * dim);
+  vector<float> gallery(num_gallery * dim);
+  for (int i = 0; i < queries.size(); ++i) {
+    queries[i] = std::sin(i + 1.f);
+  }
+  for (int i = 0; i < gallery.size(); ++i) {
+    gallery[i] = std::cos(2.f * i);
+  }
+  vector<float> cosine(num_queries * num_gallery);
+  vector<float> euclidean(num_queries * num_gallery);
+  ReIDDistances(&queries[0], num_queries, &gallery[0], num_gallery, dim,
+      true, &cosine[0]);
+  ReIDDistances(&queries[0], num_queries, &gallery[0], num_gallery, dim,
+      false, &euclidean[0]);
+  for (int i = 0; i < num_queries; ++i) {
+    for (int j = 0; j < num_gallery; ++j) {
+      float dot = 0, qq = 0, gg = 0, squared = 0;
+      for (int d = 0; d < dim; ++d) {
+        const float q = queries[i * dim + d];
+        const float g = gallery[j * dim + d];
+        dot += q * g;
+        qq += q * q;
+        gg += g * g;
+        squared += (q - g) * (q - g);
+      }
+      EXPECT_NEAR(1 - dot / std::sqrt(qq * gg), cosine[i * num_gallery + j],
+          1e-5);
+      EXPECT_NEAR(squared, euclidean[i * num_gallery + j], 1e-4);
+    }
+  }
+}
+
+TEST_F(ReIDEvaluationTest, TestTopK) {
+  const float distances[] = {0.5, 0.1, 0.3, 0.1, 0.9};
+  vector<int> top;
+  ReIDTopK(distances, 5, 3, &top);
+  ASSERT_EQ(3, top.size());
+  // Ties go to the lower index.
+  EXPECT_EQ(1, top[0]);
+  EXPECT_EQ(3, top[1]);
+  EXPECT_EQ(2, top[2]);
+  ReIDTopK(distances, 5, 10, &top);
+  EXPECT_EQ(5, top.size());
+  EXPECT_EQ(4, top[4]);
+}
+
+TEST_F(ReIDEvaluationTest, TestEvaluate) {
+  FillGallery();
+  ReIDEvaluator evaluator(persons_, cameras_);
+  EXPECT_EQ(6, evaluator.num_gallery());
+  const float distances[] = {0.5, 0.1, 0.05, 0.02, 0.9, 0.3};
+  // Items 2 (same camera) and 3 (junk) are left out: the ranking is
+  // 1, 5, 0, 4 and the true matches 0 and 4 come at ranks 2 and 3.
+  ReIDEvaluator::Score score = evaluator.Evaluate(distances, 1, 1);
+  EXPECT_EQ(2, score.first_match);
+  EXPECT_NEAR((1. / 3 + 2. / 4) / 2, score.average_precision, 1e-9);
+  // Person 2 is seen only by camera 1.
+  score = evaluator.Evaluate(distances, 2, 2);
+  EXPECT_EQ(1, score.first_match);
+  EXPECT_NEAR(0.5, score.average_precision, 1e-9);
+  EXPECT_EQ(-1, evaluator.Evaluate(distances, 2, 1).first_match);
+  // Nobody in the gallery.
+  EXPECT_EQ(-1, evaluator.Evaluate(distances, 3, 1).first_match);
+}
+
+TEST_F(ReIDEvaluationTest, TestEvaluateMatchesSorting) {
+  const int num_gallery = 200;
+  for (int i = 0; i < num_gallery; ++i) {
+    persons_.push_back(i % 13 - 1);
+    cameras_.push_back(i % 5);
+  }
+  ReIDEvaluator evaluator(persons_, cameras_);
+  vector<float> distances(num_gallery);
+  for (int query = 0; query < 20; ++query) {
+    for (int i = 0; i < num_gallery; ++i) {
+      // Coarse distances, so that many tie.
+      distances[i] = static_cast<int>(10 * std::abs(std::sin(
+          0.37f * i * (query + 1)))) / 10.f;
+    }
+    const int person = query % 12;
+    const int camera = query % 5;
+    const ReIDEvaluator::Score expected =
+        SortedScore(distances, person, camera);
+    const ReIDEvaluator::Score score =
+        evaluator.Evaluate(&distances[0], person, camera);
+    EXPECT_EQ(expected.first_match, score.first_match);
+    EXPECT_NEAR(expected.average_precision, score.average_precision, 1e-9);
+  }
+}
+
+TEST_F(ReIDEvaluationTest, TestSummary) {
+  vector<ReIDEvaluator::Score> scores(3);
+  scores[0].first_match = 2;
+  scores[0].average_precision = 0.25;
+  scores[1].first_match = -1;
+  scores[1].average_precision = 0;
+  scores[2].first_match = 0;
+  scores[2].average_precision = 0.75;
+  vector<double> cmc;
+  const double mean_average_precision = ReIDSummary(scores, 4, &cmc);
+  // The unmatched query is left out.
+  EXPECT_NEAR(0.5, mean_average_precision, 1e-9);
+  ASSERT_EQ(4, cmc.size());
+  EXPECT_NEAR(0.5, cmc[0], 1e-9);
+  EXPECT_NEAR(0.5, cmc[1], 1e-9);
+  EXPECT_NEAR(1, cmc[2], 1e-9);
+  EXPECT_NEAR(1, cmc[3], 1e-9);
+}
+
+}  // namespace caffe
@@ -0,0 +1,249 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/reid_gallery.hpp"
+#include "caffe/util/reid_search.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_embedding_util.hpp"
+
+namespace caffe {
+
+class ReIDGalleryTest : public ::testing::Test {
+ protected:
+  ReIDGalleryTest()
+      : num_gallery_(1200), num_queries_(30), dim_(16), k_(10),
+        gallery_(num_gallery_ * dim_), queries_(num_queries_ * dim_),
+        cameras_(num_gallery_), query_cameras_(num_queries_) {
+    // Embeddings scattered around 30 people, seen by 6 cameras.
+    const ClusteredEmbeddings people(30, dim_);
+    people.Fill(num_gallery_, 0.4, &gallery_[0]);
+    people.Fill(num_queries_, 0.4, &queries_[0]);
+    for (int i = 0; i < num_gallery_; ++i) {
+      cameras_[i] = i % 6;
+    }
+    for (int i = 0; i < num_queries_; ++i) {
+      query_cameras_[i] = i % 6;
+    }
+  }
+
+  // Checks results against an exhaustive search of the gallery items not
+  // removed, up to a fraction of misses.
+  void ExpectNearest(const vector<vector<ReIDMatch> >& results,
+      const vector<bool>& removed, const int* query_cameras,
+      float max_misses) {
+    vector<float> kept;
+    vector<int> ids;
+    vector<int> cameras;
+    for (int i = 0; i < num_gallery_; ++i) {
+      if (!removed[i]) {
+        kept.insert(kept.end(), &gallery_[i * dim_],
+            &gallery_[(i + 1) * dim_]);
+        ids.push_back(i);
+        cameras.push_back(cameras_[i]);
+      }
+    }
+    ReIDSearch search(&kept[0], ids.size(), dim_, true);
+    search.set_cameras(cameras);
+    vector<vector<ReIDMatch> > exact;
+    search.Search(&queries_[0], num_queries_, query_cameras, k_, &exact,
+        NULL);
+    int misses = 0;
+    for (int i = 0; i < num_queries_; ++i) {
+      ASSERT_EQ(k_, results[i].size());
+      for (int r = 0; r < k_; ++r) {
+        const int id = results[i][r].index;
+        EXPECT_FALSE(removed[id]);
+        if (query_cameras) {
+          EXPECT_NE(query_cameras[i], cameras_[id]);
+        }
+        misses += ids[exact[i][r].index] != id;
+      }
+    }
+    EXPECT_LE(misses, max_misses * num_queries_ * k_);
+  }
+
+  int num_gallery_;
+  int num_queries_;
+  int dim_;
+  int k_;
+  vector<float> gallery_;
+  vector<float> queries_;
+  vector<int> cameras_;
+  vector<int> query_cameras_;
+};
+
+TEST_F(ReIDGalleryTest, TestAddSearch) {
+  ReIDGallery gallery(dim_, true);
+  gallery.set_segment_size(100);
+  gallery.set_auto_compaction(false);
+  EXPECT_EQ(0, gallery.Add(&gallery_[0], 250, &cameras_[0]));
+  for (int i = 250; i < num_gallery_; ++i) {
+    EXPECT_EQ(i, gallery.Add(&gallery_[i * dim_], cameras_[i]));
+  }
+  EXPECT_EQ(num_gallery_, gallery.size());
+  EXPECT_EQ(12, gallery.num_segments());
+  vector<vector<ReIDMatch> > results;
+  gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+  const vector<bool> removed(num_gallery_);
+  ExpectNearest(results, removed, NULL, 0);
+  gallery.Search(&queries_[0], num_queries_, &query_cameras_[0], k_,
+      &results, NULL);
+  ExpectNearest(results, removed, &query_cameras_[0], 0);
+}
+
+TEST_F(ReIDGalleryTest, TestRemoveCompact) {
+  ReIDGallery gallery(dim_, true);
+  gallery.set_segment_size(100);
+  gallery.set_auto_compaction(false);
+  gallery.Add(&gallery_[0], num_gallery_, &cameras_[0]);
+  vector<bool> removed(num_gallery_);
+  for (int i = 0; i < num_gallery_; i += 3) {
+    EXPECT_TRUE(gallery.Remove(i));
+    removed[i] = true;
+  }
+  EXPECT_FALSE(gallery.Remove(0));
+  EXPECT_FALSE(gallery.Remove(num_gallery_));
+  EXPECT_EQ(num_gallery_ / 3, gallery.num_deleted());
+  EXPECT_TRUE(gallery.NeedsCompaction());
+  vector<vector<ReIDMatch> > results;
+  gallery.Search(&queries_[0], num_queries_, &query_cameras_[0], k_,
+      &results, NULL);
+  ExpectNearest(results, removed, &query_cameras_[0], 0);
+  gallery.Compact();
+  EXPECT_EQ(0, gallery.num_deleted());
+  EXPECT_EQ(1, gallery.num_segments());
+  EXPECT_EQ(num_gallery_ - num_gallery_ / 3, gallery.size());
+  gallery.Search(&queries_[0], num_queries_, &query_cameras_[0], k_,
+      &results, NULL);
+  ExpectNearest(results, removed, &query_cameras_[0], 0);
+  // Removals after compaction are honoured too.
+  EXPECT_TRUE(gallery.Remove(1));
+  removed[1] = true;
+  gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+  ExpectNearest(results, removed, NULL, 0);
+}
+
+TEST_F(ReIDGalleryTest, TestTieredCompaction) {
+  ReIDGallery gallery(dim_, true);
+  gallery.set_segment_size(100);
+  gallery.set_auto_compaction(false);
+  gallery.Add(&gallery_[0], 800, &cameras_[0]);
+  EXPECT_TRUE(gallery.NeedsCompaction());
+  gallery.StartCompaction();
+  gallery.WaitForCompaction();
+  EXPECT_EQ(1, gallery.num_segments());
+  // Newer segments are merged apart from a larger compacted segment.
+  gallery.Add(&gallery_[800 * dim_], 400, &cameras_[800]);
+  gallery.StartCompaction();
+  gallery.WaitForCompaction();
+  EXPECT_EQ(2, gallery.num_segments());
+  EXPECT_FALSE(gallery.NeedsCompaction());
+  vector<vector<ReIDMatch> > results;
+  gallery.Search(&queries_[0], num_queries_, &query_cameras_[0], k_,
+      &results, NULL);
+  vector<bool> removed(num_gallery_);
+  ExpectNearest(results, removed, &query_cameras_[0], 0);
+  // Many deletions merge everything.
+  for (int i = 0; i < num_gallery_; i += 3) {
+    gallery.Remove(i);
+    removed[i] = true;
+  }
+  gallery.StartCompaction();
+  gallery.WaitForCompaction();
+  EXPECT_EQ(1, gallery.num_segments());
+  EXPECT_EQ(0, gallery.num_deleted());
+  gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+  ExpectNearest(results, removed, NULL, 0);
+}
+
+TEST_F(ReIDGalleryTest, TestANNCompaction) {
+  ReIDGallery gallery(dim_, true, "hnsw");
+  gallery.set_segment_size(200);
+  gallery.set_auto_compaction(false);
+  gallery.set_effort(200);
+  gallery.Add(&gallery_[0], 1000, &cameras_[0]);
+  gallery.Compact();
+  EXPECT_EQ(1, gallery.num_segments());
+  // The rest go to new segments searched exhaustively.
+  gallery.Add(&gallery_[1000 * dim_], num_gallery_ - 1000, &cameras_[1000]);
+  EXPECT_EQ(2, gallery.num_segments());
+  vector<bool> removed(num_gallery_);
+  for (int i = 0; i < num_gallery_; i += 4) {
+    gallery.Remove(i);
+    removed[i] = true;
+  }
+  vector<vector<ReIDMatch> > results;
+  gallery.Search(&queries_[0], num_queries_, &query_cameras_[0], k_,
+      &results, NULL);
+  ExpectNearest(results, removed, &query_cameras_[0], 0.05);
+  gallery.Compact();
+  EXPECT_EQ(1, gallery.num_segments());
+  gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+  ExpectNearest(results, removed, NULL, 0.05);
+}
+
+TEST_F(ReIDGalleryTest, TestSmallPQSegments) {
+  // Compacted segments too small to train product quantization on are
+  // searched exhaustively.
+  ReIDGallery gallery(dim_, true, "pq");
+  gallery.set_segment_size(10);
+  gallery.set_auto_compaction(false);
+  gallery.Add(&gallery_[0], 100, &cameras_[0]);
+  gallery.Compact();
+  EXPECT_EQ(1, gallery.num_segments());
+  vector<vector<ReIDMatch> > results;
+  gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+  vector<bool> absent(num_gallery_, true);
+  std::fill(absent.begin(), absent.begin() + 100, false);
+  ExpectNearest(results, absent, NULL, 0);
+}
+
+// Adds and removes items while searching, with compaction in the
+// background.
+static void Update(ReIDGallery* gallery, const vector<float>* embeddings,
+    int num, int dim) {
+  for (int i = 0; i < num; ++i) {
+    gallery->Add(&(*embeddings)[i * dim]);
+    if (i % 2) {
+      gallery->Remove(i - 1);
+    }
+  }
+}
+
+TEST_F(ReIDGalleryTest, TestConcurrentUpdates) {
+  ReIDGallery gallery(dim_, true, "ivf");
+  gallery.set_segment_size(50);
+  boost::thread updater(&Update, &gallery, &gallery_, num_gallery_, dim_);
+  vector<vector<ReIDMatch> > results;
+  for (int s = 0; s < 50; ++s) {
+    gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+    for (int i = 0; i < num_queries_; ++i) {
+      for (int r = 0; r < results[i].size(); ++r) {
+        EXPECT_LT(results[i][r].index, num_gallery_);
+        if (r > 0) {
+          EXPECT_LE(results[i][r - 1].distance, results[i][r].distance);
+        }
+      }
+    }
+  }
+  updater.join();
+  gallery.WaitForCompaction();
+  EXPECT_EQ(num_gallery_ / 2, gallery.size());
+  gallery.Compact();
+  EXPECT_EQ(0, gallery.num_deleted());
+  gallery.set_effort(1024);
+  gallery.Search(&queries_[0], num_queries_, NULL, k_, &results, NULL);
+  vector<bool> removed(num_gallery_);
+  for (int i = 0; i < num_gallery_; i += 2) {
+    removed[i] = true;
+  }
+  ExpectNearest(results, removed, NULL, 0);
+}
+
+}  // namespace caffe
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/reid_reranking.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_embedding_util.hpp"
+
+namespace caffe {
+
+class ReIDRerankingTest : public ::testing::Test {
+ protected:
+  ReIDRerankingTest()
+      : num_queries_(12), num_gallery_(90), dim_(8),
+        queries_(num_queries_ * dim_), gallery_(num_gallery_ * dim_) {
+    // Embeddings scattered around 9 people.
+    const ClusteredEmbeddings people(9, dim_);
+    people.Fill(num_gallery_, 0.5, &gallery_[0]);
+    people.Fill(num_queries_, 0.5, &queries_[0]);
+  }
+
+  // The original distances from every query to every gallery item.
+  void Distances(bool cosine, vector<float>* distances) {
+    distances->resize(num_queries_ * num_gallery_);
+    ReIDDistances(&queries_[0], num_queries_, &gallery_[0], num_gallery_,
+        dim_, cosine, &(*distances)[0]);
+  }
+
+  // The reciprocal neighbors of item within the first k + 1 of ranks.
+  static vector<int> Reciprocal(const vector<vector<int> >& ranks, int item,
+      int k) {
+    vector<int> neighbors;
+    for (int i = 0; i <= k; ++i) {
+      const int candidate = ranks[item][i];
+      const vector<int>& backward = ranks[candidate];
+      if (std::find(backward.begin(), backward.begin() + k + 1, item) !=
+          backward.begin() + k + 1) {
+        neighbors.push_back(candidate);
+      }
+    }
+    return neighbors;
+  }
+
+  // The re-ranked distances, computed densely as the paper describes.
+  void Reference(bool cosine, int k1, int k2, float lambda,
+      vector<float>* reranked) {
+    const int n = num_queries_ + num_gallery_;
+    vector<float> all(queries_);
+    all.insert(all.end(), gallery_.begin(), gallery_.end());
+    vector<float> original(n * n);
+    ReIDDistances(&all[0], n, &all[0], n, dim_, cosine, &original[0]);
+    vector<vector<int> > ranks(n);
+    for (int i = 0; i < n; ++i) {
+      ReIDTopK(&original[i * n], n, n, &ranks[i]);
+    }
+    vector<vector<float> > V(n, vector<float>(n));
+    for (int i = 0; i < n; ++i) {
+      const vector<int> reciprocal = Reciprocal(ranks, i, k1);
+      vector<int> expanded(reciprocal);
+      for (int c = 0; c < reciprocal.size(); ++c) {
+        const vector<int> candidates =
+            Reciprocal(ranks, reciprocal[c], (k1 + 1) / 2);
+        int shared = 0;
+        for (int j = 0; j < candidates.size(); ++j) {
+          shared += std::count(reciprocal.begin(), reciprocal.end(),
+              candidates[j]);
+        }
+        if (shared > 2. / 3 * candidates.size()) {
+          expanded.insert(expanded.end(), candidates.begin(),
+              candidates.end());
+        }
+      }
+      std::sort(expanded.begin(), expanded.end());
+      expanded.erase(std::unique(expanded.begin(), expanded.end()),
+          expanded.end());
+      // Distances are scaled by the largest to the k1 + 1 nearest.
+      const float farthest = original[i * n + ranks[i][k1]];
+      float sum = 0;
+      for (int j = 0; j < expanded.size(); ++j) {
+        sum += std::exp(-original[i * n + expanded[j]] / farthest);
+      }
+      for (int j = 0; j < expanded.size(); ++j) {
+        V[i][expanded[j]] =
+            std::exp(-original[i * n + expanded[j]] / farthest) / sum;
+      }
+    }
+    vector<vector<float> > expanded_V(n, vector<float>(n));
+    for (int i = 0; i < n; ++i) {
+      for (int m = 0; m < k2; ++m) {
+        for (int j = 0; j < n; ++j) {
+          expanded_V[i][j] += V[ranks[i][m]][j] / k2;
+        }
+      }
+    }
+    reranked->resize(num_queries_ * num_gallery_);
+    for (int q = 0; q < num_queries_; ++q) {
+      for (int g = 0; g < num_gallery_; ++g) {
+        float minima = 0, maxima = 0;
+        for (int j = 0; j < n; ++j) {
+          minima += std::min(expanded_V[q][j],
+              expanded_V[num_queries_ + g][j]);
+          maxima += std::max(expanded_V[q][j],
+              expanded_V[num_queries_ + g][j]);
+        }
+        (*reranked)[q * num_gallery_ + g] = (1 - lambda) *
+            (1 - minima / maxima) +
+            lambda * original[q * n + num_queries_ + g];
+      }
+    }
+  }
+
+  int num_queries_;
+  int num_gallery_;
+  int dim_;
+  vector<float> queries_;
+  vector<float> gallery_;
+};
+
+TEST_F(ReIDRerankingTest, TestMatchesDenseReference) {
+  const bool metrics[] = {true, false};
+  for (int m = 0; m < 2; ++m) {
+    const bool cosine = metrics[m];
+    vector<float> expected;
+    Reference(cosine, 8, 3, 0.3, &expected);
+    ReIDReranker reranker(&queries_[0], num_queries_, &gallery_[0],
+        num_gallery_, dim_, cosine, 8, 3, 0.3);
+    reranker.FindNeighbors(NULL);
+    reranker.Encode(NULL);
+    vector<float> distances;
+    Distances(cosine, &distances);
+    for (int q = 0; q < num_queries_; ++q) {
+      reranker.Rerank(q, &distances[q * num_gallery_]);
+    }
+    for (int i = 0; i < distances.size(); ++i) {
+      EXPECT_NEAR(expected[i], distances[i], 1e-5) << "cosine " << cosine;
+    }
+  }
+}
+
+TEST_F(ReIDRerankingTest, TestEuclideanScale) {
+  // With lambda 0, only the encodings count: scaling the embeddings up, and
+  // the squared euclidean distances by 100, must not change them.
+  vector<float> queries(queries_), gallery(gallery_);
+  caffe_scal<float>(queries.size(), 10, &queries[0]);
+  caffe_scal<float>(gallery.size(), 10, &gallery[0]);
+  ReIDReranker reranker(&queries_[0], num_queries_, &gallery_[0],
+      num_gallery_, dim_, false, 8, 3, 0);
+  reranker.FindNeighbors(NULL);
+  reranker.Encode(NULL);
+  ReIDReranker scaled(&queries[0], num_queries_, &gallery[0], num_gallery_,
+      dim_, false, 8, 3, 0);
+  scaled.FindNeighbors(NULL);
+  scaled.Encode(NULL);
+  vector<float> expected, distances;
+  Distances(false, &expected);
+  Distances(false, &distances);
+  float jaccard = 0;
+  for (int q = 0; q < num_queries_; ++q) {
+    reranker.Rerank(q, &expected[q * num_gallery_]);
+    scaled.Rerank(q, &distances[q * num_gallery_]);
+  }
+  for (int i = 0; i < distances.size(); ++i) {
+    EXPECT_NEAR(expected[i], distances[i], 1e-5);
+    jaccard += expected[i];
+  }
+  // The encodings hold more than the items themselves: the Jaccard
+  // distances of matching queries and gallery items are below 1.
+  EXPECT_LT(jaccard, distances.size());
+}
+
+TEST_F(ReIDRerankingTest, TestThreads) {
+  ReIDReranker serial(&queries_[0], num_queries_, &gallery_[0],
+      num_gallery_, dim_, true);
+  serial.FindNeighbors(NULL);
+  serial.Encode(NULL);
+  ReIDReranker parallel(&queries_[0], num_queries_, &gallery_[0],
+      num_gallery_, dim_, true);
+  ThreadPool pool(3);
+  parallel.FindNeighbors(&pool);
+  parallel.Encode(&pool);
+  vector<float> expected, distances;
+  Distances(true, &expected);
+  Distances(true, &distances);
+  for (int q = 0; q < num_queries_; ++q) {
+    serial.Rerank(q, &expected[q * num_gallery_]);
+    parallel.Rerank(q, &distances[q * num_gallery_]);
+  }
+  for (int i = 0; i < distances.size(); ++i) {
+    EXPECT_EQ(expected[i], distances[i]);
+  }
+}
+
+TEST_F(ReIDRerankingTest, TestLambdaOne) {
+  ReIDReranker reranker(&queries_[0], num_queries_, &gallery_[0],
+      num_gallery_, dim_, false, 20, 6, 1);
+  reranker.FindNeighbors(NULL);
+  reranker.Encode(NULL);
+  vector<float> expected, distances;
+  Distances(false, &expected);
+  Distances(false, &distances);
+  for (int q = 0; q < num_queries_; ++q) {
+    reranker.Rerank(q, &distances[q * num_gallery_]);
+  }
+  for (int i = 0; i < distances.size(); ++i) {
+    EXPECT_FLOAT_EQ(expected[i], distances[i]);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,117 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/reid_search.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ReIDSearchTest : public ::testing::Test {
+ protected:
+  ReIDSearchTest()
+      : num_queries_(37), num_gallery_(101), dim_(8),
+        queries_(num_queries_ * dim_), gallery_(num_gallery_ * dim_) {
+    for (int i = 0; i < queries_.size(); ++i) {
+      queries_[i] = std::sin(0.7f * i + 1);
+    }
+    for (int i = 0; i < gallery_.size(); ++i) {
+      gallery_[i] = std::cos(1.3f * i);
+    }
+    // Duplicates, so that some distances tie.
+    for (int d = 0; d < dim_; ++d) {
+      gallery_[50 * dim_ + d] = gallery_[10 * dim_ + d];
+    }
+  }
+
+  // Checks results against ranking the full distance matrix.
+  void CheckResults(const vector<vector<ReIDMatch> >& results, bool cosine,
+      int k) {
+    vector<float> distances(num_queries_ * num_gallery_);
+    ReIDDistances(&queries_[0], num_queries_, &gallery_[0], num_gallery_,
+        dim_, cosine, &distances[0]);
+    ASSERT_EQ(num_queries_, results.size());
+    for (int i = 0; i < num_queries_; ++i) {
+      const float* row = &distances[i * num_gallery_];
+      vector<int> top;
+      ReIDTopK(row, num_gallery_, k, &top);
+      ASSERT_EQ(top.size(), results[i].size());
+      for (int r = 0; r < top.size(); ++r) {
+        EXPECT_EQ(top[r], results[i][r].index);
+        EXPECT_NEAR(row[top[r]], results[i][r].distance, 1e-5);
+      }
+    }
+  }
+
+  int num_queries_;
+  int num_gallery_;
+  int dim_;
+  vector<float> queries_;
+  vector<float> gallery_;
+};
+
+TEST_F(ReIDSearchTest, TestSearchCosine) {
+  ReIDSearch search(&gallery_[0], num_gallery_, dim_, true);
+  vector<vector<ReIDMatch> > results;
+  search.Search(&queries_[0], num_queries_, NULL, 5, &results, NULL);
+  CheckResults(results, true, 5);
+}
+
+TEST_F(ReIDSearchTest, TestSearchTiledEuclidean) {
+  ReIDSearch search(&gallery_[0], num_gallery_, dim_, false);
+  // Blocks and tiles that do not divide the queries and gallery.
+  search.set_block_size(4);
+  search.set_tile_size(16);
+  ThreadPool pool(3);
+  vector<vector<ReIDMatch> > results;
+  search.Search(&queries_[0], num_queries_, NULL, 7, &results, &pool);
+  CheckResults(results, false, 7);
+}
+
+TEST_F(ReIDSearchTest, TestSearchWholeGallery) {
+  ReIDSearch search(&gallery_[0], num_gallery_, dim_, true);
+  search.set_tile_size(10);
+  vector<vector<ReIDMatch> > results;
+  search.Search(&queries_[0], num_queries_, NULL, 1000, &results, NULL);
+  CheckResults(results, true, num_gallery_);
+}
+
+TEST_F(ReIDSearchTest, TestSearchExcludesCamera) {
+  vector<int> cameras(num_gallery_);
+  for (int j = 0; j < num_gallery_; ++j) {
+    cameras[j] = j % 3;
+  }
+  vector<int> query_cameras(num_queries_);
+  for (int i = 0; i < num_queries_; ++i) {
+    query_cameras[i] = i % 4 - 1;
+  }
+  ReIDSearch search(&gallery_[0], num_gallery_, dim_, true);
+  search.set_cameras(cameras);
+  search.set_tile_size(32);
+  vector<vector<ReIDMatch> > results;
+  search.Search(&queries_[0], num_queries_, &query_cameras[0], 1000,
+      &results, NULL);
+  for (int i = 0; i < num_queries_; ++i) {
+    const int camera = query_cameras[i];
+    int expected = 0;
+    for (int j = 0; j < num_gallery_; ++j) {
+      expected += camera < 0 || cameras[j] != camera;
+    }
+    ASSERT_EQ(expected, results[i].size());
+    for (int r = 0; r < results[i].size(); ++r) {
+      if (camera >= 0) {
+        EXPECT_NE(camera, cameras[results[i][r].index]);
+      }
+      if (r > 0) {
+        EXPECT_LE(results[i][r - 1].distance, results[i][r].distance);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -50,6 +50,37 @@ TEST_F(SyncedMemoryTest, TestAllocationGPU) {
 
 #endif
 
+TEST_F(SyncedMemoryTest, TestReleaseCPU) {
+  const size_t held = SyncedMemory::host_memory();
+  SyncedMemory::ResetPeakMemory();
+  SyncedMemory mem(10);
+  caffe_memset(mem.size(), 1, mem.mutable_cpu_data());
+  EXPECT_EQ(held + 10, SyncedMemory::host_memory());
+  mem.release();
+  EXPECT_EQ(mem.head(), SyncedMemory::UNINITIALIZED);
+  EXPECT_EQ(held, SyncedMemory::host_memory());
+  EXPECT_EQ(held + 10, SyncedMemory::peak_host_memory());
+  // Accessed again, the memory is allocated anew.
+  const void* cpu_data = mem.cpu_data();
+  EXPECT_TRUE(cpu_data);
+  EXPECT_EQ(held + 10, SyncedMemory::host_memory());
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ((static_cast<const char*>(cpu_data))[i], 0);
+  }
+}
+
+TEST_F(SyncedMemoryTest, TestReleaseNotOwned) {
+  const size_t held = SyncedMemory::host_memory();
+  char data[10];
+  SyncedMemory mem(10);
+  mem.set_cpu_data(data);
+  EXPECT_EQ(held, SyncedMemory::host_memory());
+  mem.release();
+  EXPECT_EQ(mem.head(), SyncedMemory::UNINITIALIZED);
+  EXPECT_NE(data, mem.cpu_data());
+  EXPECT_EQ(held + 10, SyncedMemory::host_memory());
+}
+
 TEST_F(SyncedMemoryTest, TestCPUWrite) {
   SyncedMemory mem(10);
   void* cpu_data = mem.mutable_cpu_data();
@@ -99,6 +130,16 @@ TEST_F(SyncedMemoryTest, TestGPURead) {
   delete[] recovered_value;
 }
 
+TEST_F(SyncedMemoryTest, TestReleaseGPU) {
+  const size_t held = SyncedMemory::device_memory();
+  SyncedMemory mem(10);
+  EXPECT_TRUE(mem.mutable_gpu_data());
+  EXPECT_EQ(held + 10, SyncedMemory::device_memory());
+  mem.release();
+  EXPECT_EQ(mem.head(), SyncedMemory::UNINITIALIZED);
+  EXPECT_EQ(held, SyncedMemory::device_memory());
+}
+
 TEST_F(SyncedMemoryTest, TestGPUWrite) {
   SyncedMemory mem(10);
   void* gpu_data = mem.mutable_gpu_data();
@@ -0,0 +1,60 @@
+#include <boost/bind.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ public:
+  void Count(int thread_id) {
+    ++calls_[thread_id];
+  }
+
+ protected:
+  vector<int> calls_;
+};
+
+TEST_F(ThreadPoolTest, TestRunCallsEachThreadOnce) {
+  const int num_threads = 4;
+  ThreadPool pool(num_threads);
+  EXPECT_EQ(num_threads, pool.num_threads());
+  calls_.assign(num_threads, 0);
+  for (int i = 0; i < 10; ++i) {
+    pool.Run(boost::bind(&ThreadPoolTest::Count, this, _1));
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    EXPECT_EQ(10, calls_[i]);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  ThreadPool pool(1);
+  calls_.assign(1, 0);
+  pool.Run(boost::bind(&ThreadPoolTest::Count, this, _1));
+  EXPECT_EQ(1, calls_[0]);
+}
+
+TEST_F(ThreadPoolTest, TestPartition) {
+  const int count = 10;
+  const int num_parts = 4;
+  int expected_begin = 0;
+  for (int part = 0; part < num_parts; ++part) {
+    int begin, end;
+    ThreadPool::Partition(count, num_parts, part, &begin, &end);
+    EXPECT_EQ(expected_begin, begin);
+    EXPECT_EQ(part < 2 ? 3 : 2, end - begin);
+    expected_begin = end;
+  }
+  EXPECT_EQ(count, expected_begin);
+  // More parts than items leaves the last parts empty.
+  int begin, end;
+  ThreadPool::Partition(2, 4, 3, &begin, &end);
+  EXPECT_EQ(begin, end);
+}
+
+}  // namespace caffe
@@ -0,0 +1,146 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/tracklet_aggregator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_embedding_util.hpp"
+
+namespace caffe {
+
+class TrackletAggregatorTest : public ::testing::Test {
+ protected:
+  TrackletAggregatorTest() : dim_(8), people_(4, dim_) {}
+
+  // A frame of a tracklet: a direction for the person, jittered.
+  vector<float> Frame(int person, float jitter) const {
+    return people_.Sample(person, jitter);
+  }
+
+  const int dim_;
+  const ClusteredEmbeddings people_;
+};
+
+TEST_F(TrackletAggregatorTest, TestWeightedMean) {
+  TrackletAggregator aggregator(dim_, false);
+  vector<float> expected(dim_);
+  float total = 0;
+  for (int f = 0; f < 5; ++f) {
+    // Two tracklets interleaved, so that they must be kept apart.
+    const vector<float> frame = Frame(0, 0.5);
+    const float quality = 0.5f + f;
+    EXPECT_TRUE(aggregator.Offer(7));
+    aggregator.Add(7, &frame[0], quality);
+    EXPECT_TRUE(aggregator.Offer(-3));
+    aggregator.Add(-3, &Frame(1, 0.5)[0]);
+    for (int d = 0; d < dim_; ++d) {
+      expected[d] += quality * frame[d];
+    }
+    total += quality;
+  }
+  EXPECT_EQ(2, aggregator.num_tracklets());
+  EXPECT_EQ(5, aggregator.num_embedded(7));
+  EXPECT_FALSE(aggregator.stable(7));
+  vector<float> descriptor(dim_);
+  aggregator.Finish(7, &descriptor[0]);
+  for (int d = 0; d < dim_; ++d) {
+    EXPECT_NEAR(expected[d] / total, descriptor[d], 1e-5);
+  }
+  EXPECT_FALSE(aggregator.Contains(7));
+  EXPECT_TRUE(aggregator.Contains(-3));
+  EXPECT_EQ(1, aggregator.num_tracklets());
+}
+
+TEST_F(TrackletAggregatorTest, TestNormalized) {
+  TrackletAggregator aggregator(dim_);
+  // Scaling a frame must not change its weight.
+  vector<float> a = Frame(0, 0);
+  vector<float> b = Frame(1, 0);
+  vector<float> scaled_b(b);
+  for (int d = 0; d < dim_; ++d) {
+    scaled_b[d] *= 10;
+  }
+  aggregator.Add(0, &a[0]);
+  aggregator.Add(0, &scaled_b[0]);
+  aggregator.Add(1, &a[0]);
+  aggregator.Add(1, &b[0]);
+  vector<float> first(dim_), second(dim_);
+  aggregator.Descriptor(0, &first[0]);
+  aggregator.Descriptor(1, &second[0]);
+  float norm = 0;
+  for (int d = 0; d < dim_; ++d) {
+    EXPECT_NEAR(second[d], first[d], 1e-5);
+    norm += first[d] * first[d];
+  }
+  EXPECT_NEAR(1, norm, 1e-5);
+}
+
+TEST_F(TrackletAggregatorTest, TestDefaultsEmbedEveryFrame) {
+  TrackletAggregator aggregator(dim_);
+  // Identical frames do not turn the descriptor, up to rounding.
+  const vector<float> frame = Frame(0, 0);
+  for (int f = 0; f < 50; ++f) {
+    EXPECT_TRUE(aggregator.Offer(0));
+    aggregator.Add(0, &frame[0]);
+  }
+  EXPECT_FALSE(aggregator.stable(0));
+  EXPECT_EQ(50, aggregator.num_embedded(0));
+}
+
+TEST_F(TrackletAggregatorTest, TestEarlyStop) {
+  TrackletAggregator aggregator(dim_);
+  aggregator.set_tolerance(1e-3);
+  aggregator.set_max_stride(4);
+  aggregator.set_patience(3);
+  aggregator.set_min_frames(4);
+  TrackletAggregator reference(dim_);
+  const int num_frames = 200;
+  for (int f = 0; f < num_frames; ++f) {
+    const vector<float> frame = Frame(2, 0.2);
+    if (aggregator.Offer(0)) {
+      aggregator.Add(0, &frame[0]);
+    }
+    reference.Add(0, &frame[0]);
+  }
+  EXPECT_TRUE(aggregator.stable(0));
+  EXPECT_FALSE(aggregator.Offer(0));
+  EXPECT_EQ(num_frames + 1, aggregator.num_offered(0));
+  EXPECT_GE(aggregator.num_embedded(0), 4);
+  EXPECT_LT(aggregator.num_embedded(0), num_frames / 4);
+  // The descriptor of the frames embedded is close to that of all.
+  vector<float> descriptor(dim_), expected(dim_);
+  aggregator.Descriptor(0, &descriptor[0]);
+  reference.Descriptor(0, &expected[0]);
+  float cosine = 0;
+  for (int d = 0; d < dim_; ++d) {
+    cosine += descriptor[d] * expected[d];
+  }
+  EXPECT_GT(cosine, 0.99);
+}
+
+TEST_F(TrackletAggregatorTest, TestStrideResets) {
+  TrackletAggregator aggregator(dim_);
+  aggregator.set_tolerance(1e-3);
+  aggregator.set_max_stride(8);
+  aggregator.set_patience(1000);
+  // Identical frames leave the descriptor still, so frames are skipped
+  // more and more.
+  const vector<float> frame = Frame(0, 0);
+  int embedded = 0;
+  for (int f = 0; f < 64; ++f) {
+    if (aggregator.Offer(0)) {
+      aggregator.Add(0, &frame[0]);
+      ++embedded;
+    }
+  }
+  EXPECT_LT(embedded, 16);
+  // A frame of someone else turns it, and every next frame is embedded.
+  const vector<float> other = Frame(3, 0);
+  aggregator.Add(0, &other[0]);
+  EXPECT_TRUE(aggregator.Offer(0));
+  EXPECT_FALSE(aggregator.stable(0));
+}
+
+}  // namespace caffe
@@ -0,0 +1,237 @@
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/ann_index_hnsw.hpp"
+#include "caffe/util/ann_index_ivf.hpp"
+#include "caffe/util/ann_index_pq.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+struct ANNIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  char type[8];
+  uint32_t dim;
+  uint32_t cosine;
+  uint64_t size;
+};
+
+}  // namespace
+
+ANNIndex::ANNIndex(int dim, bool cosine)
+    : dim_(dim), cosine_(cosine), size_(0) {
+  CHECK_GT(dim, 0);
+}
+
+void ANNIndex::Add(const float* embeddings, int num) {
+  if (num <= 0) {
+    return;
+  }
+  if (cosine_) {
+    vector<float> normalized(embeddings,
+        embeddings + static_cast<size_t>(num) * dim_);
+    Normalize(&normalized[0], num, dim_);
+    AddEmbeddings(&normalized[0], num);
+  } else {
+    AddEmbeddings(embeddings, num);
+  }
+  size_ += num;
+}
+
+void ANNIndex::Build(const float* embeddings, int num) {
+  if (cosine_) {
+    vector<float> normalized(embeddings,
+        embeddings + static_cast<size_t>(num) * dim_);
+    Normalize(&normalized[0], num, dim_);
+    Train(&normalized[0], num);
+  } else {
+    Train(embeddings, num);
+  }
+  Add(embeddings, num);
+}
+
+void ANNIndex::Search(const float* query, int k,
+    vector<ReIDMatch>* matches) const {
+  CHECK_GT(k, 0);
+  matches->clear();
+  if (size_ == 0) {
+    return;
+  }
+  if (cosine_) {
+    vector<float> normalized(query, query + dim_);
+    Normalize(&normalized[0], 1, dim_);
+    SearchEmbedding(&normalized[0], k, matches);
+    // |q - g|^2 = 2 - 2 cos(q, g) for unit q and g.
+    for (int i = 0; i < matches->size(); ++i) {
+      (*matches)[i].distance /= 2;
+    }
+  } else {
+    SearchEmbedding(query, k, matches);
+  }
+}
+
+void ANNIndex::Search(const float* queries, int num, int k,
+    vector<vector<ReIDMatch> >* results, ThreadPool* pool) const {
+  results->resize(num);
+  if (pool) {
+    pool->Run(boost::bind(&ANNIndex::SearchPart, this, queries, num, k,
+        results, _1, pool->num_threads()));
+  } else {
+    SearchPart(queries, num, k, results, 0, 1);
+  }
+}
+
+void ANNIndex::SearchPart(const float* queries, int num, int k,
+    vector<vector<ReIDMatch> >* results, int part, int num_parts) const {
+  int begin, end;
+  ThreadPool::Partition(num, num_parts, part, &begin, &end);
+  for (int i = begin; i < end; ++i) {
+    Search(queries + static_cast<size_t>(i) * dim_, k, &(*results)[i]);
+  }
+}
+
+void ANNIndex::Normalize(float* embeddings, int num, int dim) {
+  for (int i = 0; i < num; ++i) {
+    float* embedding = embeddings + static_cast<size_t>(i) * dim;
+    const float norm = std::sqrt(caffe_cpu_dot(dim, embedding, embedding));
+    if (norm > 0) {
+      caffe_scal(dim, 1 / norm, embedding);
+    }
+  }
+}
+
+float ANNIndex::SquaredDistance(const float* a, const float* b, int dim) {
+  float distance = 0;
+  for (int d = 0; d < dim; ++d) {
+    const float difference = a[d] - b[d];
+    distance += difference * difference;
+  }
+  return distance;
+}
+
+void ANNIndex::WriteOrDie(FILE* file, const void* data, size_t size) {
+  CHECK_EQ(fwrite(data, 1, size, file), size) << "Cannot write index: "
+      << strerror(errno);
+}
+
+void ANNIndex::ReadOrDie(FILE* file, void* data, size_t size) {
+  CHECK_EQ(fread(data, 1, size, file), size) << "Index is truncated.";
+}
+
+void ANNIndex::Save(const string& path) const {
+  FILE* file = fopen(path.c_str(), "wb");
+  CHECK(file) << "Cannot create " << path << ": " << strerror(errno);
+  ANNIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMagic;
+  header.version = kVersion;
+  strncpy(header.type, type(), sizeof(header.type) - 1);
+  header.dim = dim_;
+  header.cosine = cosine_;
+  header.size = size_;
+  WriteOrDie(file, &header, sizeof(header));
+  Write(file);
+  CHECK_EQ(fclose(file), 0) << "Cannot write " << path << ": "
+      << strerror(errno);
+}
+
+void KMeans(const float* embeddings, int num, int dim, int k, int iterations,
+    int max_samples, vector<float>* centroids) {
+  CHECK_GT(k, 0);
+  CHECK_GE(num, k) << "Fewer embeddings than clusters.";
+  rng_t rng(100);
+  vector<int> order(num);
+  for (int i = 0; i < num; ++i) {
+    order[i] = i;
+  }
+  shuffle(order.begin(), order.end(), &rng);
+  order.resize(std::max(k, std::min(num, max_samples)));
+  const int num_samples = order.size();
+  vector<float> samples(static_cast<size_t>(num_samples) * dim);
+  for (int i = 0; i < num_samples; ++i) {
+    std::copy(embeddings + static_cast<size_t>(order[i]) * dim,
+        embeddings + static_cast<size_t>(order[i] + 1) * dim,
+        &samples[static_cast<size_t>(i) * dim]);
+  }
+  centroids->assign(samples.begin(),
+      samples.begin() + static_cast<size_t>(k) * dim);
+  vector<int> nearest;
+  vector<int> counts(k);
+  for (int iteration = 0; iteration < iterations; ++iteration) {
+    NearestCentroids(&(*centroids)[0], k, &samples[0], num_samples, dim,
+        &nearest);
+    std::fill(centroids->begin(), centroids->end(), 0);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (int i = 0; i < num_samples; ++i) {
+      caffe_axpy<float>(dim, 1, &samples[static_cast<size_t>(i) * dim],
+          &(*centroids)[static_cast<size_t>(nearest[i]) * dim]);
+      ++counts[nearest[i]];
+    }
+    for (int c = 0; c < k; ++c) {
+      float* centroid = &(*centroids)[static_cast<size_t>(c) * dim];
+      if (counts[c] == 0) {
+        // Restart an empty cluster from a random sample.
+        const float* sample =
+            &samples[static_cast<size_t>(rng() % num_samples) * dim];
+        std::copy(sample, sample + dim, centroid);
+      } else {
+        caffe_scal<float>(dim, 1.f / counts[c], centroid);
+      }
+    }
+  }
+}
+
+void NearestCentroids(const float* centroids, int num_centroids,
+    const float* embeddings, int num, int dim, vector<int>* nearest) {
+  ReIDSearch search(centroids, num_centroids, dim, false);
+  vector<vector<ReIDMatch> > matches;
+  search.Search(embeddings, num, NULL, 1, &matches, NULL);
+  nearest->resize(num);
+  for (int i = 0; i < num; ++i) {
+    (*nearest)[i] = matches[i][0].index;
+  }
+}
+
+ANNIndex* GetANNIndex(const string& type, int dim, bool cosine) {
+  if (type == "hnsw") {
+    return new HNSWIndex(dim, cosine);
+  }
+  if (type == "ivf") {
+    return new IVFIndex(dim, cosine);
+  }
+  if (type == "pq") {
+    return new PQIndex(dim, cosine);
+  }
+  LOG(FATAL) << "Unknown index type " << type;
+  return NULL;
+}
+
+ANNIndex* LoadANNIndex(const string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  CHECK(file) << "File not found: " << path;
+  ANNIndexHeader header;
+  ANNIndex::ReadOrDie(file, &header, sizeof(header));
+  CHECK_EQ(header.magic, ANNIndex::kMagic) << path << " is not an index.";
+  CHECK_EQ(header.version, ANNIndex::kVersion)
+      << "Unsupported index version in " << path;
+  header.type[sizeof(header.type) - 1] = '\0';
+  ANNIndex* index = GetANNIndex(header.type, header.dim, header.cosine);
+  index->Read(file);
+  index->size_ = header.size;
+  fclose(file);
+  return index;
+}
+
+}  // namespace caffe
@@ -0,0 +1,261 @@
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/ann_index_hnsw.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The nodes a search has visited: those tagged with the search's epoch, so
+// that a new search only bumps the epoch instead of clearing a list as long
+// as the index. Searches run concurrently, so each thread has its own.
+class VisitedList {
+ public:
+  VisitedList() : epoch_(0) {}
+
+  // Starts a search of an index of num_nodes nodes.
+  void Reset(int num_nodes) {
+    if (tags_.size() < static_cast<size_t>(num_nodes)) {
+      tags_.resize(num_nodes, 0);
+    }
+    if (++epoch_ == 0) {
+      std::fill(tags_.begin(), tags_.end(), 0);
+      epoch_ = 1;
+    }
+  }
+  // Marks node visited, and returns whether it already was.
+  inline bool Visit(int node) {
+    if (tags_[node] == epoch_) {
+      return true;
+    }
+    tags_[node] = epoch_;
+    return false;
+  }
+
+ private:
+  vector<unsigned int> tags_;
+  unsigned int epoch_;
+};
+
+boost::thread_specific_ptr<VisitedList> visited_list_;
+
+}  // namespace
+
+HNSWIndex::HNSWIndex(int dim, bool cosine, int M, int ef_construction)
+    : ANNIndex(dim, cosine), M_(M), ef_construction_(ef_construction),
+      ef_search_(64), level_scale_(1 / std::log(static_cast<double>(M))),
+      rng_(100), entry_point_(-1), max_level_(-1) {
+  CHECK_GT(M, 1);
+  CHECK_GT(ef_construction, 0);
+}
+
+void HNSWIndex::set_effort(int effort) {
+  CHECK_GT(effort, 0);
+  ef_search_ = effort;
+}
+
+void HNSWIndex::AddEmbeddings(const float* embeddings, int num) {
+  const int first = levels_.size();
+  data_.insert(data_.end(), embeddings,
+      embeddings + static_cast<size_t>(num) * dim_);
+  boost::uniform_real<double> uniform(0, 1);
+  boost::variate_generator<rng_t&, boost::uniform_real<double> >
+      random(rng_, uniform);
+  for (int node = first; node < first + num; ++node) {
+    // Level l holds a fraction M^-l of the nodes.
+    const int level =
+        static_cast<int>(-std::log(1 - random()) * level_scale_);
+    levels_.push_back(level);
+    links_.push_back(vector<vector<int> >(level + 1));
+    Insert(node);
+  }
+}
+
+void HNSWIndex::Descend(const float* query, int level, int* node,
+    float* distance) const {
+  bool moved = true;
+  while (moved) {
+    moved = false;
+    const vector<int>& neighbors = links_[*node][level];
+    for (int i = 0; i < neighbors.size(); ++i) {
+      const float d = SquaredDistance(query, embedding(neighbors[i]), dim_);
+      if (d < *distance) {
+        *distance = d;
+        *node = neighbors[i];
+        moved = true;
+      }
+    }
+  }
+}
+
+void HNSWIndex::SearchLevel(const float* query, const Candidate& entry,
+    int ef, int level, vector<Candidate>* nearest) const {
+  // Candidates to expand, nearest on top, and the ef nearest found, farthest
+  // on top.
+  std::priority_queue<Candidate, vector<Candidate>,
+      std::greater<Candidate> > candidates;
+  std::priority_queue<Candidate> found;
+  if (!visited_list_.get()) {
+    visited_list_.reset(new VisitedList());
+  }
+  VisitedList& visited = *visited_list_;
+  visited.Reset(levels_.size());
+  candidates.push(entry);
+  found.push(entry);
+  visited.Visit(entry.second);
+  while (!candidates.empty()) {
+    const Candidate current = candidates.top();
+    if (current.first > found.top().first && found.size() >= ef) {
+      break;
+    }
+    candidates.pop();
+    const vector<int>& neighbors = links_[current.second][level];
+    for (int i = 0; i < neighbors.size(); ++i) {
+      if (visited.Visit(neighbors[i])) {
+        continue;
+      }
+      const float d = SquaredDistance(query, embedding(neighbors[i]), dim_);
+      if (found.size() < ef || d < found.top().first) {
+        candidates.push(Candidate(d, neighbors[i]));
+        found.push(Candidate(d, neighbors[i]));
+        if (found.size() > ef) {
+          found.pop();
+        }
+      }
+    }
+  }
+  nearest->resize(found.size());
+  for (int i = found.size() - 1; i >= 0; --i) {
+    (*nearest)[i] = found.top();
+    found.pop();
+  }
+}
+
+void HNSWIndex::SelectNeighbors(const vector<Candidate>& candidates,
+    int max_links, vector<int>* neighbors) const {
+  neighbors->clear();
+  for (int i = 0; i < candidates.size() && neighbors->size() < max_links;
+       ++i) {
+    const float* candidate = embedding(candidates[i].second);
+    bool diverse = true;
+    for (int j = 0; j < neighbors->size() && diverse; ++j) {
+      diverse = SquaredDistance(candidate, embedding((*neighbors)[j]), dim_)
+          >= candidates[i].first;
+    }
+    if (diverse) {
+      neighbors->push_back(candidates[i].second);
+    }
+  }
+}
+
+void HNSWIndex::Link(int node, int level, const vector<int>& neighbors) {
+  links_[node][level] = neighbors;
+  for (int i = 0; i < neighbors.size(); ++i) {
+    vector<int>& links = links_[neighbors[i]][level];
+    links.push_back(node);
+    if (links.size() > max_links(level)) {
+      // Prune the neighbor's links as if it had just been inserted.
+      const float* center = embedding(neighbors[i]);
+      vector<Candidate> candidates(links.size());
+      for (int j = 0; j < links.size(); ++j) {
+        candidates[j] = Candidate(
+            SquaredDistance(center, embedding(links[j]), dim_), links[j]);
+      }
+      std::sort(candidates.begin(), candidates.end());
+      SelectNeighbors(candidates, max_links(level), &links);
+    }
+  }
+}
+
+void HNSWIndex::Insert(int node) {
+  const int level = levels_[node];
+  if (entry_point_ < 0) {
+    entry_point_ = node;
+    max_level_ = level;
+    return;
+  }
+  const float* query = embedding(node);
+  int nearest = entry_point_;
+  float distance = SquaredDistance(query, embedding(nearest), dim_);
+  for (int l = max_level_; l > level; --l) {
+    Descend(query, l, &nearest, &distance);
+  }
+  vector<Candidate> candidates;
+  vector<int> neighbors;
+  for (int l = std::min(level, max_level_); l >= 0; --l) {
+    SearchLevel(query, Candidate(distance, nearest), ef_construction_, l,
+        &candidates);
+    SelectNeighbors(candidates, M_, &neighbors);
+    Link(node, l, neighbors);
+    distance = candidates[0].first;
+    nearest = candidates[0].second;
+  }
+  if (level > max_level_) {
+    entry_point_ = node;
+    max_level_ = level;
+  }
+}
+
+void HNSWIndex::SearchEmbedding(const float* query, int k,
+    vector<ReIDMatch>* matches) const {
+  int nearest = entry_point_;
+  float distance = SquaredDistance(query, embedding(nearest), dim_);
+  for (int l = max_level_; l > 0; --l) {
+    Descend(query, l, &nearest, &distance);
+  }
+  vector<Candidate> candidates;
+  SearchLevel(query, Candidate(distance, nearest), std::max(ef_search_, k),
+      0, &candidates);
+  // The heap breaks distance ties by index, as ReIDSearch does.
+  const int count = std::min<int>(k, candidates.size());
+  matches->resize(count);
+  for (int i = 0; i < count; ++i) {
+    (*matches)[i].index = candidates[i].second;
+    (*matches)[i].distance = candidates[i].first;
+  }
+}
+
+void HNSWIndex::Write(FILE* file) const {
+  const int32_t settings[] = {M_, ef_construction_, ef_search_, entry_point_,
+      max_level_};
+  WriteOrDie(file, settings, sizeof(settings));
+  WriteVector(file, data_);
+  WriteVector(file, levels_);
+  for (int node = 0; node < links_.size(); ++node) {
+    for (int level = 0; level < links_[node].size(); ++level) {
+      WriteVector(file, links_[node][level]);
+    }
+  }
+}
+
+void HNSWIndex::Read(FILE* file) {
+  int32_t settings[5];
+  ReadOrDie(file, settings, sizeof(settings));
+  M_ = settings[0];
+  ef_construction_ = settings[1];
+  ef_search_ = settings[2];
+  entry_point_ = settings[3];
+  max_level_ = settings[4];
+  level_scale_ = 1 / std::log(static_cast<double>(M_));
+  ReadVector(file, &data_);
+  ReadVector(file, &levels_);
+  CHECK_EQ(data_.size(), levels_.size() * dim_) << "Corrupt HNSW index.";
+  links_.resize(levels_.size());
+  for (int node = 0; node < links_.size(); ++node) {
+    links_[node].resize(levels_[node] + 1);
+    for (int level = 0; level <= levels_[node]; ++level) {
+      ReadVector(file, &links_[node][level]);
+    }
+  }
+}
+
+}  // namespace caffe
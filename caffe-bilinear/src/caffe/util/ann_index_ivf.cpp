@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/ann_index_ivf.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+
+namespace caffe {
+
+IVFIndex::IVFIndex(int dim, bool cosine, int num_lists)
+    : ANNIndex(dim, cosine), max_lists_(num_lists), num_probes_(8),
+      train_iterations_(10) {
+  CHECK_GT(num_lists, 0);
+}
+
+void IVFIndex::set_effort(int effort) {
+  CHECK_GT(effort, 0);
+  num_probes_ = effort;
+}
+
+void IVFIndex::Train(const float* embeddings, int num) {
+  CHECK_EQ(size_, 0) << "Train the IVF index before adding to it.";
+  CHECK_GT(num, 0);
+  const int num_lists = std::min(max_lists_, num);
+  KMeans(embeddings, num, dim_, num_lists, train_iterations_,
+      256 * num_lists, &centroids_);
+  ids_.assign(num_lists, vector<int>());
+  data_.assign(num_lists, vector<float>());
+}
+
+void IVFIndex::AddEmbeddings(const float* embeddings, int num) {
+  CHECK(centroids_.size()) << "Train the IVF index before adding to it.";
+  vector<int> lists;
+  NearestCentroids(&centroids_[0], num_lists(), embeddings, num, dim_,
+      &lists);
+  for (int i = 0; i < num; ++i) {
+    const float* embedding = embeddings + static_cast<size_t>(i) * dim_;
+    ids_[lists[i]].push_back(size_ + i);
+    data_[lists[i]].insert(data_[lists[i]].end(), embedding,
+        embedding + dim_);
+  }
+}
+
+void IVFIndex::SearchEmbedding(const float* query, int k,
+    vector<ReIDMatch>* matches) const {
+  const int lists = num_lists();
+  vector<float> distances(lists);
+  for (int c = 0; c < lists; ++c) {
+    distances[c] = SquaredDistance(query,
+        &centroids_[static_cast<size_t>(c) * dim_], dim_);
+  }
+  vector<int> probes;
+  ReIDTopK(&distances[0], lists, num_probes_, &probes);
+  vector<std::pair<float, int> > nearest;
+  for (int p = 0; p < probes.size(); ++p) {
+    const vector<int>& ids = ids_[probes[p]];
+    const float* data = ids.empty() ? NULL : &data_[probes[p]][0];
+    for (int i = 0; i < ids.size(); ++i) {
+      const std::pair<float, int> candidate(SquaredDistance(query,
+          data + static_cast<size_t>(i) * dim_, dim_), ids[i]);
+      // Keep the k nearest in a max-heap.
+      if (nearest.size() < k) {
+        nearest.push_back(candidate);
+        std::push_heap(nearest.begin(), nearest.end());
+      } else if (candidate < nearest.front()) {
+        std::pop_heap(nearest.begin(), nearest.end());
+        nearest.back() = candidate;
+        std::push_heap(nearest.begin(), nearest.end());
+      }
+    }
+  }
+  std::sort_heap(nearest.begin(), nearest.end());
+  matches->resize(nearest.size());
+  for (int i = 0; i < nearest.size(); ++i) {
+    (*matches)[i].index = nearest[i].second;
+    (*matches)[i].distance = nearest[i].first;
+  }
+}
+
+void IVFIndex::Write(FILE* file) const {
+  const int32_t settings[] = {max_lists_, num_probes_, train_iterations_};
+  WriteOrDie(file, settings, sizeof(settings));
+  WriteVector(file, centroids_);
+  for (int c = 0; c < ids_.size(); ++c) {
+    WriteVector(file, ids_[c]);
+    WriteVector(file, data_[c]);
+  }
+}
+
+void IVFIndex::Read(FILE* file) {
+  int32_t settings[3];
+  ReadOrDie(file, settings, sizeof(settings));
+  max_lists_ = settings[0];
+  num_probes_ = settings[1];
+  train_iterations_ = settings[2];
+  ReadVector(file, &centroids_);
+  CHECK_EQ(centroids_.size() % dim_, 0) << "Corrupt IVF index.";
+  ids_.resize(num_lists());
+  data_.resize(num_lists());
+  for (int c = 0; c < ids_.size(); ++c) {
+    ReadVector(file, &ids_[c]);
+    ReadVector(file, &data_[c]);
+  }
+}
+
+}  // namespace caffe
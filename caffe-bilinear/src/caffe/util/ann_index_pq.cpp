@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/ann_index_pq.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+
+namespace caffe {
+
+PQIndex::PQIndex(int dim, bool cosine, int num_subspaces)
+    : ANNIndex(dim, cosine), quantizer_(dim, std::min(dim, num_subspaces)),
+      rerank_(100), train_iterations_(10), exact_(NULL) {
+}
+
+void PQIndex::set_effort(int effort) {
+  CHECK_GT(effort, 0);
+  rerank_ = effort;
+}
+
+void PQIndex::Train(const float* embeddings, int num) {
+  CHECK_EQ(size_, 0) << "Train the PQ index before adding to it.";
+  quantizer_.Train(embeddings, num, train_iterations_);
+}
+
+void PQIndex::AddEmbeddings(const float* embeddings, int num) {
+  CHECK(quantizer_.trained()) << "Train the PQ index before adding to it.";
+  const size_t first = codes_.size();
+  codes_.resize(first + static_cast<size_t>(num) * quantizer_.code_size());
+  quantizer_.Encode(embeddings, num, &codes_[first]);
+}
+
+float PQIndex::ExactDistance(const float* query, int i) const {
+  const float* embedding = exact_ + static_cast<size_t>(i) * dim_;
+  if (!cosine_) {
+    return SquaredDistance(query, embedding, dim_);
+  }
+  // The lent embeddings are not normalized.
+  const float query_norm2 = caffe_cpu_dot(dim_, query, query);
+  const float norm2 = caffe_cpu_dot(dim_, embedding, embedding);
+  if (norm2 == 0) {
+    return query_norm2;
+  }
+  const float dot = caffe_cpu_dot(dim_, query, embedding);
+  return std::max(0.f, query_norm2 + 1 - 2 * dot / std::sqrt(norm2));
+}
+
+void PQIndex::SquaredDistances(const float* query, int num_exact,
+    vector<float>* distances, vector<int>* nearest) const {
+  vector<float> table(quantizer_.table_size());
+  quantizer_.ComputeTable(query, &table[0]);
+  distances->resize(size_);
+  quantizer_.Distances(&table[0], &codes_[0], size_, &(*distances)[0]);
+  nearest->clear();
+  if (num_exact > 0) {
+    ReIDTopK(&(*distances)[0], size_, num_exact, nearest);
+  }
+  if (exact_) {
+    for (int i = 0; i < nearest->size(); ++i) {
+      (*distances)[(*nearest)[i]] = ExactDistance(query, (*nearest)[i]);
+    }
+  }
+}
+
+void PQIndex::SearchEmbedding(const float* query, int k,
+    vector<ReIDMatch>* matches) const {
+  vector<float> distances;
+  vector<int> nearest;
+  SquaredDistances(query, exact_ ? std::max(k, rerank_) : k, &distances,
+      &nearest);
+  vector<std::pair<float, int> > ranked(nearest.size());
+  for (int i = 0; i < nearest.size(); ++i) {
+    ranked[i] = std::make_pair(distances[nearest[i]], nearest[i]);
+  }
+  const int count = std::min<int>(k, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+  matches->resize(count);
+  for (int i = 0; i < count; ++i) {
+    (*matches)[i].index = ranked[i].second;
+    (*matches)[i].distance = ranked[i].first;
+  }
+}
+
+void PQIndex::Distances(const float* query, float* distances) const {
+  if (size_ == 0) {
+    return;
+  }
+  vector<float> normalized(query, query + dim_);
+  if (cosine_) {
+    Normalize(&normalized[0], 1, dim_);
+  }
+  vector<float> squared;
+  vector<int> nearest;
+  SquaredDistances(&normalized[0], exact_ ? rerank_ : 0, &squared,
+      &nearest);
+  if (exact_ && nearest.size() < size_) {
+    // Exact distances and estimates do not compare: shift the estimates of
+    // the rest, all at least that of the last candidate, behind the
+    // candidates.
+    vector<bool> candidate(size_);
+    float farthest = 0;
+    for (int i = 0; i < nearest.size(); ++i) {
+      candidate[nearest[i]] = true;
+      farthest = std::max(farthest, squared[nearest[i]]);
+    }
+    float last_estimate = std::numeric_limits<float>::max();
+    for (int i = 0; i < size_; ++i) {
+      if (!candidate[i]) {
+        last_estimate = std::min(last_estimate, squared[i]);
+      }
+    }
+    const float shift = std::max(0.f, farthest - last_estimate);
+    for (int i = 0; i < size_; ++i) {
+      if (!candidate[i]) {
+        squared[i] += shift;
+      }
+    }
+  }
+  const float scale = cosine_ ? 0.5f : 1.f;
+  for (int i = 0; i < size_; ++i) {
+    distances[i] = squared[i] * scale;
+  }
+}
+
+void PQIndex::Write(FILE* file) const {
+  const int32_t settings[] = {quantizer_.num_subspaces(), rerank_,
+      train_iterations_};
+  WriteOrDie(file, settings, sizeof(settings));
+  WriteVector(file, quantizer_.centroids());
+  WriteVector(file, codes_);
+}
+
+void PQIndex::Read(FILE* file) {
+  int32_t settings[3];
+  ReadOrDie(file, settings, sizeof(settings));
+  CHECK(settings[0] > 0 && settings[0] <= dim_) << "Corrupt PQ index.";
+  quantizer_ = ProductQuantizer(dim_, settings[0]);
+  rerank_ = settings[1];
+  train_iterations_ = settings[2];
+  vector<float> centroids;
+  ReadVector(file, &centroids);
+  quantizer_.set_centroids(centroids);
+  ReadVector(file, &codes_);
+  CHECK_EQ(codes_.size() % quantizer_.code_size(), 0) << "Corrupt PQ index.";
+}
+
+}  // namespace caffe
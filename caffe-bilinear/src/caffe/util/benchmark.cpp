@@ -1,5 +1,11 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
 #include "caffe/common.hpp"
 #include "caffe/util/benchmark.hpp"
 
@@ -166,4 +172,73 @@ float CPUTimer::MicroSeconds() {
   return this->elapsed_microseconds_;
 }
 
+LatencyHistogram::LatencyHistogram()
+    : buckets_(kNumBuckets, 0), count_(0), sum_(0), max_(0) {
+}
+
+int LatencyHistogram::Bucket(double microseconds) {
+  if (microseconds < 1) {
+    return 0;
+  }
+  const int bucket =
+      static_cast<int>(std::log2(microseconds) * kBucketsPerOctave) + 1;
+  return std::min(bucket, kNumBuckets - 1);
+}
+
+double LatencyHistogram::BucketUpperBound(int bucket) {
+  return std::pow(2., static_cast<double>(bucket) / kBucketsPerOctave);
+}
+
+void LatencyHistogram::Add(double microseconds) {
+  ++buckets_[Bucket(microseconds)];
+  ++count_;
+  sum_ += microseconds;
+  max_ = std::max(max_, microseconds);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int i = 0; i < kNumBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::Clear() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+}
+
+double LatencyHistogram::Percentile(double p) const {
+  CHECK_GE(p, 0);
+  CHECK_LE(p, 100);
+  if (count_ == 0) {
+    return 0;
+  }
+  const double rank = p / 100. * count_;
+  size_t seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen > 0 && seen >= rank) {
+      return std::min(BucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+std::string LatencyHistogram::Summary() const {
+  std::ostringstream summary;
+  summary << std::fixed << std::setprecision(3)
+      << "n=" << count_
+      << " mean=" << mean() / 1000 << "ms"
+      << " p50=" << Percentile(50) / 1000 << "ms"
+      << " p90=" << Percentile(90) / 1000 << "ms"
+      << " p99=" << Percentile(99) / 1000 << "ms"
+      << " max=" << max_ / 1000 << "ms";
+  return summary.str();
+}
+
 }  // namespace caffe
@@ -0,0 +1,197 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/embedding_cache.hpp"
+#include "caffe/util/embedding_store.hpp"
+
+namespace caffe {
+
+namespace {
+
+inline uint64_t Rotate(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// The 64-bit finalizer of MurmurHash3.
+inline uint64_t Mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+string KeyName(uint64_t key) {
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx",
+      static_cast<unsigned long long>(key));  // NOLINT(runtime/int)
+  return name;
+}
+
+// The name of the leading entry of a saved cache.
+string ModelName(uint64_t model) {
+  return "model_" + KeyName(model);
+}
+
+}  // namespace
+
+double EmbeddingCache::Stats::hit_rate() const {
+  const uint64_t lookups = hits + misses;
+  return lookups ? static_cast<double>(hits) / lookups : 0;
+}
+
+string EmbeddingCache::Stats::Summary() const {
+  std::ostringstream summary;
+  summary << hits << "/" << hits + misses << " hits ("
+      << 100 * hit_rate() << "%), " << size << " cached, " << evictions
+      << " evicted";
+  return summary.str();
+}
+
+EmbeddingCache::EmbeddingCache(int dim, int capacity, uint64_t model)
+    : dim_(dim), capacity_(capacity), model_(model),
+      embeddings_(static_cast<size_t>(capacity) * dim), hand_(0),
+      mutex_(new boost::mutex()) {
+  CHECK_GT(dim, 0);
+  CHECK_GT(capacity, 0) << "An embedding cache needs at least one entry.";
+  slots_.reserve(capacity);
+}
+
+uint64_t EmbeddingCache::Hash(const void* data, size_t size, uint64_t seed) {
+  const uint64_t k1 = 0x87c37b91114253d5ULL;
+  const uint64_t k2 = 0x4cf5ad432745937fULL;
+  const char* bytes = static_cast<const char*>(data);
+  uint64_t h = seed ^ (size * k1);
+  const size_t words = size / sizeof(uint64_t);
+  for (size_t i = 0; i < words; ++i) {
+    uint64_t w;
+    memcpy(&w, bytes + i * sizeof(w), sizeof(w));
+    h ^= Rotate(w * k1, 31) * k2;
+    h = Rotate(h, 27) * 5 + 0x52dce729;
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, bytes + words * sizeof(tail), size % sizeof(tail));
+  h ^= Rotate(tail * k2, 33) * k1;
+  return Mix(h);
+}
+
+bool EmbeddingCache::Lookup(uint64_t key, float* embedding) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  boost::unordered_map<uint64_t, int>::const_iterator it = index_.find(key);
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return false;
+  }
+  ++stats_.hits;
+  slots_[it->second].referenced = true;
+  const float* cached = &embeddings_[static_cast<size_t>(it->second) * dim_];
+  std::copy(cached, cached + dim_, embedding);
+  return true;
+}
+
+int EmbeddingCache::Evict() {
+  if (slots_.size() < capacity_) {
+    slots_.push_back(Slot());
+    return slots_.size() - 1;
+  }
+  // Every referenced slot passed is cleared, so this ends within one turn.
+  while (slots_[hand_].referenced) {
+    slots_[hand_].referenced = false;
+    hand_ = (hand_ + 1) % capacity_;
+  }
+  const int slot = hand_;
+  hand_ = (hand_ + 1) % capacity_;
+  index_.erase(slots_[slot].key);
+  ++stats_.evictions;
+  return slot;
+}
+
+void EmbeddingCache::Insert(uint64_t key, const float* embedding) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  boost::unordered_map<uint64_t, int>::const_iterator it = index_.find(key);
+  int slot;
+  if (it != index_.end()) {
+    slot = it->second;
+  } else {
+    slot = Evict();
+    slots_[slot].key = key;
+    slots_[slot].referenced = false;
+    index_[key] = slot;
+    ++stats_.insertions;
+  }
+  std::copy(embedding, embedding + dim_,
+      &embeddings_[static_cast<size_t>(slot) * dim_]);
+}
+
+void EmbeddingCache::Clear() {
+  boost::mutex::scoped_lock lock(*mutex_);
+  slots_.clear();
+  index_.clear();
+  hand_ = 0;
+}
+
+EmbeddingCache::Stats EmbeddingCache::stats() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  Stats stats = stats_;
+  stats.size = slots_.size();
+  return stats;
+}
+
+void EmbeddingCache::Save(const string& path) const {
+  // Copied out first, so that lookups do not wait for the disk.
+  vector<uint64_t> keys;
+  vector<float> embeddings;
+  {
+    boost::mutex::scoped_lock lock(*mutex_);
+    keys.resize(slots_.size());
+    for (int i = 0; i < slots_.size(); ++i) {
+      keys[i] = slots_[i].key;
+    }
+    embeddings.assign(embeddings_.begin(),
+        embeddings_.begin() + keys.size() * dim_);
+  }
+  const string temp_path = path + ".tmp";
+  EmbeddingStoreWriter writer(temp_path, dim_, EmbeddingStore::FLOAT);
+  const vector<float> zeros(dim_);
+  writer.Add(&zeros[0], -1, -1, ModelName(model_));
+  for (int i = 0; i < keys.size(); ++i) {
+    writer.Add(&embeddings[static_cast<size_t>(i) * dim_], -1, -1,
+        KeyName(keys[i]));
+  }
+  writer.Close();
+  CHECK_EQ(rename(temp_path.c_str(), path.c_str()), 0)
+      << "Failed to rename " << temp_path << " to " << path;
+}
+
+int EmbeddingCache::Load(const string& path) {
+  EmbeddingStore store;
+  store.Open(path);
+  if (store.num_embeddings() == 0 || store.name(0) != ModelName(model_)) {
+    LOG(WARNING) << "Ignoring the cached embeddings of " << path
+        << ", which were not computed by this model.";
+    return 0;
+  }
+  CHECK_EQ(store.dim(), dim_) << "The cached embeddings of " << path
+      << " have another dimension.";
+  CHECK_EQ(store.type(), EmbeddingStore::FLOAT);
+  const int num = store.num_embeddings();
+  for (int i = 1; i < num; ++i) {
+    const string name = store.name(i);
+    char* end;
+    const uint64_t key = strtoull(name.c_str(), &end, 16);
+    CHECK(name.size() == 16 && *end == '\0') << "Bad cache key " << name
+        << " in " << path;
+    Insert(key, store.data() + static_cast<size_t>(i) * dim_);
+  }
+  return num - 1;
+}
+
+}  // namespace caffe
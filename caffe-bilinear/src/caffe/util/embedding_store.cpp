@@ -0,0 +1,330 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/embedding_store.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Start of the next section: sections are 64-byte aligned.
+uint64_t Align(uint64_t offset) {
+  return (offset + 63) / 64 * 64;
+}
+
+// Whether count items of item_size bytes from offset end by end, without
+// overflowing.
+bool SectionFits(uint64_t offset, uint64_t count, uint64_t item_size,
+    uint64_t end) {
+  return offset <= end &&
+      (count == 0 || item_size <= (end - offset) / count);
+}
+
+inline uint32_t FloatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float BitsFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+uint16_t FloatToHalf(float value) {
+  uint32_t bits = FloatBits(value);
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint32_t half;
+  if (bits >= (127 + 16) << 23) {
+    // Too large for fp16, infinite or NaN.
+    half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+  } else if (bits < (127 - 14) << 23) {
+    // Subnormal in fp16: let the float adder round the mantissa.
+    const uint32_t magic = (127 - 15 + 23 - 10 + 1) << 23;
+    half = FloatBits(BitsFloat(bits) + BitsFloat(magic)) - magic;
+  } else {
+    // Rebias the exponent and round to nearest, ties to even.
+    const uint32_t odd = (bits >> 13) & 1;
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + odd;
+    half = bits >> 13;
+  }
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloat(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1f;
+  const uint32_t mantissa = value & 0x3ff;
+  if (exponent == 0) {
+    const float subnormal = std::ldexp(static_cast<float>(mantissa), -24);
+    return sign ? -subnormal : subnormal;
+  }
+  if (exponent == 0x1f) {
+    return BitsFloat(sign | 0x7f800000u | (mantissa << 13));
+  }
+  return BitsFloat(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+
+size_t EmbeddingStore::ValueSize(Type type) {
+  switch (type) {
+  case FLOAT:
+    return sizeof(float);
+  case FLOAT16:
+    return sizeof(uint16_t);
+  case INT8:
+    return sizeof(int8_t);
+  default:
+    LOG(FATAL) << "Unknown embedding type " << type;
+  }
+  return 0;
+}
+
+EmbeddingStore::EmbeddingStore()
+    : mapping_(NULL), mapping_size_(0), header_(NULL), rows_(NULL),
+      scales_(NULL), labels_(NULL), name_offsets_(NULL), names_(NULL) {
+}
+
+EmbeddingStore::~EmbeddingStore() {
+  Close();
+}
+
+void EmbeddingStore::Open(const string& path) {
+  Close();
+  const int fd = open(path.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << path;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat " << path;
+  mapping_size_ = st.st_size;
+  CHECK_GE(mapping_size_, sizeof(EmbeddingStoreHeader))
+      << path << " is not an embedding store.";
+  mapping_ = mmap(NULL, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(mapping_ != MAP_FAILED) << "Cannot map " << path << ": "
+      << strerror(errno);
+  const uint8_t* base = static_cast<const uint8_t*>(mapping_);
+  header_ = reinterpret_cast<const EmbeddingStoreHeader*>(base);
+  CHECK_EQ(header_->magic, kMagic) << path << " is not an embedding store.";
+  CHECK_EQ(header_->version, kVersion)
+      << "Unsupported embedding store version in " << path;
+  CHECK_LE(header_->type, INT8) << "Unknown embedding type in " << path;
+  CHECK_EQ(header_->size, mapping_size_) << path << " is truncated.";
+  // The sections must follow each other within the file.
+  const uint64_t num = header_->num_embeddings;
+  const uint64_t row_size =
+      static_cast<uint64_t>(header_->dim) * ValueSize(type());
+  CHECK(header_->rows_offset >= sizeof(EmbeddingStoreHeader) &&
+      SectionFits(header_->rows_offset, num, row_size,
+                  header_->scales_offset) &&
+      SectionFits(header_->scales_offset, type() == INT8 ? num : 0,
+                  sizeof(float), header_->labels_offset) &&
+      SectionFits(header_->labels_offset, num, 2 * sizeof(int32_t),
+                  header_->names_offset) &&
+      SectionFits(header_->names_offset, num + 1, sizeof(uint64_t),
+                  header_->size)) << "Bad section offsets in " << path;
+  rows_ = base + header_->rows_offset;
+  scales_ = reinterpret_cast<const float*>(base + header_->scales_offset);
+  labels_ = reinterpret_cast<const int32_t*>(base + header_->labels_offset);
+  name_offsets_ =
+      reinterpret_cast<const uint64_t*>(base + header_->names_offset);
+  names_ = reinterpret_cast<const char*>(name_offsets_ + num + 1);
+  const uint64_t names_size =
+      header_->size - (header_->names_offset + (num + 1) * sizeof(uint64_t));
+  for (uint64_t i = 0; i < num; ++i) {
+    CHECK_LE(name_offsets_[i], name_offsets_[i + 1])
+        << "Bad name offsets in " << path;
+  }
+  CHECK_LE(name_offsets_[num], names_size) << "Bad name offsets in " << path;
+  boost::crc_32_type crc;
+  crc.process_block(labels_, base + header_->size);
+  CHECK_EQ(crc.checksum(), header_->metadata_checksum)
+      << "The labels and names of " << path << " are corrupt.";
+}
+
+void EmbeddingStore::Close() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = NULL;
+    header_ = NULL;
+  }
+}
+
+bool EmbeddingStore::Verify() const {
+  boost::crc_32_type crc;
+  crc.process_block(rows_, reinterpret_cast<const uint8_t*>(labels_));
+  return crc.checksum() == header_->data_checksum;
+}
+
+const float* EmbeddingStore::data() const {
+  CHECK_EQ(type(), FLOAT) << "Decode the embeddings of fp16 or int8 stores.";
+  return reinterpret_cast<const float*>(rows_);
+}
+
+void EmbeddingStore::Decode(int begin, int end, float* embeddings) const {
+  CHECK_LE(0, begin);
+  CHECK_LE(begin, end);
+  CHECK_LE(end, num_embeddings());
+  const size_t count = static_cast<size_t>(end - begin) * dim();
+  const size_t first = static_cast<size_t>(begin) * dim();
+  switch (type()) {
+  case FLOAT:
+    memcpy(embeddings, data() + first, count * sizeof(float));
+    break;
+  case FLOAT16: {
+    const uint16_t* values = reinterpret_cast<const uint16_t*>(rows_) + first;
+    for (size_t i = 0; i < count; ++i) {
+      embeddings[i] = HalfToFloat(values[i]);
+    }
+    break;
+  }
+  case INT8: {
+    const int8_t* values = reinterpret_cast<const int8_t*>(rows_) + first;
+    for (int i = begin; i < end; ++i) {
+      const float scale = scales_[i];
+      for (int d = 0; d < dim(); ++d) {
+        *embeddings++ = scale * *values++;
+      }
+    }
+    break;
+  }
+  }
+}
+
+EmbeddingStoreWriter::EmbeddingStoreWriter(const string& path, int dim,
+    EmbeddingStore::Type type)
+    : path_(path), file_(NULL),
+      row_(dim * EmbeddingStore::ValueSize(type)) {
+  CHECK_GT(dim, 0);
+  memset(&header_, 0, sizeof(header_));
+  header_.magic = EmbeddingStore::kMagic;
+  header_.version = EmbeddingStore::kVersion;
+  header_.type = type;
+  header_.dim = dim;
+  header_.rows_offset = Align(sizeof(header_));
+  file_ = fopen(path.c_str(), "wb");
+  CHECK(file_) << "Cannot create " << path << ": " << strerror(errno);
+  CHECK_EQ(fseek(file_, header_.rows_offset, SEEK_SET), 0);
+}
+
+EmbeddingStoreWriter::~EmbeddingStoreWriter() {
+  if (file_) {
+    Close();
+  }
+}
+
+void EmbeddingStoreWriter::Write(const void* data, size_t size) {
+  CHECK_EQ(fwrite(data, 1, size, file_), size) << "Cannot write " << path_
+      << ": " << strerror(errno);
+}
+
+void EmbeddingStoreWriter::Add(const float* embedding, int person,
+    int camera, const string& name) {
+  CHECK(file_) << "Adding to a closed embedding store.";
+  const int dim = header_.dim;
+  switch (header_.type) {
+  case EmbeddingStore::FLOAT:
+    memcpy(&row_[0], embedding, row_.size());
+    break;
+  case EmbeddingStore::FLOAT16: {
+    uint16_t* values = reinterpret_cast<uint16_t*>(&row_[0]);
+    for (int d = 0; d < dim; ++d) {
+      values[d] = FloatToHalf(embedding[d]);
+    }
+    break;
+  }
+  case EmbeddingStore::INT8: {
+    // Symmetric quantization of the row to [-127, 127].
+    float max_abs = 0;
+    for (int d = 0; d < dim; ++d) {
+      max_abs = std::max(max_abs, std::fabs(embedding[d]));
+    }
+    const float scale = max_abs / 127;
+    int8_t* values = reinterpret_cast<int8_t*>(&row_[0]);
+    for (int d = 0; d < dim; ++d) {
+      values[d] = scale > 0 ? static_cast<int8_t>(
+          std::floor(embedding[d] / scale + 0.5f)) : 0;
+    }
+    scales_.push_back(scale);
+    break;
+  }
+  }
+  Write(&row_[0], row_.size());
+  data_crc_.process_bytes(&row_[0], row_.size());
+  persons_.push_back(person);
+  cameras_.push_back(camera);
+  names_.push_back(name);
+}
+
+void EmbeddingStoreWriter::Close() {
+  CHECK(file_) << "Closing a closed embedding store.";
+  const uint64_t num_embeddings = persons_.size();
+  header_.num_embeddings = num_embeddings;
+  header_.scales_offset =
+      Align(header_.rows_offset + num_embeddings * row_.size());
+  header_.labels_offset =
+      Align(header_.scales_offset + scales_.size() * sizeof(float));
+  header_.names_offset =
+      Align(header_.labels_offset + num_embeddings * 2 * sizeof(int32_t));
+
+  // The checksums cover the sections and the padding between them, which
+  // the writer leaves zero.
+  const char zeros[64] = {0};
+  const uint64_t rows_end =
+      header_.rows_offset + num_embeddings * row_.size();
+  data_crc_.process_bytes(zeros, header_.scales_offset - rows_end);
+  CHECK_EQ(fseek(file_, header_.scales_offset, SEEK_SET), 0);
+  if (!scales_.empty()) {
+    Write(&scales_[0], scales_.size() * sizeof(float));
+    data_crc_.process_bytes(&scales_[0], scales_.size() * sizeof(float));
+  }
+  data_crc_.process_bytes(zeros, header_.labels_offset -
+      (header_.scales_offset + scales_.size() * sizeof(float)));
+  header_.data_checksum = data_crc_.checksum();
+
+  vector<int32_t> labels(2 * num_embeddings);
+  for (uint64_t i = 0; i < num_embeddings; ++i) {
+    labels[2 * i] = persons_[i];
+    labels[2 * i + 1] = cameras_[i];
+  }
+  vector<char> metadata(header_.names_offset - header_.labels_offset, 0);
+  if (num_embeddings) {
+    memcpy(&metadata[0], &labels[0], labels.size() * sizeof(int32_t));
+  }
+  vector<uint64_t> offsets(num_embeddings + 1, 0);
+  string names;
+  for (uint64_t i = 0; i < num_embeddings; ++i) {
+    names += names_[i];
+    offsets[i + 1] = names.size();
+  }
+  const size_t offsets_size = offsets.size() * sizeof(uint64_t);
+  metadata.insert(metadata.end(),
+      reinterpret_cast<const char*>(&offsets[0]),
+      reinterpret_cast<const char*>(&offsets[0]) + offsets_size);
+  metadata.insert(metadata.end(), names.begin(), names.end());
+  boost::crc_32_type metadata_crc;
+  metadata_crc.process_bytes(&metadata[0], metadata.size());
+  header_.metadata_checksum = metadata_crc.checksum();
+  header_.size = header_.labels_offset + metadata.size();
+
+  CHECK_EQ(fseek(file_, header_.labels_offset, SEEK_SET), 0);
+  Write(&metadata[0], metadata.size());
+  CHECK_EQ(fseek(file_, 0, SEEK_SET), 0);
+  Write(&header_, sizeof(header_));
+  CHECK_EQ(fclose(file_), 0) << "Cannot write " << path_ << ": "
+      << strerror(errno);
+  file_ = NULL;
+}
+
+}  // namespace caffe
@@ -3,6 +3,15 @@
 
 #include <limits>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__SSE2__)
+#define CAFFE_UINT8_SCALE_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CAFFE_UINT8_SCALE_NEON
+#include <arm_neon.h>
+#endif
+
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
@@ -372,4 +381,135 @@ void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
   cblas_dscal(n, alpha, y, 1);
 }
 
+namespace {
+
+// Scalar tail (and fallback) of caffe_cpu_uint8_scale over [begin, n).
+template <typename Dtype>
+void uint8_scale_scalar(const int begin, const int n, const uint8_t* x,
+    const Dtype mean, const Dtype scale, const bool mirror, Dtype* y) {
+  if (mirror) {
+    for (int i = begin; i < n; ++i) {
+      y[n - 1 - i] = (static_cast<Dtype>(x[i]) - mean) * scale;
+    }
+  } else {
+    for (int i = begin; i < n; ++i) {
+      y[i] = (static_cast<Dtype>(x[i]) - mean) * scale;
+    }
+  }
+}
+
+#if defined(CAFFE_UINT8_SCALE_X86)
+// Each returns the number of leading pixels converted.
+int uint8_scale_sse2(const int n, const uint8_t* x, const float mean,
+    const float scale, const bool mirror, float* y) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 vmean = _mm_set1_ps(mean);
+  const __m128 vscale = _mm_set1_ps(scale);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+    __m128 v[4];
+    v[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+    v[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+    v[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+    v[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+    for (int k = 0; k < 4; ++k) {
+      v[k] = _mm_mul_ps(_mm_sub_ps(v[k], vmean), vscale);
+      if (mirror) {
+        _mm_storeu_ps(y + n - i - 4 * (k + 1),
+            _mm_shuffle_ps(v[k], v[k], _MM_SHUFFLE(0, 1, 2, 3)));
+      } else {
+        _mm_storeu_ps(y + i + 4 * k, v[k]);
+      }
+    }
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+int uint8_scale_avx2(const int n, const uint8_t* x, const float mean,
+    const float scale, const bool mirror, float* y) {
+  const __m256 vmean = _mm256_set1_ps(mean);
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    __m256 v[2];
+    v[0] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+    v[1] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+    for (int k = 0; k < 2; ++k) {
+      v[k] = _mm256_mul_ps(_mm256_sub_ps(v[k], vmean), vscale);
+      if (mirror) {
+        _mm256_storeu_ps(y + n - i - 8 * (k + 1),
+            _mm256_permutevar8x32_ps(v[k], reverse));
+      } else {
+        _mm256_storeu_ps(y + i + 8 * k, v[k]);
+      }
+    }
+  }
+  return i;
+}
+
+#elif defined(CAFFE_UINT8_SCALE_NEON)
+int uint8_scale_neon(const int n, const uint8_t* x, const float mean,
+    const float scale, const bool mirror, float* y) {
+  const float32x4_t vmean = vdupq_n_f32(mean);
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const uint16x8_t words = vmovl_u8(vld1_u8(x + i));
+    float32x4_t v[2];
+    v[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+    v[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words)));
+    for (int k = 0; k < 2; ++k) {
+      v[k] = vmulq_f32(vsubq_f32(v[k], vmean), vscale);
+      if (mirror) {
+        const float32x4_t r = vrev64q_f32(v[k]);
+        vst1q_f32(y + n - i - 4 * (k + 1),
+            vcombine_f32(vget_high_f32(r), vget_low_f32(r)));
+      } else {
+        vst1q_f32(y + i + 4 * k, v[k]);
+      }
+    }
+  }
+  return i;
+}
+#endif
+
+}  // namespace
+
+template <>
+void caffe_cpu_uint8_scale<float>(const int n, const uint8_t* x,
+    const float mean, const float scale, const bool mirror, float* y) {
+  int begin = 0;
+#if defined(CAFFE_UINT8_SCALE_X86)
+  begin = caffe_cpu_has_avx2() ?
+      uint8_scale_avx2(n, x, mean, scale, mirror, y) :
+      uint8_scale_sse2(n, x, mean, scale, mirror, y);
+#elif defined(CAFFE_UINT8_SCALE_NEON)
+  begin = uint8_scale_neon(n, x, mean, scale, mirror, y);
+#endif
+  uint8_scale_scalar(begin, n, x, mean, scale, mirror, y);
+}
+
+template <>
+void caffe_cpu_uint8_scale<double>(const int n, const uint8_t* x,
+    const double mean, const double scale, const bool mirror, double* y) {
+  uint8_scale_scalar(0, n, x, mean, scale, mirror, y);
+}
+
+bool caffe_cpu_has_avx2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+#else
+  return false;
+#endif
+}
+
 }  // namespace caffe
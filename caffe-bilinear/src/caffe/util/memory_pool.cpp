@@ -0,0 +1,213 @@
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/memory_pool.hpp"
+
+namespace caffe {
+
+const size_t MemoryPool::kMinBucket;
+const size_t MemoryPool::kDefaultCacheLimit;
+
+size_t MemoryPool::BucketSize(size_t size) {
+  if (size <= kMinBucket) {
+    return kMinBucket;
+  }
+  // The largest power of two not above size, split in eight steps.
+  size_t power = kMinBucket;
+  while (power <= size / 2) {
+    power *= 2;
+  }
+  const size_t step = power / 8;
+  return (size + step - 1) / step * step;
+}
+
+string MemoryPool::Stats::Summary() const {
+  std::ostringstream summary;
+  summary << hits << "/" << requests << " allocations from the cache, "
+      << cached / 1048576.0 << " MB cached, " << reserved / 1048576.0
+      << " MB reserved (peak " << peak_reserved / 1048576.0 << " MB)";
+  return summary.str();
+}
+
+MemoryPool::MemoryPool()
+    : mutex_(new boost::mutex()), cache_limit_(kDefaultCacheLimit) {
+}
+
+MemoryPool::~MemoryPool() {
+  EmptyCache();
+}
+
+void* MemoryPool::TakeCached(Cache* cache, size_t bucket) {
+  Cache::iterator it = cache->find(bucket);
+  if (it == cache->end() || it->second.empty()) {
+    return NULL;
+  }
+  void* ptr = it->second.back();
+  it->second.pop_back();
+  return ptr;
+}
+
+void MemoryPool::CountRequest(Stats* stats, size_t bucket, bool hit) {
+  ++stats->requests;
+  if (hit) {
+    ++stats->hits;
+    stats->cached -= bucket;
+  } else {
+    stats->reserved += bucket;
+    stats->peak_reserved = std::max(stats->peak_reserved, stats->reserved);
+  }
+}
+
+void* MemoryPool::MallocHost(size_t size, bool* use_cuda) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  const size_t bucket = cache_limit_ ? BucketSize(size) : size;
+  bool pinned = false;
+#ifndef CPU_ONLY
+  pinned = Caffe::mode() == Caffe::GPU;
+#endif
+  void* ptr = TakeCached(pinned ? &pinned_cache_ : &pageable_cache_, bucket);
+  const bool hit = ptr != NULL;
+  if (hit) {
+    *use_cuda = pinned;
+  } else {
+    CaffeMallocHost(&ptr, bucket, use_cuda);
+  }
+  CountRequest(&host_stats_, bucket, hit);
+  host_buffers_[ptr] = bucket;
+  return ptr;
+}
+
+void MemoryPool::FreeHost(void* ptr, size_t size, bool use_cuda) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  std::map<void*, size_t>::iterator it = host_buffers_.find(ptr);
+  CHECK(it != host_buffers_.end()) << "Freeing a host buffer of " << size
+      << " bytes not allocated by the memory pool.";
+  const size_t bucket = it->second;
+  host_buffers_.erase(it);
+  if (host_stats_.cached + bucket > cache_limit_) {
+    CaffeFreeHost(ptr, use_cuda);
+    host_stats_.reserved -= bucket;
+    return;
+  }
+  (use_cuda ? pinned_cache_ : pageable_cache_)[bucket].push_back(ptr);
+  host_stats_.cached += bucket;
+}
+
+void* MemoryPool::MallocDevice(size_t size) {
+#ifndef CPU_ONLY
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  boost::mutex::scoped_lock lock(*mutex_);
+  const size_t bucket = cache_limit_ ? BucketSize(size) : size;
+  void* ptr = TakeCached(&device_caches_[device], bucket);
+  const bool hit = ptr != NULL;
+  if (!hit) {
+    cudaError_t error = cudaMalloc(&ptr, bucket);
+    if (error == cudaErrorMemoryAllocation) {
+      // Clear the error, and make room by giving back what is cached.
+      cudaGetLastError();
+      EmptyDeviceCache();
+      error = cudaMalloc(&ptr, bucket);
+    }
+    CUDA_CHECK(error);
+  }
+  CountRequest(&device_stats_, bucket, hit);
+  DeviceBuffer& buffer = device_buffers_[ptr];
+  buffer.size = bucket;
+  buffer.device = device;
+  return ptr;
+#else
+  NO_GPU;
+  return NULL;
+#endif
+}
+
+void MemoryPool::FreeDevice(void* ptr, size_t size) {
+#ifndef CPU_ONLY
+  boost::mutex::scoped_lock lock(*mutex_);
+  std::map<void*, DeviceBuffer>::iterator it = device_buffers_.find(ptr);
+  CHECK(it != device_buffers_.end()) << "Freeing a device buffer of " << size
+      << " bytes not allocated by the memory pool.";
+  const DeviceBuffer buffer = it->second;
+  device_buffers_.erase(it);
+  if (device_stats_.cached + buffer.size > cache_limit_) {
+    CUDA_CHECK(cudaFree(ptr));
+    device_stats_.reserved -= buffer.size;
+    return;
+  }
+  device_caches_[buffer.device][buffer.size].push_back(ptr);
+  device_stats_.cached += buffer.size;
+#else
+  NO_GPU;
+#endif
+}
+
+void MemoryPool::EmptyHostCache() {
+  for (int pinned = 0; pinned < 2; ++pinned) {
+    Cache& cache = pinned ? pinned_cache_ : pageable_cache_;
+    for (Cache::iterator it = cache.begin(); it != cache.end(); ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        CaffeFreeHost(it->second[i], pinned);
+      }
+    }
+    cache.clear();
+  }
+  host_stats_.reserved -= host_stats_.cached;
+  host_stats_.cached = 0;
+}
+
+void MemoryPool::EmptyDeviceCache() {
+#ifndef CPU_ONLY
+  for (std::map<int, Cache>::iterator device = device_caches_.begin();
+       device != device_caches_.end(); ++device) {
+    for (Cache::iterator it = device->second.begin();
+         it != device->second.end(); ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        CUDA_CHECK(cudaFree(it->second[i]));
+      }
+    }
+  }
+  device_caches_.clear();
+  device_stats_.reserved -= device_stats_.cached;
+  device_stats_.cached = 0;
+#endif
+}
+
+void MemoryPool::EmptyCache() {
+  boost::mutex::scoped_lock lock(*mutex_);
+  EmptyHostCache();
+  EmptyDeviceCache();
+}
+
+void MemoryPool::set_cache_limit(size_t limit) {
+  boost::mutex::scoped_lock lock(*mutex_);
+  cache_limit_ = limit;
+  if (host_stats_.cached > limit) {
+    EmptyHostCache();
+  }
+  if (device_stats_.cached > limit) {
+    EmptyDeviceCache();
+  }
+}
+
+size_t MemoryPool::cache_limit() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  return cache_limit_;
+}
+
+MemoryPool::Stats MemoryPool::host_stats() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  return host_stats_;
+}
+
+MemoryPool::Stats MemoryPool::device_stats() const {
+  boost::mutex::scoped_lock lock(*mutex_);
+  return device_stats_;
+}
+
+}  // namespace caffe
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_PQ_DISTANCES_X86
+#include <immintrin.h>
+#endif
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/product_quantizer.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+namespace {
+
+const int kNumCentroids = ProductQuantizer::kNumCentroids;
+
+void DistancesScalar(const float* table, const uint8_t* codes, int M,
+    int num, float* distances) {
+  for (int i = 0; i < num; ++i) {
+    const uint8_t* code = codes + static_cast<size_t>(i) * M;
+    // Four independent sums keep several table loads in flight.
+    float d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+    const float* t = table;
+    int m = 0;
+    for (; m + 4 <= M; m += 4, t += 4 * kNumCentroids) {
+      d0 += t[code[m]];
+      d1 += t[kNumCentroids + code[m + 1]];
+      d2 += t[2 * kNumCentroids + code[m + 2]];
+      d3 += t[3 * kNumCentroids + code[m + 3]];
+    }
+    for (; m < M; ++m, t += kNumCentroids) {
+      d0 += t[code[m]];
+    }
+    distances[i] = (d0 + d1) + (d2 + d3);
+  }
+}
+
+#if defined(CAFFE_PQ_DISTANCES_X86)
+// Gathers the entries of eight subspaces at a time.
+__attribute__((target("avx2")))
+void DistancesAvx2(const float* table, const uint8_t* codes, int M,
+    int num, float* distances) {
+  const __m256i rows = _mm256_setr_epi32(0, kNumCentroids,
+      2 * kNumCentroids, 3 * kNumCentroids, 4 * kNumCentroids,
+      5 * kNumCentroids, 6 * kNumCentroids, 7 * kNumCentroids);
+  for (int i = 0; i < num; ++i) {
+    const uint8_t* code = codes + static_cast<size_t>(i) * M;
+    __m256 sum = _mm256_setzero_ps();
+    int m = 0;
+    for (; m + 8 <= M; m += 8) {
+      const __m256i index = _mm256_add_epi32(rows, _mm256_cvtepu8_epi32(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(code + m))));
+      sum = _mm256_add_ps(sum,
+          _mm256_i32gather_ps(table + m * kNumCentroids, index, 4));
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum),
+        _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float d = _mm_cvtss_f32(half);
+    for (; m < M; ++m) {
+      d += table[m * kNumCentroids + code[m]];
+    }
+    distances[i] = d;
+  }
+}
+#endif
+
+}  // namespace
+
+ProductQuantizer::ProductQuantizer(int dim, int num_subspaces)
+    : dim_(dim), num_subspaces_(num_subspaces) {
+  CHECK_GT(num_subspaces, 0);
+  CHECK_LE(num_subspaces, dim) << "More subspaces than dimensions.";
+}
+
+void ProductQuantizer::Train(const float* embeddings, int num,
+    int iterations) {
+  CHECK_GE(num, kNumCentroids) << "Product quantization needs at least "
+      << kNumCentroids << " embeddings to train on.";
+  // One sample for all subspaces, so that their codebooks see the same data.
+  rng_t rng(100);
+  vector<int> order(num);
+  for (int i = 0; i < num; ++i) {
+    order[i] = i;
+  }
+  shuffle(order.begin(), order.end(), &rng);
+  order.resize(std::min(num, kNumCentroids * kNumCentroids));
+  const int num_samples = order.size();
+  centroids_.resize(static_cast<size_t>(kNumCentroids) * dim_);
+  vector<float> samples;
+  vector<float> codebook;
+  for (int m = 0; m < num_subspaces_; ++m) {
+    const int begin = subspace_begin(m);
+    const int sub_dim = subspace_dim(m);
+    samples.resize(static_cast<size_t>(num_samples) * sub_dim);
+    for (int i = 0; i < num_samples; ++i) {
+      const float* embedding =
+          embeddings + static_cast<size_t>(order[i]) * dim_ + begin;
+      std::copy(embedding, embedding + sub_dim,
+          &samples[static_cast<size_t>(i) * sub_dim]);
+    }
+    KMeans(&samples[0], num_samples, sub_dim, kNumCentroids, iterations,
+        num_samples, &codebook);
+    std::copy(codebook.begin(), codebook.end(),
+        &centroids_[static_cast<size_t>(kNumCentroids) * begin]);
+  }
+}
+
+void ProductQuantizer::set_centroids(const vector<float>& centroids) {
+  CHECK_EQ(centroids.size(), static_cast<size_t>(kNumCentroids) * dim_)
+      << "Codebooks do not match the dimension.";
+  centroids_ = centroids;
+}
+
+void ProductQuantizer::Encode(const float* embeddings, int num,
+    uint8_t* codes) const {
+  CHECK(trained()) << "Train the quantizer before encoding.";
+  if (num <= 0) {
+    return;
+  }
+  vector<float> subvectors;
+  vector<int> nearest;
+  for (int m = 0; m < num_subspaces_; ++m) {
+    const int begin = subspace_begin(m);
+    const int sub_dim = subspace_dim(m);
+    subvectors.resize(static_cast<size_t>(num) * sub_dim);
+    for (int i = 0; i < num; ++i) {
+      const float* embedding =
+          embeddings + static_cast<size_t>(i) * dim_ + begin;
+      std::copy(embedding, embedding + sub_dim,
+          &subvectors[static_cast<size_t>(i) * sub_dim]);
+    }
+    NearestCentroids(centroid(m, 0), kNumCentroids, &subvectors[0], num,
+        sub_dim, &nearest);
+    for (int i = 0; i < num; ++i) {
+      codes[static_cast<size_t>(i) * num_subspaces_ + m] = nearest[i];
+    }
+  }
+}
+
+void ProductQuantizer::Decode(const uint8_t* codes, int num,
+    float* embeddings) const {
+  CHECK(trained()) << "Train the quantizer before decoding.";
+  for (int i = 0; i < num; ++i) {
+    const uint8_t* code = codes + static_cast<size_t>(i) * num_subspaces_;
+    float* embedding = embeddings + static_cast<size_t>(i) * dim_;
+    for (int m = 0; m < num_subspaces_; ++m) {
+      const float* c = centroid(m, code[m]);
+      std::copy(c, c + subspace_dim(m), embedding + subspace_begin(m));
+    }
+  }
+}
+
+void ProductQuantizer::ComputeTable(const float* query, float* table) const {
+  CHECK(trained()) << "Train the quantizer before searching.";
+  for (int m = 0; m < num_subspaces_; ++m) {
+    const float* sub_query = query + subspace_begin(m);
+    const int sub_dim = subspace_dim(m);
+    const float* c = centroid(m, 0);
+    for (int j = 0; j < kNumCentroids; ++j, c += sub_dim) {
+      float distance = 0;
+      for (int d = 0; d < sub_dim; ++d) {
+        const float difference = sub_query[d] - c[d];
+        distance += difference * difference;
+      }
+      table[m * kNumCentroids + j] = distance;
+    }
+  }
+}
+
+void ProductQuantizer::Distances(const float* table, const uint8_t* codes,
+    int num, float* distances) const {
+#if defined(CAFFE_PQ_DISTANCES_X86)
+  if (caffe_cpu_has_avx2()) {
+    DistancesAvx2(table, codes, num_subspaces_, num, distances);
+    return;
+  }
+#endif
+  DistancesScalar(table, codes, num_subspaces_, num, distances);
+}
+
+}  // namespace caffe
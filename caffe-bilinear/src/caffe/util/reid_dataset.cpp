@@ -0,0 +1,231 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/reid_dataset.hpp"
+
+namespace caffe {
+
+bool ParseMarket1501Name(const string& path, int* person, int* camera) {
+  const size_t slash = path.find_last_of('/');
+  const string name =
+      slash == string::npos ? path : path.substr(slash + 1);
+  // <person>_c<camera>s<sequence>_<frame>_<box>.jpg
+  const size_t underscore = name.find('_');
+  if (underscore == string::npos || underscore == 0 ||
+      underscore + 2 >= name.size() || name[underscore + 1] != 'c') {
+    return false;
+  }
+  char* end;
+  const long p = strtol(name.c_str(), &end, 10);  // NOLINT(runtime/int)
+  if (end != name.c_str() + underscore) {
+    return false;
+  }
+  const char* camera_begin = name.c_str() + underscore + 2;
+  const long c = strtol(camera_begin, &end, 10);  // NOLINT(runtime/int)
+  if (end == camera_begin) {
+    return false;
+  }
+  *person = p;
+  *camera = c;
+  return true;
+}
+
+namespace {
+
+// Start of the next section: sections are 64-byte aligned.
+uint64_t Align(uint64_t offset) {
+  return (offset + 63) / 64 * 64;
+}
+
+// Whether count items of item_size bytes from offset end by end, without
+// overflowing.
+bool SectionFits(uint64_t offset, uint64_t count, uint64_t item_size,
+    uint64_t end) {
+  return offset <= end &&
+      (count == 0 || item_size <= (end - offset) / count);
+}
+
+}  // namespace
+
+ReIDDataset::ReIDDataset()
+    : mapping_(NULL), mapping_size_(0), header_(NULL), records_(NULL),
+      labels_(NULL), identities_(NULL), members_(NULL) {
+}
+
+ReIDDataset::~ReIDDataset() {
+  Close();
+}
+
+void ReIDDataset::Open(const string& path) {
+  Close();
+  const int fd = open(path.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << path;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat " << path;
+  mapping_size_ = st.st_size;
+  CHECK_GE(mapping_size_, sizeof(ReIDDatasetHeader))
+      << path << " is not a re-ID dataset.";
+  mapping_ = mmap(NULL, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(mapping_ != MAP_FAILED) << "Cannot map " << path << ": "
+      << strerror(errno);
+  const uint8_t* base = static_cast<const uint8_t*>(mapping_);
+  header_ = reinterpret_cast<const ReIDDatasetHeader*>(base);
+  CHECK_EQ(header_->magic, kMagic) << path << " is not a re-ID dataset.";
+  CHECK_EQ(header_->version, kVersion)
+      << "Unsupported re-ID dataset version in " << path;
+  const uint64_t num = header_->num_records;
+  CHECK(header_->records_offset >= sizeof(ReIDDatasetHeader) &&
+      SectionFits(header_->records_offset, num, record_size(),
+                  header_->labels_offset) &&
+      SectionFits(header_->labels_offset, num, 2 * sizeof(int32_t),
+                  header_->identities_offset) &&
+      SectionFits(header_->identities_offset, header_->num_persons,
+                  3 * sizeof(uint32_t), header_->members_offset) &&
+      SectionFits(header_->members_offset, num, sizeof(uint32_t),
+                  mapping_size_)) << path << " is truncated or corrupt.";
+  records_ = base + header_->records_offset;
+  labels_ = reinterpret_cast<const int32_t*>(base + header_->labels_offset);
+  identities_ =
+      reinterpret_cast<const uint32_t*>(base + header_->identities_offset);
+  members_ = reinterpret_cast<const uint32_t*>(base + header_->members_offset);
+  // The index is followed blindly when sampling: check it points into the
+  // records.
+  for (int k = 0; k < num_persons(); ++k) {
+    const uint64_t first = identities_[3 * k + 1];
+    CHECK_LE(first + identities_[3 * k + 2], num)
+        << "Bad identity index in " << path;
+  }
+  for (uint64_t i = 0; i < num; ++i) {
+    CHECK_LT(members_[i], num) << "Bad identity index in " << path;
+  }
+}
+
+void ReIDDataset::Close() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = NULL;
+    header_ = NULL;
+  }
+}
+
+int ReIDDataset::FindPerson(int person) const {
+  int begin = 0;
+  int end = num_persons();
+  while (begin < end) {
+    const int middle = begin + (end - begin) / 2;
+    if (person_id(middle) < person) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin < num_persons() && person_id(begin) == person ? begin : -1;
+}
+
+ReIDDatasetWriter::ReIDDatasetWriter(const string& path, int channels,
+    int height, int width)
+    : path_(path), file_(NULL) {
+  CHECK_GT(channels, 0);
+  CHECK_GT(height, 0);
+  CHECK_GT(width, 0);
+  memset(&header_, 0, sizeof(header_));
+  header_.magic = ReIDDataset::kMagic;
+  header_.version = ReIDDataset::kVersion;
+  header_.channels = channels;
+  header_.height = height;
+  header_.width = width;
+  header_.records_offset = Align(sizeof(header_));
+  file_ = fopen(path.c_str(), "wb");
+  CHECK(file_) << "Cannot create " << path << ": " << strerror(errno);
+  CHECK_EQ(fseek(file_, header_.records_offset, SEEK_SET), 0);
+}
+
+ReIDDatasetWriter::~ReIDDatasetWriter() {
+  if (file_) {
+    Close();
+  }
+}
+
+void ReIDDatasetWriter::Write(const void* data, size_t size) {
+  CHECK_EQ(fwrite(data, 1, size, file_), size) << "Cannot write " << path_
+      << ": " << strerror(errno);
+}
+
+void ReIDDatasetWriter::Add(const uint8_t* pixels, int person, int camera) {
+  CHECK(file_) << "Adding to a closed re-ID dataset.";
+  Write(pixels, static_cast<size_t>(header_.channels) * header_.height *
+      header_.width);
+  persons_.push_back(person);
+  cameras_.push_back(camera);
+}
+
+void ReIDDatasetWriter::Close() {
+  CHECK(file_) << "Closing a closed re-ID dataset.";
+  const uint64_t num_records = persons_.size();
+  header_.num_records = num_records;
+  const uint64_t record_size = static_cast<uint64_t>(header_.channels) *
+      header_.height * header_.width;
+  header_.labels_offset =
+      Align(header_.records_offset + num_records * record_size);
+  // Group the records by person, stably so that each identity lists its
+  // records in the order they were added.
+  vector<std::pair<int, uint32_t> > order(num_records);
+  for (uint32_t i = 0; i < num_records; ++i) {
+    order[i] = std::make_pair(persons_[i], i);
+  }
+  std::stable_sort(order.begin(), order.end());
+  vector<uint32_t> identities;
+  vector<uint32_t> members(num_records);
+  for (uint32_t i = 0; i < num_records; ++i) {
+    if (i == 0 || order[i].first != order[i - 1].first) {
+      identities.push_back(static_cast<uint32_t>(order[i].first));
+      identities.push_back(i);
+      identities.push_back(0);
+    }
+    ++identities.back();
+    members[i] = order[i].second;
+  }
+  header_.num_persons = identities.size() / 3;
+  header_.identities_offset =
+      Align(header_.labels_offset + num_records * 2 * sizeof(int32_t));
+  header_.members_offset = Align(header_.identities_offset +
+      identities.size() * sizeof(uint32_t));
+
+  vector<int32_t> labels(2 * num_records);
+  for (uint32_t i = 0; i < num_records; ++i) {
+    labels[2 * i] = persons_[i];
+    labels[2 * i + 1] = cameras_[i];
+  }
+  CHECK_EQ(fseek(file_, header_.labels_offset, SEEK_SET), 0);
+  if (num_records) {
+    Write(&labels[0], labels.size() * sizeof(labels[0]));
+  }
+  CHECK_EQ(fseek(file_, header_.identities_offset, SEEK_SET), 0);
+  if (!identities.empty()) {
+    Write(&identities[0], identities.size() * sizeof(identities[0]));
+  }
+  CHECK_EQ(fseek(file_, header_.members_offset, SEEK_SET), 0);
+  if (num_records) {
+    Write(&members[0], members.size() * sizeof(members[0]));
+  }
+  CHECK_EQ(fseek(file_, 0, SEEK_SET), 0);
+  Write(&header_, sizeof(header_));
+  CHECK_EQ(fclose(file_), 0) << "Cannot write " << path_ << ": "
+      << strerror(errno);
+  file_ = NULL;
+  LOG(INFO) << "Wrote " << num_records << " records of "
+      << header_.num_persons << " persons to " << path_;
+}
+
+}  // namespace caffe
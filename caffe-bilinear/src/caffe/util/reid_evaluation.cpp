@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/reid_dataset.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+
+namespace caffe {
+
+void ReadReIDFeatures(const string& backend, const string& source,
+    vector<float>* features, int* dim) {
+  boost::scoped_ptr<db::DB> db(db::GetDB(backend));
+  db->Open(source, db::READ);
+  boost::scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  Datum datum;
+  *dim = 0;
+  features->clear();
+  for (; cursor->valid(); cursor->Next()) {
+    CHECK(datum.ParseFromString(cursor->value()));
+    if (*dim == 0) {
+      *dim = datum.float_data_size();
+      CHECK_GT(*dim, 0) << "No float features in " << source;
+    }
+    CHECK_EQ(*dim, datum.float_data_size())
+        << "Features of different sizes in " << source;
+    features->insert(features->end(), datum.float_data().begin(),
+        datum.float_data().end());
+  }
+  CHECK_GT(features->size(), 0) << "No features in " << source;
+}
+
+void ReadReIDList(const string& source, vector<string>* names,
+    vector<int>* persons, vector<int>* cameras) {
+  std::ifstream infile(source.c_str());
+  CHECK(infile.good()) << "Failed to open " << source;
+  string line;
+  while (std::getline(infile, line)) {
+    std::istringstream words(line);
+    string name;
+    if (!(words >> name)) {
+      continue;
+    }
+    int person, camera;
+    CHECK(ParseMarket1501Name(name, &person, &camera))
+        << "Not a re-ID image name: " << name;
+    names->push_back(name);
+    persons->push_back(person);
+    cameras->push_back(camera);
+  }
+}
+
+void ReIDFeatures::Load(const string& backend, const string& source,
+    const string& list) {
+  names_.clear();
+  persons_.clear();
+  cameras_.clear();
+  if (backend == "store") {
+    store_.Open(source);
+    num_ = store_.num_embeddings();
+    dim_ = store_.dim();
+    if (store_.type() == EmbeddingStore::FLOAT) {
+      features_.clear();
+      data_ = store_.data();
+    } else {
+      features_.resize(static_cast<size_t>(num_) * dim_);
+      store_.Decode(0, num_, &features_[0]);
+      data_ = &features_[0];
+    }
+    if (list.empty()) {
+      for (int i = 0; i < num_; ++i) {
+        names_.push_back(store_.name(i));
+        persons_.push_back(store_.person(i));
+        cameras_.push_back(store_.camera(i));
+      }
+    }
+  } else {
+    store_.Close();
+    ReadReIDFeatures(backend, source, &features_, &dim_);
+    num_ = features_.size() / dim_;
+    data_ = &features_[0];
+  }
+  if (list.size()) {
+    ReadReIDList(list, &names_, &persons_, &cameras_);
+    CHECK_EQ(num_, names_.size()) << "The list " << list
+        << " does not match the features of " << source;
+  }
+  for (int i = 0; i < names_.size(); ++i) {
+    if (names_[i].empty()) {
+      names_[i] = format_int(i);
+    }
+  }
+}
+
+void ReIDDistances(const float* queries, int num_queries,
+    const float* gallery, int num_gallery, int dim, bool cosine,
+    float* distances) {
+  vector<float> query_norms(num_queries);
+  vector<float> gallery_norms(num_gallery);
+  for (int i = 0; i < num_queries; ++i) {
+    const float* query = queries + static_cast<size_t>(i) * dim;
+    query_norms[i] = caffe_cpu_dot(dim, query, query);
+  }
+  for (int j = 0; j < num_gallery; ++j) {
+    const float* item = gallery + static_cast<size_t>(j) * dim;
+    gallery_norms[j] = caffe_cpu_dot(dim, item, item);
+  }
+  caffe_cpu_gemm<float>(CblasNoTrans, CblasTrans, num_queries, num_gallery,
+      dim, 1., queries, gallery, 0., distances);
+  for (int i = 0; i < num_queries; ++i) {
+    float* row = distances + static_cast<size_t>(i) * num_gallery;
+    if (cosine) {
+      // Embeddings of norm 0 are as far from everything as can be.
+      const float query_norm = std::sqrt(query_norms[i]);
+      for (int j = 0; j < num_gallery; ++j) {
+        const float norm = query_norm * std::sqrt(gallery_norms[j]);
+        row[j] = norm > 0 ? 1 - row[j] / norm : 2;
+      }
+    } else {
+      for (int j = 0; j < num_gallery; ++j) {
+        row[j] = std::max(query_norms[i] + gallery_norms[j] - 2 * row[j], 0.f);
+      }
+    }
+  }
+}
+
+namespace {
+
+// Orders gallery items by distance, then by index.
+struct NearerThan {
+  explicit NearerThan(const float* distances) : distances_(distances) {}
+  bool operator()(int a, int b) const {
+    return distances_[a] < distances_[b] ||
+        (distances_[a] == distances_[b] && a < b);
+  }
+  const float* distances_;
+};
+
+}  // namespace
+
+void ReIDTopK(const float* distances, int n, int k, vector<int>* top) {
+  k = std::min(k, n);
+  top->resize(n);
+  for (int i = 0; i < n; ++i) {
+    (*top)[i] = i;
+  }
+  std::partial_sort(top->begin(), top->begin() + k, top->end(),
+      NearerThan(distances));
+  top->resize(k);
+}
+
+ReIDEvaluator::ReIDEvaluator(const vector<int>& persons,
+    const vector<int>& cameras)
+    : persons_(persons), cameras_(cameras), junk_(persons.size()) {
+  CHECK_EQ(persons.size(), cameras.size());
+  for (int i = 0; i < persons_.size(); ++i) {
+    junk_[i] = persons_[i] < 0;
+    if (!junk_[i]) {
+      items_of_[persons_[i]].push_back(i);
+    }
+  }
+}
+
+ReIDEvaluator::Score ReIDEvaluator::Evaluate(const float* distances,
+    int person, int camera) const {
+  Score score;
+  score.first_match = -1;
+  score.average_precision = 0;
+  map<int, vector<int> >::const_iterator items = items_of_.find(person);
+  if (items == items_of_.end()) {
+    return score;
+  }
+  // The true matches in ranking order, and the query's own junk.
+  vector<int> matches;
+  vector<int> own_junk;
+  for (int i = 0; i < items->second.size(); ++i) {
+    const int item = items->second[i];
+    (cameras_[item] == camera ? own_junk : matches).push_back(item);
+  }
+  if (matches.empty()) {
+    return score;
+  }
+  const NearerThan nearer(distances);
+  std::sort(matches.begin(), matches.end(), nearer);
+  // ahead[k] counts the ranked items nearer than matches[k] but not than
+  // matches[k - 1]; most items are farther than all the matches.
+  vector<int> ahead(matches.size() + 1, 0);
+  const int last = matches.back();
+  for (int i = 0; i < persons_.size(); ++i) {
+    if (!junk_[i] && nearer(i, last)) {
+      ++ahead[std::upper_bound(matches.begin(), matches.end(), i, nearer) -
+          matches.begin()];
+    }
+  }
+  for (int i = 0; i < own_junk.size(); ++i) {
+    if (nearer(own_junk[i], last)) {
+      --ahead[std::upper_bound(matches.begin(), matches.end(), own_junk[i],
+          nearer) - matches.begin()];
+    }
+  }
+  int rank = 0;
+  for (int k = 0; k < matches.size(); ++k) {
+    // The other matches are among the items ahead.
+    rank += ahead[k];
+    if (k == 0) {
+      score.first_match = rank;
+    }
+    score.average_precision += (k + 1.) / (rank + 1);
+  }
+  score.average_precision /= matches.size();
+  return score;
+}
+
+double ReIDSummary(const vector<ReIDEvaluator::Score>& scores, int max_rank,
+    vector<double>* cmc) {
+  cmc->assign(max_rank, 0);
+  double average_precision = 0;
+  int num_scored = 0;
+  for (int i = 0; i < scores.size(); ++i) {
+    if (scores[i].first_match < 0) {
+      continue;
+    }
+    ++num_scored;
+    average_precision += scores[i].average_precision;
+    if (scores[i].first_match < max_rank) {
+      ++(*cmc)[scores[i].first_match];
+    }
+  }
+  for (int r = 0; r < max_rank; ++r) {
+    (*cmc)[r] = (r > 0 ? (*cmc)[r - 1] : 0) +
+        (num_scored > 0 ? (*cmc)[r] / num_scored : 0);
+  }
+  return num_scored > 0 ? average_precision / num_scored : 0;
+}
+
+}  // namespace caffe
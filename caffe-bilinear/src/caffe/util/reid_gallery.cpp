@@ -0,0 +1,441 @@
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/reid_gallery.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Uncompacted sealed segments that make a compaction worthwhile.
+const int kMaxUncompacted = 4;
+
+bool NearerMatch(const ReIDMatch& a, const ReIDMatch& b) {
+  return a.distance < b.distance ||
+      (a.distance == b.distance && a.index < b.index);
+}
+
+}  // namespace
+
+struct ReIDGallery::Segment {
+  Segment() : num_deleted(0), sealed(false), compacted(false) {}
+
+  inline int size() const { return ids.size(); }
+
+  vector<float> data;
+  vector<int> ids;
+  vector<int> cameras;
+  vector<bool> deleted;
+  int num_deleted;
+  bool sealed;
+  bool compacted;
+  // Searches the segment once sealed, unless it has an index.
+  shared_ptr<ReIDSearch> search;
+  shared_ptr<ANNIndex> index;
+};
+
+class ReIDGallery::sync {
+ public:
+  // Guards the segments and the locations; searches share it.
+  // boost::shared_mutex lets back-to-back searches starve updates, so a
+  // writer holds the turnstile while it waits, and readers pass it first.
+  class ReadLock {
+   public:
+    explicit ReadLock(const sync* s) : lock_(s->mutex_, boost::defer_lock) {
+      { boost::mutex::scoped_lock turnstile(s->turnstile_); }
+      lock_.lock();
+    }
+
+   private:
+    boost::shared_lock<boost::shared_mutex> lock_;
+  };
+  class WriteLock {
+   public:
+    explicit WriteLock(const sync* s) : lock_(s->mutex_, boost::defer_lock) {
+      boost::mutex::scoped_lock turnstile(s->turnstile_);
+      lock_.lock();
+    }
+
+   private:
+    boost::unique_lock<boost::shared_mutex> lock_;
+  };
+
+  mutable boost::shared_mutex mutex_;
+  mutable boost::mutex turnstile_;
+  // Held for the whole of a compaction.
+  boost::mutex compaction_mutex_;
+  // Guards compacting_ and thread_.
+  boost::mutex thread_mutex_;
+  boost::condition_variable compacted_;
+  bool compacting_;
+  shared_ptr<boost::thread> thread_;
+  // The segment and row of every live item.
+  boost::unordered_map<int, std::pair<Segment*, int> > locations_;
+};
+
+ReIDGallery::ReIDGallery(int dim, bool cosine, const string& type)
+    : dim_(dim), cosine_(cosine), type_(type), segment_size_(4096),
+      min_index_size_(1), effort_(0), auto_compaction_(true), next_id_(0), num_deleted_(0),
+      sync_(new sync()) {
+  CHECK_GT(dim, 0);
+  if (type != "exact") {
+    // Fails early on unknown types.
+    boost::scoped_ptr<ANNIndex> index(GetANNIndex(type, dim, cosine));
+    min_index_size_ = index->min_train_size();
+  }
+  sync_->compacting_ = false;
+}
+
+ReIDGallery::~ReIDGallery() {
+  WaitForCompaction();
+  boost::mutex::scoped_lock lock(sync_->thread_mutex_);
+  if (sync_->thread_) {
+    sync_->thread_->join();
+  }
+}
+
+void ReIDGallery::set_segment_size(int segment_size) {
+  CHECK_GT(segment_size, 0);
+  sync::WriteLock lock(sync_.get());
+  segment_size_ = segment_size;
+}
+
+void ReIDGallery::set_effort(int effort) {
+  CHECK_GT(effort, 0);
+  sync::WriteLock lock(sync_.get());
+  effort_ = effort;
+  for (int s = 0; s < segments_.size(); ++s) {
+    if (segments_[s]->index) {
+      segments_[s]->index->set_effort(effort);
+    }
+  }
+}
+
+int ReIDGallery::size() const {
+  sync::ReadLock lock(sync_.get());
+  return sync_->locations_.size();
+}
+
+int ReIDGallery::num_deleted() const {
+  sync::ReadLock lock(sync_.get());
+  return num_deleted_;
+}
+
+int ReIDGallery::num_segments() const {
+  sync::ReadLock lock(sync_.get());
+  return segments_.size();
+}
+
+int ReIDGallery::Add(const float* embedding, int camera) {
+  return Add(embedding, 1, &camera);
+}
+
+int ReIDGallery::Add(const float* embeddings, int num, const int* cameras) {
+  int first;
+  {
+    sync::WriteLock lock(sync_.get());
+    first = next_id_;
+    for (int i = 0; i < num; ++i) {
+      Append(embeddings + static_cast<size_t>(i) * dim_,
+          cameras ? cameras[i] : -1);
+    }
+  }
+  MaybeStartCompaction();
+  return first;
+}
+
+void ReIDGallery::Append(const float* embedding, int camera) {
+  if (segments_.empty() || segments_.back()->sealed) {
+    segments_.push_back(shared_ptr<Segment>(new Segment()));
+  }
+  Segment* segment = segments_.back().get();
+  sync_->locations_[next_id_] = std::make_pair(segment, segment->size());
+  segment->data.insert(segment->data.end(), embedding, embedding + dim_);
+  segment->ids.push_back(next_id_++);
+  segment->cameras.push_back(camera);
+  segment->deleted.push_back(false);
+  if (segment->size() >= segment_size_) {
+    Seal();
+  }
+}
+
+void ReIDGallery::Seal() {
+  Segment* segment = segments_.back().get();
+  segment->sealed = true;
+  segment->search.reset(new ReIDSearch(&segment->data[0], segment->size(),
+      dim_, cosine_));
+  segment->search->set_cameras(segment->cameras);
+}
+
+bool ReIDGallery::Remove(int id) {
+  {
+    sync::WriteLock lock(sync_.get());
+    boost::unordered_map<int, std::pair<Segment*, int> >::iterator
+        location = sync_->locations_.find(id);
+    if (location == sync_->locations_.end()) {
+      return false;
+    }
+    Segment* segment = location->second.first;
+    segment->deleted[location->second.second] = true;
+    ++segment->num_deleted;
+    ++num_deleted_;
+    sync_->locations_.erase(location);
+  }
+  MaybeStartCompaction();
+  return true;
+}
+
+void ReIDGallery::SearchRows(const Segment& segment,
+    const ReIDSearch* search, const float* queries, int num_queries,
+    const int* query_cameras, int k, vector<vector<ReIDMatch> >* matches,
+    ThreadPool* pool) const {
+  if (segment.index) {
+    segment.index->Search(queries, num_queries, k, matches, pool);
+  } else {
+    search->Search(queries, num_queries, query_cameras, k, matches, pool);
+  }
+}
+
+void ReIDGallery::SearchSegment(const Segment& segment, const float* queries,
+    int num_queries, const int* query_cameras, int k,
+    vector<vector<ReIDMatch> >* results, ThreadPool* pool) const {
+  const int n = segment.size();
+  results->assign(num_queries, vector<ReIDMatch>());
+  if (n == segment.num_deleted) {
+    return;
+  }
+  // The active segment is searched by a ReIDSearch of the moment.
+  const ReIDSearch* search = segment.search.get();
+  boost::scoped_ptr<ReIDSearch> active;
+  if (!segment.index && !search) {
+    active.reset(new ReIDSearch(&segment.data[0], n, dim_, cosine_));
+    active->set_cameras(segment.cameras);
+    search = active.get();
+  }
+  // Deleted items, and for an index the items of the query camera, are
+  // left out after the search: search further for the queries that keep
+  // fewer than k.
+  const bool filter_cameras = segment.index && query_cameras;
+  const int fetch = std::min(n,
+      segment.num_deleted > 0 || filter_cameras ? 2 * k : k);
+  vector<vector<ReIDMatch> > matches, more;
+  SearchRows(segment, search, queries, num_queries, query_cameras, fetch,
+      &matches, pool);
+  for (int i = 0; i < num_queries; ++i) {
+    const int camera = filter_cameras ? query_cameras[i] : -1;
+    vector<ReIDMatch>& found = (*results)[i];
+    for (int query_fetch = fetch; ; ) {
+      found.clear();
+      for (int r = 0; r < matches[i].size() && found.size() < k; ++r) {
+        const int row = matches[i][r].index;
+        if (!segment.deleted[row] &&
+            (camera < 0 || segment.cameras[row] != camera)) {
+          found.push_back(matches[i][r]);
+        }
+      }
+      // Fewer matches than asked for leave nothing more to find.
+      if (found.size() == k || query_fetch == n ||
+          matches[i].size() < query_fetch) {
+        break;
+      }
+      query_fetch = std::min(n, 2 * query_fetch);
+      SearchRows(segment, search, queries + static_cast<size_t>(i) * dim_,
+          1, query_cameras ? query_cameras + i : NULL, query_fetch, &more,
+          NULL);
+      matches[i].swap(more[0]);
+    }
+    for (int r = 0; r < found.size(); ++r) {
+      found[r].index = segment.ids[found[r].index];
+    }
+  }
+}
+
+void ReIDGallery::Search(const float* queries, int num_queries,
+    const int* query_cameras, int k, vector<vector<ReIDMatch> >* results,
+    ThreadPool* pool) const {
+  CHECK_GT(k, 0);
+  results->assign(num_queries, vector<ReIDMatch>());
+  sync::ReadLock lock(sync_.get());
+  vector<vector<ReIDMatch> > matches;
+  for (int s = 0; s < segments_.size(); ++s) {
+    SearchSegment(*segments_[s], queries, num_queries, query_cameras, k,
+        &matches, pool);
+    for (int i = 0; i < num_queries; ++i) {
+      vector<ReIDMatch>& nearest = (*results)[i];
+      nearest.insert(nearest.end(), matches[i].begin(), matches[i].end());
+      const int count = std::min<int>(k, nearest.size());
+      std::partial_sort(nearest.begin(), nearest.begin() + count,
+          nearest.end(), NearerMatch);
+      nearest.resize(count);
+    }
+  }
+}
+
+bool ReIDGallery::NeedsCompaction() const {
+  sync::ReadLock lock(sync_.get());
+  int stored = 0;
+  int uncompacted = 0;
+  for (int s = 0; s < segments_.size(); ++s) {
+    stored += segments_[s]->size();
+    uncompacted += segments_[s]->sealed && !segments_[s]->compacted;
+  }
+  return 4 * num_deleted_ > stored || uncompacted >= kMaxUncompacted;
+}
+
+void ReIDGallery::Compact() {
+  Merge(true);
+}
+
+void ReIDGallery::Merge(bool all) {
+  boost::mutex::scoped_lock compaction(sync_->compaction_mutex_);
+  vector<shared_ptr<Segment> > merging;
+  // Merged segments are segments_[begin, begin + merging.size()).
+  int begin = 0;
+  {
+    sync::WriteLock lock(sync_.get());
+    int stored = 0;
+    for (int s = 0; s < segments_.size(); ++s) {
+      stored += segments_[s]->size();
+    }
+    // Deleted items are only dropped from the segments merged, so many of
+    // them take merging everything.
+    all = all || 4 * num_deleted_ > stored;
+    if (all) {
+      if (!segments_.empty() && !segments_.back()->sealed) {
+        Seal();
+      }
+      if (segments_.empty() || (segments_.size() == 1 &&
+          segments_[0]->compacted && segments_[0]->num_deleted == 0)) {
+        return;
+      }
+      merging = segments_;
+    } else {
+      // Compacted segments come first, then the sealed ones, then the
+      // active one. The sealed ones are merged with the latest compacted
+      // segments no larger than what is merged so far, so that compacted
+      // segments grow geometrically and each item is merged a logarithmic
+      // number of times.
+      int end = segments_.size();
+      if (end > 0 && !segments_.back()->sealed) {
+        --end;
+      }
+      begin = end;
+      int live = 0;
+      while (begin > 0 && !segments_[begin - 1]->compacted) {
+        --begin;
+        live += segments_[begin]->size() - segments_[begin]->num_deleted;
+      }
+      if (begin == end) {
+        return;
+      }
+      while (begin > 0 && segments_[begin - 1]->size() -
+          segments_[begin - 1]->num_deleted <= live) {
+        --begin;
+        live += segments_[begin]->size() - segments_[begin]->num_deleted;
+      }
+      merging.assign(segments_.begin() + begin, segments_.begin() + end);
+    }
+  }
+  // Sealed segments only change by deletions, which take the lock
+  // exclusively.
+  shared_ptr<Segment> merged(new Segment());
+  {
+    sync::ReadLock lock(sync_.get());
+    for (int s = 0; s < merging.size(); ++s) {
+      const Segment& segment = *merging[s];
+      for (int row = 0; row < segment.size(); ++row) {
+        if (!segment.deleted[row]) {
+          const float* embedding =
+              &segment.data[static_cast<size_t>(row) * dim_];
+          merged->data.insert(merged->data.end(), embedding,
+              embedding + dim_);
+          merged->ids.push_back(segment.ids[row]);
+          merged->cameras.push_back(segment.cameras[row]);
+        }
+      }
+    }
+  }
+  const int n = merged->size();
+  merged->deleted.resize(n);
+  merged->sealed = true;
+  merged->compacted = true;
+  // Segments smaller than segment_size are not worth an index, and those
+  // too small to train one on are searched exhaustively.
+  if (type_ != "exact" && n >= std::max(segment_size_, min_index_size_)) {
+    merged->index.reset(GetANNIndex(type_, dim_, cosine_));
+    merged->index->Build(&merged->data[0], n);
+    merged->index->set_exact_embeddings(&merged->data[0]);
+  } else if (n > 0) {
+    merged->search.reset(new ReIDSearch(&merged->data[0], n, dim_, cosine_));
+    merged->search->set_cameras(merged->cameras);
+  }
+
+  sync::WriteLock lock(sync_.get());
+  if (merged->index && effort_ > 0) {
+    merged->index->set_effort(effort_);
+  }
+  for (int s = 0; s < merging.size(); ++s) {
+    num_deleted_ -= merging[s]->num_deleted;
+  }
+  for (int row = 0; row < n; ++row) {
+    boost::unordered_map<int, std::pair<Segment*, int> >::iterator
+        location = sync_->locations_.find(merged->ids[row]);
+    if (location == sync_->locations_.end()) {
+      // Removed while merging.
+      merged->deleted[row] = true;
+      ++merged->num_deleted;
+    } else {
+      location->second = std::make_pair(merged.get(), row);
+    }
+  }
+  num_deleted_ += merged->num_deleted;
+  // Segments are only appended meanwhile, after those merged.
+  segments_.erase(segments_.begin() + begin,
+      segments_.begin() + begin + merging.size());
+  if (n > 0) {
+    segments_.insert(segments_.begin() + begin, merged);
+  }
+}
+
+void ReIDGallery::CompactionEntry() {
+  Merge(false);
+  boost::mutex::scoped_lock lock(sync_->thread_mutex_);
+  sync_->compacting_ = false;
+  sync_->compacted_.notify_all();
+}
+
+void ReIDGallery::StartCompaction() {
+  boost::mutex::scoped_lock lock(sync_->thread_mutex_);
+  if (sync_->compacting_) {
+    return;
+  }
+  if (sync_->thread_) {
+    sync_->thread_->join();
+  }
+  sync_->compacting_ = true;
+  sync_->thread_.reset(new boost::thread(&ReIDGallery::CompactionEntry,
+      this));
+}
+
+void ReIDGallery::WaitForCompaction() {
+  boost::mutex::scoped_lock lock(sync_->thread_mutex_);
+  while (sync_->compacting_) {
+    sync_->compacted_.wait(lock);
+  }
+}
+
+void ReIDGallery::MaybeStartCompaction() {
+  if (auto_compaction_ && NeedsCompaction()) {
+    StartCompaction();
+  }
+}
+
+}  // namespace caffe
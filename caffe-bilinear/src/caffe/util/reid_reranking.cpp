@@ -0,0 +1,254 @@
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/reid_reranking.hpp"
+#include "caffe/util/reid_search.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Merges the matches among the queries and among the gallery, both nearest
+// first, into the k nearest items; gallery item g is item num_queries + g.
+void MergeMatches(const vector<ReIDMatch>& query_matches,
+    const vector<ReIDMatch>& gallery_matches, int num_queries, int k,
+    vector<int>* items) {
+  items->clear();
+  int q = 0, g = 0;
+  while (items->size() < k && (q < query_matches.size() ||
+      g < gallery_matches.size())) {
+    // Ties go to the query, the lower item.
+    if (g == gallery_matches.size() || (q < query_matches.size() &&
+        query_matches[q].distance <= gallery_matches[g].distance)) {
+      items->push_back(query_matches[q++].index);
+    } else {
+      items->push_back(num_queries + gallery_matches[g++].index);
+    }
+  }
+}
+
+}  // namespace
+
+ReIDReranker::ReIDReranker(const float* queries, int num_queries,
+    const float* gallery, int num_gallery, int dim, bool cosine, int k1,
+    int k2, float lambda)
+    : queries_(queries), num_queries_(num_queries), gallery_(gallery),
+      num_gallery_(num_gallery), dim_(dim), cosine_(cosine), k1_(k1),
+      k2_(k2), lambda_(lambda) {
+  CHECK_GT(num_queries, 0);
+  CHECK_GT(num_gallery, 0);
+  CHECK_GT(k1, 0);
+  CHECK_GT(k2, 0);
+  CHECK_LE(k2, k1 + 1) << "k2 neighbors must be among the k1 + 1 found.";
+  CHECK(lambda >= 0 && lambda <= 1) << "lambda must be in [0, 1].";
+  norms_.resize(num_items());
+  for (int i = 0; i < num_items(); ++i) {
+    const float* e = embedding(i);
+    norms_[i] = caffe_cpu_dot(dim_, e, e);
+    if (cosine_) {
+      norms_[i] = std::sqrt(norms_[i]);
+    }
+  }
+}
+
+float ReIDReranker::Distance(int a, int b) const {
+  const float dot = caffe_cpu_dot(dim_, embedding(a), embedding(b));
+  if (cosine_) {
+    const float norm = norms_[a] * norms_[b];
+    return norm > 0 ? 1 - dot / norm : 2;
+  }
+  return std::max(norms_[a] + norms_[b] - 2 * dot, 0.f);
+}
+
+void ReIDReranker::FindNeighbors(ThreadPool* pool) {
+  const int k = std::min(k1_ + 1, num_items());
+  ReIDSearch query_search(queries_, num_queries_, dim_, cosine_);
+  ReIDSearch gallery_search(gallery_, num_gallery_, dim_, cosine_);
+  const int query_k = std::min(k, num_queries_);
+  const int gallery_k = std::min(k, num_gallery_);
+  neighbors_.resize(num_items());
+  // Searched a set at a time, to hold the matches of one set only.
+  vector<vector<ReIDMatch> > query_matches, gallery_matches;
+  query_search.Search(queries_, num_queries_, NULL, query_k, &query_matches,
+      pool);
+  gallery_search.Search(queries_, num_queries_, NULL, gallery_k,
+      &gallery_matches, pool);
+  for (int i = 0; i < num_queries_; ++i) {
+    MergeMatches(query_matches[i], gallery_matches[i], num_queries_, k,
+        &neighbors_[i]);
+  }
+  query_search.Search(gallery_, num_gallery_, NULL, query_k, &query_matches,
+      pool);
+  gallery_search.Search(gallery_, num_gallery_, NULL, gallery_k,
+      &gallery_matches, pool);
+  for (int i = 0; i < num_gallery_; ++i) {
+    MergeMatches(query_matches[i], gallery_matches[i], num_queries_, k,
+        &neighbors_[num_queries_ + i]);
+  }
+}
+
+bool ReIDReranker::IsNeighbor(int a, int b, int k) const {
+  const vector<int>& neighbors = neighbors_[a];
+  const int count = std::min<int>(k + 1, neighbors.size());
+  return std::find(neighbors.begin(), neighbors.begin() + count, b) !=
+      neighbors.begin() + count;
+}
+
+void ReIDReranker::ReciprocalNeighbors(int item, int k,
+    vector<int>* neighbors) const {
+  neighbors->clear();
+  const vector<int>& forward = neighbors_[item];
+  const int count = std::min<int>(k + 1, forward.size());
+  for (int i = 0; i < count; ++i) {
+    if (IsNeighbor(forward[i], item, k)) {
+      neighbors->push_back(forward[i]);
+    }
+  }
+}
+
+void ReIDReranker::EncodePart(int part, int num_parts) {
+  int begin, end;
+  ThreadPool::Partition(num_items(), num_parts, part, &begin, &end);
+  const int half = (k1_ + 1) / 2;
+  vector<int> reciprocal, candidates, expanded;
+  for (int item = begin; item < end; ++item) {
+    ReciprocalNeighbors(item, k1_, &reciprocal);
+    expanded = reciprocal;
+    // Add the reciprocal sets of the neighbors that are mostly reciprocal
+    // neighbors already.
+    for (int i = 0; i < reciprocal.size(); ++i) {
+      ReciprocalNeighbors(reciprocal[i], half, &candidates);
+      int shared = 0;
+      for (int j = 0; j < candidates.size(); ++j) {
+        shared += std::find(reciprocal.begin(), reciprocal.end(),
+            candidates[j]) != reciprocal.end();
+      }
+      if (3 * shared > 2 * candidates.size()) {
+        expanded.insert(expanded.end(), candidates.begin(), candidates.end());
+      }
+    }
+    std::sort(expanded.begin(), expanded.end());
+    expanded.erase(std::unique(expanded.begin(), expanded.end()),
+        expanded.end());
+    // Unscaled squared euclidean distances would make every weight but the
+    // item's own underflow.
+    const float farthest = Distance(item, neighbors_[item].back());
+    const float scale = farthest > 0 ? 1 / farthest : 0;
+    vector<Entry>& encoding = encodings_[item];
+    encoding.resize(expanded.size());
+    float sum = 0;
+    for (int i = 0; i < expanded.size(); ++i) {
+      encoding[i].index = expanded[i];
+      encoding[i].weight = std::exp(-scale * Distance(item, expanded[i]));
+      sum += encoding[i].weight;
+    }
+    for (int i = 0; i < encoding.size(); ++i) {
+      encoding[i].weight /= sum;
+    }
+  }
+}
+
+void ReIDReranker::ExpandQueryPart(const vector<vector<Entry> >* encodings,
+    int part, int num_parts) {
+  int begin, end;
+  ThreadPool::Partition(num_items(), num_parts, part, &begin, &end);
+  // Encodings are summed densely; weights are positive, so a zero sum
+  // marks an item not yet held.
+  vector<float> sums(num_items());
+  vector<int> held;
+  for (int item = begin; item < end; ++item) {
+    const vector<int>& neighbors = neighbors_[item];
+    const int count = std::min<int>(k2_, neighbors.size());
+    held.clear();
+    for (int n = 0; n < count; ++n) {
+      const vector<Entry>& encoding = (*encodings)[neighbors[n]];
+      for (int i = 0; i < encoding.size(); ++i) {
+        if (sums[encoding[i].index] == 0) {
+          held.push_back(encoding[i].index);
+        }
+        sums[encoding[i].index] += encoding[i].weight;
+      }
+    }
+    std::sort(held.begin(), held.end());
+    vector<Entry>& expanded = encodings_[item];
+    expanded.resize(held.size());
+    for (int i = 0; i < held.size(); ++i) {
+      expanded[i].index = held[i];
+      expanded[i].weight = sums[held[i]] / count;
+      sums[held[i]] = 0;
+    }
+  }
+}
+
+void ReIDReranker::Encode(ThreadPool* pool) {
+  CHECK_EQ(neighbors_.size(), num_items()) << "Find the neighbors first.";
+  encodings_.assign(num_items(), vector<Entry>());
+  if (pool) {
+    pool->Run(boost::bind(&ReIDReranker::EncodePart, this, _1,
+        pool->num_threads()));
+  } else {
+    EncodePart(0, 1);
+  }
+  if (k2_ > 1) {
+    vector<vector<Entry> > encodings(num_items());
+    encodings.swap(encodings_);
+    if (pool) {
+      pool->Run(boost::bind(&ReIDReranker::ExpandQueryPart, this,
+          &encodings, _1, pool->num_threads()));
+    } else {
+      ExpandQueryPart(&encodings, 0, 1);
+    }
+  }
+  // Invert the gallery encodings; only those of the queries are kept as
+  // they are, and the neighbors are no longer needed.
+  inverted_begin_.assign(num_items() + 1, 0);
+  for (int g = 0; g < num_gallery_; ++g) {
+    const vector<Entry>& encoding = encodings_[num_queries_ + g];
+    for (int i = 0; i < encoding.size(); ++i) {
+      ++inverted_begin_[encoding[i].index + 1];
+    }
+  }
+  for (int i = 0; i < num_items(); ++i) {
+    inverted_begin_[i + 1] += inverted_begin_[i];
+  }
+  inverted_.resize(inverted_begin_.back());
+  vector<size_t> next(inverted_begin_.begin(), inverted_begin_.end() - 1);
+  for (int g = 0; g < num_gallery_; ++g) {
+    const vector<Entry>& encoding = encodings_[num_queries_ + g];
+    for (int i = 0; i < encoding.size(); ++i) {
+      Entry& entry = inverted_[next[encoding[i].index]++];
+      entry.index = g;
+      entry.weight = encoding[i].weight;
+    }
+  }
+  encodings_.resize(num_queries_);
+  vector<vector<int> >().swap(neighbors_);
+}
+
+void ReIDReranker::Rerank(int query, float* distances) const {
+  CHECK_EQ(inverted_begin_.size(), num_items() + 1) << "Encode first.";
+  CHECK_GE(query, 0);
+  CHECK_LT(query, num_queries_);
+  // Encodings sum to 1, so the sum of the maxima is 2 minus that of the
+  // minima.
+  vector<float> minima(num_gallery_);
+  const vector<Entry>& encoding = encodings_[query];
+  for (int i = 0; i < encoding.size(); ++i) {
+    const float weight = encoding[i].weight;
+    const size_t end = inverted_begin_[encoding[i].index + 1];
+    for (size_t j = inverted_begin_[encoding[i].index]; j < end; ++j) {
+      minima[inverted_[j].index] += std::min(weight, inverted_[j].weight);
+    }
+  }
+  for (int g = 0; g < num_gallery_; ++g) {
+    const float jaccard = 1 - minima[g] / (2 - minima[g]);
+    distances[g] = (1 - lambda_) * jaccard + lambda_ * distances[g];
+  }
+}
+
+}  // namespace caffe
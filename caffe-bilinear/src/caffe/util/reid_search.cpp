@@ -0,0 +1,135 @@
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/reid_search.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Orders matches by distance, then by index; the heaps keep the farthest of
+// their matches on top.
+inline bool NearerMatch(const ReIDMatch& a, const ReIDMatch& b) {
+  return a.distance < b.distance ||
+      (a.distance == b.distance && a.index < b.index);
+}
+
+}  // namespace
+
+ReIDSearch::ReIDSearch(const float* gallery, int num_gallery, int dim,
+    bool cosine)
+    : gallery_(gallery), num_gallery_(num_gallery), dim_(dim),
+      cosine_(cosine), gallery_norms_(num_gallery), block_size_(32),
+      tile_size_(4096) {
+  CHECK_GT(dim, 0);
+  for (int j = 0; j < num_gallery; ++j) {
+    const float* embedding = gallery + static_cast<size_t>(j) * dim;
+    gallery_norms_[j] = caffe_cpu_dot(dim, embedding, embedding);
+    if (cosine) {
+      gallery_norms_[j] = std::sqrt(gallery_norms_[j]);
+    }
+  }
+}
+
+void ReIDSearch::set_cameras(const vector<int>& cameras) {
+  CHECK_EQ(num_gallery_, cameras.size());
+  cameras_ = cameras;
+}
+
+void ReIDSearch::set_block_size(int block_size) {
+  CHECK_GT(block_size, 0);
+  block_size_ = block_size;
+}
+
+void ReIDSearch::set_tile_size(int tile_size) {
+  CHECK_GT(tile_size, 0);
+  tile_size_ = tile_size;
+}
+
+void ReIDSearch::Search(const float* queries, int num_queries,
+    const int* query_cameras, int k, vector<vector<ReIDMatch> >* results,
+    ThreadPool* pool) const {
+  CHECK_GT(k, 0);
+  CHECK(!query_cameras || cameras_.size())
+      << "Set the gallery cameras to search by camera.";
+  results->resize(num_queries);
+  if (pool) {
+    pool->Run(boost::bind(&ReIDSearch::SearchPart, this, queries,
+        num_queries, query_cameras, k, results, _1, pool->num_threads()));
+  } else {
+    SearchPart(queries, num_queries, query_cameras, k, results, 0, 1);
+  }
+}
+
+void ReIDSearch::SearchPart(const float* queries, int num_queries,
+    const int* query_cameras, int k, vector<vector<ReIDMatch> >* results,
+    int part, int num_parts) const {
+  int begin, end;
+  ThreadPool::Partition(num_queries, num_parts, part, &begin, &end);
+  vector<float> tile(static_cast<size_t>(block_size_) *
+      std::min(tile_size_, std::max(num_gallery_, 1)));
+  for (int block = begin; block < end; block += block_size_) {
+    SearchBlock(queries + static_cast<size_t>(block) * dim_,
+        std::min(block_size_, end - block),
+        query_cameras ? query_cameras + block : NULL, k, &tile[0],
+        &(*results)[block]);
+  }
+}
+
+void ReIDSearch::SearchBlock(const float* queries, int num_queries,
+    const int* query_cameras, int k, float* tile,
+    vector<ReIDMatch>* heaps) const {
+  vector<float> query_norms(num_queries);
+  for (int i = 0; i < num_queries; ++i) {
+    const float* query = queries + static_cast<size_t>(i) * dim_;
+    query_norms[i] = caffe_cpu_dot(dim_, query, query);
+    if (cosine_) {
+      query_norms[i] = std::sqrt(query_norms[i]);
+    }
+    heaps[i].clear();
+    heaps[i].reserve(std::min(k, num_gallery_));
+  }
+  for (int start = 0; start < num_gallery_; start += tile_size_) {
+    const int count = std::min(tile_size_, num_gallery_ - start);
+    caffe_cpu_gemm<float>(CblasNoTrans, CblasTrans, num_queries, count, dim_,
+        1., queries, gallery_ + static_cast<size_t>(start) * dim_, 0., tile);
+    for (int i = 0; i < num_queries; ++i) {
+      const float* dots = tile + static_cast<size_t>(i) * count;
+      const int camera = query_cameras ? query_cameras[i] : -1;
+      vector<ReIDMatch>& heap = heaps[i];
+      for (int j = 0; j < count; ++j) {
+        const int index = start + j;
+        if (camera >= 0 && cameras_[index] == camera) {
+          continue;
+        }
+        ReIDMatch match;
+        match.index = index;
+        if (cosine_) {
+          const float norm = query_norms[i] * gallery_norms_[index];
+          match.distance = norm > 0 ? 1 - dots[j] / norm : 2;
+        } else {
+          match.distance = std::max(
+              query_norms[i] + gallery_norms_[index] - 2 * dots[j], 0.f);
+        }
+        if (heap.size() < k) {
+          heap.push_back(match);
+          std::push_heap(heap.begin(), heap.end(), NearerMatch);
+        } else if (NearerMatch(match, heap.front())) {
+          std::pop_heap(heap.begin(), heap.end(), NearerMatch);
+          heap.back() = match;
+          std::push_heap(heap.begin(), heap.end(), NearerMatch);
+        }
+      }
+    }
+  }
+  for (int i = 0; i < num_queries; ++i) {
+    std::sort_heap(heaps[i].begin(), heaps[i].end(), NearerMatch);
+  }
+}
+
+}  // namespace caffe
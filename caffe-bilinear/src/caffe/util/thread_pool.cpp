@@ -0,0 +1,98 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  sync() : generation_(0), pending_(0), stop_(false) {}
+
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  boost::function<void(int)> task_;
+  // Incremented by every Run, so that each thread runs each task once.
+  uint64_t generation_;
+  int pending_;
+  bool stop_;
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(num_threads), sync_(new sync()) {
+  CHECK_GT(num_threads, 0) << "A thread pool needs at least one thread.";
+  for (int i = 1; i < num_threads; ++i) {
+    threads_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&ThreadPool::Entry, this, i)));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->start_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+}
+
+void ThreadPool::Run(const boost::function<void(int)>& task) {
+  // The pool threads may write into memory owned by the caller, so the
+  // caller must not leave (e.g. on an interruption of InternalThread)
+  // before they are done.
+  boost::this_thread::disable_interruption no_interruption;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->task_ = task;
+    sync_->pending_ = num_threads_ - 1;
+    ++sync_->generation_;
+  }
+  sync_->start_.notify_all();
+  task(0);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->pending_ > 0) {
+    sync_->done_.wait(lock);
+  }
+  sync_->task_.clear();
+}
+
+void ThreadPool::Entry(int thread_id) {
+  uint64_t generation = 0;
+  while (true) {
+    boost::function<void(int)> task;
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      while (!sync_->stop_ && sync_->generation_ == generation) {
+        sync_->start_.wait(lock);
+      }
+      if (sync_->stop_) {
+        return;
+      }
+      generation = sync_->generation_;
+      task = sync_->task_;
+    }
+    task(thread_id);
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      --sync_->pending_;
+    }
+    sync_->done_.notify_one();
+  }
+}
+
+void ThreadPool::Partition(int count, int num_parts, int part,
+    int* begin, int* end) {
+  CHECK_GT(num_parts, 0);
+  CHECK_GE(part, 0);
+  CHECK_LT(part, num_parts);
+  const int size = count / num_parts;
+  const int remainder = count % num_parts;
+  *begin = part * size + std::min(part, remainder);
+  *end = *begin + size + (part < remainder ? 1 : 0);
+}
+
+}  // namespace caffe
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/tracklet_aggregator.hpp"
+
+namespace caffe {
+
+TrackletAggregator::TrackletAggregator(int dim, bool normalize)
+    : dim_(dim), normalize_(normalize), tolerance_(0), max_stride_(1),
+      patience_(3), min_frames_(1), frame_(dim) {
+  CHECK_GT(dim, 0);
+}
+
+void TrackletAggregator::set_tolerance(float tolerance) {
+  CHECK_GE(tolerance, 0);
+  tolerance_ = tolerance;
+}
+
+void TrackletAggregator::set_max_stride(int max_stride) {
+  CHECK_GT(max_stride, 0);
+  max_stride_ = max_stride;
+}
+
+void TrackletAggregator::set_patience(int patience) {
+  CHECK_GT(patience, 0);
+  patience_ = patience;
+}
+
+void TrackletAggregator::set_min_frames(int min_frames) {
+  CHECK_GT(min_frames, 0);
+  min_frames_ = min_frames;
+}
+
+const TrackletAggregator::Tracklet& TrackletAggregator::Find(
+    int tracklet) const {
+  std::map<int, Tracklet>::const_iterator it = tracklets_.find(tracklet);
+  CHECK(it != tracklets_.end()) << "Unknown tracklet " << tracklet;
+  return it->second;
+}
+
+bool TrackletAggregator::IsStable(const Tracklet& state) const {
+  return state.embedded >= min_frames_ && state.calm >= patience_;
+}
+
+bool TrackletAggregator::Contains(int tracklet) const {
+  return tracklets_.count(tracklet) > 0;
+}
+
+bool TrackletAggregator::stable(int tracklet) const {
+  return IsStable(Find(tracklet));
+}
+
+int TrackletAggregator::num_offered(int tracklet) const {
+  return Find(tracklet).offered;
+}
+
+int TrackletAggregator::num_embedded(int tracklet) const {
+  return Find(tracklet).embedded;
+}
+
+bool TrackletAggregator::Offer(int tracklet) {
+  Tracklet& state = tracklets_[tracklet];
+  ++state.offered;
+  if (IsStable(state)) {
+    return false;
+  }
+  if (state.skip > 0) {
+    --state.skip;
+    return false;
+  }
+  return true;
+}
+
+void TrackletAggregator::Add(int tracklet, const float* embedding,
+    float quality) {
+  CHECK_GT(quality, 0) << "Frame qualities must be positive.";
+  Tracklet& state = tracklets_[tracklet];
+  const float* frame = embedding;
+  if (normalize_) {
+    const float norm = std::sqrt(caffe_cpu_dot(dim_, embedding, embedding));
+    caffe_cpu_scale(dim_, norm > 0 ? 1 / norm : 0.f, embedding, &frame_[0]);
+    frame = &frame_[0];
+  }
+  if (state.sum.empty()) {
+    state.sum.assign(dim_, 0);
+  }
+  // The turn of the descriptor is that of the weighted sum, from
+  // S.(S + q f) = |S|^2 + q S.f without keeping the previous sum.
+  const double old_squares = state.sum_squares;
+  const double cross = old_squares + quality *
+      static_cast<double>(caffe_cpu_dot(dim_, &state.sum[0], frame));
+  caffe_axpy(dim_, quality, frame, &state.sum[0]);
+  state.sum_squares = caffe_cpu_dot(dim_, &state.sum[0], &state.sum[0]);
+  state.weight += quality;
+  ++state.embedded;
+  if (old_squares > 0 && state.sum_squares > 0) {
+    const double change =
+        1 - cross / std::sqrt(old_squares * state.sum_squares);
+    // A zero tolerance never counts a frame as calm: rounding can make the
+    // change of a frame along the descriptor slightly negative.
+    if (tolerance_ > 0 && change < tolerance_) {
+      ++state.calm;
+      state.stride = std::min(2 * state.stride, max_stride_);
+    } else {
+      state.calm = 0;
+      state.stride = 1;
+    }
+  }
+  state.skip = state.stride - 1;
+}
+
+void TrackletAggregator::Descriptor(int tracklet, float* descriptor) const {
+  const Tracklet& state = Find(tracklet);
+  if (state.sum.empty()) {
+    caffe_set(dim_, 0.f, descriptor);
+    return;
+  }
+  float scale = 1 / state.weight;
+  if (normalize_) {
+    scale = state.sum_squares > 0 ? 1 / std::sqrt(state.sum_squares) : 0;
+  }
+  caffe_cpu_scale(dim_, scale, &state.sum[0], descriptor);
+}
+
+void TrackletAggregator::Finish(int tracklet, float* descriptor) {
+  Descriptor(tracklet, descriptor);
+  tracklets_.erase(tracklet);
+}
+
+}  // namespace caffe
@@ -0,0 +1,109 @@
+// This program converts a leveldb/lmdb of Datums into a memory-mapped re-ID
+// dataset (see caffe/util/reid_dataset.hpp), which ReIDData layers read
+// without parsing and sample by identity.
+// Usage:
+//   convert_db_to_reid_dataset [FLAGS] INPUT_DB OUTPUT_FILE
+//
+// Person labels come from the Datum labels. Camera ids come from the Datums
+// (see convert_reid_dataset) or else are parsed from the keys, as written by
+// convert_imageset ("%08d_<file name>") for Market-1501 file names, and are
+// -1 where neither is available.
+
+#include <stdint.h>
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/reid_dataset.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using boost::scoped_ptr;
+
+DEFINE_string(backend, "lmdb",
+        "The backend {leveldb, lmdb} containing the images");
+
+// Strips the "%08d_" prefix convert_imageset puts in front of file names.
+static string FileNameOfKey(const string& key) {
+  if (key.size() > 9 && key[8] == '_' &&
+      key.find_first_not_of("0123456789") == 8) {
+    return key.substr(9);
+  }
+  return key;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Convert a leveldb/lmdb of Datums into a\n"
+        "memory-mapped re-ID dataset\n"
+        "Usage:\n"
+        "    convert_db_to_reid_dataset [FLAGS] INPUT_DB OUTPUT_FILE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "tools/convert_db_to_reid_dataset");
+    return 1;
+  }
+
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[1], db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+
+  scoped_ptr<ReIDDatasetWriter> writer;
+  int count = 0;
+  int without_camera = 0;
+  Datum datum;
+  for (; cursor->valid(); cursor->Next()) {
+    datum.ParseFromString(cursor->value());
+    if (datum.encoded()) {
+#ifdef USE_OPENCV
+      DecodeDatumNative(&datum);
+#else
+      LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+    }
+    CHECK_GT(datum.data().size(), 0) << "Only uint8 data is supported.";
+    if (!writer) {
+      writer.reset(new ReIDDatasetWriter(argv[2], datum.channels(),
+          datum.height(), datum.width()));
+    }
+    CHECK(datum.channels() == writer->channels() &&
+        datum.height() == writer->height() &&
+        datum.width() == writer->width() &&
+        datum.data().size() == writer->record_size())
+        << "All records must have the same shape: " << cursor->key() << " is "
+        << datum.channels() << "x" << datum.height() << "x" << datum.width()
+        << ", not " << writer->channels() << "x" << writer->height() << "x"
+        << writer->width() << ".";
+    int person, camera = datum.camera();
+    if (!datum.has_camera() &&
+        !ParseMarket1501Name(FileNameOfKey(cursor->key()), &person,
+        &camera)) {
+      ++without_camera;
+    }
+    writer->Add(reinterpret_cast<const uint8_t*>(datum.data().data()),
+        datum.label(), camera);
+    if (++count % 1000 == 0) {
+      LOG(INFO) << "Processed " << count << " files.";
+    }
+  }
+  CHECK(writer) << "The database is empty.";
+  writer->Close();
+  if (without_camera) {
+    LOG(WARNING) << without_camera << " keys carry no camera id.";
+  }
+  return 0;
+}
@@ -0,0 +1,196 @@
+// This program converts a folder of re-identification images, named as in
+// Market-1501 ("0002_c1s1_000451_03.jpg": person 2, camera 1), to a
+// lmdb/leveldb of Datums carrying both the person label and the camera id.
+// Usage:
+//   convert_reid_dataset [FLAGS] IMAGE_FOLDER/ DB_NAME
+//
+// Images are decoded and resized on --threads threads, and written in
+// transactions of --batch_size records, in file name order (or shuffled).
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/filesystem.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/reid_dataset.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_bool(gray, false,
+    "When this option is on, treat images as grayscale ones");
+DEFINE_bool(shuffle, false,
+    "Randomly shuffle the order of images");
+DEFINE_string(backend, "lmdb",
+        "The backend {lmdb, leveldb} for storing the result");
+DEFINE_int32(resize_width, 60, "Width images are resized to");
+DEFINE_int32(resize_height, 160, "Height images are resized to");
+DEFINE_bool(encoded, false,
+    "When this option is on, the encoded image will be save in datum");
+DEFINE_string(encode_type, "",
+    "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_bool(skip_junk, true,
+    "Skip junk (person -1) and distractor (person 0) images");
+DEFINE_bool(relabel, false,
+    "Label persons 0, 1, ... in increasing id order instead of by their id");
+DEFINE_int32(threads, 4, "Number of threads decoding images");
+DEFINE_int32(batch_size, 1000, "Number of records per transaction");
+
+#ifdef USE_OPENCV
+struct ReIDImage {
+  string name;
+  int person;
+  int camera;
+  int label;
+};
+
+// Decodes the worker-th range of images into serialized Datums.
+static void ConvertRange(const string& root_folder,
+    const vector<ReIDImage>* images, int begin, int end,
+    vector<string>* values, int worker, int num_workers) {
+  int range_begin, range_end;
+  ThreadPool::Partition(end - begin, num_workers, worker, &range_begin,
+      &range_end);
+  const bool is_color = !FLAGS_gray;
+  Datum datum;
+  for (int i = begin + range_begin; i < begin + range_end; ++i) {
+    const ReIDImage& image = (*images)[i];
+    string enc = FLAGS_encode_type;
+    if (FLAGS_encoded && !enc.size()) {
+      // Guess the encoding type from the file name
+      const size_t p = image.name.rfind('.');
+      if (p != string::npos) {
+        enc = image.name.substr(p);
+        std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+      }
+    }
+    string& value = (*values)[i - begin];
+    value.clear();
+    if (!ReadImageToDatum(root_folder + image.name, image.label,
+        FLAGS_resize_height, FLAGS_resize_width, is_color, enc, &datum)) {
+      continue;
+    }
+    datum.set_camera(image.camera);
+    CHECK(datum.SerializeToString(&value));
+  }
+}
+#endif  // USE_OPENCV
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Convert a folder of re-identification images to\n"
+        "the leveldb/lmdb format used as input for Caffe, with person and\n"
+        "camera labels parsed from Market-1501 style file names.\n"
+        "Usage:\n"
+        "    convert_reid_dataset [FLAGS] IMAGE_FOLDER/ DB_NAME\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_reid_dataset");
+    return 1;
+  }
+  CHECK_GT(FLAGS_threads, 0);
+  CHECK_GT(FLAGS_batch_size, 0);
+
+  std::string root_folder(argv[1]);
+  if (root_folder.size() && root_folder[root_folder.size() - 1] != '/') {
+    root_folder += '/';
+  }
+  vector<ReIDImage> images;
+  int junk = 0;
+  for (boost::filesystem::directory_iterator it(root_folder);
+       it != boost::filesystem::directory_iterator(); ++it) {
+    const string name = it->path().filename().string();
+    ReIDImage image;
+    if (!boost::filesystem::is_regular_file(it->status()) ||
+        !ParseMarket1501Name(name, &image.person, &image.camera)) {
+      continue;
+    }
+    if (FLAGS_skip_junk && image.person <= 0) {
+      ++junk;
+      continue;
+    }
+    image.name = name;
+    image.label = image.person;
+    images.push_back(image);
+  }
+  CHECK(!images.empty()) << "No re-ID images in " << root_folder;
+  // Directory order is arbitrary.
+  std::sort(images.begin(), images.end(),
+      boost::bind(&ReIDImage::name, _1) < boost::bind(&ReIDImage::name, _2));
+  if (FLAGS_relabel) {
+    std::map<int, int> labels;
+    for (int i = 0; i < images.size(); ++i) {
+      labels.insert(std::make_pair(images[i].person, 0));
+    }
+    int next_label = 0;
+    for (std::map<int, int>::iterator it = labels.begin();
+         it != labels.end(); ++it) {
+      it->second = next_label++;
+    }
+    for (int i = 0; i < images.size(); ++i) {
+      images[i].label = labels[images[i].person];
+    }
+    LOG(INFO) << "Relabeled " << labels.size() << " persons.";
+  }
+  if (FLAGS_shuffle) {
+    // randomly shuffle data
+    LOG(INFO) << "Shuffling data";
+    shuffle(images.begin(), images.end());
+  }
+  LOG(INFO) << "A total of " << images.size() << " images"
+      << (junk ? ", skipped " + format_int(junk) + " junk ones." : ".");
+
+  if (FLAGS_encode_type.size() && !FLAGS_encoded)
+    LOG(INFO) << "encode_type specified, assuming encoded=true.";
+
+  // Create new DB
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[2], db::NEW);
+
+  ThreadPool pool(FLAGS_threads);
+  vector<string> values(FLAGS_batch_size);
+  int count = 0;
+  for (int begin = 0; begin < images.size(); begin += FLAGS_batch_size) {
+    const int end = std::min<int>(begin + FLAGS_batch_size, images.size());
+    pool.Run(boost::bind(&ConvertRange, boost::cref(root_folder), &images,
+        begin, end, &values, _1, FLAGS_threads));
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = begin; i < end; ++i) {
+      const string& value = values[i - begin];
+      if (value.empty()) {
+        LOG(WARNING) << "Could not read " << images[i].name;
+        continue;
+      }
+      // sequential
+      txn->Put(format_int(i, 8) + "_" + images[i].name, value);
+      ++count;
+    }
+    txn->Commit();
+    LOG(INFO) << "Processed " << count << " files.";
+  }
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
@@ -1,3 +1,5 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -9,16 +11,70 @@
 #include "caffe/net.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/embedding_store.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/reid_dataset.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
 using caffe::Datum;
+using caffe::EmbeddingStore;
+using caffe::EmbeddingStoreWriter;
 using caffe::Net;
 using std::string;
 namespace db = caffe::db;
 
+// Labels the images the net reads, in order, for embedding stores: from the
+// list of an ImageData layer, or from the records of a ReIDData layer. The
+// names of Market-1501 images give their person and camera; other images
+// get -1 for both. Returns false if the net has neither layer.
+bool read_image_labels(const caffe::NetParameter& net_param,
+    std::vector<string>* names, std::vector<int>* persons,
+    std::vector<int>* cameras) {
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    const caffe::LayerParameter& layer = net_param.layer(i);
+    if (layer.type() == "ImageData") {
+      LOG_IF(WARNING, layer.image_data_param().shuffle())
+          << "Shuffled images cannot be labelled.";
+      std::ifstream infile(layer.image_data_param().source().c_str());
+      CHECK(infile.good()) << "Failed to open "
+          << layer.image_data_param().source();
+      string line;
+      while (std::getline(infile, line)) {
+        std::istringstream words(line);
+        string name;
+        if (!(words >> name)) {
+          continue;
+        }
+        int person, camera;
+        if (!caffe::ParseMarket1501Name(name, &person, &camera)) {
+          person = camera = -1;
+        }
+        names->push_back(name);
+        persons->push_back(person);
+        cameras->push_back(camera);
+      }
+      return true;
+    }
+    if (layer.type() == "ReIDData") {
+      LOG_IF(WARNING, layer.reid_data_param().shuffle() ||
+          layer.reid_data_param().identities_per_batch())
+          << "Shuffled or sampled records cannot be labelled.";
+      caffe::ReIDDataset dataset;
+      dataset.Open(layer.reid_data_param().source());
+      for (int r = 0; r < dataset.num_records(); ++r) {
+        names->push_back("");
+        persons->push_back(dataset.person(r));
+        cameras->push_back(dataset.camera(r));
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
@@ -42,7 +98,9 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "A db_type of store, store_fp16 or store_int8 writes embedding stores"
+    " instead, labelled from the ImageData or ReIDData layer of the net.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -63,6 +121,11 @@ int feature_extraction_pipeline(int argc, char** argv) {
     Caffe::set_mode(Caffe::CPU);
   }
 
+  // The last required argument, the output type, decides how the net is
+  // built.
+  const string db_type = argv[num_required_args - 1];
+  const bool use_store = db_type.compare(0, 5, "store") == 0;
+
   arg_pos = 0;  // the name of the executable
   std::string pretrained_binary_proto(argv[++arg_pos]);
 
@@ -94,8 +157,15 @@ int feature_extraction_pipeline(int argc, char** argv) {
    }
    */
   std::string feature_extraction_proto(argv[++arg_pos]);
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(feature_extraction_proto, &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  if (use_store) {
+    // Nets writing embedding stores run forward only, and hold no diffs.
+    net_param.set_inference(true);
+  }
   boost::shared_ptr<Net<Dtype> > feature_extraction_net(
-      new Net<Dtype>(feature_extraction_proto, caffe::TEST));
+      new Net<Dtype>(net_param));
   feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
 
   std::string extract_feature_blob_names(argv[++arg_pos]);
@@ -120,14 +190,40 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   std::vector<boost::shared_ptr<db::DB> > feature_dbs;
   std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
+  std::vector<boost::shared_ptr<EmbeddingStoreWriter> > stores;
+  ++arg_pos;  // db_type
+  EmbeddingStore::Type store_type = EmbeddingStore::FLOAT;
+  std::vector<string> image_names;
+  std::vector<int> image_persons, image_cameras;
+  if (use_store) {
+    if (db_type == "store_fp16") {
+      store_type = EmbeddingStore::FLOAT16;
+    } else if (db_type == "store_int8") {
+      store_type = EmbeddingStore::INT8;
+    } else {
+      CHECK_EQ(db_type, "store") << "Unknown embedding store type";
+    }
+    if (!read_image_labels(net_param, &image_names, &image_persons,
+        &image_cameras)) {
+      LOG(WARNING) << "No ImageData or ReIDData layer labels the images.";
+    }
+  }
   for (size_t i = 0; i < num_features; ++i) {
-    LOG(INFO)<< "Opening dataset " << dataset_names[i];
-    boost::shared_ptr<db::DB> db(db::GetDB(db_type));
-    db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
-    boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
+    if (use_store) {
+      LOG(INFO)<< "Opening embedding store " << dataset_names[i];
+      const boost::shared_ptr<Blob<Dtype> > feature_blob =
+          feature_extraction_net->blob_by_name(blob_names[i]);
+      stores.push_back(boost::shared_ptr<EmbeddingStoreWriter>(
+          new EmbeddingStoreWriter(dataset_names[i],
+              feature_blob->count(1), store_type)));
+    } else {
+      LOG(INFO)<< "Opening dataset " << dataset_names[i];
+      boost::shared_ptr<db::DB> db(db::GetDB(db_type));
+      db->Open(dataset_names.at(i), db::NEW);
+      feature_dbs.push_back(db);
+      boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
+      txns.push_back(txn);
+    }
   }
 
   LOG(ERROR)<< "Extracting Features";
@@ -142,40 +238,61 @@ int feature_extraction_pipeline(int argc, char** argv) {
       int batch_size = feature_blob->num();
       int dim_features = feature_blob->count() / batch_size;
       const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
+      if (use_store) {
+        for (int n = 0; n < batch_size; ++n) {
+          feature_blob_data = feature_blob->cpu_data() +
+              feature_blob->offset(n);
+          const std::vector<float> embedding(feature_blob_data,
+              feature_blob_data + dim_features);
+          // Data layers wrap around at the end of their images.
+          const int image = image_names.empty() ? -1 :
+              image_indices[i] % image_names.size();
+          stores[i]->Add(&embedding[0],
+              image < 0 ? -1 : image_persons[image],
+              image < 0 ? -1 : image_cameras[image],
+              image < 0 ? "" : image_names[image]);
+          ++image_indices[i];
         }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
+      } else {
+        for (int n = 0; n < batch_size; ++n) {
+          datum.set_height(feature_blob->height());
+          datum.set_width(feature_blob->width());
+          datum.set_channels(feature_blob->channels());
+          datum.clear_data();
+          datum.clear_float_data();
+          feature_blob_data = feature_blob->cpu_data() +
+              feature_blob->offset(n);
+          for (int d = 0; d < dim_features; ++d) {
+            datum.add_float_data(feature_blob_data[d]);
+          }
+          string key_str = caffe::format_int(image_indices[i], 10);
+
+          string out;
+          CHECK(datum.SerializeToString(&out));
+          txns.at(i)->Put(key_str, out);
+          ++image_indices[i];
+          if (image_indices[i] % 1000 == 0) {
+            txns.at(i)->Commit();
+            txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
+            LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
+                " query images for feature blob " << blob_names[i];
+          }
+        }  // for (int n = 0; n < batch_size; ++n)
+      }
     }  // for (int i = 0; i < num_features; ++i)
   }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
   // write the last batch
   for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
+    if (use_store) {
+      stores.at(i)->Close();
+    } else {
+      if (image_indices[i] % 1000 != 0) {
+        txns.at(i)->Commit();
+      }
+      feature_dbs.at(i)->Close();
     }
     LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
         " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
@@ -0,0 +1,153 @@
+// This program pools the re-identification embeddings of the frames of
+// tracklets into one descriptor per tracklet, streaming the frames in order
+// through a TrackletAggregator as a tracker would. With --tolerance, frames
+// are subsampled and tracklets stop early once their descriptor settles; it
+// reports how many frames would have needed the network, and how close the
+// descriptors are to those pooled over every frame.
+// Usage:
+//   reid_aggregate_tracklets [FLAGS] FRAME_FEATURES TRACKLET_STORE
+//
+// The frame features are an embedding store or an lmdb/leveldb database of
+// float Datums, as written by extract_features. A tracklet is a run of
+// consecutive frames of the same person and camera, unless --tracklets
+// lists the tracklet of each frame. Each tracklet is written to the output
+// embedding store with the person, camera and name of its first frame.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/embedding_store.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/tracklet_aggregator.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(backend, "store",
+    "The format {store, lmdb, leveldb} of the frame features");
+DEFINE_string(tracklets, "",
+    "Optional; a file with the integer tracklet of each frame, one per line");
+DEFINE_string(quality, "uniform",
+    "The weight of a frame {uniform, norm}; norm weights it by the norm of "
+    "its embedding, which drops for blurred or occluded crops");
+DEFINE_bool(normalize, true,
+    "L2-normalize frames before pooling, and the descriptors");
+DEFINE_double(tolerance, 0,
+    "Turn (1 - cos) of the descriptor under which a frame counts as adding "
+    "nothing; 0 embeds every frame");
+DEFINE_int32(max_stride, 8, "The most frames skipped between embedded ones");
+DEFINE_int32(patience, 3,
+    "Frames adding nothing in a row after which a tracklet stops");
+DEFINE_int32(min_frames, 4, "Frames embedded before a tracklet may stop");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Pool the embeddings of the frames of tracklets\n"
+        "into one descriptor per tracklet.\n"
+        "Usage:\n"
+        "    reid_aggregate_tracklets [FLAGS] FRAME_FEATURES TRACKLET_STORE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "tools/reid_aggregate_tracklets");
+    return 1;
+  }
+  CHECK(FLAGS_quality == "uniform" || FLAGS_quality == "norm")
+      << "Unknown quality " << FLAGS_quality;
+
+  ReIDFeatures frames;
+  frames.Load(FLAGS_backend, argv[1], "");
+  const int num = frames.num();
+  const int dim = frames.dim();
+  vector<int> tracklets(num);
+  if (!FLAGS_tracklets.empty()) {
+    std::ifstream infile(FLAGS_tracklets.c_str());
+    CHECK(infile.good()) << "Failed to open " << FLAGS_tracklets;
+    for (int i = 0; i < num; ++i) {
+      CHECK(infile >> tracklets[i]) << "Expected " << num << " tracklets in "
+          << FLAGS_tracklets;
+    }
+  } else {
+    CHECK(frames.has_labels())
+        << "Frames without labels need --tracklets.";
+    for (int i = 1; i < num; ++i) {
+      const bool same = frames.persons()[i] == frames.persons()[i - 1] &&
+          frames.cameras()[i] == frames.cameras()[i - 1];
+      tracklets[i] = tracklets[i - 1] + !same;
+    }
+  }
+  // The first and last frame of each tracklet, to label it and to emit it
+  // as soon as it ends.
+  std::map<int, int> first, last;
+  for (int i = 0; i < num; ++i) {
+    first.insert(std::make_pair(tracklets[i], i));
+    last[tracklets[i]] = i;
+  }
+
+  TrackletAggregator aggregator(dim, FLAGS_normalize);
+  aggregator.set_tolerance(FLAGS_tolerance);
+  aggregator.set_max_stride(FLAGS_max_stride);
+  aggregator.set_patience(FLAGS_patience);
+  aggregator.set_min_frames(FLAGS_min_frames);
+  // Pools every frame, for reference.
+  TrackletAggregator reference(dim, FLAGS_normalize);
+  EmbeddingStoreWriter writer(argv[2], dim, EmbeddingStore::FLOAT);
+  vector<float> descriptor(dim), expected(dim);
+  int embedded = 0;
+  double similarity = 0;
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < num; ++i) {
+    const int tracklet = tracklets[i];
+    const float* frame = frames.data() + static_cast<size_t>(i) * dim;
+    float quality = 1;
+    if (FLAGS_quality == "norm") {
+      // A zero embedding adds nothing to the pool anyway.
+      quality = std::max(std::sqrt(caffe_cpu_dot(dim, frame, frame)), 1e-12f);
+    }
+    if (aggregator.Offer(tracklet)) {
+      aggregator.Add(tracklet, frame, quality);
+      ++embedded;
+    }
+    reference.Add(tracklet, frame, quality);
+    if (i == last[tracklet]) {
+      aggregator.Finish(tracklet, &descriptor[0]);
+      reference.Finish(tracklet, &expected[0]);
+      const int f = first[tracklet];
+      writer.Add(&descriptor[0],
+          frames.has_labels() ? frames.persons()[f] : -1,
+          frames.has_labels() ? frames.cameras()[f] : -1,
+          frames.names()[f]);
+      const float norms = std::sqrt(
+          caffe_cpu_dot(dim, &descriptor[0], &descriptor[0]) *
+          caffe_cpu_dot(dim, &expected[0], &expected[0]));
+      similarity += norms > 0 ?
+          caffe_cpu_dot(dim, &descriptor[0], &expected[0]) / norms : 1;
+    }
+  }
+  writer.Close();
+  const int num_tracklets = writer.num_embeddings();
+  LOG(INFO) << "Pooled " << num << " frames into " << num_tracklets
+      << " tracklets in " << timer.Seconds() << " s.";
+  LOG(INFO) << "Embedded " << embedded << " frames ("
+      << 100.f * embedded / std::max(num, 1) << "%); mean cosine similarity "
+      << "to the descriptors of all frames: "
+      << similarity / std::max(num_tracklets, 1);
+  return 0;
+}
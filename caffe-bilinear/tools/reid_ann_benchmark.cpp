@@ -0,0 +1,109 @@
+// This program measures how an approximate nearest neighbor index trades
+// recall for latency: for each search effort it reports recall@k, the
+// fraction of the exact k nearest gallery items found, and the time per
+// query.
+// Usage:
+//   reid_ann_benchmark [FLAGS] QUERY_FEATURES GALLERY_FEATURES INDEX
+//
+// The features are embedding stores or lmdb/leveldb databases of float
+// Datums, as written by extract_features; INDEX is built over
+// GALLERY_FEATURES by reid_build_index, and sets the metric.
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/reid_search.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(backend, "store",
+    "The format {store, lmdb, leveldb} of the features");
+DEFINE_string(efforts, "8,16,32,64,128,256",
+    "The search efforts to measure");
+DEFINE_int32(top_k, 10, "The k of recall@k");
+DEFINE_int32(threads, 1,
+    "Number of threads searching; 1 measures the latency of a query");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measure recall@k against search time of an\n"
+        "approximate nearest neighbor index.\n"
+        "Usage:\n"
+        "    reid_ann_benchmark [FLAGS] QUERY_FEATURES GALLERY_FEATURES"
+        " INDEX\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/reid_ann_benchmark");
+    return 1;
+  }
+  CHECK_GT(FLAGS_top_k, 0);
+  CHECK_GT(FLAGS_threads, 0);
+  vector<string> effort_names;
+  boost::split(effort_names, FLAGS_efforts, boost::is_any_of(","));
+
+  ReIDFeatures queries, gallery;
+  queries.Load(FLAGS_backend, argv[1], "");
+  gallery.Load(FLAGS_backend, argv[2], "");
+  scoped_ptr<ANNIndex> index(LoadANNIndex(argv[3]));
+  CHECK_EQ(queries.dim(), index->dim());
+  CHECK_EQ(gallery.num(), index->size())
+      << "The index was not built over " << argv[2];
+  index->set_exact_embeddings(gallery.data());
+  const int num_queries = queries.num();
+  const int k = FLAGS_top_k;
+  ThreadPool pool(FLAGS_threads);
+
+  CPUTimer timer;
+  timer.Start();
+  ReIDSearch search(gallery.data(), gallery.num(), gallery.dim(),
+      index->cosine());
+  vector<vector<ReIDMatch> > exact;
+  search.Search(queries.data(), num_queries, NULL, k, &exact, &pool);
+  LOG(INFO) << "Exact search of " << num_queries << " queries in "
+      << gallery.num() << " gallery images: "
+      << timer.MilliSeconds() / num_queries << " ms per query.";
+
+  for (int e = 0; e < effort_names.size(); ++e) {
+    const int effort = atoi(effort_names[e].c_str());
+    CHECK_GT(effort, 0) << "Bad effort " << effort_names[e];
+    index->set_effort(effort);
+    vector<vector<ReIDMatch> > results;
+    timer.Start();
+    index->Search(queries.data(), num_queries, k, &results, &pool);
+    const float milliseconds = timer.MilliSeconds();
+    int found = 0;
+    int expected = 0;
+    for (int i = 0; i < num_queries; ++i) {
+      // Items as near as the k-th count as found; they may tie.
+      const float kth = exact[i].empty() ? 0 : exact[i].back().distance;
+      for (int r = 0; r < results[i].size(); ++r) {
+        found += results[i][r].distance <= kth * (1 + 1e-5f) + 1e-6f;
+      }
+      expected += exact[i].size();
+    }
+    LOG(INFO) << index->type() << " effort " << effort << ": recall@" << k
+        << " = " << static_cast<float>(found) / std::max(expected, 1)
+        << ", " << milliseconds / num_queries << " ms per query.";
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// This program builds an approximate nearest neighbor index over the
+// re-identification embeddings of a gallery, for reid_search and
+// reid_ann_benchmark.
+// Usage:
+//   reid_build_index [FLAGS] GALLERY_FEATURES INDEX
+//
+// The features are an embedding store or an lmdb/leveldb database of float
+// Datums, as written by extract_features. Gallery items keep their order:
+// match i of the index is embedding i of the features.
+
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/ann_index_hnsw.hpp"
+#include "caffe/util/ann_index_ivf.hpp"
+#include "caffe/util/ann_index_pq.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(backend, "store",
+    "The format {store, lmdb, leveldb} of the features");
+DEFINE_string(metric, "cosine",
+    "The distance embeddings are compared with {cosine, euclidean}");
+DEFINE_string(type, "hnsw", "The index {hnsw, ivf, pq}");
+DEFINE_int32(hnsw_m, 16, "hnsw: links per node");
+DEFINE_int32(ef_construction, 200,
+    "hnsw: candidates considered when linking a node");
+DEFINE_int32(ivf_lists, 1024, "ivf: number of lists");
+DEFINE_int32(pq_subspaces, 32,
+    "pq: bytes per embedding, each coding a run of dimensions");
+DEFINE_int32(effort, 0,
+    "The default search effort saved with the index: candidates for hnsw, "
+    "lists probed for ivf, candidates re-ranked exactly for pq; 0 keeps "
+    "the index default");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Build an approximate nearest neighbor index over\n"
+        "re-identification embeddings.\n"
+        "Usage:\n"
+        "    reid_build_index [FLAGS] GALLERY_FEATURES INDEX\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/reid_build_index");
+    return 1;
+  }
+  CHECK(FLAGS_metric == "cosine" || FLAGS_metric == "euclidean")
+      << "Unknown metric " << FLAGS_metric;
+
+  CPUTimer timer;
+  timer.Start();
+  ReIDFeatures gallery;
+  gallery.Load(FLAGS_backend, argv[1], "");
+  LOG(INFO) << "Loaded " << gallery.num() << " gallery images of dimension "
+      << gallery.dim() << " in " << timer.Seconds() << " s.";
+
+  timer.Start();
+  const bool cosine = FLAGS_metric == "cosine";
+  scoped_ptr<ANNIndex> index;
+  if (FLAGS_type == "hnsw") {
+    index.reset(new HNSWIndex(gallery.dim(), cosine, FLAGS_hnsw_m,
+        FLAGS_ef_construction));
+  } else if (FLAGS_type == "ivf") {
+    index.reset(new IVFIndex(gallery.dim(), cosine, FLAGS_ivf_lists));
+  } else if (FLAGS_type == "pq") {
+    index.reset(new PQIndex(gallery.dim(), cosine, FLAGS_pq_subspaces));
+  } else {
+    LOG(FATAL) << "Unknown index type " << FLAGS_type;
+  }
+  if (FLAGS_effort > 0) {
+    index->set_effort(FLAGS_effort);
+  }
+  index->Build(gallery.data(), gallery.num());
+  LOG(INFO) << "Built the " << index->type() << " index in "
+      << timer.Seconds() << " s.";
+  index->Save(argv[2]);
+  return 0;
+}
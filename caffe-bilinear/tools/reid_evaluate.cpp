@@ -0,0 +1,304 @@
+// This program evaluates re-identification embeddings on a query and a
+// gallery set, following the Market-1501 protocol, and reports the CMC
+// curve and the mean average precision.
+// Usage:
+//   reid_evaluate [FLAGS] QUERY_FEATURES GALLERY_FEATURES
+//
+// The features are embedding stores, which carry the person and camera of
+// every image, or lmdb/leveldb databases of float Datums, one per image,
+// which need --query_list and --gallery_list; both are written by
+// extract_features. A list holds the image names of a feature database in
+// the same order, one per line; only the first word of a line is read, so
+// the lists of convert_imageset work too. Persons and cameras are parsed
+// from the names ("0002_c1s1_000451_03.jpg": person 2, camera 1).
+//
+// With --rerank, distances are re-ranked with k-reciprocal encoding before
+// scoring, and the time each stage took is reported.
+//
+// With --pq_index, a "pq" index built over GALLERY_FEATURES by
+// reid_build_index ranks the gallery a second time from its compressed
+// codes, and the change in CMC and mAP is reported. It cannot be combined
+// with --rerank, whose neighbors come from the exact features.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/bind.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/ann_index_pq.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/reid_reranking.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(backend, "store",
+    "The format {store, lmdb, leveldb} of the features");
+DEFINE_string(query_list, "",
+    "The image names of the queries, in feature order; needed unless the "
+    "queries are an embedding store");
+DEFINE_string(gallery_list, "",
+    "The image names of the gallery, in feature order; needed unless the "
+    "gallery is an embedding store");
+DEFINE_string(metric, "cosine",
+    "The distance embeddings are compared with {cosine, euclidean}");
+DEFINE_string(ranks, "1,5,10,20",
+    "The ranks of the CMC curve to report");
+DEFINE_int32(threads, 4, "Number of threads scoring queries");
+DEFINE_int32(block_size, 256,
+    "Number of queries whose distances are computed at once");
+DEFINE_string(top_k_file, "",
+    "Optional; write the names of the top_k nearest gallery images of each "
+    "query there, one query per line");
+DEFINE_int32(top_k, 10, "Length of the rankings written to top_k_file");
+DEFINE_bool(rerank, false,
+    "Re-rank the gallery for each query with k-reciprocal encoding");
+DEFINE_int32(rerank_k1, 20, "With --rerank, the size of reciprocal sets");
+DEFINE_int32(rerank_k2, 6,
+    "With --rerank, the neighbors whose encodings are averaged");
+DEFINE_double(rerank_lambda, 0.3,
+    "With --rerank, the weight of the original distance");
+DEFINE_string(pq_index, "",
+    "Optional; also evaluate the rankings of this product-quantized index "
+    "of the gallery");
+DEFINE_int32(pq_rerank, 100,
+    "With --pq_index, the number of nearest candidates re-ranked with the "
+    "exact embeddings; 0 ranks by the codes alone");
+
+struct Evaluation {
+  const ReIDEvaluator* evaluator;
+  const float* queries;
+  const float* gallery;
+  int num_gallery;
+  int dim;
+  bool cosine;
+  const vector<int>* persons;
+  const vector<int>* cameras;
+  vector<ReIDEvaluator::Score>* scores;
+  vector<vector<int> >* rankings;
+  const ReIDReranker* reranker;
+  // Time each worker spent re-ranking.
+  vector<double>* rerank_seconds;
+  const PQIndex* pq;
+  vector<ReIDEvaluator::Score>* pq_scores;
+};
+
+// Scores the worker-th share of the queries [begin, end), a block at a time.
+static void EvaluateRange(const Evaluation* evaluation, int begin, int end,
+    int worker, int num_workers) {
+  int range_begin, range_end;
+  ThreadPool::Partition(end - begin, num_workers, worker, &range_begin,
+      &range_end);
+  const int num_gallery = evaluation->num_gallery;
+  const int dim = evaluation->dim;
+  vector<float> distances;
+  vector<float> pq_distances(evaluation->pq ? num_gallery : 0);
+  CPUTimer rerank_timer;
+  for (int block = begin + range_begin; block < begin + range_end;
+       block += FLAGS_block_size) {
+    const int num_queries =
+        std::min(FLAGS_block_size, begin + range_end - block);
+    distances.resize(static_cast<size_t>(num_queries) * num_gallery);
+    ReIDDistances(evaluation->queries + static_cast<size_t>(block) * dim,
+        num_queries, evaluation->gallery, num_gallery, dim,
+        evaluation->cosine, &distances[0]);
+    for (int i = 0; i < num_queries; ++i) {
+      const int query = block + i;
+      float* row = &distances[static_cast<size_t>(i) * num_gallery];
+      if (evaluation->reranker) {
+        rerank_timer.Start();
+        evaluation->reranker->Rerank(query, row);
+        (*evaluation->rerank_seconds)[worker] += rerank_timer.Seconds();
+      }
+      (*evaluation->scores)[query] = evaluation->evaluator->Evaluate(row,
+          (*evaluation->persons)[query], (*evaluation->cameras)[query]);
+      if (evaluation->pq) {
+        evaluation->pq->Distances(
+            evaluation->queries + static_cast<size_t>(query) * dim,
+            &pq_distances[0]);
+        (*evaluation->pq_scores)[query] = evaluation->evaluator->Evaluate(
+            &pq_distances[0], (*evaluation->persons)[query],
+            (*evaluation->cameras)[query]);
+      }
+      if (evaluation->rankings) {
+        ReIDTopK(row, num_gallery, FLAGS_top_k,
+            &(*evaluation->rankings)[query]);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Evaluate re-identification embeddings with the\n"
+        "Market-1501 protocol: CMC and mean average precision.\n"
+        "Usage:\n"
+        "    reid_evaluate [FLAGS] QUERY_FEATURES GALLERY_FEATURES\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/reid_evaluate");
+    return 1;
+  }
+  CHECK(FLAGS_metric == "cosine" || FLAGS_metric == "euclidean")
+      << "Unknown metric " << FLAGS_metric;
+  CHECK_GT(FLAGS_threads, 0);
+  CHECK_GT(FLAGS_block_size, 0);
+  vector<int> ranks;
+  vector<string> rank_names;
+  boost::split(rank_names, FLAGS_ranks, boost::is_any_of(","));
+  for (int i = 0; i < rank_names.size(); ++i) {
+    ranks.push_back(atoi(rank_names[i].c_str()));
+    CHECK_GT(ranks.back(), 0) << "Bad rank " << rank_names[i];
+  }
+
+  CPUTimer timer;
+  timer.Start();
+  ReIDFeatures queries, gallery;
+  queries.Load(FLAGS_backend, argv[1], FLAGS_query_list);
+  gallery.Load(FLAGS_backend, argv[2], FLAGS_gallery_list);
+  CHECK(queries.has_labels()) << "The queries need --query_list.";
+  CHECK(gallery.has_labels()) << "The gallery needs --gallery_list.";
+  CHECK_EQ(queries.dim(), gallery.dim())
+      << "Queries and gallery have embeddings of different sizes.";
+  const int num_queries = queries.num();
+  const int num_gallery = gallery.num();
+  const vector<string>& query_names = queries.names();
+  const vector<string>& gallery_names = gallery.names();
+  LOG(INFO) << "Loaded " << num_queries << " queries and " << num_gallery
+      << " gallery images of dimension " << queries.dim() << " in "
+      << timer.Seconds() << " s.";
+
+  boost::scoped_ptr<ANNIndex> index;
+  const PQIndex* pq = NULL;
+  if (FLAGS_pq_index.size()) {
+    CHECK(!FLAGS_rerank) << "--pq_index compares the exact ranking with "
+        << "that of the codes, and --rerank would only apply to the first.";
+    index.reset(LoadANNIndex(FLAGS_pq_index));
+    pq = dynamic_cast<const PQIndex*>(index.get());
+    CHECK(pq) << FLAGS_pq_index << " is a " << index->type()
+        << " index, not pq.";
+    CHECK_EQ(num_gallery, pq->size())
+        << "The index was not built over " << argv[2];
+    CHECK_EQ(pq->cosine(), FLAGS_metric == "cosine")
+        << "The index was built for another metric.";
+    CHECK_GE(FLAGS_pq_rerank, 0);
+    if (FLAGS_pq_rerank > 0) {
+      index->set_effort(FLAGS_pq_rerank);
+      index->set_exact_embeddings(gallery.data());
+    }
+  }
+
+  ThreadPool pool(FLAGS_threads);
+  boost::scoped_ptr<ReIDReranker> reranker;
+  vector<double> rerank_seconds(FLAGS_threads);
+  if (FLAGS_rerank) {
+    reranker.reset(new ReIDReranker(queries.data(), num_queries,
+        gallery.data(), num_gallery, queries.dim(), FLAGS_metric == "cosine",
+        FLAGS_rerank_k1, FLAGS_rerank_k2, FLAGS_rerank_lambda));
+    timer.Start();
+    reranker->FindNeighbors(&pool);
+    const float neighbor_seconds = timer.Seconds();
+    timer.Start();
+    reranker->Encode(&pool);
+    LOG(INFO) << "Re-ranking: found the " << FLAGS_rerank_k1 + 1
+        << " nearest neighbors in " << neighbor_seconds << " s, encoded them"
+        << " in " << timer.Seconds() << " s.";
+  }
+
+  timer.Start();
+  ReIDEvaluator evaluator(gallery.persons(), gallery.cameras());
+  vector<ReIDEvaluator::Score> scores(num_queries);
+  vector<ReIDEvaluator::Score> pq_scores(pq ? num_queries : 0);
+  vector<vector<int> > rankings;
+  if (FLAGS_top_k_file.size()) {
+    CHECK_GT(FLAGS_top_k, 0);
+    rankings.resize(num_queries);
+  }
+  Evaluation evaluation;
+  evaluation.evaluator = &evaluator;
+  evaluation.queries = queries.data();
+  evaluation.gallery = gallery.data();
+  evaluation.num_gallery = num_gallery;
+  evaluation.dim = queries.dim();
+  evaluation.cosine = FLAGS_metric == "cosine";
+  evaluation.persons = &queries.persons();
+  evaluation.cameras = &queries.cameras();
+  evaluation.scores = &scores;
+  evaluation.rankings = rankings.empty() ? NULL : &rankings;
+  evaluation.reranker = reranker.get();
+  evaluation.rerank_seconds = &rerank_seconds;
+  evaluation.pq = pq;
+  evaluation.pq_scores = &pq_scores;
+  pool.Run(boost::bind(&EvaluateRange, &evaluation, 0, num_queries, _1,
+      FLAGS_threads));
+  const int max_rank = *std::max_element(ranks.begin(), ranks.end());
+  vector<double> cmc;
+  const double mean_average_precision = ReIDSummary(scores, max_rank, &cmc);
+  int unmatched = 0;
+  for (int i = 0; i < num_queries; ++i) {
+    unmatched += scores[i].first_match < 0;
+  }
+  LOG(INFO) << "Evaluated in " << timer.Seconds() << " s"
+      << (unmatched ? ", skipping " + format_int(unmatched) +
+          " queries with no true match." : ".");
+  if (reranker) {
+    double seconds = 0;
+    for (int i = 0; i < rerank_seconds.size(); ++i) {
+      seconds += rerank_seconds[i];
+    }
+    LOG(INFO) << "Re-ranking: Jaccard distances took "
+        << seconds / FLAGS_threads << " s per thread.";
+  }
+  for (int i = 0; i < ranks.size(); ++i) {
+    LOG(INFO) << "CMC@" << ranks[i] << " = " << cmc[ranks[i] - 1];
+  }
+  LOG(INFO) << "mAP = " << mean_average_precision;
+  if (pq) {
+    vector<double> pq_cmc;
+    const double pq_mean_average_precision =
+        ReIDSummary(pq_scores, max_rank, &pq_cmc);
+    const int code_size = pq->quantizer().code_size();
+    LOG(INFO) << "Product quantization, " << code_size << " bytes per "
+        << "embedding (" << 4.f * pq->dim() / code_size << "x smaller), "
+        << FLAGS_pq_rerank << " re-ranked:";
+    for (int i = 0; i < ranks.size(); ++i) {
+      LOG(INFO) << "CMC@" << ranks[i] << " = " << pq_cmc[ranks[i] - 1]
+          << " (" << std::showpos << pq_cmc[ranks[i] - 1] - cmc[ranks[i] - 1]
+          << std::noshowpos << ")";
+    }
+    LOG(INFO) << "mAP = " << pq_mean_average_precision << " ("
+        << std::showpos << pq_mean_average_precision - mean_average_precision
+        << std::noshowpos << ")";
+  }
+
+  if (rankings.size()) {
+    std::ofstream outfile(FLAGS_top_k_file.c_str());
+    CHECK(outfile.good()) << "Failed to open " << FLAGS_top_k_file;
+    for (int i = 0; i < num_queries; ++i) {
+      outfile << query_names[i];
+      for (int k = 0; k < rankings[i].size(); ++k) {
+        outfile << " " << gallery_names[rankings[i][k]];
+      }
+      outfile << "\n";
+    }
+  }
+  return 0;
+}
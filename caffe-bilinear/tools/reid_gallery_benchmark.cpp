@@ -0,0 +1,184 @@
+// This program measures how fast a ReIDGallery takes updates while it is
+// searched: it adds the gallery in batches while another thread keeps
+// searching the queries, then removes the oldest items as a retention
+// policy would, compacts, and reports ingest and search throughput, the
+// compaction time and recall@k against an exhaustive search.
+// Usage:
+//   reid_gallery_benchmark [FLAGS] QUERY_FEATURES GALLERY_FEATURES
+//
+// The features are embedding stores or lmdb/leveldb databases of float
+// Datums, as written by extract_features.
+
+#include <algorithm>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/reid_gallery.hpp"
+#include "caffe/util/reid_search.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(backend, "store",
+    "The format {store, lmdb, leveldb} of the features");
+DEFINE_string(metric, "cosine",
+    "The distance embeddings are compared with {cosine, euclidean}");
+DEFINE_string(type, "exact",
+    "How compacted segments are searched {exact, hnsw, ivf, pq}");
+DEFINE_int32(segment_size, 4096, "Items per segment");
+DEFINE_int32(batch_size, 64, "Items added at once");
+DEFINE_double(retention, 0.8,
+    "The fraction of the gallery kept; the oldest items go");
+DEFINE_int32(effort, 0, "The search effort; 0 keeps the index default");
+DEFINE_int32(top_k, 10, "The k of recall@k");
+
+// Searches the queries over and over until stopped.
+struct Searcher {
+  const ReIDGallery* gallery;
+  const ReIDFeatures* queries;
+  boost::mutex mutex;
+  bool stop;
+  int searched;
+
+  void Run() {
+    vector<vector<ReIDMatch> > results;
+    for (;;) {
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        if (stop) {
+          return;
+        }
+      }
+      gallery->Search(queries->data(), queries->num(), NULL, FLAGS_top_k,
+          &results, NULL);
+      boost::mutex::scoped_lock lock(mutex);
+      searched += queries->num();
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measure updates and searches of a re-ID gallery\n"
+        "that changes online.\n"
+        "Usage:\n"
+        "    reid_gallery_benchmark [FLAGS] QUERY_FEATURES GALLERY_FEATURES\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "tools/reid_gallery_benchmark");
+    return 1;
+  }
+  CHECK(FLAGS_metric == "cosine" || FLAGS_metric == "euclidean")
+      << "Unknown metric " << FLAGS_metric;
+  CHECK_GT(FLAGS_batch_size, 0);
+  CHECK_GT(FLAGS_top_k, 0);
+  CHECK(FLAGS_retention > 0 && FLAGS_retention <= 1)
+      << "The retention must be in (0, 1].";
+
+  ReIDFeatures queries, features;
+  queries.Load(FLAGS_backend, argv[1], "");
+  features.Load(FLAGS_backend, argv[2], "");
+  CHECK_EQ(queries.dim(), features.dim())
+      << "Queries and gallery have embeddings of different sizes.";
+  const int num = features.num();
+  const int dim = features.dim();
+  const bool cosine = FLAGS_metric == "cosine";
+
+  ReIDGallery gallery(dim, cosine, FLAGS_type);
+  gallery.set_segment_size(FLAGS_segment_size);
+  if (FLAGS_effort > 0) {
+    gallery.set_effort(FLAGS_effort);
+  }
+  Searcher searcher;
+  searcher.gallery = &gallery;
+  searcher.queries = &queries;
+  searcher.stop = false;
+  searcher.searched = 0;
+  boost::thread search_thread(boost::bind(&Searcher::Run, &searcher));
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < num; i += FLAGS_batch_size) {
+    gallery.Add(features.data() + static_cast<size_t>(i) * dim,
+        std::min(FLAGS_batch_size, num - i), NULL);
+  }
+  float seconds = timer.Seconds();
+  int searched;
+  {
+    boost::mutex::scoped_lock lock(searcher.mutex);
+    searched = searcher.searched;
+    searcher.searched = 0;
+  }
+  LOG(INFO) << "Added " << num << " items in " << seconds << " s: "
+      << num / seconds << " items/s, while searching " << searched / seconds
+      << " queries/s.";
+
+  // Compact once, below, after all the removals.
+  gallery.set_auto_compaction(false);
+  gallery.WaitForCompaction();
+  timer.Start();
+  const int num_removed = num - static_cast<int>(FLAGS_retention * num);
+  for (int id = 0; id < num_removed; ++id) {
+    gallery.Remove(id);
+  }
+  seconds = timer.Seconds();
+  LOG(INFO) << "Removed the " << num_removed << " oldest items in " << seconds
+      << " s.";
+
+  {
+    boost::mutex::scoped_lock lock(searcher.mutex);
+    searcher.searched = 0;
+  }
+  timer.Start();
+  const int num_segments = gallery.num_segments();
+  gallery.Compact();
+  seconds = timer.Seconds();
+  {
+    boost::mutex::scoped_lock lock(searcher.mutex);
+    searched = searcher.searched;
+    searcher.stop = true;
+  }
+  search_thread.join();
+  LOG(INFO) << "Compacted " << num_segments << " segments into "
+      << gallery.num_segments() << " in " << seconds << " s, while searching "
+      << searched / std::max(seconds, 1e-6f) << " queries/s.";
+
+  timer.Start();
+  vector<vector<ReIDMatch> > results;
+  gallery.Search(queries.data(), queries.num(), NULL, FLAGS_top_k, &results,
+      NULL);
+  LOG(INFO) << "Searched the compacted gallery: "
+      << timer.MilliSeconds() / queries.num() << " ms per query.";
+  const float* kept = features.data() + static_cast<size_t>(num_removed) * dim;
+  ReIDSearch search(kept, num - num_removed, dim, cosine);
+  vector<vector<ReIDMatch> > exact;
+  search.Search(queries.data(), queries.num(), NULL, FLAGS_top_k, &exact,
+      NULL);
+  int found = 0;
+  int expected = 0;
+  for (int i = 0; i < queries.num(); ++i) {
+    // Items as near as the k-th count as found; they may tie.
+    const float kth = exact[i].empty() ? 0 : exact[i].back().distance;
+    for (int r = 0; r < results[i].size(); ++r) {
+      CHECK_GE(results[i][r].index, num_removed) << "Found a removed item.";
+      found += results[i][r].distance <= kth * (1 + 1e-5f) + 1e-6f;
+    }
+    expected += exact[i].size();
+  }
+  LOG(INFO) << "recall@" << FLAGS_top_k << " = "
+      << static_cast<float>(found) / std::max(expected, 1);
+  return 0;
+}
@@ -0,0 +1,161 @@
+// This program finds the nearest gallery images of every query image from
+// their re-identification embeddings, streaming over the gallery so that
+// the queries x gallery distance matrix is never held in memory.
+// Usage:
+//   reid_search [FLAGS] QUERY_FEATURES GALLERY_FEATURES OUTPUT
+//
+// The features are embedding stores or lmdb/leveldb databases of float
+// Datums, one per image, as written by extract_features. OUTPUT gets a line
+// per query: the query, then its top_k matches as "gallery:distance",
+// nearest first. Queries and gallery items are named, and their cameras
+// known, from an embedding store or from --query_list and --gallery_list;
+// otherwise they are named by their index.
+//
+// With --index, an approximate nearest neighbor index built over
+// GALLERY_FEATURES by reid_build_index answers instead; same-camera
+// matches are then filtered out of its 2 x top_k nearest.
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/ann_index.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/reid_evaluation.hpp"
+#include "caffe/util/reid_search.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(backend, "store",
+    "The format {store, lmdb, leveldb} of the features");
+DEFINE_string(metric, "cosine",
+    "The distance embeddings are compared with {cosine, euclidean}; an "
+    "index keeps the one it was built with");
+DEFINE_int32(top_k, 10, "Number of matches to find for each query");
+DEFINE_int32(threads, 4, "Number of threads searching");
+DEFINE_int32(block_size, 32, "Number of queries searched together");
+DEFINE_int32(tile_size, 4096,
+    "Number of gallery items compared with a block of queries at once");
+DEFINE_string(query_list, "",
+    "Optional; the image names of the queries, in feature order");
+DEFINE_string(gallery_list, "",
+    "Optional; the image names of the gallery, in feature order");
+DEFINE_string(index, "",
+    "Optional; search this approximate nearest neighbor index of the "
+    "gallery instead of the whole gallery");
+DEFINE_int32(effort, 0,
+    "With --index, the search effort: candidates for hnsw, lists probed "
+    "for ivf, candidates re-ranked exactly for pq; 0 keeps the one saved "
+    "with the index");
+DEFINE_bool(exclude_same_camera, true,
+    "Given the cameras of the queries and the gallery, leave out the "
+    "gallery images taken by the camera of the query");
+
+// The names of features, or their indices if they have none.
+static vector<string> Names(const ReIDFeatures& features) {
+  if (features.has_labels()) {
+    return features.names();
+  }
+  vector<string> names;
+  for (int i = 0; i < features.num(); ++i) {
+    names.push_back(format_int(i));
+  }
+  return names;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Find the nearest gallery images of every query\n"
+        "image from their re-identification embeddings.\n"
+        "Usage:\n"
+        "    reid_search [FLAGS] QUERY_FEATURES GALLERY_FEATURES OUTPUT\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/reid_search");
+    return 1;
+  }
+  CHECK(FLAGS_metric == "cosine" || FLAGS_metric == "euclidean")
+      << "Unknown metric " << FLAGS_metric;
+  CHECK_GT(FLAGS_threads, 0);
+
+  CPUTimer timer;
+  timer.Start();
+  ReIDFeatures queries, gallery;
+  queries.Load(FLAGS_backend, argv[1], FLAGS_query_list);
+  gallery.Load(FLAGS_backend, argv[2], FLAGS_gallery_list);
+  CHECK_EQ(queries.dim(), gallery.dim())
+      << "Queries and gallery have embeddings of different sizes.";
+  const int num_queries = queries.num();
+  const vector<string> query_names = Names(queries);
+  const vector<string> gallery_names = Names(gallery);
+  LOG(INFO) << "Loaded " << num_queries << " queries and " << gallery.num()
+      << " gallery images of dimension " << queries.dim() << " in "
+      << timer.Seconds() << " s.";
+
+  timer.Start();
+  const bool exclude_same_camera = FLAGS_exclude_same_camera &&
+      queries.has_labels() && gallery.has_labels();
+  ThreadPool pool(FLAGS_threads);
+  vector<vector<ReIDMatch> > results;
+  if (FLAGS_index.size()) {
+    boost::scoped_ptr<ANNIndex> index(LoadANNIndex(FLAGS_index));
+    CHECK_EQ(gallery.num(), index->size())
+        << "The index was not built over " << argv[2];
+    index->set_exact_embeddings(gallery.data());
+    if (FLAGS_effort > 0) {
+      index->set_effort(FLAGS_effort);
+    }
+    index->Search(queries.data(), num_queries,
+        exclude_same_camera ? 2 * FLAGS_top_k : FLAGS_top_k, &results, &pool);
+    for (int i = 0; i < num_queries && exclude_same_camera; ++i) {
+      vector<ReIDMatch> kept;
+      for (int r = 0; r < results[i].size() && kept.size() < FLAGS_top_k;
+           ++r) {
+        if (gallery.cameras()[results[i][r].index] !=
+            queries.cameras()[i]) {
+          kept.push_back(results[i][r]);
+        }
+      }
+      results[i].swap(kept);
+    }
+  } else {
+    ReIDSearch search(gallery.data(), gallery.num(), gallery.dim(),
+        FLAGS_metric == "cosine");
+    search.set_block_size(FLAGS_block_size);
+    search.set_tile_size(FLAGS_tile_size);
+    const int* cameras = NULL;
+    if (exclude_same_camera) {
+      search.set_cameras(gallery.cameras());
+      cameras = &queries.cameras()[0];
+    }
+    search.Search(queries.data(), num_queries, cameras, FLAGS_top_k,
+        &results, &pool);
+  }
+  LOG(INFO) << "Searched in " << timer.Seconds() << " s.";
+
+  std::ofstream outfile(argv[3]);
+  CHECK(outfile.good()) << "Failed to open " << argv[3];
+  for (int i = 0; i < num_queries; ++i) {
+    outfile << query_names[i];
+    for (int k = 0; k < results[i].size(); ++k) {
+      outfile << " " << gallery_names[results[i][k].index] << ":"
+          << results[i][k].distance;
+    }
+    outfile << "\n";
+  }
+  return 0;
+}
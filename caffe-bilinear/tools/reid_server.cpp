@@ -0,0 +1,762 @@
+// This program serves re-identification embeddings over a Unix domain socket.
+// Requests are coalesced into batches and run through the network on a pool
+// of workers, each with its own execution context of one loaded net.
+// Usage:
+//   reid_server serve --model=DEPLOY --weights=WEIGHTS [FLAGS]
+//   reid_server bench [FLAGS]
+//
+// A request is a RequestHeader followed by payload_bytes of payload:
+//   kTensorU8:  channels x height x width raw pixels, scaled by --scale,
+//   kTensorF32: channels x height x width floats, fed as is,
+//   kImage:     an encoded image, resized and cut into overlapping stripes
+//               stacked along the channels (requires OpenCV).
+// The reply is a ResponseHeader followed by dim floats of the embedding.
+//
+// With --cache_mb, embeddings are cached by a hash of the decoded input and
+// of the model, so that repeated crops are answered without a forward pass.
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/embedding_cache.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif  // USE_OPENCV
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::EmbeddingCache;
+using caffe::LatencyHistogram;
+using caffe::Net;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(socket, "/tmp/reid_server.sock",
+    "Path of the Unix domain socket to listen on or connect to.");
+DEFINE_string(model, "",
+    "The deploy model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights.");
+DEFINE_string(blob, "ip1_reid",
+    "The blob holding the embeddings.");
+DEFINE_int32(gpu, -1,
+    "Optional; run in GPU mode on the given device ID.");
+DEFINE_int32(workers, 1,
+    "Number of forward workers, each with its own execution context.");
+DEFINE_int32(max_batch, 32,
+    "Largest number of requests coalesced into one forward pass.");
+DEFINE_int32(max_wait_us, 2000,
+    "Longest time the first request of a batch waits for more to arrive.");
+DEFINE_double(scale, 0.00390625,
+    "Scale applied to uint8 tensors and decoded images.");
+DEFINE_int32(resize_height, 160, "Height images are resized to.");
+DEFINE_int32(resize_width, 60, "Width images are resized to.");
+DEFINE_int32(stripes, 3,
+    "Number of horizontal stripes images are cut into (0 to keep them whole).");
+DEFINE_int32(overlap, 10, "Number of rows shared by adjacent stripes.");
+DEFINE_int32(stats_interval, 10,
+    "Seconds between statistics reports of the server (0 to disable).");
+DEFINE_int32(max_payload_bytes, 16 << 20,
+    "Largest request payload accepted; connections sending more are closed.");
+DEFINE_int32(memory_pool_mb, 256,
+    "Optional; the most free memory, in MB, the memory pool keeps cached on "
+    "the host and on the devices each (-1 for no limit, 0 to cache none).");
+DEFINE_int32(cache_mb, 0,
+    "Memory for cached embeddings, in MB (0 to disable the cache).");
+DEFINE_string(cache_store, "",
+    "Optional; an embedding store the cache is loaded from at startup, if "
+    "it exists and was saved for the same model, and saved to every "
+    "--cache_save_interval seconds.");
+DEFINE_int32(cache_save_interval, 300,
+    "Seconds between saves of the cache to --cache_store.");
+DEFINE_int32(clients, 8,
+    "bench: number of concurrent connections.");
+DEFINE_int32(requests, 1000,
+    "bench: number of requests sent by each connection.");
+DEFINE_int32(channels, 9, "bench: channels of the generated tensors.");
+DEFINE_int32(height, 60, "bench: height of the generated tensors.");
+DEFINE_int32(width, 60, "bench: width of the generated tensors.");
+DEFINE_int32(distinct_inputs, 1,
+    "bench: distinct tensors each connection cycles through (0 for a new "
+    "one every request).");
+
+namespace {
+
+const uint32_t kMagic = 0x44494552;  // "REID"
+
+enum RequestKind { kTensorU8 = 0, kTensorF32 = 1, kImage = 2 };
+enum Status { kOk = 0, kBadRequest = 1, kInternalError = 2 };
+
+struct RequestHeader {
+  uint32_t magic;
+  uint32_t kind;
+  uint32_t channels;
+  uint32_t height;
+  uint32_t width;
+  uint32_t payload_bytes;
+};
+
+struct ResponseHeader {
+  uint32_t magic;
+  int32_t status;
+  uint32_t dim;
+};
+
+bool ReadFully(int fd, void* buffer, size_t size) {
+  char* data = static_cast<char*>(buffer);
+  while (size > 0) {
+    const ssize_t n = read(fd, data, size);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return false; }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool WriteFully(int fd, const void* buffer, size_t size) {
+  const char* data = static_cast<const char*>(buffer);
+  while (size > 0) {
+    const ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return false; }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+boost::posix_time::ptime Now() {
+  return boost::posix_time::microsec_clock::local_time();
+}
+
+double MicroSecondsBetween(const boost::posix_time::ptime& start,
+    const boost::posix_time::ptime& end) {
+  return (end - start).total_microseconds();
+}
+
+// One pending request: the decoded input, and the embedding filled in by
+// the worker that ran it.
+struct Request {
+  Request() : key(0), status(kOk), done(false) {}
+
+  vector<float> input;
+  int channels, height, width;
+  // The hash of the input and its shape, for the cache.
+  uint64_t key;
+  vector<float> embedding;
+  int status;
+  boost::posix_time::ptime enqueued;
+
+  bool done;
+  boost::mutex mutex;
+  boost::condition_variable condition;
+
+  void Complete(int s) {
+    boost::mutex::scoped_lock lock(mutex);
+    status = s;
+    done = true;
+    condition.notify_one();
+  }
+  void WaitDone() {
+    boost::mutex::scoped_lock lock(mutex);
+    while (!done) {
+      condition.wait(lock);
+    }
+  }
+};
+
+// Pending requests. Idle workers take turns forming batches: the one holding
+// batching_mutex_ waits for a first request, then for up to max_wait or
+// until max_batch requests are queued, whichever comes first.
+class RequestQueue {
+ public:
+  void Push(Request* request) {
+    boost::mutex::scoped_lock lock(mutex_);
+    queue_.push_back(request);
+    condition_.notify_all();
+  }
+
+  void PopBatch(int max_batch, int max_wait_us, vector<Request*>* batch) {
+    boost::mutex::scoped_lock batching_lock(batching_mutex_);
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.empty()) {
+      condition_.wait(lock);
+    }
+    const boost::system_time deadline = boost::get_system_time() +
+        boost::posix_time::microseconds(max_wait_us);
+    while (queue_.size() < max_batch) {
+      if (!condition_.timed_wait(lock, deadline)) {
+        break;
+      }
+    }
+    batch->clear();
+    while (!queue_.empty() && batch->size() < max_batch) {
+      batch->push_back(queue_.front());
+      queue_.pop_front();
+    }
+  }
+
+ private:
+  std::deque<Request*> queue_;
+  boost::mutex mutex_;
+  boost::mutex batching_mutex_;
+  boost::condition_variable condition_;
+};
+
+// Embeddings of recent inputs, shared by all connections and workers. Set
+// up by serve() with --cache_mb.
+shared_ptr<EmbeddingCache> embedding_cache;
+
+// Server-side timings, shared by all workers.
+struct ServerStats {
+  boost::mutex mutex;
+  LatencyHistogram queue_latency;
+  LatencyHistogram forward_latency;
+  LatencyHistogram reshape_latency;
+  LatencyHistogram total_latency;
+  LatencyHistogram cached_latency;
+  LatencyHistogram batch_size;
+
+  void Report() {
+    boost::mutex::scoped_lock lock(mutex);
+    if (total_latency.count() == 0 && cached_latency.count() == 0) {
+      return;
+    }
+    LOG(INFO) << "Requests:      " << total_latency.Summary();
+    if (embedding_cache) {
+      LOG(INFO) << "  cached:      " << cached_latency.Summary();
+      LOG(INFO) << "Cache:         " << embedding_cache->stats().Summary();
+    }
+    LOG(INFO) << "  queue wait:  " << queue_latency.Summary();
+    LOG(INFO) << "  forward:     " << forward_latency.Summary();
+    if (reshape_latency.count() > 0) {
+      LOG(INFO) << "  reshape:     " << reshape_latency.Summary();
+    }
+    LOG(INFO) << "Batch size:    mean=" << batch_size.mean()
+        << " p50=" << batch_size.Percentile(50)
+        << " max=" << batch_size.max();
+    LOG(INFO) << "Host memory:   "
+        << Caffe::memory_pool().host_stats().Summary();
+    // This thread is in CPU mode, whatever the workers run in.
+    const caffe::MemoryPool::Stats device = Caffe::memory_pool().device_stats();
+    if (device.requests > 0) {
+      LOG(INFO) << "Device memory: " << device.Summary();
+    }
+  }
+};
+
+// Turns decoded images into network inputs: scaled, and cut into the
+// overlapping stripes of the re-ID training data. Set up by serve(); without
+// mirror, crop or mean values it keeps no state between calls, so all
+// connections share it.
+shared_ptr<caffe::DataTransformer<float> > image_transformer;
+
+// Decodes the payload of a request into a float CHW tensor. Returns false if
+// the request is malformed.
+bool DecodeRequest(const RequestHeader& header, const vector<char>& payload,
+    Request* request) {
+  const size_t pixels =
+      static_cast<size_t>(header.channels) * header.height * header.width;
+  switch (header.kind) {
+  case kTensorU8: {
+    if (payload.size() != pixels) { return false; }
+    request->input.resize(pixels);
+    if (pixels) {
+      caffe::caffe_cpu_uint8_scale<float>(pixels,
+          reinterpret_cast<const uint8_t*>(&payload[0]), 0, FLAGS_scale,
+          false, &request->input[0]);
+    }
+    request->channels = header.channels;
+    request->height = header.height;
+    request->width = header.width;
+    return true;
+  }
+  case kTensorF32: {
+    if (payload.size() != pixels * sizeof(float)) { return false; }
+    request->input.resize(pixels);
+    if (pixels) {
+      memcpy(&request->input[0], &payload[0], payload.size());
+    }
+    request->channels = header.channels;
+    request->height = header.height;
+    request->width = header.width;
+    return true;
+  }
+  case kImage: {
+#ifdef USE_OPENCV
+    if (payload.empty()) { return false; }
+    cv::Mat encoded(1, payload.size(), CV_8UC1,
+        const_cast<char*>(&payload[0]));
+    cv::Mat image = cv::imdecode(encoded, CV_LOAD_IMAGE_COLOR);
+    if (!image.data) { return false; }
+    cv::Mat resized;
+    cv::resize(image, resized,
+        cv::Size(FLAGS_resize_width, FLAGS_resize_height));
+    const vector<int> shape = image_transformer->InferBlobShape(resized);
+    Blob<float> input(shape);
+    request->input.resize(input.count());
+    input.set_cpu_data(&request->input[0]);
+    image_transformer->Transform(resized, &input);
+    request->channels = shape[1];
+    request->height = shape[2];
+    request->width = shape[3];
+    return true;
+#else
+    LOG(ERROR) << "Image requests require OpenCV; compile with USE_OPENCV.";
+    return false;
+#endif  // USE_OPENCV
+  }
+  default:
+    return false;
+  }
+}
+
+// Runs batches on its own execution context of the served net.
+class Worker {
+ public:
+  Worker(shared_ptr<Net<float> > net, RequestQueue* queue, ServerStats* stats)
+      : net_(net), queue_(queue), stats_(stats) {
+    CHECK_EQ(net_->num_inputs(), 1) << "The served net must have one input.";
+    CHECK(net_->has_blob(FLAGS_blob)) << "Unknown blob " << FLAGS_blob;
+    output_ = net_->blob_by_name(FLAGS_blob);
+  }
+
+  void Run(Caffe::Brew mode, int device) {
+    // Caffe's state is thread-local.
+    if (mode == Caffe::GPU) {
+      Caffe::SetDevice(device);
+    }
+    Caffe::set_mode(mode);
+    vector<Request*> batch;
+    while (true) {
+      queue_->PopBatch(FLAGS_max_batch, FLAGS_max_wait_us, &batch);
+      RunBatch(batch);
+    }
+  }
+
+ protected:
+  void RunBatch(const vector<Request*>& batch) {
+    const boost::posix_time::ptime start = Now();
+    Blob<float>* input = net_->input_blobs()[0];
+    vector<Request*> valid;
+    for (int i = 0; i < batch.size(); ++i) {
+      if (batch[i]->channels == input->shape(1) &&
+          batch[i]->height == input->shape(2) &&
+          batch[i]->width == input->shape(3)) {
+        valid.push_back(batch[i]);
+      } else {
+        batch[i]->Complete(kBadRequest);
+      }
+    }
+    if (valid.empty()) {
+      return;
+    }
+    vector<int> shape = input->shape();
+    double reshape_us = -1;
+    if (shape[0] != valid.size()) {
+      // The net is reserved for max_batch: this only updates shapes.
+      const boost::posix_time::ptime reshape_start = Now();
+      shape[0] = valid.size();
+      input->Reshape(shape);
+      net_->Reshape();
+      reshape_us = MicroSecondsBetween(reshape_start, Now());
+    }
+    const int dim = input->count(1);
+    float* input_data = input->mutable_cpu_data();
+    for (int i = 0; i < valid.size(); ++i) {
+      std::copy(valid[i]->input.begin(), valid[i]->input.end(),
+          input_data + i * dim);
+    }
+    net_->Forward();
+    const int embedding_dim = output_->count(1);
+    const float* output_data = output_->cpu_data();
+    const boost::posix_time::ptime end = Now();
+    {
+      boost::mutex::scoped_lock lock(stats_->mutex);
+      stats_->batch_size.Add(valid.size());
+      stats_->forward_latency.Add(MicroSecondsBetween(start, end));
+      if (reshape_us >= 0) {
+        stats_->reshape_latency.Add(reshape_us);
+      }
+      for (int i = 0; i < valid.size(); ++i) {
+        stats_->queue_latency.Add(
+            MicroSecondsBetween(valid[i]->enqueued, start));
+        stats_->total_latency.Add(
+            MicroSecondsBetween(valid[i]->enqueued, end));
+      }
+    }
+    for (int i = 0; i < valid.size(); ++i) {
+      valid[i]->embedding.assign(output_data + i * embedding_dim,
+          output_data + (i + 1) * embedding_dim);
+      if (embedding_cache) {
+        embedding_cache->Insert(valid[i]->key, &valid[i]->embedding[0]);
+      }
+      valid[i]->Complete(kOk);
+    }
+  }
+
+  shared_ptr<Net<float> > net_;
+  shared_ptr<Blob<float> > output_;
+  RequestQueue* queue_;
+  ServerStats* stats_;
+};
+
+// A digest of the definition and weights of net and of the blob served, so
+// that embeddings cached for one model are never served for another.
+uint64_t ModelDigest(const Net<float>& net) {
+  caffe::NetParameter param;
+  net.ToProto(&param, false);
+  string bytes;
+  param.SerializeToString(&bytes);
+  const uint64_t digest = EmbeddingCache::Hash(bytes.data(), bytes.size());
+  return EmbeddingCache::Hash(FLAGS_blob.data(), FLAGS_blob.size(), digest);
+}
+
+// The cache key of a decoded request: a hash of its input, chained from one
+// of its shape and of the model.
+uint64_t RequestKey(const Request& request) {
+  const uint32_t shape[3] = {static_cast<uint32_t>(request.channels),
+      static_cast<uint32_t>(request.height),
+      static_cast<uint32_t>(request.width)};
+  const uint64_t seed = EmbeddingCache::Hash(shape, sizeof(shape),
+      embedding_cache->model());
+  return EmbeddingCache::Hash(request.input.empty() ? NULL :
+      &request.input[0], request.input.size() * sizeof(float), seed);
+}
+
+// Serves the requests of one connection in order until the peer hangs up.
+void ServeConnection(int fd, RequestQueue* queue, ServerStats* stats) {
+  RequestHeader header;
+  vector<char> payload;
+  while (ReadFully(fd, &header, sizeof(header))) {
+    if (header.magic != kMagic) {
+      LOG(ERROR) << "Bad request magic, closing connection.";
+      break;
+    }
+    // Checked before the payload is allocated, since the size comes from
+    // the client.
+    if (header.payload_bytes >
+        static_cast<uint32_t>(FLAGS_max_payload_bytes)) {
+      LOG(ERROR) << "Request payload of " << header.payload_bytes
+          << " bytes exceeds --max_payload_bytes, closing connection.";
+      break;
+    }
+    payload.resize(header.payload_bytes);
+    if (header.payload_bytes &&
+        !ReadFully(fd, &payload[0], header.payload_bytes)) {
+      break;
+    }
+    Request request;
+    request.enqueued = Now();
+    if (DecodeRequest(header, payload, &request)) {
+      bool cached = false;
+      if (embedding_cache) {
+        request.key = RequestKey(request);
+        request.embedding.resize(embedding_cache->dim());
+        cached = embedding_cache->Lookup(request.key, &request.embedding[0]);
+      }
+      if (cached) {
+        boost::mutex::scoped_lock lock(stats->mutex);
+        stats->cached_latency.Add(MicroSecondsBetween(request.enqueued,
+            Now()));
+      } else {
+        queue->Push(&request);
+        request.WaitDone();
+      }
+    } else {
+      request.status = kBadRequest;
+    }
+    ResponseHeader response;
+    response.magic = kMagic;
+    response.status = request.status;
+    response.dim = request.status == kOk ? request.embedding.size() : 0;
+    if (!WriteFully(fd, &response, sizeof(response)) ||
+        (response.dim && !WriteFully(fd, &request.embedding[0],
+                                     response.dim * sizeof(float)))) {
+      break;
+    }
+  }
+  close(fd);
+}
+
+void SaveCache() {
+  while (true) {
+    boost::this_thread::sleep(
+        boost::posix_time::seconds(FLAGS_cache_save_interval));
+    caffe::CPUTimer timer;
+    timer.Start();
+    embedding_cache->Save(FLAGS_cache_store);
+    LOG(INFO) << "Saved " << embedding_cache->stats().size
+        << " cached embeddings to " << FLAGS_cache_store << " in "
+        << timer.MilliSeconds() << " ms.";
+  }
+}
+
+void ReportStats(ServerStats* stats) {
+  while (true) {
+    boost::this_thread::sleep(boost::posix_time::seconds(FLAGS_stats_interval));
+    stats->Report();
+  }
+}
+
+int ConnectToServer() {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(fd, 0) << "socket: " << strerror(errno);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  CHECK_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "connect " << FLAGS_socket << ": "
+      << strerror(errno);
+  return fd;
+}
+
+// Load generator connection: sends random uint8 tensors back to back.
+void RunClient(int client_id, LatencyHistogram* latency, int* failures) {
+  const int fd = ConnectToServer();
+  RequestHeader header;
+  header.magic = kMagic;
+  header.kind = kTensorU8;
+  header.channels = FLAGS_channels;
+  header.height = FLAGS_height;
+  header.width = FLAGS_width;
+  header.payload_bytes = FLAGS_channels * FLAGS_height * FLAGS_width;
+  vector<char> payload(header.payload_bytes);
+  int current = -1;
+  vector<float> embedding;
+  for (int i = 0; i < FLAGS_requests; ++i) {
+    // Connections cycle through distinct_inputs tensors of their own, to
+    // hit the cache.
+    const int input = FLAGS_distinct_inputs ? i % FLAGS_distinct_inputs : i;
+    if (input != current) {
+      caffe::rng_t rng(client_id + input * FLAGS_clients);
+      for (int j = 0; j < payload.size(); ++j) {
+        payload[j] = static_cast<char>(rng());
+      }
+      current = input;
+    }
+    const boost::posix_time::ptime start = Now();
+    ResponseHeader response;
+    CHECK(WriteFully(fd, &header, sizeof(header)));
+    CHECK(WriteFully(fd, &payload[0], payload.size()));
+    CHECK(ReadFully(fd, &response, sizeof(response)));
+    CHECK_EQ(response.magic, kMagic);
+    embedding.resize(response.dim);
+    if (response.dim) {
+      CHECK(ReadFully(fd, &embedding[0], response.dim * sizeof(float)));
+    }
+    if (response.status != kOk) {
+      ++*failures;
+    }
+    latency->Add(MicroSecondsBetween(start, Now()));
+  }
+  close(fd);
+}
+
+}  // namespace
+
+// A simple registry for commands, as in tools/caffe.cpp.
+typedef int (*BrewFunction)();
+typedef std::map<caffe::string, BrewFunction> BrewMap;
+BrewMap g_brew_map;
+
+#define RegisterBrewFunction(func) \
+namespace { \
+class __Registerer_##func { \
+ public: /* NOLINT */ \
+  __Registerer_##func() { \
+    g_brew_map[#func] = &func; \
+  } \
+}; \
+__Registerer_##func g_registerer_##func; \
+}
+
+static BrewFunction GetBrewFunction(const caffe::string& name) {
+  if (g_brew_map.count(name)) {
+    return g_brew_map[name];
+  } else {
+    LOG(ERROR) << "Available reid_server actions:";
+    for (BrewMap::iterator it = g_brew_map.begin();
+         it != g_brew_map.end(); ++it) {
+      LOG(ERROR) << "\t" << it->first;
+    }
+    LOG(FATAL) << "Unknown action: " << name;
+    return NULL;  // not reachable, just to suppress old compiler warnings.
+  }
+}
+
+// Serve: load the net and answer embedding requests until killed.
+int serve() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to serve.";
+  CHECK_GT(FLAGS_workers, 0);
+  CHECK_GE(FLAGS_max_payload_bytes, 0);
+  CHECK_GT(FLAGS_max_batch, 0);
+  Caffe::Brew mode = Caffe::CPU;
+  if (FLAGS_gpu >= 0) {
+    LOG(INFO) << "Use GPU with device ID " << FLAGS_gpu;
+    Caffe::SetDevice(FLAGS_gpu);
+    mode = Caffe::GPU;
+  }
+  Caffe::set_mode(mode);
+  caffe::TransformationParameter transform_param;
+  transform_param.set_scale(FLAGS_scale);
+  transform_param.set_stripes(FLAGS_stripes);
+  transform_param.set_stripe_overlap(FLAGS_overlap);
+  image_transformer.reset(
+      new caffe::DataTransformer<float>(transform_param, caffe::TEST));
+  // Serving never runs backward: keep no diffs.
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  net_param.set_inference(true);
+  shared_ptr<Net<float> > net(new Net<float>(net_param));
+  if (FLAGS_weights.size()) {
+    net->CopyTrainedLayersFrom(FLAGS_weights);
+  }
+  // Size every context for the largest batch, so that batches of any size
+  // run without allocating.
+  net->Reserve(FLAGS_max_batch);
+  if (FLAGS_cache_mb > 0) {
+    CHECK(net->has_blob(FLAGS_blob)) << "Unknown blob " << FLAGS_blob;
+    const int dim = net->blob_by_name(FLAGS_blob)->count(1);
+    const int64_t capacity = (static_cast<int64_t>(FLAGS_cache_mb) << 20) /
+        (dim * sizeof(float));
+    embedding_cache.reset(new EmbeddingCache(dim,
+        std::max<int64_t>(std::min<int64_t>(capacity, INT_MAX), 1),
+        ModelDigest(*net)));
+    if (!FLAGS_cache_store.empty() &&
+        access(FLAGS_cache_store.c_str(), F_OK) == 0) {
+      LOG(INFO) << "Loaded " << embedding_cache->Load(FLAGS_cache_store)
+          << " cached embeddings from " << FLAGS_cache_store;
+    }
+    LOG(INFO) << "Caching up to " << embedding_cache->capacity()
+        << " embeddings.";
+  }
+
+  RequestQueue queue;
+  ServerStats stats;
+  vector<shared_ptr<Worker> > workers;
+  boost::thread_group threads;
+  for (int i = 0; i < FLAGS_workers; ++i) {
+    shared_ptr<Net<float> > context = i == 0 ? net : net->CreateContext();
+    if (i > 0) {
+      context->Reserve(FLAGS_max_batch);
+    }
+    workers.push_back(shared_ptr<Worker>(new Worker(context, &queue, &stats)));
+    threads.create_thread(boost::bind(&Worker::Run, workers.back().get(),
+        mode, FLAGS_gpu));
+  }
+  if (FLAGS_stats_interval > 0) {
+    threads.create_thread(boost::bind(&ReportStats, &stats));
+  }
+  if (embedding_cache && !FLAGS_cache_store.empty() &&
+      FLAGS_cache_save_interval > 0) {
+    threads.create_thread(&SaveCache);
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listener, 0) << "socket: " << strerror(errno);
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long.";
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  unlink(FLAGS_socket.c_str());
+  CHECK_EQ(bind(listener, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "bind " << FLAGS_socket << ": "
+      << strerror(errno);
+  CHECK_EQ(listen(listener, 128), 0) << "listen: " << strerror(errno);
+  // A client hanging up mid-reply must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+  LOG(INFO) << "Serving " << FLAGS_blob << " on " << FLAGS_socket << " with "
+      << FLAGS_workers << " workers, max batch " << FLAGS_max_batch
+      << ", max wait " << FLAGS_max_wait_us << " us.";
+  while (true) {
+    const int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR) { continue; }
+      LOG(FATAL) << "accept: " << strerror(errno);
+    }
+    boost::thread(boost::bind(&ServeConnection, fd, &queue, &stats)).detach();
+  }
+  return 0;
+}
+RegisterBrewFunction(serve);
+
+// Bench: generate load against a running server and report throughput and
+// end-to-end latency.
+int bench() {
+  CHECK_GT(FLAGS_clients, 0);
+  vector<LatencyHistogram> latencies(FLAGS_clients);
+  vector<int> failures(FLAGS_clients, 0);
+  caffe::CPUTimer timer;
+  timer.Start();
+  boost::thread_group threads;
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    threads.create_thread(boost::bind(&RunClient, i, &latencies[i],
+        &failures[i]));
+  }
+  threads.join_all();
+  timer.Stop();
+  LatencyHistogram latency;
+  int failed = 0;
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    latency.Merge(latencies[i]);
+    failed += failures[i];
+  }
+  LOG(INFO) << "Sent " << latency.count() << " requests over "
+      << FLAGS_clients << " connections in " << timer.Seconds() << " s: "
+      << latency.count() / timer.Seconds() << " requests/s, "
+      << failed << " failed.";
+  LOG(INFO) << "Latency: " << latency.Summary();
+  return failed ? 1 : 0;
+}
+RegisterBrewFunction(bench);
+
+int main(int argc, char** argv) {
+  // Print output to stderr (while still logging).
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("re-ID embedding server\n"
+      "usage: reid_server <command> <args>\n\n"
+      "commands:\n"
+      "  serve           serve embeddings over a Unix domain socket\n"
+      "  bench           generate load against a running server");
+  caffe::GlobalInit(&argc, &argv);
+  Caffe::memory_pool().set_cache_limit(FLAGS_memory_pool_mb < 0 ?
+      static_cast<size_t>(-1) :
+      static_cast<size_t>(FLAGS_memory_pool_mb) << 20);
+  if (argc == 2) {
+    return GetBrewFunction(caffe::string(argv[1]))();
+  } else {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/reid_server");
+  }
+}